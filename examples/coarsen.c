@@ -121,6 +121,8 @@ int main (int argc, char * argv[])
   GtsPSurface * ps = NULL;
   gboolean verbose = FALSE;
   gboolean progressive = FALSE;
+  gboolean binary = FALSE;
+  gdouble step = 0.;
   gboolean log_cost = FALSE;
   guint number = 0;
   gdouble cmax = 0.0;
@@ -146,6 +148,7 @@ int main (int argc, char * argv[])
     static struct option long_options[] = {
       {"angle", no_argument, NULL, 'a'},
       {"progressive", no_argument, NULL, 'p'},
+      {"binary", required_argument, NULL, 'B'},
       {"help", no_argument, NULL, 'h'},
       {"verbose", no_argument, NULL, 'v'},
       {"number", required_argument, NULL, 'n'},
@@ -160,10 +163,10 @@ int main (int argc, char * argv[])
       { NULL }
     };
     int option_index = 0;
-    switch ((c = getopt_long (argc, argv, "hvmc:n:lpf:w:b:s:La",
+    switch ((c = getopt_long (argc, argv, "hvmc:n:lpB:f:w:b:s:La",
 			      long_options, &option_index))) {
 #else /* not HAVE_GETOPT_LONG */
-    switch ((c = getopt (argc, argv, "hvmc:n:lpf:w:b:s:La"))) {
+    switch ((c = getopt (argc, argv, "hvmc:n:lpB:f:w:b:s:La"))) {
 #endif /* not HAVE_GETOPT_LONG */
     case 'a': /* angle */
       cost = COST_ANGLE;
@@ -174,6 +177,10 @@ int main (int argc, char * argv[])
     case 'p': /* write progressive surface */
       progressive = TRUE;
       break;
+    case 'B': /* write binary progressive surface */
+      progressive = binary = TRUE;
+      step = strtod (optarg, NULL);
+      break;
     case 'n': /* stop by number */
       stop = NUMBER;
       number = strtol (optarg, NULL, 0);
@@ -225,6 +232,9 @@ int main (int argc, char * argv[])
 	     "  -s W, --sweight=W   set weight used for shape optimization\n"
 	     "                      default is 0.0\n"
 	     "  -p    --progressive write progressive surface file\n"
+	     "  -B Q, --binary=Q    write binary progressive surface file, using\n"
+	     "                      a quantization step Q for the split vertices\n"
+	     "                      (0 for no quantization)\n"
 	     "  -L    --log         logs the evolution of the cost\n"
 	     "  -v    --verbose     print statistics about the surface\n"
 	     "  -h    --help        display this help and exit\n"
@@ -244,7 +254,7 @@ int main (int argc, char * argv[])
 		       gts_face_class (),
 		       gts_edge_class (),
 		       gts_vertex_class ());
-  fp = gts_file_new (stdin);
+  fp = gts_file_new_mapped (stdin);
   if (gts_surface_read (s, fp)) {
     fputs ("coarsen: the file on standard input is not a valid GTS file\n", 
 	   stderr);
@@ -327,7 +337,9 @@ int main (int argc, char * argv[])
   }
 
   /* write resulting surface to standard output */
-  if (progressive)
+  if (binary)
+    gts_psurface_write_binary (ps, stdout, step);
+  else if (progressive)
     gts_psurface_write (ps, stdout);
   else
     gts_surface_write (s, stdout);
@@ -22,13 +22,19 @@
 #include <math.h>
 #include "gts.h"
 
+#ifdef NATIVE_WIN32
+#  include <fcntl.h>
+#  include <io.h>
+#endif 
+
 int main (int argc, char * argv[])
 {
   GtsSurface * s;
   GtsBBox * bbox;
   gdouble delta;
   GtsPoint * p1, * p2, * p3;
-  guint nt;
+  guint64 nt;
+  gint c;
   GtsRange cluster_stats;
   GtsClusterGrid * cluster_grid;
   
@@ -40,37 +46,61 @@ int main (int argc, char * argv[])
     return 1;
   }
 
+#ifdef NATIVE_WIN32
+  _setmode (_fileno (stdin), _O_BINARY);
+#endif 
+
   s = gts_surface_new (gts_surface_class (),
 		       gts_face_class (),
 		       gts_edge_class (),
 		       gts_vertex_class ());
 
   bbox = gts_bbox_new (gts_bbox_class (), s, 0., 0., 0., 0., 0., 0.);
-  scanf ("%u", &nt);
-  scanf ("%lf %lf %lf", &bbox->x1, &bbox->y1, &bbox->z1);
-  scanf ("%lf %lf %lf", &bbox->x2, &bbox->y2, &bbox->z2);
+  /* binary triangle soups (see gtssoup) start with a signature,
+     text input with the number of triangles */
+  c = getc (stdin);
+  ungetc (c, stdin);
+  if (c == 'G') {
+    if (!gts_triangle_soup_read_header (stdin, &nt, bbox)) {
+      fputs ("oocs: invalid triangle soup header\n", stderr);
+      return 1;
+    }
+  }
+  else {
+    guint n = 0;
+
+    scanf ("%u", &n);
+    nt = n;
+    scanf ("%lf %lf %lf", &bbox->x1, &bbox->y1, &bbox->z1);
+    scanf ("%lf %lf %lf", &bbox->x2, &bbox->y2, &bbox->z2);
+  }
   delta = strtod (argv[1], NULL)*sqrt (gts_bbox_diagonal2 (bbox));
 
   cluster_grid = gts_cluster_grid_new (gts_cluster_grid_class (), 
 				       gts_cluster_class (), 
 				       s, bbox, delta);
 
-  p1 = gts_point_new (gts_point_class (), 0., 0., 0.);
-  p2 = gts_point_new (gts_point_class (), 0., 0., 0.);
-  p3 = gts_point_new (gts_point_class (), 0., 0., 0.);
+  if (c == 'G')
+    nt = gts_cluster_grid_read_triangle_soup (cluster_grid, stdin, nt, NULL);
+  else {
+    p1 = gts_point_new (gts_point_class (), 0., 0., 0.);
+    p2 = gts_point_new (gts_point_class (), 0., 0., 0.);
+    p3 = gts_point_new (gts_point_class (), 0., 0., 0.);
 
-  while (scanf ("%lf %lf %lf", &p1->x, &p1->y, &p1->z) == 3 &&
-	 scanf ("%lf %lf %lf", &p2->x, &p2->y, &p2->z) == 3 &&
-	 scanf ("%lf %lf %lf", &p3->x, &p3->y, &p3->z) == 3)
-    gts_cluster_grid_add_triangle (cluster_grid, p1, p2, p3, NULL);
-  cluster_stats = gts_cluster_grid_update (cluster_grid);
+    while (scanf ("%lf %lf %lf", &p1->x, &p1->y, &p1->z) == 3 &&
+	   scanf ("%lf %lf %lf", &p2->x, &p2->y, &p2->z) == 3 &&
+	   scanf ("%lf %lf %lf", &p3->x, &p3->y, &p3->z) == 3)
+      gts_cluster_grid_add_triangle (cluster_grid, p1, p2, p3, NULL);
 
-  gts_object_destroy (GTS_OBJECT (p1));
-  gts_object_destroy (GTS_OBJECT (p2));
-  gts_object_destroy (GTS_OBJECT (p3));
+    gts_object_destroy (GTS_OBJECT (p1));
+    gts_object_destroy (GTS_OBJECT (p2));
+    gts_object_destroy (GTS_OBJECT (p3));
+  }
+  cluster_stats = gts_cluster_grid_update (cluster_grid);
   gts_object_destroy (GTS_OBJECT (cluster_grid));
 
-  fprintf (stderr, "Initial number of triangles: %u\n", nt);
+  fprintf (stderr, "Initial number of triangles: %" G_GUINT64_FORMAT "\n", 
+	   nt);
   fprintf (stderr, "%d clusters of size: min: %g avg: %.1f|%.1f max: %g\n",
 	   cluster_stats.n,
 	   cluster_stats.min, 
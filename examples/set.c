@@ -138,7 +138,7 @@ int main (int argc, char * argv[])
   }
   /* reads in first surface file */
   s1 = GTS_SURFACE (gts_object_new (GTS_OBJECT_CLASS (gts_surface_class ())));
-  fp = gts_file_new (fptr);
+  fp = gts_file_new_mapped (fptr);
   if (gts_surface_read (s1, fp)) {
     fprintf (stderr, "set: `%s' is not a valid GTS surface file\n", 
 	     file1);
@@ -155,7 +155,7 @@ int main (int argc, char * argv[])
   }
   /* reads in second surface file */
   s2 = GTS_SURFACE (gts_object_new (GTS_OBJECT_CLASS (gts_surface_class ())));
-  fp = gts_file_new (fptr);
+  fp = gts_file_new_mapped (fptr);
   if (gts_surface_read (s2, fp)) {
     fprintf (stderr, "set: `%s' is not a valid GTS surface file\n", 
 	     file2);
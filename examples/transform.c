@@ -38,6 +38,7 @@ int main (int argc, char * argv[])
   gboolean verbose = FALSE;
   gboolean revert = FALSE;
   gboolean normalize = FALSE;
+  gboolean binary = FALSE;
 
   if (!setlocale (LC_ALL, "POSIX"))
     g_warning ("cannot set locale to POSIX");
@@ -60,19 +61,23 @@ int main (int argc, char * argv[])
       {"tz", required_argument, NULL, 'w'},
       {"revert", no_argument, NULL, 'i'},
       {"normalize", no_argument, NULL, 'o'},
+      {"binary", no_argument, NULL, 'b'},
       {"help", no_argument, NULL, 'h'},
       {"verbose", no_argument, NULL, 'v'},
       { NULL }
     };
     int option_index = 0;
-    switch ((c = getopt_long (argc, argv, "hvr:m:n:s:R:M:N:it:u:w:o",
+    switch ((c = getopt_long (argc, argv, "hvr:m:n:s:R:M:N:it:u:w:ob",
 			      long_options, &option_index))) {
 #else /* not HAVE_GETOPT_LONG */
-    switch ((c = getopt (argc, argv, "hvr:m:n:s:R:M:N:it:u:w:o"))) {
+    switch ((c = getopt (argc, argv, "hvr:m:n:s:R:M:N:it:u:w:ob"))) {
 #endif /* not HAVE_GETOPT_LONG */
     case 'o': /* normalize */
       normalize = TRUE;
       break;
+    case 'b': /* binary */
+      binary = TRUE;
+      break;
     case 'r': { /* rotate around x-axis */
       gdouble angle, cosa, sina;
       GtsMatrix * rot, * p;
@@ -202,6 +207,7 @@ int main (int argc, char * argv[])
 	     "  -i        --revert        turn surface inside out\n"
              "  -o        --normalize     fit the resulting surface in a cube of\n"
 	     "                            size 1 centered at the origin\n"
+	     "  -b        --binary        write the resulting surface in binary format\n"
 	     "  -v        --verbose       print statistics about the surface\n"
 	     "  -h        --help          display this help and exit\n"
 	     "\n"
@@ -219,7 +225,7 @@ int main (int argc, char * argv[])
 		       gts_face_class (),
 		       gts_edge_class (),
 		       gts_vertex_class ());
-  fp = gts_file_new (stdin);
+  fp = gts_file_new_mapped (stdin);
   if (gts_surface_read (s, fp)) {
     fputs ("transform: file on standard input is not a valid GTS file\n", 
 	   stderr);
@@ -252,7 +258,10 @@ int main (int argc, char * argv[])
     gts_surface_foreach_vertex (s, (GtsFunc) gts_point_transform, sc);
     gts_matrix_destroy (sc);
   }
-  gts_surface_write (s, stdout);
+  if (binary)
+    gts_surface_write_binary (s, stdout);
+  else
+    gts_surface_write (s, stdout);
 
   return 0;
 }
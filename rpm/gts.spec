@@ -32,8 +32,8 @@ BuildRequires: gtk-doc >= 1.3-4, netpbm-devel
 %endif
 
 # For both distros
-Requires: glib2
-BuildRequires: glib2-devel
+Requires: glib2 >= 2.36
+BuildRequires: glib2-devel >= 2.36
 
 %package devel
 Summary: Development files for gts
@@ -42,7 +42,7 @@ Group: Productivity/Scientific/Other
 %else
 Group: Applications/Engineering
 %endif
-Requires: glib2-devel
+Requires: glib2-devel >= 2.36
 Requires: %{name} = %{version}-%{release}
 
 %package doc
@@ -33,10 +33,18 @@
  * distance between an object and a collection of others using
  * gts_bb_tree_point_distance(), gts_bb_tree_segment_distance(),
  * gts_bb_tree_triangle_distance() or gts_bb_tree_surface_distance()
+ *
+ * The trees created by gts_bb_tree_new() are made of #GNode and of
+ * one #GtsBBox for each node. A #GtsBVH is the same kind of tree
+ * stored in a few flat arrays. It is faster to build and to query and
+ * uses much less memory. The gts_bvh_*() functions are the
+ * equivalents of the gts_bb_tree_*() functions for #GtsBVH and
+ * gts_bvh_new_from_bb_tree() can be used to convert an existing tree.
  */
 
 
 #include <math.h>
+#include <string.h>
 #include "gts.h"
 
 static void bbox_init (GtsBBox * bbox)
@@ -400,33 +408,17 @@ void gts_bbox_draw (GtsBBox * bb, FILE * fptr)
 #define MINMAX(x1, x2, xmin, xmax) { if (x1 < x2) { xmin = x1; xmax = x2; }\
                                      else { xmin = x2; xmax = x1; } }
 
-/**
- * gts_bbox_point_distance2:
- * @bb: a #GtsBBox.
- * @p: a #GtsPoint.
- * @min: a pointer on a gdouble.
- * @max: a pointer on a gdouble.
- * 
- * Sets @min and @max to lower and upper bounds for the square of the
- * Euclidean distance between the object contained in @bb and @p. For these
- * bounds to make any sense the bounding box must be "tight" i.e. each of the
- * 6 faces of the box must at least be touched by one point of the bounded
- * object.
- */
-void gts_bbox_point_distance2 (GtsBBox * bb, GtsPoint * p,
-			       gdouble * min, gdouble * max)
+/* @b are the coordinates x1, y1, z1, x2, y2, z2 of a bounding box,
+   see gts_bbox_point_distance2() */
+static void bounds_point_distance2 (const gdouble * b, GtsPoint * p,
+				    gdouble * min, gdouble * max)
 {
   gdouble x1, y1, z1, x2, y2, z2, x, y, z;
   gdouble dmin, dmax, xd1, xd2, yd1, yd2, zd1, zd2;
   gdouble mx, Mx, my, My, mz, Mz;
-    
-  g_return_if_fail (bb != NULL);
-  g_return_if_fail (p != NULL);
-  g_return_if_fail (min != NULL);
-  g_return_if_fail (max != NULL);
 
-  x1 = bb->x1; y1 = bb->y1; z1 = bb->z1; 
-  x2 = bb->x2; y2 = bb->y2; z2 = bb->z2;
+  x1 = b[0]; y1 = b[1]; z1 = b[2]; 
+  x2 = b[3]; y2 = b[4]; z2 = b[5];
   x = p->x; y = p->y; z = p->z;
 
   xd1 = (x1 - x)*(x1 - x);
@@ -452,6 +444,30 @@ void gts_bbox_point_distance2 (GtsBBox * bb, GtsPoint * p,
   *max = dmax;
 }
 
+/**
+ * gts_bbox_point_distance2:
+ * @bb: a #GtsBBox.
+ * @p: a #GtsPoint.
+ * @min: a pointer on a gdouble.
+ * @max: a pointer on a gdouble.
+ * 
+ * Sets @min and @max to lower and upper bounds for the square of the
+ * Euclidean distance between the object contained in @bb and @p. For these
+ * bounds to make any sense the bounding box must be "tight" i.e. each of the
+ * 6 faces of the box must at least be touched by one point of the bounded
+ * object.
+ */
+void gts_bbox_point_distance2 (GtsBBox * bb, GtsPoint * p,
+			       gdouble * min, gdouble * max)
+{
+  g_return_if_fail (bb != NULL);
+  g_return_if_fail (p != NULL);
+  g_return_if_fail (min != NULL);
+  g_return_if_fail (max != NULL);
+
+  bounds_point_distance2 (&bb->x1, p, min, max);
+}
+
 /**
  * gts_bbox_is_stabbed:
  * @bb: a #GtsBBox.
@@ -1016,38 +1032,27 @@ GtsPoint * gts_bb_tree_point_closest (GNode * tree,
   return np;  
 }
 
-/**
- * gts_bb_tree_triangle_distance:
- * @tree: a bounding box tree.
- * @t: a #GtsTriangle.
- * @distance: a #GtsBBoxDistFunc.
- * @delta: spatial scale of the sampling to be used.
- * @range: a #GtsRange to be filled with the results.
- * 
- * Given a triangle @t, points are sampled regularly on its surface
- * using @delta as increment. The distance from each of these points
- * to the closest object of @tree is computed using @distance and the
- * gts_bb_tree_point_distance() function. The fields of @range are
- * filled with the number of points sampled, the minimum, average and
- * maximum value and the standard deviation.  
- */
-void gts_bb_tree_triangle_distance (GNode * tree,
-				    GtsTriangle * t,
-				    GtsBBoxDistFunc distance,
-				    gdouble delta,
-				    GtsRange * range)
+/* gts_bb_tree_point_distance() or gts_bvh_point_distance() */
+typedef gdouble (* PointDistanceFunc) (gpointer tree,
+				       GtsPoint * p,
+				       GtsBBoxDistFunc distance,
+				       GtsBBox ** bbox);
+
+typedef void (* SampleFunc) (GtsPoint * p, gpointer data);
+
+/* Sets @p to points sampled regularly on the surface of @t using
+   @delta as increment and calls @func for each of them */
+static void triangle_sample (GtsTriangle * t,
+			     gdouble delta,
+			     GtsPoint * p,
+			     SampleFunc func,
+			     gpointer data)
 {
-  GtsPoint * p1, * p2, * p3, * p;
+  GtsPoint * p1, * p2, * p3;
   GtsVector p1p2, p1p3;
   gdouble l1, t1, dt1;
   guint i, n1;
 
-  g_return_if_fail (tree != NULL);
-  g_return_if_fail (t != NULL);
-  g_return_if_fail (distance != NULL);
-  g_return_if_fail (delta > 0.);
-  g_return_if_fail (range != NULL);
-
   gts_triangle_vertices (t, 
 			 (GtsVertex **) &p1, 
 			 (GtsVertex **) &p2, 
@@ -1055,8 +1060,6 @@ void gts_bb_tree_triangle_distance (GNode * tree,
 
   gts_vector_init (p1p2, p1, p2);
   gts_vector_init (p1p3, p1, p3);
-  gts_range_init (range);
-  p = GTS_POINT (gts_object_new (GTS_OBJECT_CLASS (gts_point_class ())));
 
   l1 = sqrt (gts_vector_scalar (p1p2, p1p2));
   n1 = l1/delta + 1;
@@ -1081,48 +1084,83 @@ void gts_bb_tree_triangle_distance (GNode * tree,
       p->y = y + t2*p1p3[1];
       p->z = z + t2*p1p3[2];
 
-      gts_range_add_value (range,
-		    gts_bb_tree_point_distance (tree, p, distance, NULL));
+      (* func) (p, data);
     }
   }
+}
+
+static void add_point_distance (GtsPoint * p, gpointer * data)
+{
+  PointDistanceFunc point_distance = data[1];
+
+  gts_range_add_value (data[3], 
+		       (* point_distance) (data[0], p, data[2], NULL));
+}
+
+static void triangle_distance (gpointer tree,
+			       PointDistanceFunc point_distance,
+			       GtsTriangle * t,
+			       GtsBBoxDistFunc distance,
+			       gdouble delta,
+			       GtsRange * range)
+{
+  GtsPoint * p;
+  gpointer data[4];
 
+  gts_range_init (range);
+  p = GTS_POINT (gts_object_new (GTS_OBJECT_CLASS (gts_point_class ())));
+  data[0] = tree;
+  data[1] = point_distance;
+  data[2] = distance;
+  data[3] = range;
+  triangle_sample (t, delta, p, (SampleFunc) add_point_distance, data);
   gts_object_destroy (GTS_OBJECT (p));
   gts_range_update (range);
 }
 
 /**
- * gts_bb_tree_segment_distance:
+ * gts_bb_tree_triangle_distance:
  * @tree: a bounding box tree.
- * @s: a #GtsSegment.
+ * @t: a #GtsTriangle.
  * @distance: a #GtsBBoxDistFunc.
  * @delta: spatial scale of the sampling to be used.
  * @range: a #GtsRange to be filled with the results.
  * 
- * Given a segment @s, points are sampled regularly on its length
+ * Given a triangle @t, points are sampled regularly on its surface
  * using @delta as increment. The distance from each of these points
  * to the closest object of @tree is computed using @distance and the
  * gts_bb_tree_point_distance() function. The fields of @range are
  * filled with the number of points sampled, the minimum, average and
  * maximum value and the standard deviation.  
  */
-void gts_bb_tree_segment_distance (GNode * tree,
-				   GtsSegment * s,
-				   gdouble (*distance) (GtsPoint *, 
-							gpointer),
-				   gdouble delta,
-				   GtsRange * range)
+void gts_bb_tree_triangle_distance (GNode * tree,
+				    GtsTriangle * t,
+				    GtsBBoxDistFunc distance,
+				    gdouble delta,
+				    GtsRange * range)
 {
-  GtsPoint * p1, * p2, * p;
-  GtsVector p1p2;
-  gdouble l, t, dt;
-  guint i, n;
-
   g_return_if_fail (tree != NULL);
-  g_return_if_fail (s != NULL);
+  g_return_if_fail (t != NULL);
   g_return_if_fail (distance != NULL);
   g_return_if_fail (delta > 0.);
   g_return_if_fail (range != NULL);
 
+  triangle_distance (tree, (PointDistanceFunc) gts_bb_tree_point_distance,
+		     t, distance, delta, range);
+}
+
+static void segment_distance (gpointer tree,
+			      PointDistanceFunc point_distance,
+			      GtsSegment * s,
+			      GtsBBoxDistFunc distance,
+			      gdouble delta,
+			      GtsRange * range)
+{
+  GtsPoint * p1, * p2, * p;
+  GtsVector p1p2;
+  gdouble l, t, dt;
+  guint i, n;
+
   p1 = GTS_POINT (s->v1);
   p2 = GTS_POINT (s->v2);
 
@@ -1140,33 +1178,117 @@ void gts_bb_tree_segment_distance (GNode * tree,
     p->z = p1->z + t*p1p2[2];
     
     gts_range_add_value (range,
-			 gts_bb_tree_point_distance (tree, p, distance, NULL));
+			 (* point_distance) (tree, p, distance, NULL));
   }
 
   gts_object_destroy (GTS_OBJECT (p));
   gts_range_update (range);
 }
 
+/**
+ * gts_bb_tree_segment_distance:
+ * @tree: a bounding box tree.
+ * @s: a #GtsSegment.
+ * @distance: a #GtsBBoxDistFunc.
+ * @delta: spatial scale of the sampling to be used.
+ * @range: a #GtsRange to be filled with the results.
+ * 
+ * Given a segment @s, points are sampled regularly on its length
+ * using @delta as increment. The distance from each of these points
+ * to the closest object of @tree is computed using @distance and the
+ * gts_bb_tree_point_distance() function. The fields of @range are
+ * filled with the number of points sampled, the minimum, average and
+ * maximum value and the standard deviation.  
+ */
+void gts_bb_tree_segment_distance (GNode * tree,
+				   GtsSegment * s,
+				   gdouble (*distance) (GtsPoint *, 
+							gpointer),
+				   gdouble delta,
+				   GtsRange * range)
+{
+  g_return_if_fail (tree != NULL);
+  g_return_if_fail (s != NULL);
+  g_return_if_fail (distance != NULL);
+  g_return_if_fail (delta > 0.);
+  g_return_if_fail (range != NULL);
+
+  segment_distance (tree, (PointDistanceFunc) gts_bb_tree_point_distance,
+		    s, distance, delta, range);
+}
+
+
+/* Adds to @range the distances @range_triangle of the points
+   sampled on @t */
+static void surface_distance_add (GtsTriangle * t,
+				  GtsRange * range_triangle,
+				  GtsRange * range,
+				  gdouble * total_area)
+{
+  gdouble area;
+
+  if (range_triangle->min < range->min)
+    range->min = range_triangle->min;
+  if (range_triangle->max > range->max)
+    range->max = range_triangle->max;
+  range->n += range_triangle->n;
+
+  area = gts_triangle_area (t);
+  *total_area += area;
+  range->sum += area*range_triangle->mean;
+  range->sum2 += area*range_triangle->mean*range_triangle->mean;
+}
+
+/* Weighted mean and standard deviation of @range, @total being the
+   sum of the weights */
+static void surface_distance_update (GtsRange * range, gdouble total)
+{
+  if (total > 0.) {
+    if (range->sum2 - range->sum*range->sum/total >= 0.)
+      range->stddev = sqrt ((range->sum2 - range->sum*range->sum/total)
+			    /total);
+    else
+      range->stddev = 0.;
+    range->mean = range->sum/total;
+  }
+  else
+    range->min = range->max = range->mean = range->stddev = 0.;
+}
+
 static void surface_distance_foreach_triangle (GtsTriangle * t, 
 					       gpointer * data)
 {
   gdouble * delta = data[1];
-  GtsRange * range = data[2];
-  gdouble * total_area = data[3], area;
   GtsRange range_triangle;
 
-  gts_bb_tree_triangle_distance (data[0], t, data[4], *delta, &range_triangle);
+  triangle_distance (data[0], data[5], t, data[4], *delta, &range_triangle);
+  surface_distance_add (t, &range_triangle, data[2], data[3]);
+}
 
-  if (range_triangle.min < range->min)
-    range->min = range_triangle.min;
-  if (range_triangle.max > range->max)
-    range->max = range_triangle.max;
-  range->n += range_triangle.n;
+static void surface_distance (gpointer tree,
+			      PointDistanceFunc point_distance,
+			      gdouble diagonal2,
+			      GtsSurface * s,
+			      GtsBBoxDistFunc distance,
+			      gdouble delta,
+			      GtsRange * range)
+{
+  gpointer data[6];
+  gdouble total_area = 0.;
 
-  area = gts_triangle_area (t);
-  *total_area += area;
-  range->sum += area*range_triangle.mean;
-  range->sum2 += area*range_triangle.mean*range_triangle.mean;
+  gts_range_init (range);
+  delta *= sqrt (diagonal2);
+  data[0] = tree;
+  data[1] = &delta;
+  data[2] = range;
+  data[3] = &total_area;
+  data[4] = distance;
+  data[5] = point_distance;
+
+  gts_surface_foreach_face (s, 
+			    (GtsFunc) surface_distance_foreach_triangle, 
+			    data);
+  surface_distance_update (range, total_area);
 }
 
 /**
@@ -1192,36 +1314,15 @@ void gts_bb_tree_surface_distance (GNode * tree,
 				   gdouble delta,
 				   GtsRange * range)
 {
-  gpointer data[5];
-  gdouble total_area = 0.;
-
   g_return_if_fail (tree != NULL);
   g_return_if_fail (s != NULL);
   g_return_if_fail (delta > 0. && delta < 1.);
   g_return_if_fail (range != NULL);
 
-  gts_range_init (range);
-  delta *= sqrt (gts_bbox_diagonal2 (tree->data));
-  data[0] = tree;
-  data[1] = &delta;
-  data[2] = range;
-  data[3] = &total_area;
-  data[4] = distance;
-
-  gts_surface_foreach_face (s, 
-			    (GtsFunc) surface_distance_foreach_triangle, 
-			    data);
-
-  if (total_area > 0.) {
-    if (range->sum2 - range->sum*range->sum/total_area >= 0.)
-      range->stddev = sqrt ((range->sum2 - range->sum*range->sum/total_area)
-			    /total_area);
-    else
-      range->stddev = 0.;
-    range->mean = range->sum/total_area;
-  }
-  else
-    range->min = range->max = range->mean = range->stddev = 0.;
+  surface_distance (tree, 
+		    (PointDistanceFunc) gts_bb_tree_point_distance,
+		    gts_bbox_diagonal2 (tree->data),
+		    s, distance, delta, range);
 }
 
 static void surface_distance_foreach_boundary (GtsEdge * e,
@@ -1235,7 +1336,7 @@ static void surface_distance_foreach_boundary (GtsEdge * e,
   if (gts_edge_is_boundary (e, NULL)) {
     GtsSegment * s =  GTS_SEGMENT (e);
 
-    gts_bb_tree_segment_distance (data[0], s, data[4], *delta, &range_edge);
+    segment_distance (data[0], data[5], s, data[4], *delta, &range_edge);
 
     if (range_edge.min < range->min)
       range->min = range_edge.min;
@@ -1250,6 +1351,32 @@ static void surface_distance_foreach_boundary (GtsEdge * e,
   }
 }
 
+static void surface_boundary_distance (gpointer tree,
+				       PointDistanceFunc point_distance,
+				       gdouble diagonal2,
+				       GtsSurface * s,
+				       GtsBBoxDistFunc distance,
+				       gdouble delta,
+				       GtsRange * range)
+{
+  gpointer data[6];
+  gdouble total_length = 0.;
+
+  gts_range_init (range);
+  delta *= sqrt (diagonal2);
+  data[0] = tree;
+  data[1] = &delta;
+  data[2] = range;
+  data[3] = &total_length;
+  data[4] = distance;
+  data[5] = point_distance;
+
+  gts_surface_foreach_edge (s, 
+			    (GtsFunc) surface_distance_foreach_boundary, 
+			    data);
+  surface_distance_update (range, total_length);
+}
+
 /**
  * gts_bb_tree_surface_boundary_distance:
  * @tree: a bounding box tree.
@@ -1274,35 +1401,1976 @@ void gts_bb_tree_surface_boundary_distance (GNode * tree,
 					    gdouble delta,
 					    GtsRange * range)
 {
-  gpointer data[5];
-  gdouble total_length = 0.;
-
   g_return_if_fail (tree != NULL);
   g_return_if_fail (s != NULL);
   g_return_if_fail (delta > 0. && delta < 1.);
   g_return_if_fail (range != NULL);
 
-  gts_range_init (range);
-  delta *= sqrt (gts_bbox_diagonal2 (tree->data));
-  data[0] = tree;
-  data[1] = &delta;
-  data[2] = range;
-  data[3] = &total_length;
-  data[4] = distance;
+  surface_boundary_distance (tree, 
+			     (PointDistanceFunc) gts_bb_tree_point_distance,
+			     gts_bbox_diagonal2 (tree->data),
+			     s, distance, delta, range);
+}
 
-  gts_surface_foreach_edge (s, 
-			    (GtsFunc) surface_distance_foreach_boundary, 
-			    data);
+/* Flat bounding box trees */
+
+#define BVH_LEAF_SIZE  4
+#define BVH_STACK_SIZE 64
+
+typedef struct _BVHNode BVHNode;
+
+struct _BVHNode {
+  gdouble b[6];      /* x1, y1, z1, x2, y2, z2 */
+  guint n;           /* number of bounding boxes of a leaf node or 0 */
+  guint i;           /* index of the first bounding box of a leaf node
+			or of the second child of an inner node */
+};
+
+struct _GtsBVH {
+  BVHNode * nodes;   /* depth-first order, the first child of node k is k + 1 */
+  guint nn, depth;
+  GtsBBox ** bboxes; /* the leaves in tree order */
+  gdouble * bounds;  /* and their coordinates */
+  guint n;
+
+  GtsBVHBuilder builder;
+  guint leaf_size;
+  gdouble cost;      /* SAH cost of the tree when it was built */
+  GThreadFunc load;  /* updates the coordinates of a chunk of leaves */
+};
+
+#define BVH_BOUNDS(bvh, j) (&(bvh)->bounds[6*(j)])
+#define BVH_IS_LEAF(node)  ((node)->n > 0)
+
+#define bounds_are_overlapping(a, b) (!((a)[0] > (b)[3] || (b)[0] > (a)[3] ||\
+				       (a)[1] > (b)[4] || (b)[1] > (a)[4] ||\
+				       (a)[2] > (b)[5] || (b)[2] > (a)[5]))
+#define bounds_are_stabbed(b, p) (!((p)->x > (b)[3] ||\
+				   (p)->y < (b)[1] || (p)->y > (b)[4] ||\
+				   (p)->z < (b)[2] || (p)->z > (b)[5]))
+#define bounds_volume(b) (((b)[3] - (b)[0])*((b)[4] - (b)[1])*((b)[5] - (b)[2]))
+
+static void bounds_union (gdouble * b, const gdouble * b1)
+{
+  guint c;
 
-  if (total_length > 0.) {
-    if (range->sum2 - range->sum*range->sum/total_length >= 0.)
-      range->stddev = sqrt ((range->sum2 - 
-			     range->sum*range->sum/total_length)
-			    /total_length);
-    else
-      range->stddev = 0.;
-    range->mean = range->sum/total_length;
+  for (c = 0; c < 3; c++) {
+    if (b1[c] < b[c]) b[c] = b1[c];
+    if (b1[c + 3] > b[c + 3]) b[c + 3] = b1[c + 3];
   }
-  else
-    range->min = range->max = range->mean = range->stddev = 0.;
+}
+
+static guint bounds_longest_axis (const gdouble * b)
+{
+  if (b[3] - b[0] > b[4] - b[1])
+    return b[5] - b[2] > b[3] - b[0] ? 2 : 0;
+  return b[5] - b[2] > b[4] - b[1] ? 2 : 1;
+}
+
+static guint bvh_node_new (GtsBVH * bvh, guint depth)
+{
+  if (depth > bvh->depth)
+    bvh->depth = depth;
+  return bvh->nn++;
+}
+
+/* Workspace of the builders */
+typedef struct _BVHBuild BVHBuild;
+
+struct _BVHBuild {
+  GtsBVH * bvh;
+  GtsBVHBuilder builder;
+  guint leaf_size;
+  guint * idx;        /* the leaves in tree order */
+  guint * sorted[3];  /* GTS_BVH_SWEEP_SAH: the leaves sorted along each axis */
+  guchar * left;      /* ... side of each leaf */
+  gdouble * area;     /* ... cost of the right part of the splits */
+  guint * tmp;
+  BVHNode * nodes;    /* the nodes built */
+  guint nn, depth;
+  GArray * tasks;     /* the partitions left to other threads or NULL */
+  guint task_size;
+};
+
+/* A partition built by another thread, the root of which is node @k
+   of the calling thread */
+typedef struct {
+  guint k, start, n, depth;
+  BVHNode * nodes;
+  guint nn;
+} BVHTask;
+
+/* Partitions of at least BVH_TASK_MIN leaves can be built
+   concurrently and the coordinates of the leaves are copied by chunks
+   of at least BVH_CHUNK_MIN leaves */
+#define BVH_TASK_MIN  16384
+#define BVH_CHUNK_MIN 65536
+
+/* twice the center of leaf @i along @dir */
+#define BVH_CENTER(bvh, i, dir) ((bvh)->bounds[6*(i) + (dir)] +\
+				 (bvh)->bounds[6*(i) + (dir) + 3])
+
+#define BVH_TRAVERSAL_COST 1.
+#define BVH_BINS           16
+
+static gdouble bounds_half_area (const gdouble * b)
+{
+  gdouble x = b[3] - b[0], y = b[4] - b[1], z = b[5] - b[2];
+
+  return x*y + y*z + z*x;
+}
+
+static void leaves_bounds (GtsBVH * bvh, const guint * idx, guint n,
+			   gdouble * b)
+{
+  guint i;
+
+  memcpy (b, BVH_BOUNDS (bvh, idx[0]), 6*sizeof (gdouble));
+  for (i = 1; i < n; i++)
+    bounds_union (b, BVH_BOUNDS (bvh, idx[i]));
+}
+
+static void centers_bounds (GtsBVH * bvh, const guint * idx, guint n,
+			    gdouble * b)
+{
+  guint i, c;
+
+  for (c = 0; c < 3; c++)
+    b[c] = b[c + 3] = BVH_CENTER (bvh, idx[0], c);
+  for (i = 1; i < n; i++)
+    for (c = 0; c < 3; c++) {
+      gdouble x = BVH_CENTER (bvh, idx[i], c);
+
+      if (x < b[c]) b[c] = x;
+      if (x > b[c + 3]) b[c + 3] = x;
+    }
+}
+
+/* Partitions @idx so that the leaves for which @dir is smaller
+   than @cut come first and returns their number */
+static guint partition (GtsBVH * bvh, guint * idx, guint n, 
+			guint dir, gdouble cut)
+{
+  guint i = 0, j = n;
+
+  while (i < j)
+    if (BVH_CENTER (bvh, idx[i], dir) > cut) {
+      guint tmp = idx[i];
+
+      idx[i] = idx[--j];
+      idx[j] = tmp;
+    }
+    else
+      i++;
+  return i;
+}
+
+/* Same splitting rule as gts_bb_tree_new() */
+static guint split_midpoint (BVHBuild * b, guint * idx, guint n,
+			     const gdouble * nb)
+{
+  guint dir, m;
+
+  if (n <= b->leaf_size)
+    return 0;
+  dir = bounds_longest_axis (nb);
+  m = partition (b->bvh, idx, n, dir, nb[dir] + nb[dir + 3]);
+  return m == 0 || m == n ? n/2 : m;
+}
+
+/* Moves the leaf of rank @m along @dir at position @m */
+static void select_nth (GtsBVH * bvh, guint * idx, gint n, gint m, guint dir)
+{
+  gint lo = 0, hi = n - 1;
+
+  while (lo < hi) {
+    gdouble pivot = BVH_CENTER (bvh, idx[(lo + hi)/2], dir);
+    gint i = lo, j = hi;
+
+    while (i <= j) {
+      while (BVH_CENTER (bvh, idx[i], dir) < pivot) i++;
+      while (BVH_CENTER (bvh, idx[j], dir) > pivot) j--;
+      if (i <= j) {
+	guint tmp = idx[i];
+
+	idx[i++] = idx[j];
+	idx[j--] = tmp;
+      }
+    }
+    if (m <= j)
+      hi = j;
+    else if (m >= i)
+      lo = i;
+    else
+      break;
+  }
+}
+
+static guint split_median (BVHBuild * b, guint * idx, guint n)
+{
+  gdouble cb[6];
+
+  if (n <= b->leaf_size)
+    return 0;
+  centers_bounds (b->bvh, idx, n, cb);
+  select_nth (b->bvh, idx, n, n/2, bounds_longest_axis (cb));
+  return n/2;
+}
+
+typedef struct {
+  gdouble b[6];
+  guint n;
+} BVHBin;
+
+#define BIN_INDEX(x, min, scale) (MIN (BVH_BINS - 1, (guint) (((x) - (min))*(scale))))
+
+static guint split_binned_sah (BVHBuild * b, guint * idx, guint n,
+			       const gdouble * nb)
+{
+  GtsBVH * bvh = b->bvh;
+  gdouble cb[6], area = bounds_half_area (nb), best = G_MAXDOUBLE;
+  guint dir, best_dir = 0, best_bin = 0, i, m;
+
+  if (n == 1)
+    return 0;
+  if (area <= 0.)
+    return n > b->leaf_size ? n/2 : 0;
+
+  centers_bounds (bvh, idx, n, cb);
+  for (dir = 0; dir < 3; dir++) {
+    BVHBin bins[BVH_BINS];
+    gdouble right[BVH_BINS], acc[6], scale;
+    guint nr = 0, nl = 0;
+
+    if (cb[dir + 3] <= cb[dir])
+      continue;
+    scale = BVH_BINS/(cb[dir + 3] - cb[dir]);
+    for (i = 0; i < BVH_BINS; i++)
+      bins[i].n = 0;
+    for (i = 0; i < n; i++) {
+      BVHBin * bin = &bins[BIN_INDEX (BVH_CENTER (bvh, idx[i], dir), 
+				       cb[dir], scale)];
+
+      if (bin->n++ == 0)
+	memcpy (bin->b, BVH_BOUNDS (bvh, idx[i]), 6*sizeof (gdouble));
+      else
+	bounds_union (bin->b, BVH_BOUNDS (bvh, idx[i]));
+    }
+
+    for (i = BVH_BINS - 1; i > 0; i--) {
+      if (bins[i].n > 0) {
+	if (nr == 0)
+	  memcpy (acc, bins[i].b, 6*sizeof (gdouble));
+	else
+	  bounds_union (acc, bins[i].b);
+	nr += bins[i].n;
+      }
+      right[i] = nr > 0 ? bounds_half_area (acc)*nr : 0.;
+    }
+    for (i = 0; i < BVH_BINS - 1; i++) {
+      if (bins[i].n > 0) {
+	if (nl == 0)
+	  memcpy (acc, bins[i].b, 6*sizeof (gdouble));
+	else
+	  bounds_union (acc, bins[i].b);
+	nl += bins[i].n;
+      }
+      if (nl > 0 && nl < n) {
+	gdouble cost = bounds_half_area (acc)*nl + right[i + 1];
+
+	if (cost < best) {
+	  best = cost;
+	  best_dir = dir;
+	  best_bin = i;
+	}
+      }
+    }
+  }
+
+  if (best == G_MAXDOUBLE) /* all the centers are identical */
+    return n > b->leaf_size ? n/2 : 0;
+  if (n <= b->leaf_size && BVH_TRAVERSAL_COST + best/area >= n)
+    return 0;
+
+  m = 0;
+  for (i = 0; i < n; i++)
+    if (BIN_INDEX (BVH_CENTER (bvh, idx[i], best_dir), cb[best_dir], 
+		   BVH_BINS/(cb[best_dir + 3] - cb[best_dir])) <= best_bin) {
+      guint tmp = idx[i];
+
+      idx[i] = idx[m];
+      idx[m++] = tmp;
+    }
+  return m;
+}
+
+static guint split_sweep_sah (BVHBuild * b, guint start, guint n,
+			      const gdouble * nb)
+{
+  GtsBVH * bvh = b->bvh;
+  gdouble area = bounds_half_area (nb), best = G_MAXDOUBLE;
+  gdouble * right = b->area + start;
+  guint * tmp = b->tmp + start;
+  guint dir, best_dir = 0, m = 0, i;
+
+  if (n == 1)
+    return 0;
+  if (area > 0.) {
+    for (dir = 0; dir < 3; dir++) {
+      guint * s = b->sorted[dir] + start;
+      gdouble acc[6];
+
+      memcpy (acc, BVH_BOUNDS (bvh, s[n - 1]), 6*sizeof (gdouble));
+      for (i = n - 1; i > 0; i--) {
+	bounds_union (acc, BVH_BOUNDS (bvh, s[i]));
+	right[i] = bounds_half_area (acc)*(n - i);
+      }
+      memcpy (acc, BVH_BOUNDS (bvh, s[0]), 6*sizeof (gdouble));
+      for (i = 1; i < n; i++) {
+	gdouble cost = bounds_half_area (acc)*i + right[i];
+
+	if (cost < best) {
+	  best = cost;
+	  best_dir = dir;
+	  m = i;
+	}
+	bounds_union (acc, BVH_BOUNDS (bvh, s[i]));
+      }
+    }
+    if (n <= b->leaf_size && BVH_TRAVERSAL_COST + best/area >= n)
+      return 0;
+  }
+  else if (n <= b->leaf_size)
+    return 0;
+  else
+    m = n/2;
+
+  /* split the three sorted lists */
+  for (i = 0; i < n; i++)
+    b->left[b->sorted[best_dir][start + i]] = (i < m);
+  for (dir = 0; dir < 3; dir++)
+    if (dir != best_dir) {
+      guint * s = b->sorted[dir] + start, nl = 0, nr = m;
+
+      for (i = 0; i < n; i++)
+	tmp[b->left[s[i]] ? nl++ : nr++] = s[i];
+      memcpy (s, tmp, n*sizeof (guint));
+    }
+  return m;
+}
+
+static guint bvh_build (BVHBuild * b, guint start, guint n, guint depth)
+{
+  guint k = b->nn++, m = 0;
+  guint * idx = b->idx + start;
+  BVHNode * node = &b->nodes[k];
+
+  if (depth > b->depth)
+    b->depth = depth;
+  if (b->tasks && n >= BVH_TASK_MIN && n <= b->task_size) {
+    BVHTask t;
+
+    t.k = k;
+    t.start = start;
+    t.n = n;
+    t.depth = depth;
+    g_array_append_val (b->tasks, t);
+    return k;
+  }
+
+  leaves_bounds (b->bvh, idx, n, node->b);
+  switch (b->builder) {
+  case GTS_BVH_MIDPOINT:   m = split_midpoint (b, idx, n, node->b); break;
+  case GTS_BVH_MEDIAN:     m = split_median (b, idx, n); break;
+  case GTS_BVH_BINNED_SAH: m = split_binned_sah (b, idx, n, node->b); break;
+  case GTS_BVH_SWEEP_SAH:  m = split_sweep_sah (b, start, n, node->b); break;
+  default:
+    g_assert_not_reached ();
+  }
+
+  if (m == 0) {
+    node->n = n;
+    node->i = start;
+  }
+  else {
+    node->n = 0;
+    bvh_build (b, start, m, depth + 1);
+    node->i = bvh_build (b, start + m, n - m, depth + 1);
+  }
+  return k;
+}
+
+/* Runs @func (@data) in @n threads */
+static void bvh_threads_run (guint n, GThreadFunc func, gpointer data)
+{
+  GThread ** threads = g_malloc (n*sizeof (GThread *));
+  guint k;
+
+  for (k = 0; k < n; k++)
+    threads[k] = g_thread_new ("gts-bvh", func, data);
+  for (k = 0; k < n; k++)
+    g_thread_join (threads[k]);
+  g_free (threads);
+}
+
+typedef struct {
+  BVHBuild * b;
+  gint next;
+} BVHTasks;
+
+static gpointer bvh_build_tasks (BVHTasks * t)
+{
+  gint i;
+
+  while ((i = g_atomic_int_add (&t->next, 1)) < (gint) t->b->tasks->len) {
+    BVHTask * task = &g_array_index (t->b->tasks, BVHTask, i);
+    BVHBuild b = *t->b;
+
+    b.nodes = g_malloc ((2*task->n - 1)*sizeof (BVHNode));
+    b.nn = 0;
+    b.depth = task->depth;
+    b.tasks = NULL;
+    bvh_build (&b, task->start, task->n, task->depth);
+    task->nodes = g_realloc (b.nodes, b.nn*sizeof (BVHNode));
+    task->nn = b.nn;
+    task->depth = b.depth;
+  }
+  return NULL;
+}
+
+/* Builds the tasks of @b using @n threads and inserts the resulting
+   subtrees in place of their roots */
+static void bvh_run_tasks (BVHBuild * b, guint n)
+{
+  GArray * tasks = b->tasks;
+  BVHTasks t;
+  BVHNode * nodes;
+  guint * pos, k, j, shift;
+
+  t.b = b;
+  t.next = 0;
+  bvh_threads_run (MIN (n, tasks->len), (GThreadFunc) bvh_build_tasks, &t);
+
+  /* new position of the nodes of @b */
+  pos = g_malloc (b->nn*sizeof (guint));
+  for (k = 0, j = 0, shift = 0; k < b->nn; k++) {
+    pos[k] = k + shift;
+    if (j < tasks->len && g_array_index (tasks, BVHTask, j).k == k)
+      shift += g_array_index (tasks, BVHTask, j++).nn - 1;
+  }
+
+  nodes = g_malloc ((b->nn + shift)*sizeof (BVHNode));
+  for (k = 0, j = 0; k < b->nn; k++)
+    if (j < tasks->len && g_array_index (tasks, BVHTask, j).k == k) {
+      BVHTask * task = &g_array_index (tasks, BVHTask, j++);
+      guint l;
+
+      for (l = 0; l < task->nn; l++) {
+	BVHNode * node = &nodes[pos[k] + l];
+
+	*node = task->nodes[l];
+	if (!BVH_IS_LEAF (node))
+	  node->i += pos[k];
+      }
+      if (task->depth > b->depth)
+	b->depth = task->depth;
+      g_free (task->nodes);
+    }
+    else {
+      BVHNode * node = &nodes[pos[k]];
+
+      *node = b->nodes[k];
+      if (!BVH_IS_LEAF (node))
+	node->i = pos[node->i];
+    }
+  g_free (pos);
+  g_free (b->nodes);
+  b->nodes = nodes;
+  b->nn += shift;
+}
+
+/* Chunks of leaves processed concurrently */
+typedef struct {
+  GtsBVH * bvh;
+  const guint * idx;
+  GtsBBox ** bboxes;
+  gdouble * bounds;
+  guint start, end;
+} BVHChunk;
+
+static BVHChunk * bvh_chunks_new (GtsBVH * bvh, guint threads, guint * n)
+{
+  BVHChunk * c;
+  guint k;
+
+  *n = MAX (1, MIN (threads, bvh->n/BVH_CHUNK_MIN + 1));
+  c = g_malloc0 (*n*sizeof (BVHChunk));
+  for (k = 0; k < *n; k++) {
+    c[k].bvh = bvh;
+    c[k].start = (guint64) bvh->n*k/(*n);
+    c[k].end = (guint64) bvh->n*(k + 1)/(*n);
+  }
+  return c;
+}
+
+static void bvh_chunks_run (BVHChunk * c, guint n, GThreadFunc func)
+{
+  if (n == 1)
+    (* func) (c);
+  else {
+    GThread ** threads = g_malloc (n*sizeof (GThread *));
+    guint k;
+
+    for (k = 0; k < n; k++)
+      threads[k] = g_thread_new ("gts-bvh", func, &c[k]);
+    for (k = 0; k < n; k++)
+      g_thread_join (threads[k]);
+    g_free (threads);
+  }
+}
+
+/* Updates the coordinates of the leaves of @bvh using @threads
+   threads */
+static void bvh_load (GtsBVH * bvh, guint threads)
+{
+  BVHChunk * c;
+  guint nc;
+
+  c = bvh_chunks_new (bvh, threads, &nc);
+  bvh_chunks_run (c, nc, bvh->load);
+  g_free (c);
+}
+
+static gpointer bvh_chunk_load (BVHChunk * c)
+{
+  guint i;
+
+  for (i = c->start; i < c->end; i++)
+    memcpy (BVH_BOUNDS (c->bvh, i), &c->bvh->bboxes[i]->x1, 
+	    6*sizeof (gdouble));
+  return NULL;
+}
+
+/* stores the leaves in tree order */
+static gpointer bvh_chunk_permute (BVHChunk * c)
+{
+  guint i;
+
+  for (i = c->start; i < c->end; i++) {
+    c->bboxes[i] = c->bvh->bboxes[c->idx[i]];
+    memcpy (&c->bounds[6*i], BVH_BOUNDS (c->bvh, c->idx[i]), 
+	    6*sizeof (gdouble));
+  }
+  return NULL;
+}
+
+/* computes the bounding boxes of the triangles first */
+static gpointer bvh_chunk_triangles (BVHChunk * c)
+{
+  guint i;
+
+  for (i = c->start; i < c->end; i++) {
+    GtsBBox * bbox = c->bvh->bboxes[i];
+    GtsTriangle * t = bbox->bounded;
+    GtsPoint * p[3];
+    guint j;
+
+    p[0] = GTS_POINT (GTS_SEGMENT (t->e1)->v1);
+    p[1] = GTS_POINT (GTS_SEGMENT (t->e1)->v2);
+    p[2] = GTS_POINT (gts_triangle_vertex (t));
+    bbox->x1 = bbox->x2 = p[0]->x;
+    bbox->y1 = bbox->y2 = p[0]->y;
+    bbox->z1 = bbox->z2 = p[0]->z;
+    for (j = 1; j < 3; j++) {
+      if (p[j]->x > bbox->x2) bbox->x2 = p[j]->x;
+      if (p[j]->x < bbox->x1) bbox->x1 = p[j]->x;
+      if (p[j]->y > bbox->y2) bbox->y2 = p[j]->y;
+      if (p[j]->y < bbox->y1) bbox->y1 = p[j]->y;
+      if (p[j]->z > bbox->z2) bbox->z2 = p[j]->z;
+      if (p[j]->z < bbox->z1) bbox->z1 = p[j]->z;
+    }
+  }
+  return bvh_chunk_load (c);
+}
+
+typedef struct {
+  GtsBVH * bvh;
+  guint * s;
+  guint dir;
+} BVHSort;
+
+static gint compare_centers (gconstpointer a, gconstpointer b, gpointer data)
+{
+  BVHSort * sort = data;
+  gdouble ca = BVH_CENTER (sort->bvh, *((guint *) a), sort->dir);
+  gdouble cb = BVH_CENTER (sort->bvh, *((guint *) b), sort->dir);
+
+  return ca < cb ? -1 : ca > cb ? 1 : 0;
+}
+
+static gpointer bvh_sort (BVHSort * sort)
+{
+  g_qsort_with_data (sort->s, sort->bvh->n, sizeof (guint), 
+		     compare_centers, sort);
+  return NULL;
+}
+
+static gdouble bvh_sah_cost (GtsBVH * bvh)
+{
+  gdouble area = bounds_half_area (bvh->nodes[0].b), cost = 0.;
+  guint k;
+
+  for (k = 0; k < bvh->nn; k++) {
+    BVHNode * node = &bvh->nodes[k];
+    gdouble ratio = area > 0. ? bounds_half_area (node->b)/area : 1.;
+
+    cost += ratio*(BVH_IS_LEAF (node) ? node->n : BVH_TRAVERSAL_COST);
+  }
+  return cost;
+}
+
+/* (Re)builds the nodes of @bvh from the updated coordinates of its
+   leaves using @threads threads. The tree obtained does not depend
+   on @threads. */
+static void bvh_build_tree (GtsBVH * bvh, GtsBVHBuilder builder, 
+			    guint leaf_size, guint threads)
+{
+  GtsBBox ** bboxes;
+  gdouble * bounds;
+  BVHChunk * c;
+  BVHBuild b;
+  guint i, nc;
+
+  if (threads == 0)
+    threads = g_get_num_processors ();
+
+  bvh->builder = builder;
+  bvh->leaf_size = leaf_size;
+  bvh_load (bvh, threads);
+
+  b.bvh = bvh;
+  b.builder = builder;
+  b.leaf_size = leaf_size;
+  b.idx = g_malloc (bvh->n*sizeof (guint));
+  for (i = 0; i < bvh->n; i++)
+    b.idx[i] = i;
+  if (builder == GTS_BVH_SWEEP_SAH) {
+    BVHSort sort[3];
+    guint dir;
+
+    for (dir = 0; dir < 3; dir++) {
+      if (dir > 0) {
+	b.sorted[dir] = g_malloc (bvh->n*sizeof (guint));
+	memcpy (b.sorted[dir], b.idx, bvh->n*sizeof (guint));
+      }
+      else
+	b.sorted[dir] = b.idx;
+      sort[dir].bvh = bvh;
+      sort[dir].s = b.sorted[dir];
+      sort[dir].dir = dir;
+    }
+    if (threads > 1 && bvh->n >= BVH_TASK_MIN) {
+      GThread * t[3];
+
+      for (dir = 0; dir < 3; dir++)
+	t[dir] = g_thread_new ("gts-bvh", (GThreadFunc) bvh_sort, &sort[dir]);
+      for (dir = 0; dir < 3; dir++)
+	g_thread_join (t[dir]);
+    }
+    else
+      for (dir = 0; dir < 3; dir++)
+	bvh_sort (&sort[dir]);
+    b.left = g_malloc (bvh->n);
+    b.area = g_malloc (bvh->n*sizeof (gdouble));
+    b.tmp = g_malloc (bvh->n*sizeof (guint));
+  }
+
+  /* the top of the tree is built by the calling thread and the
+     partitions of at most task_size leaves by the other threads */
+  b.nodes = g_malloc ((2*bvh->n - 1)*sizeof (BVHNode));
+  b.nn = b.depth = 0;
+  b.tasks = NULL;
+  if (threads > 1 && bvh->n >= 2*BVH_TASK_MIN) {
+    b.tasks = g_array_new (FALSE, FALSE, sizeof (BVHTask));
+    b.task_size = MAX (BVH_TASK_MIN, bvh->n/(4*threads));
+  }
+  bvh_build (&b, 0, bvh->n, 0);
+  if (b.tasks) {
+    if (b.tasks->len > 0)
+      bvh_run_tasks (&b, threads);
+    g_array_free (b.tasks, TRUE);
+  }
+  g_free (bvh->nodes);
+  bvh->nodes = g_realloc (b.nodes, b.nn*sizeof (BVHNode));
+  bvh->nn = b.nn;
+  bvh->depth = b.depth;
+
+  bboxes = g_malloc (bvh->n*sizeof (GtsBBox *));
+  bounds = g_malloc (6*bvh->n*sizeof (gdouble));
+  c = bvh_chunks_new (bvh, threads, &nc);
+  for (i = 0; i < nc; i++) {
+    c[i].idx = b.idx;
+    c[i].bboxes = bboxes;
+    c[i].bounds = bounds;
+  }
+  bvh_chunks_run (c, nc, (GThreadFunc) bvh_chunk_permute);
+  g_free (c);
+  g_free (bvh->bboxes);
+  g_free (bvh->bounds);
+  bvh->bboxes = bboxes;
+  bvh->bounds = bounds;
+  bvh->cost = bvh_sah_cost (bvh);
+
+  g_free (b.idx);
+  if (builder == GTS_BVH_SWEEP_SAH) {
+    g_free (b.sorted[1]);
+    g_free (b.sorted[2]);
+    g_free (b.left);
+    g_free (b.area);
+    g_free (b.tmp);
+  }
+}
+
+static GtsBVH * bvh_new (GtsBBox ** bboxes, guint n,
+			 GtsBVHBuilder builder, guint leaf_size,
+			 guint threads, GThreadFunc load)
+{
+  GtsBVH * bvh = g_malloc (sizeof (GtsBVH));
+
+  bvh->n = n;
+  bvh->bboxes = bboxes;
+  bvh->bounds = g_malloc (6*n*sizeof (gdouble));
+  bvh->nodes = NULL;
+  bvh->load = load;
+  bvh_build_tree (bvh, builder, leaf_size, threads);
+
+  return bvh;
+}
+
+/**
+ * gts_bvh_new_full:
+ * @bboxes: a list of #GtsBBox.
+ * @builder: the method used to build the tree.
+ * @leaf_size: the maximum number of bounding boxes in a leaf node.
+ * @threads: the number of threads to use or 0 for one per processor.
+ *
+ * Builds a new flat bounding box tree for @bboxes. The nodes of the
+ * tree are stored in depth-first order in a single array, together
+ * with their bounds, and each leaf node bounds a range of at most
+ * @leaf_size bounding boxes of @bboxes. No #GtsBBox is created for
+ * the inner nodes.
+ *
+ * The builders using the surface area heuristic can create leaf nodes
+ * with less than @leaf_size bounding boxes if splitting them further
+ * is not worth it. They are slower but give better trees for
+ * bounding boxes of very different sizes. gts_bvh_stats() can be
+ * used to compare the trees obtained.
+ *
+ * Once the partitions of @bboxes are small enough, their subtrees are
+ * built concurrently by @threads threads. The tree obtained does not
+ * depend on @threads.
+ *
+ * The bounding boxes of @bboxes are the leaves of the tree, they
+ * must not be modified while the tree is in use.
+ *
+ * Returns: a new #GtsBVH.
+ */
+GtsBVH * gts_bvh_new_full (GSList * bboxes, 
+			   GtsBVHBuilder builder, 
+			   guint leaf_size,
+			   guint threads)
+{
+  GtsBBox ** a;
+  guint n = 0;
+
+  g_return_val_if_fail (bboxes != NULL, NULL);
+  g_return_val_if_fail (leaf_size > 0, NULL);
+
+  a = g_malloc (g_slist_length (bboxes)*sizeof (GtsBBox *));
+  while (bboxes) {
+    a[n++] = bboxes->data;
+    bboxes = bboxes->next;
+  }
+  return bvh_new (a, n, builder, leaf_size, threads, 
+		  (GThreadFunc) bvh_chunk_load);
+}
+
+/**
+ * gts_bvh_new:
+ * @bboxes: a list of #GtsBBox.
+ *
+ * Builds a new flat bounding box tree for @bboxes using
+ * gts_bvh_new_full() with the same rule as gts_bb_tree_new()
+ * (%GTS_BVH_MIDPOINT) and at most four bounding boxes per leaf node.
+ *
+ * Returns: a new #GtsBVH.
+ */
+GtsBVH * gts_bvh_new (GSList * bboxes)
+{
+  g_return_val_if_fail (bboxes != NULL, NULL);
+
+  return gts_bvh_new_full (bboxes, GTS_BVH_MIDPOINT, BVH_LEAF_SIZE, 1);
+}
+
+/**
+ * gts_bvh_surface_full:
+ * @s: a #GtsSurface.
+ * @builder: the method used to build the tree.
+ * @leaf_size: the maximum number of bounding boxes in a leaf node.
+ * @threads: the number of threads to use or 0 for one per processor.
+ *
+ * See gts_bvh_new_full(). The bounding boxes of the faces are also
+ * computed by @threads threads.
+ *
+ * Returns: a new #GtsBVH bounding the faces of @s or %NULL if @s
+ * has no faces.
+ */
+GtsBVH * gts_bvh_surface_full (GtsSurface * s, 
+			       GtsBVHBuilder builder, 
+			       guint leaf_size,
+			       guint threads)
+{
+  GtsBBox ** bboxes;
+  guint i, n;
+
+  g_return_val_if_fail (s != NULL, NULL);
+  g_return_val_if_fail (leaf_size > 0, NULL);
+
+  if ((n = gts_surface_face_number (s)) == 0)
+    return NULL;
+  /* objects cannot be created concurrently, their coordinates are
+     computed by bvh_chunk_triangles() */
+  bboxes = g_malloc (n*sizeof (GtsBBox *));
+  for (i = 0; i < n; i++)
+    bboxes[i] = gts_bbox_new (gts_bbox_class (), 
+			      g_ptr_array_index (s->faces, i),
+			      0., 0., 0., 0., 0., 0.);
+  return bvh_new (bboxes, n, builder, leaf_size, threads, 
+		  (GThreadFunc) bvh_chunk_triangles);
+}
+
+/**
+ * gts_bvh_surface:
+ * @s: a #GtsSurface.
+ *
+ * Returns: a new #GtsBVH bounding the faces of @s, built as with
+ * gts_bvh_new(), or %NULL if @s has no faces.
+ */
+GtsBVH * gts_bvh_surface (GtsSurface * s)
+{
+  g_return_val_if_fail (s != NULL, NULL);
+
+  return gts_bvh_surface_full (s, GTS_BVH_MIDPOINT, BVH_LEAF_SIZE, 1);
+}
+
+/**
+ * gts_bvh_rebuild:
+ * @bvh: a #GtsBVH.
+ * @builder: the method used to build the tree.
+ * @leaf_size: the maximum number of bounding boxes in a leaf node.
+ * @threads: the number of threads to use or 0 for one per processor.
+ *
+ * Rebuilds the tree of @bvh from the current coordinates of its
+ * leaves, see gts_bvh_new_full(). If @bvh was built using
+ * gts_bvh_surface_full(), the bounding boxes of the faces are
+ * updated first.
+ */
+void gts_bvh_rebuild (GtsBVH * bvh, 
+		      GtsBVHBuilder builder, 
+		      guint leaf_size,
+		      guint threads)
+{
+  g_return_if_fail (bvh != NULL);
+  g_return_if_fail (leaf_size > 0);
+
+  bvh_build_tree (bvh, builder, leaf_size, threads);
+}
+
+/* Recomputes the bounds of nodes @start to @end - 1, making a
+   subtree, children first */
+static void bvh_refit_nodes (GtsBVH * bvh, guint start, guint end)
+{
+  guint k = end;
+
+  while (k-- > start) {
+    BVHNode * node = &bvh->nodes[k];
+
+    if (BVH_IS_LEAF (node)) {
+      guint i;
+
+      memcpy (node->b, BVH_BOUNDS (bvh, node->i), 6*sizeof (gdouble));
+      for (i = 1; i < node->n; i++)
+	bounds_union (node->b, BVH_BOUNDS (bvh, node->i + i));
+    }
+    else {
+      memcpy (node->b, bvh->nodes[k + 1].b, 6*sizeof (gdouble));
+      bounds_union (node->b, bvh->nodes[node->i].b);
+    }
+  }
+}
+
+typedef struct {
+  GtsBVH * bvh;
+  GArray * subtrees; /* first and last + 1 nodes of each subtree */
+  gint next;
+} BVHRefit;
+
+/* Splits the subtree made of nodes @k to @end - 1 into subtrees of
+   at most @size nodes, the roots of which are stored in @top */
+static void bvh_refit_split (BVHRefit * r, guint k, guint end, guint size,
+			     GArray * top)
+{
+  if (end - k <= size) {
+    g_array_append_val (r->subtrees, k);
+    g_array_append_val (r->subtrees, end);
+  }
+  else {
+    guint i = r->bvh->nodes[k].i;
+
+    g_array_append_val (top, k);
+    bvh_refit_split (r, k + 1, i, size, top);
+    bvh_refit_split (r, i, end, size, top);
+  }
+}
+
+static gpointer bvh_refit_subtrees (BVHRefit * r)
+{
+  gint i;
+
+  while ((i = g_atomic_int_add (&r->next, 1)) < 
+	 (gint) r->subtrees->len/2)
+    bvh_refit_nodes (r->bvh, 
+		     g_array_index (r->subtrees, guint, 2*i),
+		     g_array_index (r->subtrees, guint, 2*i + 1));
+  return NULL;
+}
+
+/**
+ * gts_bvh_refit:
+ * @bvh: a #GtsBVH.
+ * @threshold: the maximum relative increase of the cost of the tree
+ * or 0.
+ * @threads: the number of threads to use or 0 for one per processor.
+ *
+ * Updates the bounds of all the nodes of @bvh from the current
+ * coordinates of its leaves, without changing the hierarchy of the
+ * tree. If @bvh was built using gts_bvh_surface_full(), the bounding
+ * boxes of the faces are updated first, otherwise the bounding boxes
+ * of the leaves must be updated by the caller. This is much faster
+ * than gts_bvh_rebuild() and gives a valid tree whatever the
+ * displacements of the leaves.
+ *
+ * Large displacements can however make the tree much less efficient.
+ * If @threshold is positive and the SAH cost of the refitted tree
+ * (see #GtsBVHStats) is more than 1 + @threshold times the cost of
+ * the tree when it was last built, @bvh is rebuilt using the same
+ * builder and leaf size.
+ *
+ * Returns: %TRUE if @bvh has been rebuilt, %FALSE otherwise.
+ */
+gboolean gts_bvh_refit (GtsBVH * bvh, gdouble threshold, guint threads)
+{
+  g_return_val_if_fail (bvh != NULL, FALSE);
+
+  if (threads == 0)
+    threads = g_get_num_processors ();
+
+  bvh_load (bvh, threads);
+  if (threads > 1 && bvh->nn >= 2*BVH_TASK_MIN) {
+    GArray * top = g_array_new (FALSE, FALSE, sizeof (guint));
+    BVHRefit r;
+    guint i;
+
+    r.bvh = bvh;
+    r.subtrees = g_array_new (FALSE, FALSE, sizeof (guint));
+    r.next = 0;
+    bvh_refit_split (&r, 0, bvh->nn, MAX (BVH_TASK_MIN, bvh->nn/(4*threads)),
+		     top);
+    bvh_threads_run (MIN (threads, r.subtrees->len/2), 
+		     (GThreadFunc) bvh_refit_subtrees, &r);
+    /* the top of the tree, children first */
+    for (i = top->len; i > 0; i--) {
+      BVHNode * node = &bvh->nodes[g_array_index (top, guint, i - 1)];
+
+      memcpy (node->b, (node + 1)->b, 6*sizeof (gdouble));
+      bounds_union (node->b, bvh->nodes[node->i].b);
+    }
+    g_array_free (r.subtrees, TRUE);
+    g_array_free (top, TRUE);
+  }
+  else
+    bvh_refit_nodes (bvh, 0, bvh->nn);
+
+  if (threshold > 0. && bvh_sah_cost (bvh) > (1. + threshold)*bvh->cost) {
+    bvh_build_tree (bvh, bvh->builder, bvh->leaf_size, threads);
+    return TRUE;
+  }
+  return FALSE;
+}
+
+static guint bvh_add_node (GtsBVH * bvh, GNode * node, guint depth);
+
+static guint bvh_add_children (GtsBVH * bvh, GNode * child, guint depth)
+{
+  guint k;
+
+  if (child->next == NULL)
+    return bvh_add_node (bvh, child, depth);
+
+  k = bvh_node_new (bvh, depth);
+  bvh->nodes[k].n = 0;
+  bvh_add_node (bvh, child, depth + 1);
+  bvh->nodes[k].i = bvh_add_children (bvh, child->next, depth + 1);
+  memcpy (bvh->nodes[k].b, bvh->nodes[k + 1].b, 6*sizeof (gdouble));
+  bounds_union (bvh->nodes[k].b, bvh->nodes[bvh->nodes[k].i].b);
+  return k;
+}
+
+static guint bvh_add_node (GtsBVH * bvh, GNode * node, guint depth)
+{
+  GtsBBox * bb = node->data;
+  guint k;
+
+  if (node->children && node->children->next == NULL)
+    return bvh_add_node (bvh, node->children, depth);
+
+  k = bvh_node_new (bvh, depth);
+  memcpy (bvh->nodes[k].b, &bb->x1, 6*sizeof (gdouble));
+  if (node->children == NULL) { /* leaf node */
+    bvh->bboxes[bvh->n] = bb;
+    memcpy (BVH_BOUNDS (bvh, bvh->n), &bb->x1, 6*sizeof (gdouble));
+    bvh->nodes[k].n = 1;
+    bvh->nodes[k].i = bvh->n++;
+  }
+  else {
+    bvh->nodes[k].n = 0;
+    bvh_add_node (bvh, node->children, depth + 1);
+    bvh->nodes[k].i = bvh_add_children (bvh, node->children->next, 
+					depth + 1);
+  }
+  return k;
+}
+
+/**
+ * gts_bvh_new_from_bb_tree:
+ * @tree: a bounding box tree (see gts_bb_tree_new()).
+ *
+ * Builds a flat copy of @tree. The hierarchy of @tree is preserved,
+ * each of its leaves being stored in its own leaf node. The leaves of
+ * @tree are shared with the new tree which can then be used in place
+ * of @tree by the gts_bvh_*() functions. @tree can be destroyed
+ * using gts_bb_tree_destroy() with @free_leaves set to %FALSE.
+ *
+ * Returns: a new #GtsBVH.
+ */
+GtsBVH * gts_bvh_new_from_bb_tree (GNode * tree)
+{
+  GtsBVH * bvh;
+  guint n;
+
+  g_return_val_if_fail (tree != NULL, NULL);
+
+  n = g_node_n_nodes (tree, G_TRAVERSE_LEAVES);
+  bvh = g_malloc (sizeof (GtsBVH));
+  bvh->bboxes = g_malloc (n*sizeof (GtsBBox *));
+  bvh->bounds = g_malloc (6*n*sizeof (gdouble));
+  bvh->nodes = g_malloc ((2*n - 1)*sizeof (BVHNode));
+  bvh->n = bvh->nn = bvh->depth = 0;
+  bvh_add_node (bvh, tree, 0);
+  bvh->nodes = g_realloc (bvh->nodes, bvh->nn*sizeof (BVHNode));
+  bvh->builder = GTS_BVH_MIDPOINT;
+  bvh->leaf_size = 1;
+  bvh->cost = bvh_sah_cost (bvh);
+  bvh->load = (GThreadFunc) bvh_chunk_load;
+
+  return bvh;
+}
+
+/**
+ * gts_bvh_destroy:
+ * @bvh: a #GtsBVH.
+ * @free_leaves: if %TRUE the bounding boxes given by the user are freed.
+ *
+ * Frees all the memory allocated for @bvh. If @free_leaves is set to
+ * %TRUE, also destroys the bounding boxes which are leaves of the tree.
+ */
+void gts_bvh_destroy (GtsBVH * bvh, gboolean free_leaves)
+{
+  g_return_if_fail (bvh != NULL);
+
+  if (free_leaves) {
+    guint i;
+
+    for (i = 0; i < bvh->n; i++)
+      gts_object_destroy (GTS_OBJECT (bvh->bboxes[i]));
+  }
+  g_free (bvh->nodes);
+  g_free (bvh->bboxes);
+  g_free (bvh->bounds);
+  g_free (bvh);
+}
+
+/**
+ * gts_bvh_bbox:
+ * @klass: a #GtsBBoxClass.
+ * @bvh: a #GtsBVH.
+ *
+ * Returns: a new #GtsBBox, bounding box of all the leaves of @bvh.
+ */
+GtsBBox * gts_bvh_bbox (GtsBBoxClass * klass, GtsBVH * bvh)
+{
+  gdouble * b;
+
+  g_return_val_if_fail (klass != NULL, NULL);
+  g_return_val_if_fail (bvh != NULL, NULL);
+
+  b = bvh->nodes[0].b;
+  return gts_bbox_new (klass, bvh, b[0], b[1], b[2], b[3], b[4], b[5]);
+}
+
+/**
+ * gts_bvh_leaves:
+ * @bvh: a #GtsBVH.
+ * @n: return location for the number of leaves of @bvh.
+ *
+ * Returns: the array of the leaves of @bvh. This array belongs to
+ * @bvh and must not be modified.
+ */
+GtsBBox ** gts_bvh_leaves (GtsBVH * bvh, guint * n)
+{
+  g_return_val_if_fail (bvh != NULL, NULL);
+  g_return_val_if_fail (n != NULL, NULL);
+
+  *n = bvh->n;
+  return bvh->bboxes;
+}
+
+/**
+ * gts_bvh_stats:
+ * @bvh: a #GtsBVH.
+ * @stats: a #GtsBVHStats.
+ *
+ * Fills @stats with statistics on the quality of @bvh. The cost of
+ * @bvh is the expected cost of a query as estimated by the surface
+ * area heuristic, the cost of visiting a node and the cost of testing
+ * a bounding box being both taken equal to one.
+ */
+void gts_bvh_stats (GtsBVH * bvh, GtsBVHStats * stats)
+{
+  guint * stack, top = 0;
+
+  g_return_if_fail (bvh != NULL);
+  g_return_if_fail (stats != NULL);
+
+  stats->n_nodes = bvh->nn;
+  stats->n_leaves = 0;
+  stats->depth = bvh->depth;
+  stats->sah_cost = bvh_sah_cost (bvh);
+  gts_range_init (&stats->leaf_size);
+  gts_range_init (&stats->leaf_depth);
+
+  stack = g_malloc (2*(bvh->depth + 1)*sizeof (guint));
+  stack[top++] = 0; stack[top++] = 0;
+  while (top) {
+    guint depth = stack[--top], k = stack[--top];
+    BVHNode * node = &bvh->nodes[k];
+
+    if (BVH_IS_LEAF (node)) {
+      stats->n_leaves++;
+      gts_range_add_value (&stats->leaf_size, node->n);
+      gts_range_add_value (&stats->leaf_depth, depth);
+    }
+    else {
+      stack[top++] = node->i; stack[top++] = depth + 1;
+      stack[top++] = k + 1; stack[top++] = depth + 1;
+    }
+  }
+  g_free (stack);
+
+  gts_range_update (&stats->leaf_size);
+  gts_range_update (&stats->leaf_depth);
+}
+
+static guint * stack_new (guint * buf, guint size)
+{
+  return size <= BVH_STACK_SIZE ? buf : g_malloc (size*sizeof (guint));
+}
+
+static void stack_destroy (guint * stack, guint * buf)
+{
+  if (stack != buf)
+    g_free (stack);
+}
+
+/**
+ * gts_bvh_stabbed:
+ * @bvh: a #GtsBVH.
+ * @p: a #GtsPoint.
+ *
+ * Returns: a list of bounding boxes, leaves of @bvh which are
+ * stabbed by the ray defined by @p (see gts_bbox_is_stabbed()).
+ */
+GSList * gts_bvh_stabbed (GtsBVH * bvh, GtsPoint * p)
+{
+  guint buf[BVH_STACK_SIZE], * stack, top = 0;
+  GSList * list = NULL;
+
+  g_return_val_if_fail (bvh != NULL, NULL);
+  g_return_val_if_fail (p != NULL, NULL);
+
+  stack = stack_new (buf, bvh->depth + 1);
+  stack[top++] = 0;
+  while (top) {
+    BVHNode * node = &bvh->nodes[stack[--top]];
+
+    if (!bounds_are_stabbed (node->b, p))
+      continue;
+    if (BVH_IS_LEAF (node)) {
+      guint j;
+
+      for (j = node->i; j < node->i + node->n; j++)
+	if (bounds_are_stabbed (BVH_BOUNDS (bvh, j), p))
+	  list = g_slist_prepend (list, bvh->bboxes[j]);
+    }
+    else {
+      stack[top++] = node->i;
+      stack[top++] = node - bvh->nodes + 1;
+    }
+  }
+  stack_destroy (stack, buf);
+
+  return list;
+}
+
+static gboolean bvh_overlap (GtsBVH * bvh, GtsBBox * bbox, GSList ** list)
+{
+  guint buf[BVH_STACK_SIZE], * stack, top = 0;
+  gdouble * b = &bbox->x1;
+  gboolean overlap = FALSE;
+
+  stack = stack_new (buf, bvh->depth + 1);
+  stack[top++] = 0;
+  while (top) {
+    BVHNode * node = &bvh->nodes[stack[--top]];
+
+    if (!bounds_are_overlapping (node->b, b))
+      continue;
+    if (BVH_IS_LEAF (node)) {
+      guint j;
+
+      for (j = node->i; j < node->i + node->n; j++)
+	if (bvh->bboxes[j] == bbox ||
+	    bounds_are_overlapping (BVH_BOUNDS (bvh, j), b)) {
+	  overlap = TRUE;
+	  if (list == NULL)
+	    break;
+	  *list = g_slist_prepend (*list, bvh->bboxes[j]);
+	}
+      if (overlap && list == NULL)
+	break;
+    }
+    else {
+      stack[top++] = node->i;
+      stack[top++] = node - bvh->nodes + 1;
+    }
+  }
+  stack_destroy (stack, buf);
+
+  return overlap;
+}
+
+/**
+ * gts_bvh_overlap:
+ * @bvh: a #GtsBVH.
+ * @bbox: a #GtsBBox.
+ *
+ * Returns: a list of bounding boxes, leaves of @bvh which overlap @bbox.
+ */
+GSList * gts_bvh_overlap (GtsBVH * bvh, GtsBBox * bbox)
+{
+  GSList * list = NULL;
+
+  g_return_val_if_fail (bvh != NULL, NULL);
+  g_return_val_if_fail (bbox != NULL, NULL);
+
+  bvh_overlap (bvh, bbox, &list);
+  return list;
+}
+
+/**
+ * gts_bvh_is_overlapping:
+ * @bvh: a #GtsBVH.
+ * @bbox: a #GtsBBox.
+ *
+ * Returns: %TRUE if any leaf of @bvh overlaps @bbox, %FALSE otherwise.
+ */
+gboolean gts_bvh_is_overlapping (GtsBVH * bvh, GtsBBox * bbox)
+{
+  g_return_val_if_fail (bvh != NULL, FALSE);
+  g_return_val_if_fail (bbox != NULL, FALSE);
+
+  return bvh_overlap (bvh, bbox, NULL);
+}
+
+/**
+ * gts_bvh_traverse_overlapping:
+ * @bvh1: a #GtsBVH.
+ * @bvh2: a #GtsBVH.
+ * @func: a #GtsBBTreeTraverseFunc.
+ * @data: user data to be passed to @func.
+ *
+ * Calls @func for each overlapping pair of leaves of @bvh1 and @bvh2.
+ * As for gts_bb_tree_traverse_overlapping(), @bvh1 and @bvh2 can be
+ * the same tree.
+ */
+void gts_bvh_traverse_overlapping (GtsBVH * bvh1, GtsBVH * bvh2,
+				   GtsBBTreeTraverseFunc func,
+				   gpointer data)
+{
+  guint buf[BVH_STACK_SIZE], * stack, top = 0;
+
+  g_return_if_fail (bvh1 != NULL && bvh2 != NULL);
+  g_return_if_fail (func != NULL);
+
+  stack = stack_new (buf, 2*(bvh1->depth + bvh2->depth + 1));
+  stack[top++] = 0; stack[top++] = 0;
+  while (top) {
+    guint k2 = stack[--top], k1 = stack[--top];
+    BVHNode * n1 = &bvh1->nodes[k1], * n2 = &bvh2->nodes[k2];
+
+    if (!bounds_are_overlapping (n1->b, n2->b))
+      continue;
+    if (BVH_IS_LEAF (n1) && BVH_IS_LEAF (n2)) {
+      guint i, j;
+
+      for (i = n1->i; i < n1->i + n1->n; i++)
+	for (j = n2->i; j < n2->i + n2->n; j++)
+	  if (bounds_are_overlapping (BVH_BOUNDS (bvh1, i), 
+				      BVH_BOUNDS (bvh2, j)))
+	    (* func) (bvh1->bboxes[i], bvh2->bboxes[j], data);
+    }
+    else if (BVH_IS_LEAF (n2) || 
+	     (!BVH_IS_LEAF (n1) && 
+	      bounds_volume (n1->b) > bounds_volume (n2->b))) {
+      stack[top++] = n1->i; stack[top++] = k2;
+      stack[top++] = k1 + 1; stack[top++] = k2;
+    }
+    else {
+      stack[top++] = k1; stack[top++] = n2->i;
+      stack[top++] = k1; stack[top++] = k2 + 1;
+    }
+  }
+  stack_destroy (stack, buf);
+}
+
+/* Workspace of the point queries */
+typedef struct _BVHQuery BVHQuery;
+
+struct _BVHQuery {
+  guint * stack;     /* nodes to visit */
+  gdouble * min;     /* and their minimum distance */
+  guint * leaves;    /* candidate leaves */
+  gdouble * lmin;    /* and their minimum distance */
+  guint nl, size;
+};
+
+static void bvh_query_init (BVHQuery * q, GtsBVH * bvh)
+{
+  q->stack = g_malloc ((bvh->depth + 1)*sizeof (guint));
+  q->min = g_malloc ((bvh->depth + 1)*sizeof (gdouble));
+  q->size = 16;
+  q->leaves = g_malloc (q->size*sizeof (guint));
+  q->lmin = g_malloc (q->size*sizeof (gdouble));
+}
+
+static void bvh_query_free (BVHQuery * q)
+{
+  g_free (q->stack);
+  g_free (q->min);
+  g_free (q->leaves);
+  g_free (q->lmin);
+}
+
+/* Sets q->leaves to the leaves of @bvh which may contain the object
+   closest to @p, using the same bounds as
+   gts_bb_tree_point_closest_bboxes(). @bound is an upper bound of
+   the square of the distance between @p and the closest object. */
+static void bvh_point_closest (GtsBVH * bvh, GtsPoint * p, gdouble bound,
+			       BVHQuery * q)
+{
+  gdouble min, min_max;
+  guint top = 0, i, j;
+
+  q->nl = 0;
+  bounds_point_distance2 (bvh->nodes[0].b, p, &min, &min_max);
+  if (bound < min_max)
+    min_max = bound;
+  q->stack[top] = 0; q->min[top++] = min;
+  while (top) {
+    BVHNode * node;
+
+    if (q->min[--top] > min_max)
+      continue;
+    node = &bvh->nodes[q->stack[top]];
+    if (BVH_IS_LEAF (node)) {
+      for (j = node->i; j < node->i + node->n; j++) {
+	gdouble max;
+
+	bounds_point_distance2 (BVH_BOUNDS (bvh, j), p, &min, &max);
+	if (max < min_max)
+	  min_max = max;
+	if (min <= min_max) {
+	  if (q->nl == q->size) {
+	    q->size *= 2;
+	    q->leaves = g_realloc (q->leaves, q->size*sizeof (guint));
+	    q->lmin = g_realloc (q->lmin, q->size*sizeof (gdouble));
+	  }
+	  q->leaves[q->nl] = j;
+	  q->lmin[q->nl++] = min;
+	}
+      }
+    }
+    else {
+      guint k1 = node - bvh->nodes + 1, k2 = node->i;
+      gdouble min1, max1, min2, max2;
+
+      bounds_point_distance2 (bvh->nodes[k1].b, p, &min1, &max1);
+      bounds_point_distance2 (bvh->nodes[k2].b, p, &min2, &max2);
+      if (max1 < min_max)
+	min_max = max1;
+      if (max2 < min_max)
+	min_max = max2;
+      if (min1 < min2) {
+	if (min2 <= min_max) { q->stack[top] = k2; q->min[top++] = min2; }
+	if (min1 <= min_max) { q->stack[top] = k1; q->min[top++] = min1; }
+      }
+      else {
+	if (min1 <= min_max) { q->stack[top] = k1; q->min[top++] = min1; }
+	if (min2 <= min_max) { q->stack[top] = k2; q->min[top++] = min2; }
+      }
+    }
+  }
+
+  for (i = j = 0; i < q->nl; i++)
+    if (q->lmin[i] <= min_max)
+      q->leaves[j++] = q->leaves[i];
+  q->nl = j;
+}
+
+/**
+ * gts_bvh_point_closest_bboxes:
+ * @bvh: a #GtsBVH.
+ * @p: a #GtsPoint.
+ *
+ * Returns: a list of #GtsBBox. One of the bounding boxes is assured to contain
+ * the object of @bvh closest to @p.
+ */
+GSList * gts_bvh_point_closest_bboxes (GtsBVH * bvh, GtsPoint * p)
+{
+  GSList * list = NULL;
+  BVHQuery q;
+  guint i;
+
+  g_return_val_if_fail (bvh != NULL, NULL);
+  g_return_val_if_fail (p != NULL, NULL);
+
+  bvh_query_init (&q, bvh);
+  bvh_point_closest (bvh, p, G_MAXDOUBLE, &q);
+  for (i = 0; i < q.nl; i++)
+    list = g_slist_prepend (list, bvh->bboxes[q.leaves[i]]);
+  bvh_query_free (&q);
+
+  return list;
+}
+
+/**
+ * gts_bvh_point_distance:
+ * @bvh: a #GtsBVH.
+ * @p: a #GtsPoint.
+ * @distance: a #GtsBBoxDistFunc.
+ * @bbox: if not %NULL is set to the bounding box containing the closest 
+ * object.
+ *
+ * Returns: the distance as evaluated by @distance between @p and the closest
+ * object in @bvh.
+ */
+gdouble gts_bvh_point_distance (GtsBVH * bvh, 
+				GtsPoint * p,
+				GtsBBoxDistFunc distance,
+				GtsBBox ** bbox)
+{
+  gdouble dmin = G_MAXDOUBLE;
+  BVHQuery q;
+  guint i;
+
+  g_return_val_if_fail (bvh != NULL, dmin);
+  g_return_val_if_fail (p != NULL, dmin);
+  g_return_val_if_fail (distance != NULL, dmin);
+
+  bvh_query_init (&q, bvh);
+  bvh_point_closest (bvh, p, G_MAXDOUBLE, &q);
+  for (i = 0; i < q.nl; i++) {
+    GtsBBox * bb = bvh->bboxes[q.leaves[i]];
+    gdouble d = (* distance) (p, bb->bounded);
+
+    if (fabs (d) < fabs (dmin)) {
+      dmin = d;
+      if (bbox)
+	*bbox = bb;
+    }
+  }
+  bvh_query_free (&q);
+
+  return dmin;
+}
+
+/**
+ * gts_bvh_point_closest:
+ * @bvh: a #GtsBVH.
+ * @p: a #GtsPoint.
+ * @closest: a #GtsBBoxClosestFunc.
+ * @distance: if not %NULL is set to the distance between @p and the 
+ * new #GtsPoint.
+ *
+ * Returns: a new #GtsPoint, closest point to @p and belonging to an object of
+ * @bvh.
+ */
+GtsPoint * gts_bvh_point_closest (GtsBVH * bvh, 
+				  GtsPoint * p,
+				  GtsBBoxClosestFunc closest,
+				  gdouble * distance)
+{
+  gdouble dmin = G_MAXDOUBLE;
+  GtsPoint * np = NULL;
+  BVHQuery q;
+  guint i;
+
+  g_return_val_if_fail (bvh != NULL, NULL);
+  g_return_val_if_fail (p != NULL, NULL);
+  g_return_val_if_fail (closest != NULL, NULL);
+
+  bvh_query_init (&q, bvh);
+  bvh_point_closest (bvh, p, G_MAXDOUBLE, &q);
+  for (i = 0; i < q.nl; i++) {
+    GtsPoint * tp = (* closest) (p, bvh->bboxes[q.leaves[i]]->bounded);
+    gdouble d = gts_point_distance2 (tp, p);
+
+    if (d < dmin) {
+      if (np)
+	gts_object_destroy (GTS_OBJECT (np));
+      np = tp;
+      dmin = d;
+    }
+    else
+      gts_object_destroy (GTS_OBJECT (tp));
+  }
+  bvh_query_free (&q);
+
+  if (distance)
+    *distance = dmin;
+
+  return np;  
+}
+
+/* Batched queries */
+
+#define BVH_BATCH_BLOCK 1024
+
+typedef struct {
+  GtsBVH * bvh;
+  const gdouble * xyz;
+  gdouble * distance;
+  gdouble * closest;
+  GtsTriangle ** triangles;
+  guint * order;     /* the points in Morton order */
+  guint n;
+  gint next;         /* the next block of points to process */
+} BVHBatch;
+
+/* spreads the 10 lower bits of @x every third bit */
+static guint32 morton_spread (guint32 x)
+{
+  x &= 0x3ff;
+  x = (x | (x << 16)) & 0x030000ff;
+  x = (x | (x << 8))  & 0x0300f00f;
+  x = (x | (x << 4))  & 0x030c30c3;
+  x = (x | (x << 2))  & 0x09249249;
+  return x;
+}
+
+/* Returns the indices of the @n points @xyz sorted along a Morton
+   curve, so that consecutive points are close to each other */
+static guint * morton_order (const gdouble * xyz, guint n)
+{
+  guint32 * code = g_malloc (n*sizeof (guint32));
+  guint * order = g_malloc (n*sizeof (guint));
+  guint * tmp = g_malloc (n*sizeof (guint));
+  guint * count = g_malloc ((1 << 15)*sizeof (guint));
+  gdouble b[6], scale[3];
+  guint i, c, pass;
+
+  for (c = 0; c < 3; c++)
+    b[c] = b[c + 3] = xyz[c];
+  for (i = 1; i < n; i++)
+    for (c = 0; c < 3; c++) {
+      if (xyz[3*i + c] < b[c]) b[c] = xyz[3*i + c];
+      if (xyz[3*i + c] > b[c + 3]) b[c + 3] = xyz[3*i + c];
+    }
+  for (c = 0; c < 3; c++)
+    scale[c] = b[c + 3] > b[c] ? 1023.99/(b[c + 3] - b[c]) : 0.;
+  for (i = 0; i < n; i++) {
+    code[i] = 0;
+    for (c = 0; c < 3; c++)
+      code[i] |= morton_spread ((xyz[3*i + c] - b[c])*scale[c]) << c;
+    order[i] = i;
+  }
+
+  /* radix sort of the 30 bits codes */
+  for (pass = 0; pass < 2; pass++) {
+    guint shift = 15*pass, sum = 0;
+
+    memset (count, 0, (1 << 15)*sizeof (guint));
+    for (i = 0; i < n; i++)
+      count[(code[order[i]] >> shift) & 0x7fff]++;
+    for (i = 0; i < (1 << 15); i++) {
+      guint m = count[i];
+
+      count[i] = sum;
+      sum += m;
+    }
+    for (i = 0; i < n; i++)
+      tmp[count[(code[order[i]] >> shift) & 0x7fff]++] = order[i];
+    memcpy (order, tmp, n*sizeof (guint));
+  }
+
+  g_free (code);
+  g_free (tmp);
+  g_free (count);
+  return order;
+}
+
+static gpointer bvh_batch_run (BVHBatch * b)
+{
+  GtsBVH * bvh = b->bvh;
+  BVHQuery q;
+  gint k;
+
+  bvh_query_init (&q, bvh);
+  while ((k = g_atomic_int_add (&b->next, 1)) < 
+	 (gint) ((b->n + BVH_BATCH_BLOCK - 1)/BVH_BATCH_BLOCK)) {
+    guint i, end = MIN (b->n, (k + 1)*BVH_BATCH_BLOCK);
+    GtsTriangle * last = NULL;
+
+    for (i = k*BVH_BATCH_BLOCK; i < end; i++) {
+      guint j = b->order[i], l;
+      GtsTriangle * tmin = NULL;
+      gdouble dmin = G_MAXDOUBLE;
+      GtsPoint p;
+
+      p.x = b->xyz[3*j]; p.y = b->xyz[3*j + 1]; p.z = b->xyz[3*j + 2];
+      /* the triangle closest to the previous point is usually close
+	 to this one */
+      if (last) {
+	tmin = last;
+	dmin = gts_point_triangle_distance2 (&p, last);
+      }
+      bvh_point_closest (bvh, &p, dmin, &q);
+      for (l = 0; l < q.nl; l++) {
+	GtsTriangle * t = bvh->bboxes[q.leaves[l]]->bounded;
+
+	if (t != last) {
+	  gdouble d = gts_point_triangle_distance2 (&p, t);
+
+	  if (d < dmin) {
+	    dmin = d;
+	    tmin = t;
+	  }
+	}
+      }
+
+      if (b->distance)
+	b->distance[j] = sqrt (dmin);
+      if (b->closest) {
+	GtsPoint c;
+
+	gts_point_triangle_closest (&p, tmin, &c);
+	b->closest[3*j] = c.x; 
+	b->closest[3*j + 1] = c.y;
+	b->closest[3*j + 2] = c.z;
+      }
+      if (b->triangles)
+	b->triangles[j] = tmin;
+      last = tmin;
+    }
+  }
+  bvh_query_free (&q);
+
+  return NULL;
+}
+
+/**
+ * gts_bvh_points_distance:
+ * @bvh: a #GtsBVH bounding #GtsTriangle.
+ * @xyz: the coordinates of @n points.
+ * @n: the number of points.
+ * @distance: an array of @n distances to fill or %NULL.
+ * @closest: an array of 3 @n coordinates to fill or %NULL.
+ * @triangles: an array of @n triangles to fill or %NULL.
+ * @threads: the number of threads to use or 0 for one per processor.
+ *
+ * For each point of @xyz, finds the closest triangle bounded by a
+ * leaf of @bvh (as built by gts_bvh_surface_full()), its Euclidean
+ * distance to the point and the closest point of the triangle. The
+ * results are stored in the same order as @xyz in each of @distance,
+ * @closest and @triangles which are not %NULL.
+ *
+ * The points are processed along a space-filling curve, so that
+ * consecutive queries visit the same nodes of the tree, the closest
+ * triangle of a point giving a first bound for the next one. This is
+ * much faster than calling gts_bvh_point_distance() for each point
+ * and no memory is allocated per point. The points are split
+ * between @threads threads.
+ */
+void gts_bvh_points_distance (GtsBVH * bvh,
+			      const gdouble * xyz,
+			      guint n,
+			      gdouble * distance,
+			      gdouble * closest,
+			      GtsTriangle ** triangles,
+			      guint threads)
+{
+  BVHBatch b;
+
+  g_return_if_fail (bvh != NULL);
+  g_return_if_fail (n == 0 || xyz != NULL);
+
+  if (n == 0)
+    return;
+  if (threads == 0)
+    threads = g_get_num_processors ();
+
+  b.bvh = bvh;
+  b.xyz = xyz;
+  b.distance = distance;
+  b.closest = closest;
+  b.triangles = triangles;
+  b.order = morton_order (xyz, n);
+  b.n = n;
+  b.next = 0;
+  threads = MAX (1, MIN (threads, n/BVH_BATCH_BLOCK));
+  if (threads == 1)
+    bvh_batch_run (&b);
+  else
+    bvh_threads_run (threads, (GThreadFunc) bvh_batch_run, &b);
+  g_free (b.order);
+}
+
+/**
+ * gts_bvh_triangle_distance:
+ * @bvh: a #GtsBVH.
+ * @t: a #GtsTriangle.
+ * @distance: a #GtsBBoxDistFunc.
+ * @delta: spatial scale of the sampling to be used.
+ * @range: a #GtsRange to be filled with the results.
+ * 
+ * Same as gts_bb_tree_triangle_distance() for a #GtsBVH.
+ */
+void gts_bvh_triangle_distance (GtsBVH * bvh,
+				GtsTriangle * t,
+				GtsBBoxDistFunc distance,
+				gdouble delta,
+				GtsRange * range)
+{
+  g_return_if_fail (bvh != NULL);
+  g_return_if_fail (t != NULL);
+  g_return_if_fail (distance != NULL);
+  g_return_if_fail (delta > 0.);
+  g_return_if_fail (range != NULL);
+
+  triangle_distance (bvh, (PointDistanceFunc) gts_bvh_point_distance,
+		     t, distance, delta, range);
+}
+
+/**
+ * gts_bvh_segment_distance:
+ * @bvh: a #GtsBVH.
+ * @s: a #GtsSegment.
+ * @distance: a #GtsBBoxDistFunc.
+ * @delta: spatial scale of the sampling to be used.
+ * @range: a #GtsRange to be filled with the results.
+ * 
+ * Same as gts_bb_tree_segment_distance() for a #GtsBVH.
+ */
+void gts_bvh_segment_distance (GtsBVH * bvh,
+			       GtsSegment * s,
+			       GtsBBoxDistFunc distance,
+			       gdouble delta,
+			       GtsRange * range)
+{
+  g_return_if_fail (bvh != NULL);
+  g_return_if_fail (s != NULL);
+  g_return_if_fail (distance != NULL);
+  g_return_if_fail (delta > 0.);
+  g_return_if_fail (range != NULL);
+
+  segment_distance (bvh, (PointDistanceFunc) gts_bvh_point_distance,
+		    s, distance, delta, range);
+}
+
+static gdouble bounds_diagonal2 (const gdouble * b)
+{
+  gdouble x = b[3] - b[0], y = b[4] - b[1], z = b[5] - b[2];
+
+  return x*x + y*y + z*z;
+}
+
+/**
+ * gts_bvh_surface_distance:
+ * @bvh: a #GtsBVH.
+ * @s: a #GtsSurface.
+ * @distance: a #GtsBBoxDistFunc.
+ * @delta: a sampling increment defined as the percentage of the diagonal
+ * of the root bounding box of @bvh.
+ * @range: a #GtsRange to be filled with the results.
+ *
+ * Same as gts_bb_tree_surface_distance() for a #GtsBVH.
+ */
+void gts_bvh_surface_distance (GtsBVH * bvh,
+			       GtsSurface * s,
+			       GtsBBoxDistFunc distance,
+			       gdouble delta,
+			       GtsRange * range)
+{
+  g_return_if_fail (bvh != NULL);
+  g_return_if_fail (s != NULL);
+  g_return_if_fail (delta > 0. && delta < 1.);
+  g_return_if_fail (range != NULL);
+
+  surface_distance (bvh, (PointDistanceFunc) gts_bvh_point_distance,
+		    bounds_diagonal2 (bvh->nodes[0].b),
+		    s, distance, delta, range);
+}
+
+typedef struct {
+  GtsTriangle * t;
+  guint n;
+} FaceSamples;
+
+#define BVH_BATCH_SIZE 1048576
+
+static void add_sample (GtsPoint * p, GArray * xyz)
+{
+  g_array_append_vals (xyz, &p->x, 3);
+}
+
+/* Computes the distances of the points sampled on @faces */
+static void batch_distance (gpointer * data)
+{
+  GArray * xyz = data[4], * faces = data[5];
+  guint i, j, k = 0, n = xyz->len/3;
+  gdouble * d = g_malloc (n*sizeof (gdouble));
+
+  gts_bvh_points_distance (data[0], (gdouble *) xyz->data, n, d, NULL, NULL,
+			   *((guint *) data[6]));
+  for (i = 0; i < faces->len; i++) {
+    FaceSamples * f = &g_array_index (faces, FaceSamples, i);
+    GtsRange range_triangle;
+
+    gts_range_init (&range_triangle);
+    for (j = 0; j < f->n; j++)
+      gts_range_add_value (&range_triangle, d[k++]);
+    gts_range_update (&range_triangle);
+    surface_distance_add (f->t, &range_triangle, data[2], data[3]);
+  }
+  g_free (d);
+  g_array_set_size (xyz, 0);
+  g_array_set_size (faces, 0);
+}
+
+static void batch_sample_triangle (GtsTriangle * t, gpointer * data)
+{
+  GArray * xyz = data[4];
+  FaceSamples f;
+  GtsPoint p;
+  guint n = xyz->len;
+
+  triangle_sample (t, *((gdouble *) data[1]), &p, 
+		   (SampleFunc) add_sample, xyz);
+  f.t = t;
+  f.n = (xyz->len - n)/3;
+  g_array_append_val (data[5], f);
+  if (xyz->len >= 3*BVH_BATCH_SIZE)
+    batch_distance (data);
+}
+
+/**
+ * gts_bvh_surface_distance_batch:
+ * @bvh: a #GtsBVH bounding #GtsTriangle.
+ * @s: a #GtsSurface.
+ * @delta: a sampling increment defined as the percentage of the diagonal
+ * of the root bounding box of @bvh.
+ * @range: a #GtsRange to be filled with the results.
+ * @threads: the number of threads to use or 0 for one per processor.
+ *
+ * Same as gts_bvh_surface_distance() with
+ * gts_point_triangle_distance() as distance function, but the points
+ * sampled on the faces of @s are processed by batches using
+ * gts_bvh_points_distance().
+ */
+void gts_bvh_surface_distance_batch (GtsBVH * bvh,
+				     GtsSurface * s,
+				     gdouble delta,
+				     GtsRange * range,
+				     guint threads)
+{
+  gpointer data[7];
+  gdouble total_area = 0.;
+
+  g_return_if_fail (bvh != NULL);
+  g_return_if_fail (s != NULL);
+  g_return_if_fail (delta > 0. && delta < 1.);
+  g_return_if_fail (range != NULL);
+
+  gts_range_init (range);
+  delta *= sqrt (bounds_diagonal2 (bvh->nodes[0].b));
+  data[0] = bvh;
+  data[1] = &delta;
+  data[2] = range;
+  data[3] = &total_area;
+  data[4] = g_array_new (FALSE, FALSE, sizeof (gdouble));
+  data[5] = g_array_new (FALSE, FALSE, sizeof (FaceSamples));
+  data[6] = &threads;
+
+  gts_surface_foreach_face (s, (GtsFunc) batch_sample_triangle, data);
+  batch_distance (data);
+  g_array_free (data[4], TRUE);
+  g_array_free (data[5], TRUE);
+  surface_distance_update (range, total_area);
+}
+
+/**
+ * gts_bvh_surface_boundary_distance:
+ * @bvh: a #GtsBVH.
+ * @s: a #GtsSurface.
+ * @distance: a #GtsBBoxDistFunc.
+ * @delta: a sampling increment defined as the percentage of the diagonal
+ * of the root bounding box of @bvh.
+ * @range: a #GtsRange to be filled with the results.
+ *
+ * Same as gts_bb_tree_surface_boundary_distance() for a #GtsBVH.
+ */
+void gts_bvh_surface_boundary_distance (GtsBVH * bvh,
+					GtsSurface * s,
+					GtsBBoxDistFunc distance,
+					gdouble delta,
+					GtsRange * range)
+{
+  g_return_if_fail (bvh != NULL);
+  g_return_if_fail (s != NULL);
+  g_return_if_fail (delta > 0. && delta < 1.);
+  g_return_if_fail (range != NULL);
+
+  surface_boundary_distance (bvh, (PointDistanceFunc) gts_bvh_point_distance,
+			     bounds_diagonal2 (bvh->nodes[0].b),
+			     s, distance, delta, range);
 }
@@ -41,9 +41,7 @@
 /*#define DEBUG_BOOLEAN*/
 /*#define CHECK_ORIENTED*/
 
-#ifdef DEBUG
-#  include "gts-private.h"
-#endif /* DEBUG */
+#include "gts-private.h"
 
 static void surface_inter_destroy (GtsObject * object)
 {
@@ -939,6 +937,7 @@ GSList * intersect_triangles (GtsTriangle * t1, GtsTriangle * t2, GtsSurfaceInte
       }
     } else {
       if (GTS_VERTEX (vi)!=GTS_SEGMENT (ei)->v1) {
+        GTS_TOPOLOGY_CHANGED ();
         GTS_SEGMENT (ei)->v1 = GTS_VERTEX (vi);
         GTS_SEGMENT (ei)->v2 = GTS_VERTEX (vj);
       }
@@ -3104,21 +3103,22 @@ gboolean gts_surface_foreach_intersecting_face (GtsSurface * s,
                                                 GtsBBTreeTraverseFunc func,
                                                 gpointer data)
 {
-  GNode * tree;
+  GtsBVH * tree;
   gpointer d[3];
   gboolean self_inter = FALSE;
 
   g_return_val_if_fail (s != NULL, FALSE);
   g_return_val_if_fail (func != NULL, FALSE);
 
-  tree = gts_bb_tree_surface (s);
+  if ((tree = gts_bvh_surface (s)) == NULL)
+    return FALSE;
   d[0] = func;
   d[1] = data;
   d[2] = &self_inter;
-  gts_bb_tree_traverse_overlapping (tree, tree,
-                                    (GtsBBTreeTraverseFunc) self_intersecting,
-                                    d);
-  gts_bb_tree_destroy (tree, TRUE);
+  gts_bvh_traverse_overlapping (tree, tree,
+                                (GtsBBTreeTraverseFunc) self_intersecting,
+                                d);
+  gts_bvh_destroy (tree, TRUE);
 
   return self_inter;
 }
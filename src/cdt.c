@@ -58,163 +58,42 @@
 #include <math.h>
 #include "gts.h"
 
-#ifdef USE_SURFACE_BTREE
-
-static gint find_closest (GtsTriangle * t, gpointer value, gpointer * data)
+static void closest_face_update (GtsFace * f, GtsPoint * p,
+				 gdouble * dmin, GtsFace ** closest)
 {
-  guint * ns = data[2];
-  guint * n = data[3];
-
-  if (*n >= *ns)
-    return TRUE;
-  else {
-    gdouble * dmin = data[0];
-    gpointer * closest = data[1];
-    GtsPoint * p = data[4];
+  if (gts_triangle_orientation (GTS_TRIANGLE (f)) > 0.) {
+    GtsPoint * p1 = GTS_POINT (GTS_SEGMENT (GTS_TRIANGLE (f)->e1)->v1);
+    gdouble d = (p->x - p1->x)*(p->x - p1->x) + (p->y - p1->y)*(p->y - p1->y);
 
-    if (gts_triangle_orientation (t) > 0.) {
-      GtsPoint * p1 = GTS_POINT (GTS_SEGMENT (t->e1)->v1);
-      gdouble d = (p->x - p1->x)*(p->x - p1->x) + (p->y - p1->y)*(p->y - p1->y);
-      
-      if (d < *dmin) {
-	*dmin = d;
-	*closest = t;
-      }
-      (*n)++;
+    if (d < *dmin) {
+      *dmin = d;
+      *closest = f;
     }
   }
-  return FALSE;
 }
 
-/* select the face closest to @p among n^1/3 randomly picked faces
- *  of @surface */
+/* select the face closest to @p among n^1/3 faces of @surface picked
+ * at regular intervals */
 static GtsFace * closest_face (GtsSurface * s, GtsPoint * p)
 {
-  guint n = 0, nt, ns;
+  guint i, nt, ns, step;
   gdouble dmin = G_MAXDOUBLE;
   GtsFace * closest = NULL;
-  gpointer data[5];
 
   nt = gts_surface_face_number (s);
   if (!nt)
     return NULL;
   ns = exp (log ((gdouble) nt)/3.);
+  step = ns > 0 ? MAX (nt/ns, 1) : 1;
 
-  data[0] = &dmin;
-  data[1] = &closest;
-  data[2] = &ns;
-  data[3] = &n;
-  data[4] = p;
-  g_tree_traverse (s->faces, (GTraverseFunc) find_closest, G_IN_ORDER, data);
-
-  return closest;
-}
-
-#else /* not USE_SURFACE_BTREE */
-
-#  if GLIB_CHECK_VERSION(2,4,0)
-/* finally, with g_hash_table_find we are able to stop iteration over the hash 
-   table in the middle */
-
-typedef struct _SFindClosest SFindClosest; 
-
-struct _SFindClosest {
-  gdouble dmin; 
-  GtsFace *closest;
-  GtsPoint * p;
-  gint stop;
-};
-
-static gboolean find_closest (gpointer key, gpointer value, gpointer user_data)
-{
-  SFindClosest * data = (SFindClosest *) user_data;
-  GtsFace * f = GTS_FACE (value);
-  
-  if (gts_triangle_orientation (GTS_TRIANGLE (f)) > 0.) {
-    GtsPoint * p1 = GTS_POINT (GTS_SEGMENT (GTS_TRIANGLE (f)->e1)->v1);
-    gdouble d = ((data->p->x - p1->x)*(data->p->x - p1->x) + 
-		 (data->p->y - p1->y)*(data->p->y - p1->y));
-
-    if (d < data->dmin) {
-      data->dmin = d;
-      data->closest = f;
-    }
-  }
-  data->stop--;
-  return !(data->stop > 0);
-}
-
-static GtsFace * closest_face (GtsSurface * s, GtsPoint * p)
-{
-  SFindClosest fc;
-
-  fc.dmin = G_MAXDOUBLE;
-  fc.closest = NULL;
-  fc.p = p;
-  fc.stop = (gint) exp (log ((gdouble) g_hash_table_size (s->faces))/3.);
-  g_hash_table_find (s->faces, find_closest, &fc);
-  
-  return fc.closest;
-}
-
-#  else /* VERSION < 2.4.0 */
+  for (i = 0; i < nt; i += step)
+    closest_face_update (gts_surface_nth_face (s, i), p, &dmin, &closest);
+  /* none of the sampled faces is properly oriented */
+  for (i = 0; i < nt && closest == NULL; i++)
+    closest_face_update (gts_surface_nth_face (s, i), p, &dmin, &closest);
 
-/* Due to an unkown reason g_hash_table_foreach does not allow to stop 
- * the loop, hence the redefinition. I hope they don't change
- * the GHashTable, GHashNode structures ... */
-typedef struct _GHashNode      GHashNode;
-
-struct _GHashNode
-{
-  gpointer key;
-  gpointer value;
-  GHashNode *next;
-};
-
-struct _GHashTable
-{
-  gint size;
-  gint nnodes;
-  guint frozen;
-  GHashNode **nodes;
-  GHashFunc hash_func;
-  GCompareFunc key_compare_func;
-};
-
-/* select the face closest to @p among n^1/3 randomly picked faces
- * of @surface */
-static GtsFace * closest_face (GtsSurface * s, GtsPoint * p)
-{
-  guint i, n, nt, ns;
-  gdouble dmin = G_MAXDOUBLE;
-  GtsFace * closest = NULL;
-  GHashNode * node;
-  GHashTable * hash_table = s->faces;
-
-  nt = g_hash_table_size (hash_table);
-  if (!nt)
-    return NULL;
-
-  ns = exp(log((gdouble) nt)/3.);
-  for (i = 0, n = 0; i < hash_table->size && n < ns; i++)
-    for (node = hash_table->nodes[i]; node && n < ns; node = node->next) {
-      GtsFace * f = node->key;
-
-      if (gts_triangle_orientation (GTS_TRIANGLE (f)) > 0.) {
-	GtsPoint * p1 = GTS_POINT (GTS_SEGMENT (GTS_TRIANGLE (f)->e1)->v1);
-	gdouble d = (p->x - p1->x)*(p->x - p1->x) + (p->y - p1->y)*(p->y - p1->y);
-		 
-	if (d < dmin) {
-	  dmin = d;
-	  closest = f;
-	}
-	n++;
-      }
-    }
   return closest;
 }
-#  endif /* VERSION < 2.4.0 */
-#endif /* not USE_SURFACE_BTREE */
 
 /* returns the face belonging to @surface and neighbor of @f via @e */
 static GtsFace * neighbor (GtsFace * f,
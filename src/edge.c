@@ -32,6 +32,7 @@
  */
 
 #include "gts.h"
+#include "gts-private.h"
 
 gboolean gts_allow_floating_edges = FALSE;
 
@@ -54,6 +55,10 @@ static void edge_clone (GtsObject * clone, GtsObject * object)
 								 object);
   GTS_SEGMENT (clone)->v1 = GTS_SEGMENT (clone)->v2 = NULL;
   GTS_EDGE (clone)->triangles = NULL;
+  GTS_EDGE (clone)->visit = 0;
+#ifdef GTS_INLINE_ADJACENCY
+  GTS_EDGE (clone)->inline_used = 0;
+#endif /* GTS_INLINE_ADJACENCY */
 }
 
 static void edge_class_init (GtsObjectClass * klass)
@@ -65,6 +70,10 @@ static void edge_class_init (GtsObjectClass * klass)
 static void edge_init (GtsEdge * edge)
 {
   edge->triangles = NULL;
+  edge->visit = 0;
+#ifdef GTS_INLINE_ADJACENCY
+  edge->inline_used = 0;
+#endif /* GTS_INLINE_ADJACENCY */
 }
 
 /**
@@ -107,6 +116,67 @@ GtsEdge * gts_edge_new (GtsEdgeClass * klass,
   return GTS_EDGE (gts_segment_new (GTS_SEGMENT_CLASS (klass), v1, v2));
 }
 
+/**
+ * gts_edge_add_triangle:
+ * @e: a #GtsEdge.
+ * @t: a #GtsTriangle.
+ *
+ * Prepends @t to the list of triangles of @e.
+ */
+void gts_edge_add_triangle (GtsEdge * e, GtsTriangle * t)
+{
+  g_return_if_fail (e != NULL);
+  g_return_if_fail (t != NULL);
+
+#ifdef GTS_INLINE_ADJACENCY
+  e->triangles = inline_list_prepend (e->triangles, t, e->inline_triangles,
+				      &e->inline_used,
+				      GTS_EDGE_INLINE_TRIANGLES);
+#else /* not GTS_INLINE_ADJACENCY */
+  e->triangles = g_slist_prepend (e->triangles, t);
+#endif /* not GTS_INLINE_ADJACENCY */
+}
+
+/**
+ * gts_edge_remove_triangle:
+ * @e: a #GtsEdge.
+ * @t: a #GtsTriangle.
+ *
+ * Removes @t from the list of triangles of @e.
+ */
+void gts_edge_remove_triangle (GtsEdge * e, GtsTriangle * t)
+{
+  g_return_if_fail (e != NULL);
+
+#ifdef GTS_INLINE_ADJACENCY
+  e->triangles = inline_list_remove (e->triangles, t, e->inline_triangles,
+				     &e->inline_used,
+				     GTS_EDGE_INLINE_TRIANGLES);
+#else /* not GTS_INLINE_ADJACENCY */
+  e->triangles = g_slist_remove (e->triangles, t);
+#endif /* not GTS_INLINE_ADJACENCY */
+}
+
+/**
+ * gts_edge_free_triangles:
+ * @e: a #GtsEdge.
+ *
+ * Frees the list of triangles of @e and sets @e->triangles to
+ * %NULL. The triangles themselves are not modified.
+ */
+void gts_edge_free_triangles (GtsEdge * e)
+{
+  g_return_if_fail (e != NULL);
+
+#ifdef GTS_INLINE_ADJACENCY
+  inline_list_free (e->triangles, e->inline_triangles, &e->inline_used,
+		    GTS_EDGE_INLINE_TRIANGLES);
+#else /* not GTS_INLINE_ADJACENCY */
+  g_slist_free (e->triangles);
+#endif /* not GTS_INLINE_ADJACENCY */
+  e->triangles = NULL;
+}
+
 /**
  * gts_edge_replace:
  * @e: a #GtsEdge.
@@ -123,6 +193,7 @@ void gts_edge_replace (GtsEdge * e, GtsEdge * with)
 
   g_return_if_fail (e != NULL && with != NULL && e != with);
 
+  GTS_TOPOLOGY_CHANGED ();
   i = e->triangles;
   while (i) {
     GtsTriangle * t = i->data;
@@ -130,11 +201,10 @@ void gts_edge_replace (GtsEdge * e, GtsEdge * with)
     if (t->e2 == e) t->e2 = with;
     if (t->e3 == e) t->e3 = with;
     if (!g_slist_find (with->triangles, t))
-      with->triangles = g_slist_prepend (with->triangles, t);
+      gts_edge_add_triangle (with, t);
     i = i->next;
   }
-  g_slist_free (e->triangles);
-  e->triangles = NULL;
+  gts_edge_free_triangles (e);
 }
 
 /**
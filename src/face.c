@@ -53,6 +53,7 @@ static void face_clone (GtsObject * clone, GtsObject * object)
   (* GTS_OBJECT_CLASS (gts_face_class ())->parent_class->clone) (clone, 
 								 object);
   GTS_FACE (clone)->surfaces = NULL;
+  GTS_FACE (clone)->slot = 0;
 }
 
 static void face_class_init (GtsFaceClass * klass)
@@ -64,6 +65,7 @@ static void face_class_init (GtsFaceClass * klass)
 static void face_init (GtsFace * face)
 {
   face->surfaces = NULL;
+  face->slot = 0;
 }
 
 /**
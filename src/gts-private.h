@@ -23,6 +23,7 @@
 /* Debugging flags */
   
 /* #define DEBUG_FUNCTIONS */
+/* #define DEBUG_SURFACE_COUNTS */
 
 #ifdef DEBUG_FUNCTIONS
 /* #define DEBUG_LEAKS */
@@ -34,4 +35,145 @@ void gts_write_triangle (GtsTriangle * t, GtsPoint * o, FILE * fptr);
 void gts_write_segment (GtsSegment * s, GtsPoint * o, FILE * fptr);
 #endif /* DEBUG_FUNCTIONS */
 
+/* Input of a #GtsFile mapped in memory, see gts_file_new_mapped() */
+typedef struct _GtsFileMap GtsFileMap;
+
+struct _GtsFileMap {
+  gchar * base;          /* start of the mapping */
+  gsize length;          /* length of the mapping */
+  gboolean mmapped;      /* whether @base is to be munmap()ed or g_free()d */
+  gchar * start, * end;  /* the data read by the #GtsFile */
+  FILE * fp;             /* the file mapped */
+  glong offset;          /* the position of @start in @fp */
+  guint threads;         /* see gts_file_set_threads() */
+};
+
+/* Triangle soups, see gts_surface_write_triangle_soup(). The header
+   is made of the signature, the version (uint32), the number of
+   triangles (uint64) and the bounding box (six doubles). */
+#define GTS_SOUP_SIGNATURE     "GtsTriangleSoup\n"
+#define GTS_SOUP_VERSION       1
+#define GTS_SOUP_NT_OFFSET     20
+#define GTS_SOUP_HEADER_SIZE   76
+#define GTS_SOUP_TRIANGLE_SIZE 36
+
+/* Incremented whenever the connectivity of existing vertices, edges
+   or faces is modified in place i.e. not through
+   gts_surface_add_face() or gts_surface_remove_face(). This
+   invalidates the cached vertex and edge numbers of the surfaces. */
+extern guint64 gts_topology_stamp;
+#define GTS_TOPOLOGY_CHANGED() (gts_topology_stamp++)
+
+/* Per-class accounting of the live objects, see
+   gts_object_class_stats(). The counters are updated atomically as
+   objects are also created and destroyed by the worker threads of
+   gts_surface_new_from_arrays() and of the BVH builder. They can be
+   removed by defining GTS_NO_OBJECT_STATS. */
+#ifdef GTS_NO_OBJECT_STATS
+# define object_stats_add(klass)
+# define object_stats_remove(klass)
+#else /* not GTS_NO_OBJECT_STATS */
+static inline
+void object_stats_add (GtsObjectClass * klass)
+{
+  gint n_live = g_atomic_int_add (&klass->n_live, 1) + 1, n_peak;
+
+  g_atomic_int_inc (&klass->n_total);
+  while ((n_peak = g_atomic_int_get (&klass->n_peak)) < n_live &&
+	 !g_atomic_int_compare_and_exchange (&klass->n_peak, n_peak, n_live))
+    ;
+}
+
+static inline
+void object_stats_remove (GtsObjectClass * klass)
+{
+  g_return_if_fail (g_atomic_int_get (&klass->n_live) > 0);
+  g_atomic_int_add (&klass->n_live, -1);
+}
+#endif /* not GTS_NO_OBJECT_STATS */
+
+/* Unregisters and frees a class created with gts_object_class_new() */
+void object_class_free (GtsObjectClass * klass);
+
+/* Changes the class of an existing object */
+static inline
+void object_set_class (GtsObject * object, GtsObjectClass * klass)
+{
+  object_stats_remove (object->klass);
+  object->klass = klass;
+  object_stats_add (klass);
+}
+
+#ifdef GTS_INLINE_ADJACENCY
+/* Inline adjacency lists: the nodes of the list are taken first from
+   the array @nodes of size @n embedded in the object, @used being the
+   bitmask of the nodes of @nodes in use, and then from the heap. */
+
+static inline
+GSList * inline_list_prepend (GSList * list, gpointer data,
+			      GSList * nodes, guint32 * used, guint n)
+{
+  GSList * node;
+
+  if (*used != (n < 32 ? (1U << n) - 1 : ~0U)) {
+    guint k = 0;
+
+    while (*used & (1U << k))
+      k++;
+    *used |= 1U << k;
+    node = &nodes[k];
+  }
+  else
+    node = g_slist_alloc ();
+  node->data = data;
+  node->next = list;
+  return node;
+}
+
+static inline
+void inline_list_free_1 (GSList * node,
+			 GSList * nodes, guint32 * used, guint n)
+{
+  if (node >= nodes && node < nodes + n)
+    *used &= ~(1U << (node - nodes));
+  else
+    g_slist_free_1 (node);
+}
+
+static inline
+GSList * inline_list_remove (GSList * list, gpointer data,
+			     GSList * nodes, guint32 * used, guint n)
+{
+  GSList * i = list, * prev = NULL;
+
+  while (i) {
+    if (i->data == data) {
+      if (prev)
+	prev->next = i->next;
+      else
+	list = i->next;
+      inline_list_free_1 (i, nodes, used, n);
+      break;
+    }
+    prev = i;
+    i = i->next;
+  }
+  return list;
+}
+
+static inline
+void inline_list_free (GSList * list,
+		       GSList * nodes, guint32 * used, guint n)
+{
+  while (list) {
+    GSList * next = list->next;
+
+    if (list < nodes || list >= nodes + n)
+      g_slist_free_1 (list);
+    list = next;
+  }
+  *used = 0;
+}
+#endif /* GTS_INLINE_ADJACENCY */
+
 #endif /* __GTS_PRIVATE_H__ */
@@ -70,13 +70,14 @@ GTS_C_VAR const guint gts_binary_age;
 #define GTS_OBJ_TOKENS     ""
 
 #define GTS_MAINTAINER "luis94855510@gmail.com"
-#define USE_SURFACE_BTREE 1
 
 /* Class declarations for base types */
 
 typedef struct _GtsObjectClassInfo     GtsObjectClassInfo;
 typedef struct _GtsObject        GtsObject;
 typedef struct _GtsObjectClass   GtsObjectClass;
+typedef struct _GtsObjectPool    GtsObjectPool;
+typedef struct _GtsObjectArena   GtsObjectArena;
 typedef struct _GtsException       GtsException;
 typedef struct _GtsExceptionClass  GtsExceptionClass;
 typedef struct _GtsPoint         GtsPoint;
@@ -208,6 +209,9 @@ struct _GtsFile {
   gchar * tokens;
 
   GtsFileType ftype;
+
+  /*< private >*/
+  struct _GtsFileMap * map;
 };
 
 typedef struct _GtsFileVariable GtsFileVariable;
@@ -226,6 +230,9 @@ GtsFile *      gts_file_new                 (FILE * fp);
 GtsFile *      gts_file_new_obj             (FILE * fp);
 GtsFile *      gts_file_new_from_string     (const gchar * s);
 GtsFile *      gts_file_new_from_string_obj (const gchar * s);
+GtsFile *      gts_file_new_mapped          (FILE * fp);
+void           gts_file_set_threads         (GtsFile * f,
+                                             guint threads);
 void           gts_file_verror              (GtsFile * f,
                                              const gchar * format,
                                              va_list args);
@@ -323,7 +330,8 @@ void           gts_file_destroy             (GtsFile * f);
 typedef enum
 {
   GTS_DESTROYED         = 1 << 0,
-  GTS_USER_FLAG         = 1 /* user flags start from here */
+  GTS_POOLED            = 1 << 1,
+  GTS_USER_FLAG         = 2 /* user flags start from here */
 } GtsObjectFlags;
 
 #define GTS_OBJECT_FLAGS(obj)             (GTS_OBJECT (obj)->flags)
@@ -379,6 +387,10 @@ struct _GtsObject {
  * @clone method just copies the object structure. The default
  * @destroy method frees the memory allocated for a given object
  * structure.
+ *
+ * Each class also stores its depth in the class hierarchy and the
+ * table of its ancestors indexed by depth, which makes
+ * gts_object_is_from_class() a constant time test.
  */
 struct _GtsObjectClass {
   GtsObjectClassInfo info;
@@ -390,6 +402,14 @@ struct _GtsObjectClass {
   void        (* write)      (GtsObject *, FILE *);
   GtsColor    (* color)      (GtsObject *);
   void        (* attributes) (GtsObject *, GtsObject *);
+
+  GtsObjectPool * pool;
+
+  /*< private >*/
+  guint depth;
+  GtsObjectClass ** ancestors;
+  gint n_live, n_peak;
+  guint n_total;
 };
 
 gpointer         gts_object_class_new      (GtsObjectClass * parent_class,
@@ -405,6 +425,7 @@ gpointer gts_object_is_from_class (gpointer object,
                                    gpointer klass)
 {
   GtsObjectClass * c;
+  guint d;
 
   g_return_val_if_fail (klass != NULL, NULL);
 
@@ -415,13 +436,8 @@ gpointer gts_object_is_from_class (gpointer object,
 
   g_return_val_if_fail (c != NULL, NULL);
 
-  while (c) {
-    if (c == klass)
-      return object;
-    c = c->parent_class;
-  }
-
-  return NULL;
+  d = ((GtsObjectClass *) klass)->depth;
+  return d <= c->depth && c->ancestors[d] == klass ? object : NULL;
 }
 
 static inline
@@ -429,18 +445,14 @@ gpointer gts_object_class_is_from_class (gpointer klass,
                                          gpointer from)
 {
   GtsObjectClass * c;
+  guint d;
 
   g_return_val_if_fail (klass != NULL, NULL);
   g_return_val_if_fail (from != NULL, NULL);
 
   c = (GtsObjectClass *) klass;
-  while (c) {
-    if (c == from)
-      return klass;
-    c = c->parent_class;
-  }
-
-  return NULL;
+  d = ((GtsObjectClass *) from)->depth;
+  return d <= c->depth && c->ancestors[d] == from ? klass : NULL;
 }
 
 GtsObjectClass * gts_object_class_from_name     (const gchar * name);
@@ -455,6 +467,66 @@ void             gts_object_reset_reserved      (GtsObject * object);
 void             gts_object_destroy             (GtsObject * object);
 void             gts_finalize                   (void);
 
+typedef struct _GtsObjectPoolStats     GtsObjectPoolStats;
+
+struct _GtsObjectPoolStats {
+  guint object_size;
+  guint n_slabs;
+  guint n_used;
+  guint n_free;
+  gulong bytes;
+};
+
+void             gts_object_class_set_pool      (GtsObjectClass * klass,
+                                                 gboolean pool);
+void             gts_object_class_pool_stats    (GtsObjectClass * klass,
+                                                 GtsObjectPoolStats * stats);
+guint            gts_object_class_pool_trim     (GtsObjectClass * klass);
+void             gts_object_class_pool_release  (GtsObjectClass * klass);
+
+GtsObjectArena * gts_object_arena_new           (void);
+GtsObjectArena * gts_object_arena_set_current   (GtsObjectArena * arena);
+void             gts_object_arena_foreach       (GtsObjectArena * arena,
+                                                 GtsFunc func,
+                                                 gpointer data);
+gboolean         gts_object_arena_contains      (GtsObjectArena * arena,
+                                                 GtsObject * object);
+void             gts_object_arena_destroy       (GtsObjectArena * arena,
+                                                 gboolean force);
+
+typedef struct _GtsObjectClassStats    GtsObjectClassStats;
+
+/**
+ * GtsObjectClassStats:
+ * @klass: the #GtsObjectClass.
+ * @n_live: the number of objects of @klass not yet destroyed.
+ * @n_peak: the maximum of @n_live.
+ * @n_total: the total number of objects of @klass created.
+ * @bytes: the memory used by the live objects.
+ * @peak_bytes: the memory used by the live objects at the peak.
+ *
+ * Memory statistics of a #GtsObjectClass. Only the objects whose
+ * class is exactly @klass are counted (i.e. not the objects of
+ * derived classes).
+ */
+struct _GtsObjectClassStats {
+  GtsObjectClass * klass;
+  gulong n_live;
+  gulong n_peak;
+  gulong n_total;
+  gulong bytes;
+  gulong peak_bytes;
+};
+
+void             gts_object_class_stats         (GtsObjectClass * klass,
+                                                 GtsObjectClassStats * stats);
+GArray *         gts_object_stats_snapshot      (void);
+void             gts_object_stats_write         (GArray * snapshot,
+                                                 FILE * fp);
+void             gts_object_stats_write_json    (GArray * snapshot,
+                                                 FILE * fp);
+void             gts_object_stats_reset_peak    (void);
+
 /* Ranges: surface.c */
 typedef struct _GtsRange               GtsRange;
 
@@ -777,17 +849,39 @@ gboolean      gts_point_is_inside_surface            (GtsPoint * p,
                                                        GtsVertexClass,\
                                                        gts_vertex_class ())
 
+/**
+ * GTS_VERTEX_INLINE_SEGMENTS:
+ *
+ * If GTS_INLINE_ADJACENCY is defined, the number of nodes of the
+ * @segments list of a #GtsVertex which are stored inline.
+ */
+#ifdef GTS_INLINE_ADJACENCY
+# ifndef GTS_VERTEX_INLINE_SEGMENTS
+#  define GTS_VERTEX_INLINE_SEGMENTS 8
+# endif
+#endif /* GTS_INLINE_ADJACENCY */
+
 /**
  * GtsVertex:
  * @p: The parent object.
  * @segments: Contains all the #GtsSegment using this vertex as one of their endpoints.
  *
- * The vertex object.
+ * The vertex object. The @segments list must only be modified using
+ * gts_vertex_add_segment(), gts_vertex_remove_segment() and
+ * gts_vertex_free_segments(). If GTS_INLINE_ADJACENCY is defined,
+ * its first nodes are stored in the vertex itself.
  */
 struct _GtsVertex {
   GtsPoint p;
 
   GSList * segments;
+
+  /*< private >*/
+  guint64 visit;
+#ifdef GTS_INLINE_ADJACENCY
+  GSList inline_segments[GTS_VERTEX_INLINE_SEGMENTS];
+  guint32 inline_used;
+#endif /* GTS_INLINE_ADJACENCY */
 };
 
 /**
@@ -813,6 +907,11 @@ GtsVertex *   gts_vertex_new               (GtsVertexClass * klass,
                                             gdouble x,
                                             gdouble y,
                                             gdouble z);
+void          gts_vertex_add_segment       (GtsVertex * v,
+                                            GtsSegment * s);
+void          gts_vertex_remove_segment    (GtsVertex * v,
+                                            GtsSegment * s);
+void          gts_vertex_free_segments     (GtsVertex * v);
 void          gts_vertex_replace           (GtsVertex * v,
                                             GtsVertex * with);
 gboolean      gts_vertex_is_unattached     (GtsVertex * v);
@@ -1014,17 +1113,39 @@ gboolean      gts_segment_is_ok                      (GtsSegment * s);
                                                      GtsEdgeClass,\
                                                      gts_edge_class ())
 
+/**
+ * GTS_EDGE_INLINE_TRIANGLES:
+ *
+ * If GTS_INLINE_ADJACENCY is defined, the number of nodes of the
+ * @triangles list of a #GtsEdge which are stored inline.
+ */
+#ifdef GTS_INLINE_ADJACENCY
+# ifndef GTS_EDGE_INLINE_TRIANGLES
+#  define GTS_EDGE_INLINE_TRIANGLES 2
+# endif
+#endif /* GTS_INLINE_ADJACENCY */
+
 /**
  * GtsEdge:
  * @segment: The parent object.
  * @triangles: List of #GtsTriangle using this edge.
  *
- * The edge object.
+ * The edge object. The @triangles list must only be modified using
+ * gts_edge_add_triangle(), gts_edge_remove_triangle() and
+ * gts_edge_free_triangles(). If GTS_INLINE_ADJACENCY is defined, its
+ * first nodes are stored in the edge itself.
  */
 struct _GtsEdge {
   GtsSegment segment;
 
   GSList * triangles;
+
+  /*< private >*/
+  guint64 visit;
+#ifdef GTS_INLINE_ADJACENCY
+  GSList inline_triangles[GTS_EDGE_INLINE_TRIANGLES];
+  guint32 inline_used;
+#endif /* GTS_INLINE_ADJACENCY */
 };
 
 /**
@@ -1044,6 +1165,11 @@ GtsEdgeClass * gts_edge_class                     (void);
 GtsEdge *     gts_edge_new                        (GtsEdgeClass * klass,
                                                    GtsVertex * v1,
                                                    GtsVertex * v2);
+void          gts_edge_add_triangle               (GtsEdge * e,
+                                                   GtsTriangle * t);
+void          gts_edge_remove_triangle            (GtsEdge * e,
+                                                   GtsTriangle * t);
+void          gts_edge_free_triangles             (GtsEdge * e);
 /**
  * gts_edge_is_unattached:
  * @s: a #GtsEdge.
@@ -1254,6 +1380,9 @@ struct _GtsFace {
   GtsTriangle triangle;
 
   GSList * surfaces;
+
+  /*< private >*/
+  guint slot;
 };
 
 /**
@@ -1593,6 +1722,130 @@ void       gts_bb_tree_surface_boundary_distance
 void       gts_bb_tree_destroy               (GNode * tree,
                                               gboolean free_leaves);
 
+/* Flat bounding box trees: bbtree.c */
+
+typedef struct _GtsBVH      GtsBVH;
+typedef struct _GtsBVHStats GtsBVHStats;
+
+/**
+ * GtsBVHBuilder:
+ * @GTS_BVH_MIDPOINT: cut at the middle of the longest dimension of
+ * each node, as gts_bb_tree_new().
+ * @GTS_BVH_MEDIAN: cut each node in two halves along the longest
+ * dimension of the centers of its bounding boxes.
+ * @GTS_BVH_BINNED_SAH: choose the cut using the surface area
+ * heuristic evaluated on a few candidate planes.
+ * @GTS_BVH_SWEEP_SAH: choose the cut using the surface area
+ * heuristic evaluated between each pair of consecutive bounding
+ * boxes, sorted once along each axis.
+ *
+ * The methods used to build a #GtsBVH, see gts_bvh_new_full().
+ */
+typedef enum {
+  GTS_BVH_MIDPOINT,
+  GTS_BVH_MEDIAN,
+  GTS_BVH_BINNED_SAH,
+  GTS_BVH_SWEEP_SAH
+} GtsBVHBuilder;
+
+/**
+ * GtsBVHStats:
+ * @n_nodes: the number of nodes.
+ * @n_leaves: the number of leaf nodes.
+ * @depth: the depth of the tree.
+ * @sah_cost: the cost of the tree according to the surface area heuristic.
+ * @leaf_size: the number of bounding boxes of the leaf nodes.
+ * @leaf_depth: the depth of the leaf nodes.
+ *
+ * Statistics on the quality of a #GtsBVH, see gts_bvh_stats().
+ */
+struct _GtsBVHStats {
+  guint n_nodes;
+  guint n_leaves;
+  guint depth;
+  gdouble sah_cost;
+  GtsRange leaf_size, leaf_depth;
+};
+
+GtsBVH *   gts_bvh_new                       (GSList * bboxes);
+GtsBVH *   gts_bvh_new_full                  (GSList * bboxes,
+                                              GtsBVHBuilder builder,
+                                              guint leaf_size,
+                                              guint threads);
+GtsBVH *   gts_bvh_surface                   (GtsSurface * s);
+GtsBVH *   gts_bvh_surface_full              (GtsSurface * s,
+                                              GtsBVHBuilder builder,
+                                              guint leaf_size,
+                                              guint threads);
+void       gts_bvh_rebuild                   (GtsBVH * bvh,
+                                              GtsBVHBuilder builder,
+                                              guint leaf_size,
+                                              guint threads);
+gboolean   gts_bvh_refit                     (GtsBVH * bvh,
+                                              gdouble threshold,
+                                              guint threads);
+void       gts_bvh_stats                     (GtsBVH * bvh,
+                                              GtsBVHStats * stats);
+GtsBVH *   gts_bvh_new_from_bb_tree          (GNode * tree);
+GtsBBox *  gts_bvh_bbox                      (GtsBBoxClass * klass,
+                                              GtsBVH * bvh);
+GtsBBox ** gts_bvh_leaves                    (GtsBVH * bvh,
+                                              guint * n);
+GSList *   gts_bvh_stabbed                   (GtsBVH * bvh,
+                                              GtsPoint * p);
+GSList *   gts_bvh_overlap                   (GtsBVH * bvh,
+                                              GtsBBox * bbox);
+gboolean   gts_bvh_is_overlapping            (GtsBVH * bvh,
+                                              GtsBBox * bbox);
+void       gts_bvh_traverse_overlapping      (GtsBVH * bvh1,
+                                              GtsBVH * bvh2,
+                                              GtsBBTreeTraverseFunc func,
+                                              gpointer data);
+GSList *   gts_bvh_point_closest_bboxes      (GtsBVH * bvh,
+                                              GtsPoint * p);
+gdouble    gts_bvh_point_distance            (GtsBVH * bvh,
+                                              GtsPoint * p,
+                                              GtsBBoxDistFunc distance,
+                                              GtsBBox ** bbox);
+GtsPoint * gts_bvh_point_closest             (GtsBVH * bvh,
+                                              GtsPoint * p,
+                                              GtsBBoxClosestFunc closest,
+                                              gdouble * distance);
+void       gts_bvh_points_distance           (GtsBVH * bvh,
+                                              const gdouble * xyz,
+                                              guint n,
+                                              gdouble * distance,
+                                              gdouble * closest,
+                                              GtsTriangle ** triangles,
+                                              guint threads);
+void       gts_bvh_segment_distance          (GtsBVH * bvh,
+                                              GtsSegment * s,
+                                              GtsBBoxDistFunc distance,
+                                              gdouble delta,
+                                              GtsRange * range);
+void       gts_bvh_triangle_distance         (GtsBVH * bvh,
+                                              GtsTriangle * t,
+                                              GtsBBoxDistFunc distance,
+                                              gdouble delta,
+                                              GtsRange * range);
+void       gts_bvh_surface_distance          (GtsBVH * bvh,
+                                              GtsSurface * s,
+                                              GtsBBoxDistFunc distance,
+                                              gdouble delta,
+                                              GtsRange * range);
+void       gts_bvh_surface_distance_batch    (GtsBVH * bvh,
+                                              GtsSurface * s,
+                                              gdouble delta,
+                                              GtsRange * range,
+                                              guint threads);
+void       gts_bvh_surface_boundary_distance (GtsBVH * bvh,
+                                              GtsSurface * s,
+                                              GtsBBoxDistFunc distance,
+                                              gdouble delta,
+                                              GtsRange * range);
+void       gts_bvh_destroy                   (GtsBVH * bvh,
+                                              gboolean free_leaves);
+
 /* Surfaces: surface.c */
 
 typedef struct _GtsSurfaceStats        GtsSurfaceStats;
@@ -1629,27 +1882,34 @@ struct _GtsSurfaceQualityStats {
 /**
  * GtsSurface:
  * @object: The parent object.
- * @faces: a tree data structure of faces.
- * @faces: a tree data structure of faces.
+ * @faces: the faces of the surface, stored contiguously in no
+ * particular order.
  * @face_class: The face class.
  * @edge_class: The edge class.
  * @vertex_class: The vertex class.
  * @keep_faces: Used internally.
+ * @arena: the arena of the surface or %NULL.
+ * @unshared: if %TRUE the objects allocated in @arena are not used
+ * outside the surface and are freed together with the surface.
  *
  * The surface object.
  */
 struct _GtsSurface {
   GtsObject object;
 
-#ifdef USE_SURFACE_BTREE
-  GTree * faces;
-#else /* not USE_SURFACE_BTREE */
-  GHashTable * faces;
-#endif /* not USE_SURFACE_BTREE */
+  GPtrArray * faces;
   GtsFaceClass * face_class;
   GtsEdgeClass * edge_class;
   GtsVertexClass * vertex_class;
   gboolean keep_faces;
+  GtsObjectArena * arena;
+  gboolean unshared;
+
+  /*< private >*/
+  GHashTable * shared;
+  guint n_vertices, n_edges;
+  gboolean counts_valid;
+  guint64 counts_stamp;
 };
 
 /**
@@ -1699,6 +1959,16 @@ GtsSurface * gts_surface_new               (GtsSurfaceClass * klass,
                                             GtsFaceClass * face_class,
                                             GtsEdgeClass * edge_class,
                                             GtsVertexClass * vertex_class);
+GtsSurface * gts_surface_new_from_arrays   (GtsSurfaceClass * klass,
+                                            GtsFaceClass * face_class,
+                                            GtsEdgeClass * edge_class,
+                                            GtsVertexClass * vertex_class,
+                                            const gdouble * xyz,
+                                            guint nv,
+                                            const guint * triangles,
+                                            guint nt,
+                                            guint threads);
+GtsObjectArena * gts_surface_arena         (GtsSurface * s);
 void         gts_surface_add_face          (GtsSurface * s,
                                             GtsFace * f);
 void         gts_surface_remove_face       (GtsSurface * s,
@@ -1707,6 +1977,11 @@ guint        gts_surface_read              (GtsSurface * surface,
                                             GtsFile * f);
 guint        gts_surface_read_obj          (GtsSurface * surface,
                                             GtsFile * f);
+guint        gts_surface_read_stl          (GtsSurface * surface,
+                                            GtsFile * f,
+                                            gdouble epsilon);
+guint        gts_surface_read_ply          (GtsSurface * surface,
+                                            GtsFile * f);
 gdouble      gts_surface_area              (GtsSurface * s);
 void         gts_surface_stats             (GtsSurface * s,
                                             GtsSurfaceStats * stats);
@@ -1716,8 +1991,23 @@ void         gts_surface_print_stats       (GtsSurface * s,
                                             FILE * fptr);
 void         gts_surface_write             (GtsSurface * s,
                                             FILE * fptr);
+void         gts_surface_write_parallel    (GtsSurface * s,
+                                            FILE * fptr,
+                                            guint threads);
+void         gts_surface_write_binary      (GtsSurface * s,
+                                            FILE * fptr);
 void         gts_surface_write_obj         (GtsSurface * s,
                                             FILE * fptr);
+void         gts_surface_write_stl         (GtsSurface * s,
+                                            FILE * fptr,
+                                            gboolean binary);
+void         gts_surface_write_ply         (GtsSurface * s,
+                                            FILE * fptr,
+                                            gboolean binary);
+void         gts_surface_write_triangle_soup (GtsSurface * s,
+                                              FILE * fptr);
+guint        gts_triangle_soup_convert     (GtsFile * f,
+                                            FILE * fptr);
 void         gts_surface_write_oogl        (GtsSurface * s,
                                             FILE * fptr);
 void         gts_surface_write_vtk         (GtsSurface * s,
@@ -1736,6 +2026,12 @@ void         gts_surface_foreach_face      (GtsSurface * s,
 guint        gts_surface_foreach_face_remove (GtsSurface * s,
                                               GtsFunc func,
                                               gpointer data);
+void         gts_surface_export_arrays     (GtsSurface * s,
+                                            gdouble ** xyz,
+                                            gdouble ** normals,
+                                            guint ** triangles,
+                                            guint * nv,
+                                            guint * nt);
 typedef struct _GtsSurfaceTraverse GtsSurfaceTraverse;
 GtsSurfaceTraverse * gts_surface_traverse_new (GtsSurface * s,
                                                GtsFace * f);
@@ -1784,11 +2080,19 @@ gdouble      gts_surface_center_of_area    (GtsSurface * s,
 guint        gts_surface_vertex_number     (GtsSurface * s);
 guint        gts_surface_edge_number       (GtsSurface * s);
 guint        gts_surface_face_number       (GtsSurface * s);
+GtsFace *    gts_surface_nth_face          (GtsSurface * s,
+                                            guint n);
 void         gts_surface_distance          (GtsSurface * s1,
                                             GtsSurface * s2,
                                             gdouble delta,
                                             GtsRange * face_range,
                                             GtsRange * boundary_range);
+void         gts_surface_distance_parallel (GtsSurface * s1,
+                                            GtsSurface * s2,
+                                            gdouble delta,
+                                            GtsRange * face_range,
+                                            GtsRange * boundary_range,
+                                            guint threads);
 GSList *     gts_surface_boundary          (GtsSurface * surface);
 GSList *     gts_surface_split             (GtsSurface * s);
 
@@ -2073,6 +2377,25 @@ void           gts_fifo_foreach       (GtsFifo * fifo,
 void           gts_fifo_reverse       (GtsFifo * fifo);
 void           gts_fifo_destroy       (GtsFifo * fifo);
 
+/* Scratch tables: scratch.c */
+
+typedef struct _GtsScratch GtsScratch;
+
+GtsScratch *   gts_scratch_new        (guint size);
+void           gts_scratch_set        (GtsScratch * scratch,
+                                       gpointer object,
+                                       gpointer data);
+gpointer       gts_scratch_get        (GtsScratch * scratch,
+                                       gpointer object);
+void           gts_scratch_remove     (GtsScratch * scratch,
+                                       gpointer object);
+guint          gts_scratch_size       (GtsScratch * scratch);
+void           gts_scratch_foreach    (GtsScratch * scratch,
+                                       GHFunc func,
+                                       gpointer data);
+void           gts_scratch_clear      (GtsScratch * scratch);
+void           gts_scratch_destroy    (GtsScratch * scratch);
+
 /* Progressive surfaces */
 
 /* split.c */
@@ -2145,6 +2468,9 @@ struct _GtsPSurface {
 
   GPtrArray * vertices;
   GPtrArray * faces;
+
+  /*< private >*/
+  struct _GtsPSurfaceBinary * binary;
 };
 
 struct _GtsPSurfaceClass {
@@ -2181,6 +2507,9 @@ void          gts_psurface_set_vertex_number  (GtsPSurface * ps,
 guint         gts_psurface_get_vertex_number  (GtsPSurface * ps);
 void          gts_psurface_write              (GtsPSurface * ps,
                                                FILE * fptr);
+void          gts_psurface_write_binary       (GtsPSurface * ps,
+                                               FILE * fptr,
+                                               gdouble step);
 GtsPSurface * gts_psurface_open               (GtsPSurfaceClass * klass,
                                                GtsSurface * s,
                                                GtsSplitClass * split_class,
@@ -2188,6 +2517,10 @@ GtsPSurface * gts_psurface_open               (GtsPSurfaceClass * klass,
 GtsSplit *    gts_psurface_read_vertex        (GtsPSurface * ps,
                                                GtsFile * fp);
 void          gts_psurface_close              (GtsPSurface * ps);
+gboolean      gts_psurface_lod                (GtsPSurface * ps,
+                                               guint n,
+                                               guint * nf,
+                                               gsize * size);
 void          gts_psurface_foreach_vertex     (GtsPSurface * ps,
                                                GtsFunc func,
                                                gpointer data);
@@ -2701,6 +3034,14 @@ void           gts_cluster_grid_add_triangle (GtsClusterGrid * cluster_grid,
                                               GtsPoint * p3,
                                               gpointer data);
 GtsRange       gts_cluster_grid_update       (GtsClusterGrid * cluster_grid);
+gboolean       gts_triangle_soup_read_header (FILE * fptr,
+                                              guint64 * nt,
+                                              GtsBBox * bbox);
+guint64        gts_cluster_grid_read_triangle_soup 
+                                             (GtsClusterGrid * cluster_grid,
+                                              FILE * fptr,
+                                              guint64 nt,
+                                              gpointer data);
 
 /* Triangle strip generation: stripe.c */
 GSList *       gts_surface_strip             (GtsSurface * s);
@@ -3372,6 +3713,57 @@ GtsGraphBisection * gts_graph_bisection_new        (GtsWGraph * wg,
 void                gts_graph_bisection_destroy    (GtsGraphBisection * bg,
                                                     gboolean destroy_graphs);
 
+/* Mesh arrays: mesh.c */
+
+typedef struct _GtsMeshArrays GtsMeshArrays;
+
+/**
+ * GtsMeshArrays:
+ * @n_vertices: the number of vertices.
+ * @n_faces: the number of faces.
+ * @n_edges: the number of edges (0 if @edges is %NULL).
+ * @xyz: the coordinates of the vertices (3*@n_vertices).
+ * @faces: the indices of the three vertices of each face (3*@n_faces).
+ * @edges: the indices of the two vertices of each edge (2*@n_edges)
+ * or %NULL.
+ * @face_edges: the indices of the three edges of each face
+ * (3*@n_faces) or %NULL. Edge k of face f joins vertices k and (k + 1)
+ * % 3 of f.
+ * @opposite: for each half-edge 3*f + k (edge k of face f), the index
+ * of the opposite half-edge or -1 if the edge is a boundary or a
+ * non-manifold edge (3*@n_faces) or %NULL.
+ *
+ * A compact, array-based representation of a triangulated surface.
+ */
+struct _GtsMeshArrays {
+  guint n_vertices, n_faces, n_edges;
+  gdouble * xyz;
+  gint32 * faces;
+  gint32 * edges;
+  gint32 * face_edges;
+  gint32 * opposite;
+};
+
+GtsMeshArrays * gts_mesh_arrays_new          (guint n_vertices,
+                                              guint n_faces);
+GtsMeshArrays * gts_mesh_arrays_from_surface (GtsSurface * s,
+                                              gboolean edges);
+void            gts_mesh_arrays_build_edges  (GtsMeshArrays * m);
+guint           gts_mesh_arrays_half_edges   (GtsMeshArrays * m);
+GtsVertex **    gts_mesh_arrays_to_surface   (GtsMeshArrays * m,
+                                              GtsSurface * s);
+gdouble         gts_mesh_arrays_area         (GtsMeshArrays * m);
+gdouble         gts_mesh_arrays_volume       (GtsMeshArrays * m);
+void            gts_mesh_arrays_bbox         (GtsMeshArrays * m,
+                                              GtsVector min,
+                                              GtsVector max);
+void            gts_mesh_arrays_stats        (GtsMeshArrays * m,
+                                              guint * n_boundary_edges,
+                                              guint * n_non_manifold_edges,
+                                              GtsRange * face_area,
+                                              GtsRange * edge_length);
+void            gts_mesh_arrays_destroy      (GtsMeshArrays * m);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
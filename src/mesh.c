@@ -0,0 +1,475 @@
+/* GTS - Library for the manipulation of triangulated surfaces
+ * Copyright (C) 1999 Stéphane Popinet
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <math.h>
+#include "gts.h"
+
+/**
+ * gts_mesh_arrays_new:
+ * @n_vertices: the number of vertices.
+ * @n_faces: the number of faces.
+ *
+ * The coordinates and face indices of the new mesh are not
+ * initialized. It has no edge information.
+ *
+ * Returns: a new #GtsMeshArrays with room for @n_vertices vertices and
+ * @n_faces faces.
+ */
+GtsMeshArrays * gts_mesh_arrays_new (guint n_vertices, guint n_faces)
+{
+  GtsMeshArrays * m = g_malloc0 (sizeof (GtsMeshArrays));
+
+  m->n_vertices = n_vertices;
+  m->n_faces = n_faces;
+  m->xyz = g_malloc ((gsize) 3*n_vertices*sizeof (gdouble));
+  m->faces = g_malloc ((gsize) 3*n_faces*sizeof (gint32));
+
+  return m;
+}
+
+/**
+ * gts_mesh_arrays_destroy:
+ * @m: a #GtsMeshArrays.
+ *
+ * Frees all the memory allocated for @m.
+ */
+void gts_mesh_arrays_destroy (GtsMeshArrays * m)
+{
+  g_return_if_fail (m != NULL);
+
+  g_free (m->xyz);
+  g_free (m->faces);
+  g_free (m->edges);
+  g_free (m->face_edges);
+  g_free (m->opposite);
+  g_free (m);
+}
+
+/* The indices (starting from one) of the vertices and edges are kept
+   in the scratch tables @vindex and @eindex */
+#define MESH_INDEX(index, o) GPOINTER_TO_UINT (gts_scratch_get (index, o))
+
+static void mesh_add_face (GtsTriangle * t, gpointer * data)
+{
+  GtsMeshArrays * m = data[0];
+  GArray * xyz = data[1];
+  GArray * edges = data[2];
+  GtsScratch * vindex = data[3];
+  GtsScratch * eindex = data[4];
+  gint32 * f = &m->faces[(gsize) 3*m->n_faces];
+  GtsVertex * v[3];
+  GtsEdge * e[3];
+  guint i;
+
+  gts_triangle_vertices (t, &v[0], &v[1], &v[2]);
+  for (i = 0; i < 3; i++) {
+    guint index = MESH_INDEX (vindex, v[i]);
+
+    if (index == 0) {
+      g_array_append_vals (xyz, &GTS_POINT (v[i])->x, 1);
+      g_array_append_vals (xyz, &GTS_POINT (v[i])->y, 1);
+      g_array_append_vals (xyz, &GTS_POINT (v[i])->z, 1);
+      index = ++m->n_vertices;
+      gts_scratch_set (vindex, v[i], GUINT_TO_POINTER (index));
+    }
+    f[i] = index - 1;
+  }
+
+  if (edges) {
+    gint32 * fe = &m->face_edges[(gsize) 3*m->n_faces];
+
+    e[0] = t->e1; e[1] = t->e2; e[2] = t->e3;
+    for (i = 0; i < 3; i++) {
+      guint index = MESH_INDEX (eindex, e[i]);
+
+      if (index == 0) {
+	gint32 ev[2];
+
+	ev[0] = MESH_INDEX (vindex, GTS_SEGMENT (e[i])->v1) - 1;
+	ev[1] = MESH_INDEX (vindex, GTS_SEGMENT (e[i])->v2) - 1;
+	g_array_append_vals (edges, ev, 2);
+	index = ++m->n_edges;
+	gts_scratch_set (eindex, e[i], GUINT_TO_POINTER (index));
+      }
+      fe[i] = index - 1;
+    }
+  }
+
+  m->n_faces++;
+}
+
+/**
+ * gts_mesh_arrays_from_surface:
+ * @s: a #GtsSurface.
+ * @edges: whether to build the edge and half-edge arrays.
+ *
+ * Builds a compact, array-based copy of the vertices and faces of
+ * @s. The vertices of each face are stored in the order given by
+ * gts_triangle_vertices(). If @edges is %TRUE, the edges of @s and the
+ * half-edge adjacency are also stored (see #GtsMeshArrays) and the
+ * mesh can be converted back to a surface with exactly the same
+ * topology.
+ *
+ * Returns: a new #GtsMeshArrays.
+ */
+GtsMeshArrays * gts_mesh_arrays_from_surface (GtsSurface * s,
+					      gboolean edges)
+{
+  GtsMeshArrays * m;
+  guint n_faces;
+  GArray * xyz, * aedges = NULL;
+  GtsScratch * vindex, * eindex = NULL;
+  gpointer data[5];
+
+  g_return_val_if_fail (s != NULL, NULL);
+
+  n_faces = gts_surface_face_number (s);
+  m = g_malloc0 (sizeof (GtsMeshArrays));
+  m->faces = g_malloc ((gsize) 3*n_faces*sizeof (gint32));
+  /* a closed manifold has about half as many vertices as faces */
+  xyz = g_array_sized_new (FALSE, FALSE, sizeof (gdouble), 3*(n_faces/2 + 3));
+  vindex = gts_scratch_new (gts_surface_vertex_number (s));
+  if (edges) {
+    m->face_edges = g_malloc ((gsize) 3*n_faces*sizeof (gint32));
+    aedges = g_array_sized_new (FALSE, FALSE, sizeof (gint32),
+				2*(3*n_faces/2 + 3));
+    eindex = gts_scratch_new (gts_surface_edge_number (s));
+  }
+
+  data[0] = m;
+  data[1] = xyz;
+  data[2] = aedges;
+  data[3] = vindex;
+  data[4] = eindex;
+  gts_surface_foreach_face (s, (GtsFunc) mesh_add_face, data);
+  gts_scratch_destroy (vindex);
+  if (eindex)
+    gts_scratch_destroy (eindex);
+
+  m->xyz = (gdouble *) g_array_free (xyz, FALSE);
+  if (edges) {
+    m->edges = (gint32 *) g_array_free (aedges, FALSE);
+    gts_mesh_arrays_half_edges (m);
+  }
+
+  return m;
+}
+
+/**
+ * gts_mesh_arrays_half_edges:
+ * @m: a #GtsMeshArrays with edge information.
+ *
+ * (Re)builds the @opposite half-edge array of @m from its
+ * @face_edges array.
+ *
+ * Returns: the number of non-manifold edges of @m (used by more than
+ * two faces).
+ */
+guint gts_mesh_arrays_half_edges (GtsMeshArrays * m)
+{
+  gint32 * first;
+  guint i, nh, n_non_manifold = 0;
+
+  g_return_val_if_fail (m != NULL, 0);
+  g_return_val_if_fail (m->face_edges != NULL, 0);
+
+  nh = 3*m->n_faces;
+  g_free (m->opposite);
+  m->opposite = g_malloc (nh*sizeof (gint32));
+  first = g_malloc (m->n_edges*sizeof (gint32));
+  for (i = 0; i < m->n_edges; i++)
+    first[i] = -1;
+
+  for (i = 0; i < nh; i++) {
+    gint32 e = m->face_edges[i], h = first[e];
+
+    m->opposite[i] = -1;
+    if (h == -1)
+      first[e] = i;
+    else if (h >= 0 && m->opposite[h] == -1) {
+      m->opposite[h] = i;
+      m->opposite[i] = h;
+    }
+    else {
+      /* non-manifold edge: none of its half-edges has an opposite */
+      if (h >= 0) {
+	m->opposite[m->opposite[h]] = -1;
+	m->opposite[h] = -1;
+	first[e] = -2;
+	n_non_manifold++;
+      }
+    }
+  }
+  g_free (first);
+
+  return n_non_manifold;
+}
+
+/**
+ * gts_mesh_arrays_build_edges:
+ * @m: a #GtsMeshArrays.
+ *
+ * Builds the edge and half-edge arrays of @m from its faces. The
+ * edges are created in the order in which they are found going
+ * through the faces and are oriented like the first face using them.
+ */
+void gts_mesh_arrays_build_edges (GtsMeshArrays * m)
+{
+  gint32 * next, * head;
+  GArray * edges;
+  guint i, j;
+
+  g_return_if_fail (m != NULL);
+
+  g_free (m->edges);
+  g_free (m->face_edges);
+  m->face_edges = g_malloc ((gsize) 3*m->n_faces*sizeof (gint32));
+  edges = g_array_sized_new (FALSE, FALSE, sizeof (gint32),
+			     2*(3*m->n_faces/2 + 3));
+  m->n_edges = 0;
+
+  /* edges are kept in a linked list per smallest vertex index */
+  head = g_malloc (m->n_vertices*sizeof (gint32));
+  for (i = 0; i < m->n_vertices; i++)
+    head[i] = -1;
+  next = g_malloc ((gsize) 3*m->n_faces*sizeof (gint32));
+
+  for (i = 0; i < m->n_faces; i++)
+    for (j = 0; j < 3; j++) {
+      gint32 a = m->faces[3*i + j], b = m->faces[3*i + (j + 1) % 3];
+      gint32 lo = MIN (a, b), hi = MAX (a, b), e = head[lo];
+
+      while (e >= 0) {
+	gint32 * ev = &g_array_index (edges, gint32, 2*e);
+	if (MAX (ev[0], ev[1]) == hi)
+	  break;
+	e = next[e];
+      }
+      if (e < 0) {
+	gint32 ev[2];
+
+	ev[0] = a; ev[1] = b;
+	g_array_append_vals (edges, ev, 2);
+	e = m->n_edges++;
+	next[e] = head[lo];
+	head[lo] = e;
+      }
+      m->face_edges[3*i + j] = e;
+    }
+
+  g_free (head);
+  g_free (next);
+  m->edges = (gint32 *) g_array_free (edges, FALSE);
+  gts_mesh_arrays_half_edges (m);
+}
+
+/**
+ * gts_mesh_arrays_to_surface:
+ * @m: a #GtsMeshArrays.
+ * @s: a #GtsSurface.
+ *
+ * Adds to @s the faces described by @m, using the vertex, edge and
+ * face classes of @s. The edges of @s are created exactly as
+ * described by the edge arrays of @m, which are first built with
+ * gts_mesh_arrays_build_edges() if @m does not have any. The vertices
+ * of each face are in the same order as in @m.
+ *
+ * Returns: an array of the @m->n_vertices new #GtsVertex, to be freed
+ * with g_free().
+ */
+GtsVertex ** gts_mesh_arrays_to_surface (GtsMeshArrays * m, GtsSurface * s)
+{
+  GtsVertex ** v;
+  GtsEdge ** e;
+  guint i;
+
+  g_return_val_if_fail (m != NULL, NULL);
+  g_return_val_if_fail (s != NULL, NULL);
+
+  if (!m->edges)
+    gts_mesh_arrays_build_edges (m);
+
+  v = g_malloc (m->n_vertices*sizeof (GtsVertex *));
+  for (i = 0; i < m->n_vertices; i++)
+    v[i] = gts_vertex_new (s->vertex_class,
+			   m->xyz[3*i], m->xyz[3*i + 1], m->xyz[3*i + 2]);
+
+  e = g_malloc (m->n_edges*sizeof (GtsEdge *));
+  for (i = 0; i < m->n_edges; i++)
+    e[i] = gts_edge_new (s->edge_class,
+			 v[m->edges[2*i]], v[m->edges[2*i + 1]]);
+
+  for (i = 0; i < m->n_faces; i++) {
+    GtsEdge * fe[3];
+    guint j;
+
+    for (j = 0; j < 3; j++)
+      fe[j] = e[m->face_edges[3*i + j]];
+    /* e1 = (v1,v2), e2 = (v2,v3), e3 = (v3,v1) always gives the
+       orientation (v1,v2,v3) whatever the orientation of the edges */
+    gts_surface_add_face (s, gts_face_new (s->face_class,
+					   fe[0], fe[1], fe[2]));
+  }
+  g_free (e);
+
+  return v;
+}
+
+/**
+ * gts_mesh_arrays_area:
+ * @m: a #GtsMeshArrays.
+ *
+ * Returns: the area of @m.
+ */
+gdouble gts_mesh_arrays_area (GtsMeshArrays * m)
+{
+  gdouble area = 0.;
+  guint i;
+
+  g_return_val_if_fail (m != NULL, 0.);
+
+  for (i = 0; i < m->n_faces; i++) {
+    gdouble * p1 = &m->xyz[3*m->faces[3*i]];
+    gdouble * p2 = &m->xyz[3*m->faces[3*i + 1]];
+    gdouble * p3 = &m->xyz[3*m->faces[3*i + 2]];
+    gdouble x1 = p2[0] - p1[0], y1 = p2[1] - p1[1], z1 = p2[2] - p1[2];
+    gdouble x2 = p3[0] - p1[0], y2 = p3[1] - p1[1], z2 = p3[2] - p1[2];
+    gdouble nx = y1*z2 - z1*y2, ny = z1*x2 - x1*z2, nz = x1*y2 - y1*x2;
+
+    area += sqrt (nx*nx + ny*ny + nz*nz);
+  }
+  return area/2.;
+}
+
+/**
+ * gts_mesh_arrays_volume:
+ * @m: a #GtsMeshArrays.
+ *
+ * Returns: the signed volume of the domain bounded by @m. It makes
+ * sense only if @m is a closed and orientable manifold.
+ */
+gdouble gts_mesh_arrays_volume (GtsMeshArrays * m)
+{
+  gdouble volume = 0.;
+  guint i;
+
+  g_return_val_if_fail (m != NULL, 0.);
+
+  for (i = 0; i < m->n_faces; i++) {
+    gdouble * pa = &m->xyz[3*m->faces[3*i]];
+    gdouble * pb = &m->xyz[3*m->faces[3*i + 1]];
+    gdouble * pc = &m->xyz[3*m->faces[3*i + 2]];
+
+    volume += (pa[0]*(pb[1]*pc[2] - pb[2]*pc[1]) +
+	       pb[0]*(pc[1]*pa[2] - pc[2]*pa[1]) +
+	       pc[0]*(pa[1]*pb[2] - pa[2]*pb[1]));
+  }
+  return volume/6.;
+}
+
+/**
+ * gts_mesh_arrays_bbox:
+ * @m: a #GtsMeshArrays.
+ * @min: a #GtsVector.
+ * @max: a #GtsVector.
+ *
+ * Fills @min and @max with the lower and upper corners of the
+ * bounding box of the vertices of @m.
+ */
+void gts_mesh_arrays_bbox (GtsMeshArrays * m, GtsVector min, GtsVector max)
+{
+  guint i, c;
+
+  g_return_if_fail (m != NULL);
+
+  min[0] = min[1] = min[2] = G_MAXDOUBLE;
+  max[0] = max[1] = max[2] = - G_MAXDOUBLE;
+  for (i = 0; i < m->n_vertices; i++)
+    for (c = 0; c < 3; c++) {
+      gdouble x = m->xyz[3*i + c];
+      if (x < min[c]) min[c] = x;
+      if (x > max[c]) max[c] = x;
+    }
+}
+
+/**
+ * gts_mesh_arrays_stats:
+ * @m: a #GtsMeshArrays with edge information.
+ * @n_boundary_edges: a pointer to a guint or %NULL.
+ * @n_non_manifold_edges: a pointer to a guint or %NULL.
+ * @face_area: a #GtsRange or %NULL.
+ * @edge_length: a #GtsRange or %NULL.
+ *
+ * Fills the non-%NULL arguments with the number of boundary and
+ * non-manifold edges, the statistics of the face areas and of the
+ * edge lengths of @m.
+ */
+void gts_mesh_arrays_stats (GtsMeshArrays * m,
+			    guint * n_boundary_edges,
+			    guint * n_non_manifold_edges,
+			    GtsRange * face_area,
+			    GtsRange * edge_length)
+{
+  guint i, * degree;
+
+  g_return_if_fail (m != NULL);
+  g_return_if_fail (m->edges != NULL);
+
+  degree = g_malloc0 (m->n_edges*sizeof (guint));
+  for (i = 0; i < 3*m->n_faces; i++)
+    degree[m->face_edges[i]]++;
+  if (n_boundary_edges)
+    *n_boundary_edges = 0;
+  if (n_non_manifold_edges)
+    *n_non_manifold_edges = 0;
+  for (i = 0; i < m->n_edges; i++) {
+    if (degree[i] == 1 && n_boundary_edges)
+      (*n_boundary_edges)++;
+    else if (degree[i] > 2 && n_non_manifold_edges)
+      (*n_non_manifold_edges)++;
+  }
+  g_free (degree);
+
+  if (face_area) {
+    gts_range_init (face_area);
+    for (i = 0; i < m->n_faces; i++) {
+      gdouble * p1 = &m->xyz[3*m->faces[3*i]];
+      gdouble * p2 = &m->xyz[3*m->faces[3*i + 1]];
+      gdouble * p3 = &m->xyz[3*m->faces[3*i + 2]];
+      gdouble x1 = p2[0] - p1[0], y1 = p2[1] - p1[1], z1 = p2[2] - p1[2];
+      gdouble x2 = p3[0] - p1[0], y2 = p3[1] - p1[1], z2 = p3[2] - p1[2];
+      gdouble nx = y1*z2 - z1*y2, ny = z1*x2 - x1*z2, nz = x1*y2 - y1*x2;
+
+      gts_range_add_value (face_area, sqrt (nx*nx + ny*ny + nz*nz)/2.);
+    }
+    gts_range_update (face_area);
+  }
+
+  if (edge_length) {
+    gts_range_init (edge_length);
+    for (i = 0; i < m->n_edges; i++) {
+      gdouble * p1 = &m->xyz[3*m->edges[2*i]];
+      gdouble * p2 = &m->xyz[3*m->edges[2*i + 1]];
+      gdouble dx = p2[0] - p1[0], dy = p2[1] - p1[1], dz = p2[2] - p1[2];
+
+      gts_range_add_value (edge_length, sqrt (dx*dx + dy*dy + dz*dz));
+    }
+    gts_range_update (edge_length);
+  }
+}
@@ -24,6 +24,12 @@
 #include "gts-private.h"
 #include "config.h"
 
+#if defined (HAVE_MMAP) && defined (HAVE_SYS_MMAN_H)
+#  include <sys/types.h>
+#  include <sys/stat.h>
+#  include <sys/mman.h>
+#endif /* HAVE_MMAP && HAVE_SYS_MMAN_H */
+
 const guint gts_major_version = GTS_MAJOR_VERSION;
 const guint gts_minor_version = GTS_MINOR_VERSION;
 const guint gts_micro_version = GTS_MICRO_VERSION;
@@ -58,6 +64,7 @@ static GtsFile * file_new (void)
   f->tokens = g_strdup (GTS_TOKENS);
 
   f->ftype = GTS_FILE_GTS;
+  f->map = NULL;
 
   return f;
 }
@@ -140,6 +147,102 @@ GtsFile * gts_file_new_from_string_obj (const gchar * s)
   return f;
 }
 
+static void file_map_read (GtsFileMap * map)
+{
+  gsize size = 0, alloc = 65536, n;
+
+  map->base = g_malloc (alloc);
+  while ((n = fread (map->base + size, 1, alloc - size, map->fp)) > 0)
+    if ((size += n) == alloc)
+      map->base = g_realloc (map->base, alloc *= 2);
+  map->length = size;
+  map->start = map->base;
+}
+
+/**
+ * gts_file_new_mapped:
+ * @fp: a file pointer.
+ *
+ * Creates a #GtsFile reading the content of @fp, from its current
+ * position to its end, directly from memory. If @fp is a regular file
+ * and the system supports it, the file is memory-mapped, otherwise
+ * its content is read in memory at once.
+ *
+ * The resulting #GtsFile can be used as one created with
+ * gts_file_new(). In addition, gts_surface_read() uses a much faster
+ * parser for the surfaces written in the standard format. When the
+ * #GtsFile is destroyed, the position of @fp is set after the data
+ * actually read, if possible.
+ *
+ * Returns: a new #GtsFile.
+ */
+GtsFile * gts_file_new_mapped (FILE * fp)
+{
+  GtsFile * f;
+  GtsFileMap * map;
+
+  g_return_val_if_fail (fp != NULL, NULL);
+
+  map = g_malloc0 (sizeof (GtsFileMap));
+  map->fp = fp;
+  map->threads = 1;
+  map->offset = ftell (fp);
+#if defined (HAVE_MMAP) && defined (HAVE_SYS_MMAN_H)
+  {
+    struct stat sb;
+
+    if (map->offset >= 0 &&
+	fstat (fileno (fp), &sb) == 0 && S_ISREG (sb.st_mode) &&
+	sb.st_size > map->offset) {
+      map->base = mmap (NULL, sb.st_size, PROT_READ, MAP_PRIVATE, 
+			fileno (fp), 0);
+      if (map->base != MAP_FAILED) {
+	map->length = sb.st_size;
+	map->mmapped = TRUE;
+	map->start = map->base + map->offset;
+#ifdef MADV_SEQUENTIAL
+	madvise (map->base, map->length, MADV_SEQUENTIAL);
+#endif
+      }
+      else
+	map->base = NULL;
+    }
+  }
+#endif /* HAVE_MMAP && HAVE_SYS_MMAN_H */
+  if (map->base == NULL)
+    file_map_read (map);
+  map->end = map->base + map->length;
+
+  f = file_new ();
+  f->map = map;
+  f->s = map->start;
+  gts_file_next_token (f);
+
+  return f;
+}
+
+/**
+ * gts_file_set_threads:
+ * @f: a #GtsFile created with gts_file_new_mapped().
+ * @threads: the number of threads or 0.
+ *
+ * Sets the number of threads used to parse the content of @f, when
+ * possible, by readers such as gts_surface_read(). If @threads is 0,
+ * one thread per processor is used. By default the content of @f is
+ * parsed in the calling thread only.
+ *
+ * The records of the file are split into chunks parsed concurrently
+ * before building the objects. Any error is reported with the same
+ * line and position as when @f is parsed sequentially.
+ */
+void gts_file_set_threads (GtsFile * f, guint threads)
+{
+  g_return_if_fail (f != NULL);
+  g_return_if_fail (f->map != NULL);
+
+  f->map->threads = threads;
+}
+
 /**
  * gts_file_destroy:
  * @f: a #GtsFile.
@@ -157,6 +260,17 @@ void gts_file_destroy (GtsFile * f)
     g_free (f->error);
   if (f->s1)
     g_free (f->s1);
+  if (f->map) {
+    if (f->map->offset >= 0)
+      fseek (f->map->fp, f->map->offset + (f->s - f->map->start), SEEK_SET);
+#if defined (HAVE_MMAP) && defined (HAVE_SYS_MMAN_H)
+    if (f->map->mmapped)
+      munmap (f->map->base, f->map->length);
+    else
+#endif /* HAVE_MMAP && HAVE_SYS_MMAN_H */
+      g_free (f->map->base);
+    g_free (f->map);
+  }
   g_string_free (f->token, TRUE);
   g_free (f);
 }
@@ -213,9 +327,9 @@ static gint next_char (GtsFile * f)
 {
   if (f->fp)
     return fgetc (f->fp);
-  else if (*f->s == '\0')
+  else if ((f->map && f->s == f->map->end) || *f->s == '\0')
     return EOF;
-  return *(f->s++);
+  return (guchar) *(f->s++);
 }
 
 /**
@@ -298,12 +412,18 @@ guint gts_file_read (GtsFile * f, gpointer ptr, guint size, guint nmemb)
 
   g_return_val_if_fail (f != NULL, 0);
   g_return_val_if_fail (ptr != NULL, 0);
-  g_return_val_if_fail (f->fp != NULL, 0);
+  g_return_val_if_fail (f->fp != NULL || f->map != NULL, 0);
 
   if (f->type == GTS_ERROR)
     return 0;
 
-  n = fread (ptr, size, nmemb, f->fp);
+  if (f->fp)
+    n = fread (ptr, size, nmemb, f->fp);
+  else {
+    n = MIN (nmemb, (f->map->end - f->s)/size);
+    memcpy (ptr, f->s, n*size);
+    f->s += n*size;
+  }
   for (i = 0, p = ptr; i < n*size; i++, p++) {
     f->curpos++;
     if (*p == '\n') {
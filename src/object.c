@@ -23,6 +23,226 @@
 
 static GHashTable * class_table = NULL;
 
+/* Object pools */
+
+#define POOL_SLAB_SIZE 65536 /* approximate size of a slab in bytes */
+#define POOL_MIN_CHUNKS 64   /* minimum number of objects per slab */
+
+typedef struct _PoolSlab PoolSlab;
+
+struct _GtsObjectPool {
+  guint object_size, chunk_size, chunks_per_slab;
+  PoolSlab * slabs;
+  gpointer free_list;
+  guint n_slabs, n_used, n_free;
+  GtsObjectArena * arena;
+};
+
+struct _PoolSlab {
+  GtsObjectPool * pool;
+  PoolSlab * next;
+  guint used;
+};
+
+struct _GtsObjectArena {
+  GHashTable * pools;
+  guint n_used;
+  gboolean orphan;
+};
+
+/* Each chunk is preceded by a header pointing to its slab. The header
+   is padded to keep the objects suitably aligned. */
+typedef union {
+  PoolSlab * slab;
+  gdouble align;
+} PoolHeader;
+
+#define POOL_ALIGN(n)  (((n) + sizeof (PoolHeader) - 1) & \
+                        ~(sizeof (PoolHeader) - 1))
+#define POOL_SLAB_DATA(slab) ((gchar *) (slab) + POOL_ALIGN (sizeof (PoolSlab)))
+#define POOL_CHUNK_HEADER(object) ((PoolHeader *) (object) - 1)
+/* free chunks have a NULL klass and are linked through their reserved
+   field */
+#define POOL_NEXT(object) (((GtsObject *) (object))->reserved)
+
+static GHashTable * pool_table = NULL;
+/* the current arena of each thread */
+static GPrivate current_arena = G_PRIVATE_INIT (NULL);
+
+static GtsObjectPool * pool_lookup (GHashTable ** table, 
+				    guint object_size,
+				    GtsObjectArena * arena)
+{
+  GtsObjectPool * pool;
+
+  if (!*table)
+    *table = g_hash_table_new (NULL, NULL);
+  pool = g_hash_table_lookup (*table, GUINT_TO_POINTER (object_size));
+  if (pool == NULL) {
+    pool = g_malloc0 (sizeof (GtsObjectPool));
+    pool->object_size = object_size;
+    pool->chunk_size = sizeof (PoolHeader) + POOL_ALIGN (object_size);
+    pool->chunks_per_slab = MAX (POOL_MIN_CHUNKS, 
+				 POOL_SLAB_SIZE/pool->chunk_size);
+    pool->arena = arena;
+    g_hash_table_insert (*table, GUINT_TO_POINTER (object_size), pool);
+  }
+  return pool;
+}
+
+static GtsObjectPool * pool_for_size (guint object_size)
+{
+  return pool_lookup (&pool_table, object_size, NULL);
+}
+
+static void pool_add_slab (GtsObjectPool * pool)
+{
+  PoolSlab * slab;
+  gchar * chunk;
+  guint i;
+
+  slab = g_malloc (POOL_ALIGN (sizeof (PoolSlab)) + 
+		   pool->chunks_per_slab*pool->chunk_size);
+  slab->pool = pool;
+  slab->used = 0;
+  slab->next = pool->slabs;
+  pool->slabs = slab;
+  pool->n_slabs++;
+
+  /* thread the new chunks onto the free list, in address order */
+  chunk = POOL_SLAB_DATA (slab) + (pool->chunks_per_slab - 1)*pool->chunk_size;
+  for (i = 0; i < pool->chunks_per_slab; i++, chunk -= pool->chunk_size) {
+    gpointer object = chunk + sizeof (PoolHeader);
+
+    ((PoolHeader *) chunk)->slab = slab;
+    ((GtsObject *) object)->klass = NULL;
+    POOL_NEXT (object) = pool->free_list;
+    pool->free_list = object;
+  }
+  pool->n_free += pool->chunks_per_slab;
+}
+
+static gpointer pool_alloc (GtsObjectPool * pool)
+{
+  gpointer object;
+
+  if (pool->free_list == NULL)
+    pool_add_slab (pool);
+  object = pool->free_list;
+  pool->free_list = POOL_NEXT (object);
+  POOL_CHUNK_HEADER (object)->slab->used++;
+  pool->n_used++;
+  pool->n_free--;
+  if (pool->arena)
+    pool->arena->n_used++;
+  memset (object, 0, pool->object_size);
+
+  return object;
+}
+
+static void arena_free (GtsObjectArena * arena);
+
+static void pool_free (gpointer object)
+{
+  PoolSlab * slab = POOL_CHUNK_HEADER (object)->slab;
+  GtsObjectPool * pool = slab->pool;
+
+  g_assert (slab->used > 0);
+  slab->used--;
+  pool->n_used--;
+  pool->n_free++;
+  ((GtsObject *) object)->klass = NULL;
+  POOL_NEXT (object) = pool->free_list;
+  pool->free_list = object;
+  if (pool->arena && --pool->arena->n_used == 0 && pool->arena->orphan)
+    arena_free (pool->arena);
+}
+
+static guint pool_trim (GtsObjectPool * pool)
+{
+  PoolSlab * slab, * prev = NULL;
+  gpointer * i;
+  guint n = 0;
+
+  /* unlink the chunks of empty slabs from the free list */
+  i = &pool->free_list;
+  while (*i) {
+    if (POOL_CHUNK_HEADER (*i)->slab->used == 0)
+      *i = POOL_NEXT (*i);
+    else
+      i = &POOL_NEXT (*i);
+  }
+
+  slab = pool->slabs;
+  while (slab) {
+    PoolSlab * next = slab->next;
+    if (slab->used == 0) {
+      if (prev)
+	prev->next = next;
+      else
+	pool->slabs = next;
+      g_free (slab);
+      n++;
+    }
+    else
+      prev = slab;
+    slab = next;
+  }
+  pool->n_slabs -= n;
+  pool->n_free -= n*pool->chunks_per_slab;
+
+  return n;
+}
+
+static void pool_release (GtsObjectPool * pool)
+{
+  PoolSlab * slab = pool->slabs;
+
+  while (slab) {
+    PoolSlab * next = slab->next;
+    g_free (slab);
+    slab = next;
+  }
+  pool->slabs = NULL;
+  pool->free_list = NULL;
+  pool->n_slabs = pool->n_used = pool->n_free = 0;
+}
+
+/* Removes the objects still allocated in @pool from the statistics of
+   their classes. */
+static void pool_forget (gpointer size, GtsObjectPool * pool)
+{
+#ifndef GTS_NO_OBJECT_STATS
+  PoolSlab * slab = pool->slabs;
+
+  while (slab) {
+    gchar * chunk = POOL_SLAB_DATA (slab);
+    guint i;
+
+    for (i = 0; i < pool->chunks_per_slab; i++, chunk += pool->chunk_size) {
+      GtsObject * object = (GtsObject *) (chunk + sizeof (PoolHeader));
+
+      if (object->klass)
+	object_stats_remove (object->klass);
+    }
+    slab = slab->next;
+  }
+#endif /* not GTS_NO_OBJECT_STATS */
+}
+
+static void free_pool (gpointer size, GtsObjectPool * pool)
+{
+  pool_release (pool);
+  g_free (pool);
+}
+
+static void arena_free (GtsObjectArena * arena)
+{
+  g_hash_table_foreach (arena->pools, (GHFunc) free_pool, NULL);
+  g_hash_table_destroy (arena->pools);
+  g_free (arena);
+}
+
 static void gts_object_class_init (GtsObjectClass * klass,
 				   GtsObjectClass * parent_class)
 {
@@ -57,7 +277,15 @@ gpointer gts_object_class_new (GtsObjectClass * parent_class,
   klass = g_malloc0 (info->class_size);
   klass->info = *info;
   klass->parent_class = parent_class;
+  klass->depth = parent_class ? parent_class->depth + 1 : 0;
+  klass->ancestors = g_malloc ((klass->depth + 1)*sizeof (GtsObjectClass *));
+  if (parent_class)
+    memcpy (klass->ancestors, parent_class->ancestors,
+	    klass->depth*sizeof (GtsObjectClass *));
+  klass->ancestors[klass->depth] = klass;
   gts_object_class_init (klass, klass);
+  klass->pool = parent_class && parent_class->pool ? 
+    pool_for_size (info->object_size) : NULL;
 
   if (!class_table)
     class_table = g_hash_table_new (g_str_hash, g_str_equal);
@@ -93,9 +321,13 @@ static void object_destroy (GtsObject * object)
 #endif
   id_remove (object);
 #endif
+  object_stats_remove (object->klass);
   object->klass = NULL;
   object->reserved = NULL;
-  g_free (object);
+  if (object->flags & GTS_POOLED)
+    pool_free (object);
+  else
+    g_free (object);
 }
 
 static void object_clone (GtsObject * clone, GtsObject * object)
@@ -117,7 +349,7 @@ static void object_class_init (GtsObjectClass * klass)
 static void object_init (GtsObject * object)
 {
   object->reserved = NULL;
-  object->flags = 0;
+  object->flags &= GTS_POOLED;
 }
 
 /**
@@ -199,6 +431,24 @@ gpointer gts_object_class_check_cast (gpointer klass,
   return klass;
 }
 
+static GtsObject * object_alloc (GtsObjectClass * klass)
+{
+  GtsObjectArena * arena = g_private_get (&current_arena);
+  GtsObject * object;
+
+  if (arena)
+    object = pool_alloc (pool_lookup (&arena->pools, 
+				      klass->info.object_size,
+				      arena));
+  else if (klass->pool)
+    object = pool_alloc (klass->pool);
+  else
+    return g_malloc0 (klass->info.object_size);
+  object->flags = GTS_POOLED;
+
+  return object;
+}
+
 /**
  * gts_object_init:
  * @object: a #GtsObject.
@@ -235,8 +485,9 @@ GtsObject * gts_object_new (GtsObjectClass * klass)
 
   g_return_val_if_fail (klass != NULL, NULL);
 
-  object = g_malloc0 (klass->info.object_size);
+  object = object_alloc (klass);
   object->klass = klass;
+  object_stats_add (klass);
   gts_object_init (object, klass);
 
 #ifdef DEBUG_IDENTITY
@@ -263,14 +514,19 @@ GtsObject * gts_object_new (GtsObjectClass * klass)
 GtsObject * gts_object_clone (GtsObject * object)
 {
   GtsObject * clone;
+  guint32 pooled;
 
   g_return_val_if_fail (object != NULL, NULL);
   g_return_val_if_fail (object->klass->clone, NULL);
 
-  clone = g_malloc0 (object->klass->info.object_size);
+  clone = object_alloc (object->klass);
+  pooled = clone->flags & GTS_POOLED;
   clone->klass = object->klass;
+  object_stats_add (clone->klass);
   object_init (clone);
   (* object->klass->clone) (clone, object);
+  /* the clone method copies the flags of @object */
+  clone->flags = (clone->flags & ~GTS_POOLED) | pooled;
 
 #ifdef DEBUG_IDENTITY
   id_insert (clone);
@@ -325,8 +581,427 @@ void gts_object_attributes (GtsObject * object, GtsObject * from)
     (* object->klass->attributes) (object, from);
 }
 
+static void set_pool (gchar * name, GtsObjectClass * klass, gpointer * data)
+{
+  if (gts_object_class_is_from_class (klass, data[0]))
+    klass->pool = *((gboolean *) data[1]) ? 
+      pool_for_size (klass->info.object_size) : NULL;
+}
+
+/**
+ * gts_object_class_set_pool:
+ * @klass: a #GtsObjectClass.
+ * @pool: whether to use pooled allocation.
+ *
+ * If @pool is %TRUE, the objects of class @klass and of all the
+ * classes derived from @klass (including those created afterwards)
+ * are allocated from object pools rather than individually with
+ * g_malloc(). An object pool is shared by all the classes with the
+ * same object size and grows by slabs holding many objects. Destroyed
+ * objects are recycled through the free list of their pool.
+ *
+ * If @pool is %FALSE, new objects of these classes are allocated
+ * individually again. Objects already allocated from a pool are
+ * returned to it when destroyed.
+ *
+ * Object pools are not thread-safe.
+ */
+void gts_object_class_set_pool (GtsObjectClass * klass, gboolean pool)
+{
+  gpointer data[2];
+
+  g_return_if_fail (klass != NULL);
+
+  data[0] = klass;
+  data[1] = &pool;
+  g_hash_table_foreach (class_table, (GHFunc) set_pool, data);
+}
+
+/**
+ * gts_object_class_pool_stats:
+ * @klass: a #GtsObjectClass.
+ * @stats: a #GtsObjectPoolStats.
+ *
+ * Fills @stats with the statistics of the object pool used by @klass
+ * (number of slabs, of objects in use, of free objects and the total
+ * number of bytes allocated for the slabs). If @klass does not use an
+ * object pool all the statistics are set to zero.
+ */
+void gts_object_class_pool_stats (GtsObjectClass * klass,
+				  GtsObjectPoolStats * stats)
+{
+  GtsObjectPool * pool;
+
+  g_return_if_fail (klass != NULL);
+  g_return_if_fail (stats != NULL);
+
+  stats->object_size = klass->info.object_size;
+  pool = klass->pool;
+  if (pool) {
+    stats->n_slabs = pool->n_slabs;
+    stats->n_used = pool->n_used;
+    stats->n_free = pool->n_free;
+    stats->bytes = ((gulong) pool->n_slabs)*
+      (POOL_ALIGN (sizeof (PoolSlab)) + pool->chunks_per_slab*pool->chunk_size);
+  }
+  else {
+    stats->n_slabs = stats->n_used = stats->n_free = 0;
+    stats->bytes = 0;
+  }
+}
+
+/**
+ * gts_object_class_pool_trim:
+ * @klass: a #GtsObjectClass.
+ *
+ * Frees the slabs of the object pool of @klass which do not contain
+ * any object in use. Nothing is done if @klass does not use an object
+ * pool.
+ *
+ * Returns: the number of slabs freed.
+ */
+guint gts_object_class_pool_trim (GtsObjectClass * klass)
+{
+  GtsObjectPool * pool;
+
+  g_return_val_if_fail (klass != NULL, 0);
+
+  pool = klass->pool;
+  return pool ? pool_trim (pool) : 0;
+}
+
+/**
+ * gts_object_class_pool_release:
+ * @klass: a #GtsObjectClass.
+ *
+ * Frees at once all the memory allocated for the object pool of
+ * @klass, without calling the destroy method of the objects it
+ * contains. All the objects allocated from this pool, including
+ * objects of other classes of the same size, become invalid and must
+ * not be used or destroyed afterwards. Nothing is done if @klass does
+ * not use an object pool.
+ *
+ * This is useful to dispose of large numbers of objects, when their
+ * individual destruction is not required.
+ */
+void gts_object_class_pool_release (GtsObjectClass * klass)
+{
+  GtsObjectPool * pool;
+
+  g_return_if_fail (klass != NULL);
+
+  pool = klass->pool;
+  if (pool) {
+    pool_forget (NULL, pool);
+    pool_release (pool);
+  }
+}
+
+/**
+ * gts_object_arena_new:
+ *
+ * Returns: a new empty #GtsObjectArena.
+ */
+GtsObjectArena * gts_object_arena_new (void)
+{
+  GtsObjectArena * arena = g_malloc0 (sizeof (GtsObjectArena));
+
+  arena->pools = g_hash_table_new (NULL, NULL);
+  return arena;
+}
+
+/**
+ * gts_object_arena_set_current:
+ * @arena: a #GtsObjectArena or %NULL.
+ *
+ * Makes @arena the current arena. As long as it is current, all the
+ * objects created by gts_object_new() or gts_object_clone() are
+ * allocated in @arena, whatever their class. Objects allocated in an
+ * arena can be destroyed individually as usual, their memory is then
+ * reused for new objects of the arena.
+ *
+ * If @arena is %NULL, objects are allocated normally again.
+ *
+ * The current arena is specific to the calling thread: the objects
+ * created by other threads (including the worker threads of GTS) are
+ * not allocated in @arena. An arena must not be current in several
+ * threads at the same time.
+ *
+ * Returns: the previous current arena of the calling thread.
+ */
+GtsObjectArena * gts_object_arena_set_current (GtsObjectArena * arena)
+{
+  GtsObjectArena * previous = g_private_get (&current_arena);
+
+  g_return_val_if_fail (arena == NULL || !arena->orphan, previous);
+
+  g_private_set (&current_arena, arena);
+  return previous;
+}
+
+static void pool_foreach (gpointer size, GtsObjectPool * pool, gpointer * data)
+{
+  PoolSlab * slab = pool->slabs;
+
+  while (slab) {
+    gchar * chunk = POOL_SLAB_DATA (slab);
+    guint i;
+
+    for (i = 0; i < pool->chunks_per_slab; i++, chunk += pool->chunk_size) {
+      GtsObject * object = (GtsObject *) (chunk + sizeof (PoolHeader));
+
+      if (object->klass)
+	(* ((GtsFunc) data[0])) (object, data[1]);
+    }
+    slab = slab->next;
+  }
+}
+
+/**
+ * gts_object_arena_foreach:
+ * @arena: a #GtsObjectArena.
+ * @func: a #GtsFunc.
+ * @data: user data to be passed to @func.
+ *
+ * Calls @func for each object allocated in @arena and not yet
+ * destroyed, in no particular order. Objects must not be created or
+ * destroyed in @arena by @func.
+ */
+void gts_object_arena_foreach (GtsObjectArena * arena,
+			       GtsFunc func,
+			       gpointer data)
+{
+  gpointer info[2];
+
+  g_return_if_fail (arena != NULL);
+  g_return_if_fail (func != NULL);
+
+  info[0] = func;
+  info[1] = data;
+  g_hash_table_foreach (arena->pools, (GHFunc) pool_foreach, info);
+}
+
+/**
+ * gts_object_arena_contains:
+ * @arena: a #GtsObjectArena.
+ * @object: a #GtsObject.
+ *
+ * Returns: %TRUE if @object has been allocated in @arena, %FALSE
+ * otherwise.
+ */
+gboolean gts_object_arena_contains (GtsObjectArena * arena,
+				    GtsObject * object)
+{
+  g_return_val_if_fail (arena != NULL, FALSE);
+  g_return_val_if_fail (object != NULL, FALSE);
+
+  return (object->flags & GTS_POOLED) &&
+    POOL_CHUNK_HEADER (object)->slab->pool->arena == arena;
+}
+
+/**
+ * gts_object_arena_destroy:
+ * @arena: a #GtsObjectArena.
+ * @force: whether to free the objects still allocated in @arena.
+ *
+ * If @force is %TRUE, frees at once all the memory used by @arena,
+ * without calling the destroy method of the objects it contains.
+ * These objects become invalid and must not be used afterwards.
+ *
+ * If @force is %FALSE, @arena is freed as soon as all its objects
+ * have been destroyed (i.e. immediately if it is empty).
+ *
+ * In both cases, no new object can be allocated in @arena.
+ */
+void gts_object_arena_destroy (GtsObjectArena * arena, gboolean force)
+{
+  g_return_if_fail (arena != NULL);
+  g_return_if_fail (arena != g_private_get (&current_arena));
+  g_return_if_fail (!arena->orphan);
+
+  if (force || arena->n_used == 0) {
+    if (arena->n_used > 0)
+      g_hash_table_foreach (arena->pools, (GHFunc) pool_forget, NULL);
+    arena_free (arena);
+  }
+  else
+    arena->orphan = TRUE;
+}
+
+/**
+ * gts_object_class_stats:
+ * @klass: a #GtsObjectClass.
+ * @stats: a #GtsObjectClassStats.
+ *
+ * Fills @stats with the memory statistics of the objects of class
+ * @klass (not including the objects of derived classes). The objects
+ * created with gts_object_new() or gts_object_clone() are counted
+ * until they are destroyed or until their pool or arena is released.
+ *
+ * If GTS has been compiled with GTS_NO_OBJECT_STATS defined, no
+ * statistics are maintained and all the fields of @stats (but @klass)
+ * are set to zero.
+ */
+void gts_object_class_stats (GtsObjectClass * klass,
+			     GtsObjectClassStats * stats)
+{
+  g_return_if_fail (klass != NULL);
+  g_return_if_fail (stats != NULL);
+
+  stats->klass = klass;
+  stats->n_live = g_atomic_int_get (&klass->n_live);
+  stats->n_peak = g_atomic_int_get (&klass->n_peak);
+  stats->n_total = g_atomic_int_get (&klass->n_total);
+  stats->bytes = stats->n_live*klass->info.object_size;
+  stats->peak_bytes = stats->n_peak*klass->info.object_size;
+}
+
+static void add_class_stats (gchar * name, 
+			     GtsObjectClass * klass, 
+			     GArray * snapshot)
+{
+  if (g_atomic_int_get (&klass->n_total) > 0) {
+    GtsObjectClassStats stats;
+
+    gts_object_class_stats (klass, &stats);
+    g_array_append_val (snapshot, stats);
+  }
+}
+
+static gint compare_class_stats (const GtsObjectClassStats * s1,
+				 const GtsObjectClassStats * s2)
+{
+  if (s1->bytes != s2->bytes)
+    return s1->bytes > s2->bytes ? -1 : 1;
+  if (s1->peak_bytes != s2->peak_bytes)
+    return s1->peak_bytes > s2->peak_bytes ? -1 : 1;
+  return strcmp (s1->klass->info.name, s2->klass->info.name);
+}
+
+/**
+ * gts_object_stats_snapshot:
+ *
+ * Returns: a new #GArray of #GtsObjectClassStats, one for each class
+ * for which at least one object has been created, sorted by
+ * decreasing memory use. The array must be freed with
+ * g_array_free().
+ */
+GArray * gts_object_stats_snapshot (void)
+{
+  GArray * snapshot = g_array_new (FALSE, FALSE, 
+				   sizeof (GtsObjectClassStats));
+
+  if (class_table)
+    g_hash_table_foreach (class_table, (GHFunc) add_class_stats, snapshot);
+  g_array_sort (snapshot, (GCompareFunc) compare_class_stats);
+
+  return snapshot;
+}
+
+/**
+ * gts_object_stats_write:
+ * @snapshot: an array of #GtsObjectClassStats as returned by
+ * gts_object_stats_snapshot().
+ * @fp: a file pointer.
+ *
+ * Writes @snapshot in @fp as a table, followed by the total number of
+ * live objects and of bytes used.
+ */
+void gts_object_stats_write (GArray * snapshot, FILE * fp)
+{
+  gulong n_live = 0, n_total = 0, bytes = 0;
+  guint i;
+
+  g_return_if_fail (snapshot != NULL);
+  g_return_if_fail (fp != NULL);
+
+  fprintf (fp, "%-*s %6s %10s %10s %10s %12s %12s\n", 
+	   GTS_CLASS_NAME_LENGTH, "class", "size", "live", "peak", "total",
+	   "bytes", "peak bytes");
+  for (i = 0; i < snapshot->len; i++) {
+    GtsObjectClassStats * stats = 
+      &g_array_index (snapshot, GtsObjectClassStats, i);
+
+    fprintf (fp, "%-*s %6u %10lu %10lu %10lu %12lu %12lu\n", 
+	     GTS_CLASS_NAME_LENGTH, stats->klass->info.name,
+	     stats->klass->info.object_size,
+	     stats->n_live, stats->n_peak, stats->n_total,
+	     stats->bytes, stats->peak_bytes);
+    n_live += stats->n_live;
+    n_total += stats->n_total;
+    bytes += stats->bytes;
+  }
+  fprintf (fp, "%-*s %6s %10lu %10s %10lu %12lu\n", 
+	   GTS_CLASS_NAME_LENGTH, "total", "", n_live, "", n_total, bytes);
+}
+
+/**
+ * gts_object_stats_write_json:
+ * @snapshot: an array of #GtsObjectClassStats as returned by
+ * gts_object_stats_snapshot().
+ * @fp: a file pointer.
+ *
+ * Writes @snapshot in @fp as a JSON object.
+ */
+void gts_object_stats_write_json (GArray * snapshot, FILE * fp)
+{
+  gulong n_live = 0, bytes = 0;
+  guint i;
+
+  g_return_if_fail (snapshot != NULL);
+  g_return_if_fail (fp != NULL);
+
+  fputs ("{\n  \"classes\": [", fp);
+  for (i = 0; i < snapshot->len; i++) {
+    GtsObjectClassStats * stats = 
+      &g_array_index (snapshot, GtsObjectClassStats, i);
+
+    fprintf (fp, 
+	     "%s\n    {\"name\": \"%s\", \"size\": %u, "
+	     "\"live\": %lu, \"peak\": %lu, \"total\": %lu, "
+	     "\"bytes\": %lu, \"peak_bytes\": %lu}",
+	     i > 0 ? "," : "",
+	     stats->klass->info.name, stats->klass->info.object_size,
+	     stats->n_live, stats->n_peak, stats->n_total,
+	     stats->bytes, stats->peak_bytes);
+    n_live += stats->n_live;
+    bytes += stats->bytes;
+  }
+  fprintf (fp, "\n  ],\n  \"live\": %lu,\n  \"bytes\": %lu\n}\n",
+	   n_live, bytes);
+}
+
+static void reset_peak (gchar * name, GtsObjectClass * klass)
+{
+  g_atomic_int_set (&klass->n_peak, g_atomic_int_get (&klass->n_live));
+}
+
+/**
+ * gts_object_stats_reset_peak:
+ *
+ * Resets the peak number of objects of each class to its current
+ * number of live objects.
+ */
+void gts_object_stats_reset_peak (void)
+{
+  if (class_table)
+    g_hash_table_foreach (class_table, (GHFunc) reset_peak, NULL);
+}
+
+/* Removes @klass from the table of classes and frees it together
+   with its array of ancestors */
+void object_class_free (GtsObjectClass * klass)
+{
+  if (class_table &&
+      g_hash_table_lookup (class_table, klass->info.name) == klass)
+    g_hash_table_remove (class_table, klass->info.name);
+  g_free (klass->ancestors);
+  g_free (klass);
+}
+
 static void free_class (gchar * name, GtsObjectClass * klass)
 {
+  g_free (klass->ancestors);
   g_free (klass);
 }
 
@@ -343,4 +1018,9 @@ void gts_finalize (void)
     g_hash_table_destroy (class_table);
     class_table = NULL;
   }
+  if (pool_table) {
+    g_hash_table_foreach (pool_table, (GHFunc) free_pool, NULL);
+    g_hash_table_destroy (pool_table);
+    pool_table = NULL;
+  }
 }
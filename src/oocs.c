@@ -18,7 +18,9 @@
  */
 
 #include <math.h>
+#include <string.h>
 #include "gts.h"
+#include "gts-private.h"
 
 static void cluster_destroy (GtsObject * object)
 {
@@ -185,7 +187,9 @@ static gint cluster_id_equal (gconstpointer v1,
 static guint cluster_id_hash (gconstpointer key)
 {
   const GtsClusterId * id = (const GtsClusterId *) key;
-  return id->x + id->y + id->z;
+  /* the sum of the indices would give the same hash to all the
+     clusters of a diagonal plane of the grid */
+  return id->x*73856093U ^ id->y*19349663U ^ id->z*83492791U;
 }
 
 static void cluster_grid_init (GtsClusterGrid * cluster_grid)
@@ -385,3 +389,170 @@ GtsRange gts_cluster_grid_update (GtsClusterGrid * cluster_grid)
 
   return stats;
 }
+
+/* Triangle soups, see gts_surface_write_triangle_soup() */
+
+#define SOUP_BLOCK 65536 /* number of triangles read at once */
+
+typedef struct {
+  FILE * fp;
+  guchar * buf;
+  gsize size, n;
+} SoupBlock;
+
+static guint32 soup_get_uint32 (const guchar * p)
+{
+  return ((guint32) p[0] | ((guint32) p[1] << 8) |
+	  ((guint32) p[2] << 16) | ((guint32) p[3] << 24));
+}
+
+static gdouble soup_get_double (const guchar * p)
+{
+  union { guint64 i; gdouble d; } u;
+
+  u.i = soup_get_uint32 (p) | ((guint64) soup_get_uint32 (p + 4) << 32);
+  return u.d;
+}
+
+static gfloat soup_get_float (const guchar * p)
+{
+  union { guint32 i; gfloat f; } u;
+
+  u.i = soup_get_uint32 (p);
+  return u.f;
+}
+
+static gpointer soup_block_read (SoupBlock * b)
+{
+  b->n = fread (b->buf, 1, b->size, b->fp);
+  return NULL;
+}
+
+/* Sets the size of @b for the next triangles, at most @left of them */
+static void soup_block_size (SoupBlock * b, guint64 * left)
+{
+  guint64 n = MIN (*left, SOUP_BLOCK);
+
+  b->size = n*GTS_SOUP_TRIANGLE_SIZE;
+  *left -= n;
+}
+
+/**
+ * gts_triangle_soup_read_header:
+ * @fptr: a file pointer.
+ * @nt: return location for the number of triangles or %NULL.
+ * @bbox: a #GtsBBox or %NULL.
+ *
+ * Reads the header of the triangle soup written in @fptr by
+ * gts_surface_write_triangle_soup() or gts_triangle_soup_convert(),
+ * which must be read next using gts_cluster_grid_read_triangle_soup().
+ * The number of triangles (0 if it is unknown) is returned in @nt
+ * and the bounding box of the triangles is stored in @bbox.
+ *
+ * Returns: %TRUE if successful, %FALSE if @fptr does not start with a
+ * valid triangle soup header.
+ */
+gboolean gts_triangle_soup_read_header (FILE * fptr, 
+					guint64 * nt, 
+					GtsBBox * bbox)
+{
+  guchar header[GTS_SOUP_HEADER_SIZE];
+  const guchar * p = header + strlen (GTS_SOUP_SIGNATURE);
+
+  g_return_val_if_fail (fptr != NULL, FALSE);
+
+  if (fread (header, 1, GTS_SOUP_HEADER_SIZE, fptr) != GTS_SOUP_HEADER_SIZE ||
+      strncmp ((gchar *) header, GTS_SOUP_SIGNATURE, 
+	       strlen (GTS_SOUP_SIGNATURE)) ||
+      soup_get_uint32 (p) != GTS_SOUP_VERSION)
+    return FALSE;
+  if (nt)
+    *nt = (soup_get_uint32 (p + 4) | 
+	   ((guint64) soup_get_uint32 (p + 8) << 32));
+  if (bbox) {
+    bbox->x1 = soup_get_double (p + 12);
+    bbox->y1 = soup_get_double (p + 20);
+    bbox->z1 = soup_get_double (p + 28);
+    bbox->x2 = soup_get_double (p + 36);
+    bbox->y2 = soup_get_double (p + 44);
+    bbox->z2 = soup_get_double (p + 52);
+  }
+  return TRUE;
+}
+
+/**
+ * gts_cluster_grid_read_triangle_soup:
+ * @cluster_grid: a #GtsClusterGrid.
+ * @fptr: a file pointer.
+ * @nt: the number of triangles to read or 0.
+ * @data: user data to pass to the cluster add() method.
+ *
+ * Adds to @cluster_grid, as gts_cluster_grid_add_triangle() does,
+ * @nt triangles (or all the triangles up to the end of the file if
+ * @nt is 0) of the triangle soup @fptr, whose header must have been
+ * read with gts_triangle_soup_read_header().
+ *
+ * The triangles are read by large blocks. The next block is read by
+ * another thread while the triangles of the current block are added
+ * to @cluster_grid.
+ *
+ * Returns: the number of triangles read.
+ */
+guint64 gts_cluster_grid_read_triangle_soup (GtsClusterGrid * cluster_grid,
+					     FILE * fptr,
+					     guint64 nt,
+					     gpointer data)
+{
+  SoupBlock block[2], * current = &block[0], * next = &block[1];
+  GtsPoint * v[3];
+  guint64 left = nt > 0 ? nt : G_MAXUINT64, n = 0;
+  guint i;
+
+  g_return_val_if_fail (cluster_grid != NULL, 0);
+  g_return_val_if_fail (fptr != NULL, 0);
+
+  for (i = 0; i < 2; i++) {
+    block[i].fp = fptr;
+    block[i].buf = g_malloc (SOUP_BLOCK*GTS_SOUP_TRIANGLE_SIZE);
+  }
+  for (i = 0; i < 3; i++)
+    v[i] = gts_point_new (gts_point_class (), 0., 0., 0.);
+
+  soup_block_size (current, &left);
+  soup_block_read (current);
+  while (current->n >= GTS_SOUP_TRIANGLE_SIZE) {
+    GThread * thread = NULL;
+    const guchar * p = current->buf;
+    guint m = current->n/GTS_SOUP_TRIANGLE_SIZE;
+
+    if (current->n == current->size && left > 0) {
+      SoupBlock * b = current;
+
+      soup_block_size (next, &left);
+      thread = g_thread_new ("gts-soup", (GThreadFunc) soup_block_read, next);
+      current = next;
+      next = b;
+    }
+    for (i = 0; i < m; i++, p += GTS_SOUP_TRIANGLE_SIZE) {
+      guint j;
+
+      for (j = 0; j < 3; j++) {
+	v[j]->x = soup_get_float (p + 12*j);
+	v[j]->y = soup_get_float (p + 12*j + 4);
+	v[j]->z = soup_get_float (p + 12*j + 8);
+      }
+      gts_cluster_grid_add_triangle (cluster_grid, v[0], v[1], v[2], data);
+    }
+    n += m;
+    if (thread == NULL)
+      break;
+    g_thread_join (thread);
+  }
+
+  for (i = 0; i < 3; i++)
+    gts_object_destroy (GTS_OBJECT (v[i]));
+  for (i = 0; i < 2; i++)
+    g_free (block[i].buf);
+
+  return n;
+}
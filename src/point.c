@@ -628,14 +628,13 @@ void gts_point_triangle_closest (GtsPoint * p,
 
   det = B*B - E*C;
   if (det == 0.) { /* p1p2 and p1p3 are colinear */
-    GtsPoint * cp =
-      GTS_POINT (gts_object_new (GTS_OBJECT_CLASS (gts_point_class ())));
-    gts_point_segment_closest (p, GTS_SEGMENT (e1), cp);
+    GtsPoint cp;
+
+    gts_point_segment_closest (p, GTS_SEGMENT (e1), &cp);
     gts_point_segment_closest (p, GTS_SEGMENT (e3), closest);
 
-    if (gts_point_distance2 (cp, p) < gts_point_distance2 (closest, p))
-      gts_point_set (closest, cp->x, cp->y, cp->z);
-    gts_object_destroy (GTS_OBJECT (cp));
+    if (gts_point_distance2 (&cp, p) < gts_point_distance2 (closest, p))
+      gts_point_set (closest, cp.x, cp.y, cp.z);
     return;
   }
 
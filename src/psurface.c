@@ -54,6 +54,7 @@ static void psurface_init (GtsPSurface * psurface)
   psurface->split_class = gts_split_class ();
   psurface->pos = psurface->min = 0;
   psurface->vertices = psurface->faces = NULL;
+  psurface->binary = NULL;
 }
 
 /**
@@ -18,7 +18,9 @@
  */
 
 #include <math.h>
+#include <string.h>
 #include "gts.h"
+#include "gts-private.h"
 
 /**
  * gts_vertex_encroaches_edge:
@@ -199,14 +201,14 @@ static gint split_encroached (GtsSurface * surface,
     GtsEdge * e2 = GTS_EDGE (gts_object_clone (GTS_OBJECT (s)));
 
     GTS_SEGMENT (e1)->v1 = s->v1;
-    s->v1->segments = g_slist_prepend (s->v1->segments, e1);
+    gts_vertex_add_segment (s->v1, GTS_SEGMENT (e1));
     GTS_SEGMENT (e1)->v2 = v;
-    v->segments = g_slist_prepend (v->segments, e1);
+    gts_vertex_add_segment (v, GTS_SEGMENT (e1));
 
     GTS_SEGMENT (e2)->v1 = v;
-    v->segments = g_slist_prepend (v->segments, e2);
+    gts_vertex_add_segment (v, GTS_SEGMENT (e2));
     GTS_SEGMENT (e2)->v2 = s->v2;
-    s->v2->segments = g_slist_prepend (s->v2->segments, e2);
+    gts_vertex_add_segment (s->v2, GTS_SEGMENT (e2));
 #else
     GtsEdge * e1 = gts_edge_new (GTS_EDGE_CLASS (GTS_OBJECT (s)->klass),
 				 s->v1, v);
@@ -214,7 +216,7 @@ static gint split_encroached (GtsSurface * surface,
 				 v, s->v2);
 #endif
 
-    GTS_OBJECT (s)->klass = GTS_OBJECT_CLASS (surface->edge_class);
+    object_set_class (GTS_OBJECT (s), GTS_OBJECT_CLASS (surface->edge_class));
 
     if (f == NULL)
       g_assert ((f = gts_edge_has_parent_surface (GTS_EDGE (s), surface)));
@@ -327,6 +329,9 @@ static GtsObjectClass * heap_surface_class_new (GtsObjectClass * parent_class)
   GtsObjectClassInfo heap_surface_info;
 
   heap_surface_info = parent_class->info;
+  /* the temporary class must not replace @parent_class in the table
+     of classes */
+  strcpy (heap_surface_info.name, "GtsHeapSurface");
   heap_surface_info.class_init_func = (GtsObjectClassInitFunc)
     heap_surface_class_init;
   return gts_object_class_new (parent_class,
@@ -376,7 +381,7 @@ guint gts_delaunay_refine (GtsSurface * surface,
 
   original_class = GTS_OBJECT (surface)->klass;
   heap_surface_class = heap_surface_class_new (original_class);
-  GTS_OBJECT (surface)->klass = heap_surface_class;
+  object_set_class (GTS_OBJECT (surface), heap_surface_class);
 
   heap = gts_eheap_new (cost, cost_data);
   gts_surface_foreach_face (surface, (GtsFunc) make_face_heap, heap);
@@ -410,9 +415,9 @@ guint gts_delaunay_refine (GtsSurface * surface,
   gts_fifo_foreach (encroached, (GtsFunc) gts_object_reset_reserved, NULL);
   gts_fifo_destroy (encroached);
 
-  GTS_OBJECT (surface)->klass = original_class;
+  object_set_class (GTS_OBJECT (surface), original_class);
   GTS_OBJECT (surface)->reserved = NULL;
-  g_free (heap_surface_class);
+  object_class_free (heap_surface_class);
 
   return unrefined_number;
 }
@@ -0,0 +1,264 @@
+/* GTS - Library for the manipulation of triangulated surfaces
+ * Copyright (C) 1999 Stéphane Popinet
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <string.h>
+#include "gts.h"
+
+/* A scratch table is an open addressing hash table with linear
+   probing. A slot is in use only if its stamp is equal to the current
+   stamp of the table, so that clearing the table just increments its
+   stamp. */
+
+typedef struct _ScratchSlot ScratchSlot;
+
+struct _ScratchSlot {
+  gpointer key;
+  gpointer data;
+  guint stamp;
+};
+
+struct _GtsScratch {
+  ScratchSlot * slots;
+  guint bits;
+  guint size;
+  guint stamp;
+};
+
+#define SCRATCH_MIN_BITS 4
+#define SLOT_IS_USED(scratch, i) ((scratch)->slots[i].stamp == (scratch)->stamp)
+
+static guint scratch_hash (GtsScratch * scratch, gpointer key)
+{
+  return (guint) (((guint64) GPOINTER_TO_SIZE (key)*
+		   G_GUINT64_CONSTANT (0x9e3779b97f4a7c15)) >>
+		  (64 - scratch->bits));
+}
+
+static void scratch_alloc (GtsScratch * scratch, guint bits)
+{
+  scratch->bits = bits;
+  scratch->slots = g_malloc0 ((1 << bits)*sizeof (ScratchSlot));
+  scratch->stamp = 1;
+}
+
+static void scratch_insert (GtsScratch * scratch,
+			    gpointer key,
+			    gpointer data)
+{
+  guint mask = (1 << scratch->bits) - 1;
+  guint i = scratch_hash (scratch, key);
+
+  while (SLOT_IS_USED (scratch, i)) {
+    if (scratch->slots[i].key == key) {
+      scratch->slots[i].data = data;
+      return;
+    }
+    i = (i + 1) & mask;
+  }
+  scratch->slots[i].key = key;
+  scratch->slots[i].data = data;
+  scratch->slots[i].stamp = scratch->stamp;
+  scratch->size++;
+}
+
+static void scratch_grow (GtsScratch * scratch)
+{
+  ScratchSlot * slots = scratch->slots;
+  guint i, n = 1 << scratch->bits, stamp = scratch->stamp;
+
+  scratch_alloc (scratch, scratch->bits + 1);
+  scratch->size = 0;
+  for (i = 0; i < n; i++)
+    if (slots[i].stamp == stamp)
+      scratch_insert (scratch, slots[i].key, slots[i].data);
+  g_free (slots);
+}
+
+static gint scratch_find (GtsScratch * scratch, gpointer key)
+{
+  guint mask = (1 << scratch->bits) - 1;
+  guint i = scratch_hash (scratch, key);
+
+  while (SLOT_IS_USED (scratch, i)) {
+    if (scratch->slots[i].key == key)
+      return i;
+    i = (i + 1) & mask;
+  }
+  return -1;
+}
+
+/**
+ * gts_scratch_new:
+ * @size: the expected number of objects to be stored in the table or 0.
+ *
+ * A #GtsScratch is a table associating temporary data to objects
+ * (or to any other pointer). It can be used by an algorithm instead
+ * of the @reserved field of #GtsObject: several scratch tables can
+ * be used at the same time on the same objects and the table can be
+ * emptied in constant time using gts_scratch_clear().
+ *
+ * Returns: a new empty #GtsScratch.
+ */
+GtsScratch * gts_scratch_new (guint size)
+{
+  GtsScratch * scratch = g_malloc (sizeof (GtsScratch));
+  guint bits = SCRATCH_MIN_BITS;
+
+  while (bits < 31 && (1 << bits) < 2*size)
+    bits++;
+  scratch_alloc (scratch, bits);
+  scratch->size = 0;
+
+  return scratch;
+}
+
+/**
+ * gts_scratch_set:
+ * @scratch: a #GtsScratch.
+ * @object: a pointer (typically a #GtsObject).
+ * @data: the data to associate with @object.
+ *
+ * Associates @data with @object, replacing any data previously
+ * associated with @object.
+ */
+void gts_scratch_set (GtsScratch * scratch, gpointer object, gpointer data)
+{
+  g_return_if_fail (scratch != NULL);
+
+  if (4*(scratch->size + 1) > 3*(1 << scratch->bits))
+    scratch_grow (scratch);
+  scratch_insert (scratch, object, data);
+}
+
+/**
+ * gts_scratch_get:
+ * @scratch: a #GtsScratch.
+ * @object: a pointer (typically a #GtsObject).
+ *
+ * Returns: the data associated with @object or %NULL.
+ */
+gpointer gts_scratch_get (GtsScratch * scratch, gpointer object)
+{
+  gint i;
+
+  g_return_val_if_fail (scratch != NULL, NULL);
+
+  i = scratch_find (scratch, object);
+  return i < 0 ? NULL : scratch->slots[i].data;
+}
+
+/**
+ * gts_scratch_remove:
+ * @scratch: a #GtsScratch.
+ * @object: a pointer (typically a #GtsObject).
+ *
+ * Removes the data associated with @object (if any) from @scratch.
+ */
+void gts_scratch_remove (GtsScratch * scratch, gpointer object)
+{
+  guint mask, j;
+  gint i;
+
+  g_return_if_fail (scratch != NULL);
+
+  if ((i = scratch_find (scratch, object)) < 0)
+    return;
+
+  /* shift back the following slots of the cluster, so that no hole
+     is left between a key and its hash position */
+  mask = (1 << scratch->bits) - 1;
+  j = i;
+  while (SLOT_IS_USED (scratch, j = (j + 1) & mask)) {
+    guint k = scratch_hash (scratch, scratch->slots[j].key);
+
+    if (((j - k) & mask) >= ((j - i) & mask)) {
+      scratch->slots[i] = scratch->slots[j];
+      i = j;
+    }
+  }
+  scratch->slots[i].stamp = 0;
+  scratch->size--;
+}
+
+/**
+ * gts_scratch_size:
+ * @scratch: a #GtsScratch.
+ *
+ * Returns: the number of objects stored in @scratch.
+ */
+guint gts_scratch_size (GtsScratch * scratch)
+{
+  g_return_val_if_fail (scratch != NULL, 0);
+
+  return scratch->size;
+}
+
+/**
+ * gts_scratch_foreach:
+ * @scratch: a #GtsScratch.
+ * @func: the function to call for each object stored in @scratch.
+ * @data: user data to pass to @func.
+ *
+ * Calls @func for each object stored in @scratch, passing the object,
+ * its associated data and @data. @func must not modify @scratch.
+ */
+void gts_scratch_foreach (GtsScratch * scratch, GHFunc func, gpointer data)
+{
+  guint i, n;
+
+  g_return_if_fail (scratch != NULL);
+  g_return_if_fail (func != NULL);
+
+  n = 1 << scratch->bits;
+  for (i = 0; i < n; i++)
+    if (SLOT_IS_USED (scratch, i))
+      (* func) (scratch->slots[i].key, scratch->slots[i].data, data);
+}
+
+/**
+ * gts_scratch_clear:
+ * @scratch: a #GtsScratch.
+ *
+ * Removes all the objects stored in @scratch. This operation does
+ * not depend on the number of objects stored.
+ */
+void gts_scratch_clear (GtsScratch * scratch)
+{
+  g_return_if_fail (scratch != NULL);
+
+  if (++scratch->stamp == 0) {
+    memset (scratch->slots, 0, (1 << scratch->bits)*sizeof (ScratchSlot));
+    scratch->stamp = 1;
+  }
+  scratch->size = 0;
+}
+
+/**
+ * gts_scratch_destroy:
+ * @scratch: a #GtsScratch.
+ *
+ * Frees all the memory allocated for @scratch.
+ */
+void gts_scratch_destroy (GtsScratch * scratch)
+{
+  g_return_if_fail (scratch != NULL);
+
+  g_free (scratch->slots);
+  g_free (scratch);
+}
@@ -25,12 +25,12 @@ static void segment_destroy (GtsObject * object)
   GtsVertex * v1 = segment->v1;
   GtsVertex * v2 = segment->v2;
 
-  v1->segments = g_slist_remove (v1->segments, segment);
+  gts_vertex_remove_segment (v1, segment);
   if (!GTS_OBJECT_DESTROYED (v1) &&
       !gts_allow_floating_vertices && v1->segments == NULL)
     gts_object_destroy (GTS_OBJECT (v1));
 
-  v2->segments = g_slist_remove (v2->segments, segment);
+  gts_vertex_remove_segment (v2, segment);
   if (!GTS_OBJECT_DESTROYED (v2) &&
       !gts_allow_floating_vertices && v2->segments == NULL)
     gts_object_destroy (GTS_OBJECT (v2));
@@ -94,8 +94,8 @@ GtsSegment * gts_segment_new (GtsSegmentClass * klass,
   s = GTS_SEGMENT (gts_object_new (GTS_OBJECT_CLASS (klass)));
   s->v1 = v1;
   s->v2 = v2;
-  v1->segments = g_slist_prepend (v1->segments, s);
-  v2->segments = g_slist_prepend (v2->segments, s);
+  gts_vertex_add_segment (v1, s);
+  gts_vertex_add_segment (v2, s);
 
   return s;
 }
@@ -38,7 +38,9 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 #include "gts.h"
+#include "gts-private.h"
 
 #define DYNAMIC_SPLIT
 #define NEW
@@ -134,7 +136,7 @@ static GtsTriangle * replace_edge_collapse (GtsEdge * e,
 #endif
 					    )
 {
-  GSList * i;
+  GSList * triangles, * i;
   GtsTriangle * rt = NULL;
 #ifdef DYNAMIC_SPLIT
   guint size;
@@ -142,33 +144,29 @@ static GtsTriangle * replace_edge_collapse (GtsEdge * e,
 #endif
 
 #ifdef NEW
-  i = e->triangles;
-  e->triangles = NULL;
+  i = triangles = g_slist_copy (e->triangles);
+  gts_edge_free_triangles (e);
   size = g_slist_length (i)*sizeof (GtsTriangle *);
   *a1 = a = g_malloc (size > 0 ? size : sizeof (GtsTriangle *));
   while (i) {
     GtsTriangle * t = i->data;
-    GSList * next = i->next;
     if (t != ((GtsTriangle *) cf)) {
       if (IS_CFACE (t)) {
-	i->next = e->triangles;
-	e->triangles = i;
+	gts_edge_add_triangle (e, t);
 	/* set the edge given by edge_flag (CFACE_E1 or CFACE_E2) */
 	GTS_OBJECT (t)->reserved = GUINT_TO_POINTER (edge_flag);
 	cf->flags |= CFACE_KEEP_VVS;
       }
       else {
 	TRIANGLE_REPLACE_EDGE (t, e, with);
-	i->next = with->triangles;
-	with->triangles = i;
+	gts_edge_add_triangle (with, t);
 	rt = t;
 	*(a++) = t;
       }
     }
-    else
-      g_slist_free_1 (i);
-    i = next;
+    i = i->next;
   }
+  g_slist_free (triangles);
   *a = NULL;
   if (!e->triangles) {
     if (heap)
@@ -176,39 +174,51 @@ static GtsTriangle * replace_edge_collapse (GtsEdge * e,
     gts_object_destroy (GTS_OBJECT (e));
   }
 #else /* not NEW */
-  i = e->triangles;
+  i = triangles = g_slist_copy (e->triangles);
+  gts_edge_free_triangles (e);
 #ifdef DYNAMIC_SPLIT
   size = g_slist_length (i)*sizeof (GtsTriangle *);
   *a1 = a = g_malloc (size > 0 ? size : sizeof (GtsTriangle *));
 #endif
   while (i) {
     GtsTriangle * t = i->data;
-    GSList * next = i->next;
     if (t != ((GtsTriangle *) cf)) {
       TRIANGLE_REPLACE_EDGE (t, e, with);
-      i->next = with->triangles;
-      with->triangles = i;
+      gts_edge_add_triangle (with, t);
       rt = t;
 #ifdef DYNAMIC_SPLIT
       *(a++) = t;
 #endif
     }
-    else
-      g_slist_free_1 (i);
-    i = next;
+    i = i->next;
   }
+  g_slist_free (triangles);
 #ifdef DYNAMIC_SPLIT
   *a = NULL;
 #endif
   if (heap)
     HEAP_REMOVE_OBJECT (heap, e);
-  e->triangles = NULL;
   gts_object_destroy (GTS_OBJECT (e));
 #endif /* NEW */
 
   return rt;
 }
 
+/* Moves the segments of @from in front of the segments of @to,
+   preserving their order. */
+static void move_segments (GtsVertex * from, GtsVertex * to)
+{
+  GSList * segments = g_slist_reverse (g_slist_copy (from->segments));
+  GSList * i = segments;
+
+  while (i) {
+    gts_vertex_add_segment (to, i->data);
+    i = i->next;
+  }
+  g_slist_free (segments);
+  gts_vertex_free_segments (from);
+}
+
 static CFace * cface_new (GtsFace * f,
 			  GtsEdge * e,
 			  GtsVertex * v1, 
@@ -258,7 +268,7 @@ static CFace * cface_new (GtsFace * f,
 
   cf = (CFace *) f;
 #ifndef NEW
-  GTS_OBJECT (cf)->klass = cface_class ();
+  object_set_class (GTS_OBJECT (cf), cface_class ());
 #else
   cf->flags = flags;
 #endif
@@ -355,7 +365,7 @@ static void replace_edge_expand (GtsEdge * e,
 	     t, id (t), e, id (e), with, id (with));
 #endif
     TRIANGLE_REPLACE_EDGE (t, e, with);
-    with->triangles = g_slist_prepend (with->triangles, t);
+    gts_edge_add_triangle (with, t);
     if (GTS_OBJECT (t)->reserved) {
       /* apart from the triangles having e as an edge, t is the only
 	 triangle using v */
@@ -410,18 +420,16 @@ static void cface_expand (CFace * cf,
 
 #ifdef NEW
   if (!(flags & CFACE_KEEP_VVS)) {
-    g_slist_free (vvs->triangles);
-    vvs->triangles = NULL;
+    gts_edge_free_triangles (vvs);
     gts_object_destroy (GTS_OBJECT (vvs));
   }
 #else
-  g_slist_free (vvs->triangles);
-  vvs->triangles = NULL;
+  gts_edge_free_triangles (vvs);
   gts_object_destroy (GTS_OBJECT (vvs));
 #endif
 
   /* gts_face_new : because I am "creating" a face */
-  GTS_OBJECT (cf)->klass = GTS_OBJECT_CLASS (gts_face_class ());
+  object_set_class (GTS_OBJECT (cf), GTS_OBJECT_CLASS (gts_face_class ()));
   gts_object_init (GTS_OBJECT (cf), GTS_OBJECT (cf)->klass);
   
   if (orientation)
@@ -585,7 +593,7 @@ void gts_split_collapse (GtsSplit * vs,
 {
   GtsEdge * e;
   GtsVertex * v, * v1, * v2;
-  GSList * i, * end;
+  GSList * i;
 #ifdef DYNAMIC_SPLIT
   GtsSplitCFace * cf;
   guint j;
@@ -602,6 +610,7 @@ void gts_split_collapse (GtsSplit * vs,
 
   g_return_if_fail (v->segments == NULL);
   
+  GTS_TOPOLOGY_CHANGED ();
   /* we don't want to destroy vertices */
   gts_allow_floating_vertices = TRUE;
 
@@ -652,7 +661,7 @@ void gts_split_collapse (GtsSplit * vs,
   while (i) {
     cf->f = i->data;
     g_assert (GTS_IS_FACE (cf->f));
-    GTS_OBJECT (cf->f)->klass = GTS_OBJECT_CLASS (cface_class ());
+    object_set_class (GTS_OBJECT (cf->f), GTS_OBJECT_CLASS (cface_class ()));
     cf++;
     i = i->next;
   }
@@ -692,13 +701,11 @@ void gts_split_collapse (GtsSplit * vs,
     i = i->next;
   }
 #endif /* NEW */
-  g_slist_free (e->triangles);
-  e->triangles = NULL;
+  gts_edge_free_triangles (e);
   gts_object_destroy (GTS_OBJECT (e));
 
   gts_allow_floating_vertices = FALSE;
 
-  end = NULL;
   i = v1->segments;
   while (i) {
     GtsSegment * s = i->data;
@@ -706,16 +713,10 @@ void gts_split_collapse (GtsSplit * vs,
       s->v1 = v;
     else
       s->v2 = v;
-    end = i;
     i = i->next;
   }
-  if (end) {
-    end->next = v->segments;
-    v->segments = v1->segments;
-    v1->segments = NULL;
-  }
+  move_segments (v1, v);
 
-  end = NULL;
   i = v2->segments;
   while (i) {
     GtsSegment * s = i->data;
@@ -723,14 +724,9 @@ void gts_split_collapse (GtsSplit * vs,
       s->v1 = v;
     else
       s->v2 = v;
-    end = i;
     i = i->next;
   }
-  if (end) {
-    end->next = v->segments;
-    v->segments = v2->segments;
-    v2->segments = NULL;
-  }
+  move_segments (v2, v);
 
 #ifdef DEBUG
   if (invalid) {
@@ -817,6 +813,7 @@ void gts_split_expand (GtsSplit * vs,
   g_return_if_fail (s != NULL);
   g_return_if_fail (klass != NULL);
 
+  GTS_TOPOLOGY_CHANGED ();
   /* we don't want to destroy vertices */
   gts_allow_floating_vertices = TRUE;
 
@@ -866,9 +863,8 @@ void gts_split_expand (GtsSplit * vs,
       else
 	GTS_SEGMENT (e1)->v2 = with;
 
-      v->segments = g_slist_remove_link (v->segments, i);
-      i->next = with->segments;
-      with->segments = i;
+      gts_vertex_remove_segment (v, GTS_SEGMENT (e1));
+      gts_vertex_add_segment (with, GTS_SEGMENT (e1));
       changed = TRUE;
     }
     if (next)
@@ -1379,6 +1375,249 @@ void gts_psurface_write (GtsPSurface * ps, FILE * fptr)
   g_hash_table_destroy (hash);
 }
 
+/* Binary format, see gts_psurface_write_binary() */
+
+#define PSURFACE_BINARY_SIGNATURE "GtsPSurfaceBinary"
+#define PSURFACE_BINARY_VERSION   1
+#define PSURFACE_BINARY_QUANTIZED 0x1
+#define PSURFACE_LOD_STEP         64
+
+typedef struct _GtsPSurfaceBinary GtsPSurfaceBinary;
+
+struct _GtsPSurfaceBinary {
+  gdouble step;                 /* quantization step or 0. */
+  guint ns, lod_step;
+  const guchar * lod;           /* the LOD index */
+  const guchar * start, * records, * end;
+};
+
+static void put_uint32 (GByteArray * b, guint32 v)
+{
+  guchar p[4];
+
+  p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+  g_byte_array_append (b, p, 4);
+}
+
+static void put_uint64 (GByteArray * b, guint64 v)
+{
+  put_uint32 (b, v);
+  put_uint32 (b, v >> 32);
+}
+
+static void put_double (GByteArray * b, gdouble d)
+{
+  union { guint64 i; gdouble d; } u;
+
+  u.d = d;
+  put_uint64 (b, u.i);
+}
+
+static void put_varint (GByteArray * b, guint64 v)
+{
+  guchar p[10];
+  guint n = 0;
+
+  while (v >= 0x80) {
+    p[n++] = v | 0x80;
+    v >>= 7;
+  }
+  p[n++] = v;
+  g_byte_array_append (b, p, n);
+}
+
+/* signed integers are zigzag-encoded so that small negative values
+   also use few bytes */
+static void put_svarint (GByteArray * b, gint64 v)
+{
+  put_varint (b, ((guint64) v << 1) ^ (guint64) (v >> 63));
+}
+
+static void write_vertex_pbinary (GtsPoint * p, gpointer * data)
+{
+  GArray * pos = data[1];
+
+  GTS_OBJECT (p)->reserved = GUINT_TO_POINTER (pos->len/3);
+  put_double (data[0], p->x);
+  put_double (data[0], p->y);
+  put_double (data[0], p->z);
+  g_array_append_val (pos, p->x);
+  g_array_append_val (pos, p->y);
+  g_array_append_val (pos, p->z);
+}
+
+static void write_edge_pbinary (GtsSegment * s, gpointer * data)
+{
+  guint * ne = data[1];
+
+  GTS_OBJECT (s)->reserved = GUINT_TO_POINTER ((*ne)++);
+  put_uint32 (data[0], GPOINTER_TO_UINT (GTS_OBJECT (s->v1)->reserved));
+  put_uint32 (data[0], GPOINTER_TO_UINT (GTS_OBJECT (s->v2)->reserved));
+}
+
+static void write_face_pbinary (GtsTriangle * t, gpointer * data)
+{
+  guint * nf = data[1];
+
+  /* the indices of the faces are stored + 1 */
+  g_hash_table_insert (data[2], t, GUINT_TO_POINTER (++(*nf)));
+  put_uint32 (data[0], GPOINTER_TO_UINT (GTS_OBJECT (t->e1)->reserved));
+  put_uint32 (data[0], GPOINTER_TO_UINT (GTS_OBJECT (t->e2)->reserved));
+  put_uint32 (data[0], GPOINTER_TO_UINT (GTS_OBJECT (t->e3)->reserved));
+}
+
+/* The indices of the faces (and of the vertices) of the vertex splits
+   are written relative to the end of the table, as recent faces are
+   more likely to be used */
+static void write_faces_pbinary (GByteArray * b, GtsTriangle ** a,
+				 GHashTable * hash, guint nf)
+{
+  guint n = 0;
+
+  while (a[n])
+    n++;
+  put_varint (b, n);
+  while (*a)
+    put_varint (b, nf - GPOINTER_TO_UINT (g_hash_table_lookup (hash, *(a++))));
+}
+
+/**
+ * gts_psurface_write_binary:
+ * @ps: a #GtsPSurface.
+ * @fptr: a file pointer.
+ * @step: the quantization step of the coordinates or 0.
+ *
+ * Writes to @fptr a binary description of @ps, which can be read
+ * with gts_psurface_open() from a #GtsFile created with
+ * gts_file_new_mapped().
+ *
+ * The file contains the coarsest surface, with coordinates in double
+ * precision, followed by packed records for the vertex splits. If
+ * @step is positive, the coordinates of the two vertices created by
+ * each vertex split are stored as the difference with the coordinates
+ * of the split vertex, rounded to a multiple of @step. Otherwise they
+ * are stored in double precision.
+ *
+ * The file also contains an index giving the position of every
+ * 64th vertex split and the corresponding number of faces, see
+ * gts_psurface_lod().
+ *
+ * Only the geometry and connectivity of @ps are stored, not the data
+ * written by the write() methods of its objects.
+ */
+void gts_psurface_write_binary (GtsPSurface * ps, FILE * fptr, gdouble step)
+{
+  GByteArray * header, * lod, * base, * records;
+  GArray * pos;
+  GHashTable * hash;
+  guint nv0, ne0 = 0, nf0 = 0, nf, ns = 0;
+  gpointer data[3];
+
+  g_return_if_fail (ps != NULL);
+  g_return_if_fail (fptr != NULL);
+  g_return_if_fail (GTS_PSURFACE_IS_CLOSED (ps));
+
+  while (gts_psurface_remove_vertex (ps))
+    ;
+
+  /* the decoded coordinates of the vertices */
+  pos = g_array_new (FALSE, FALSE, sizeof (gdouble));
+  hash = g_hash_table_new (NULL, NULL);
+  base = g_byte_array_new ();
+  data[0] = base;
+  data[1] = pos;
+  gts_surface_foreach_vertex (ps->s, (GtsFunc) write_vertex_pbinary, data);
+  nv0 = pos->len/3;
+  data[1] = &ne0;
+  gts_surface_foreach_edge (ps->s, (GtsFunc) write_edge_pbinary, data);
+  data[1] = &nf0;
+  data[2] = hash;
+  gts_surface_foreach_face (ps->s, (GtsFunc) write_face_pbinary, data);
+  gts_surface_foreach_edge (ps->s, (GtsFunc) gts_object_reset_reserved, NULL);
+
+  lod = g_byte_array_new ();
+  records = g_byte_array_new ();
+  nf = nf0;
+  while (ps->pos) {
+    GtsSplit * vs = g_ptr_array_index (ps->split, --ps->pos);
+    GtsSplitCFace * scf = vs->cfaces;
+    GtsVertex * v[2];
+    guint iv = GPOINTER_TO_UINT (GTS_OBJECT (vs->v)->reserved), i, j;
+
+    if (ns++ % PSURFACE_LOD_STEP == 0) {
+      put_uint64 (lod, records->len);
+      put_uint32 (lod, nf);
+    }
+    put_varint (records, pos->len/3 - 1 - iv);
+    put_varint (records, vs->ncf);
+
+    v[0] = GTS_SPLIT_V1 (vs);
+    v[1] = GTS_SPLIT_V2 (vs);
+    for (i = 0; i < 2; i++) {
+      GtsPoint * p = GTS_POINT (v[i]);
+      gdouble x[3];
+
+      x[0] = p->x; x[1] = p->y; x[2] = p->z;
+      for (j = 0; j < 3; j++)
+	if (step > 0.) {
+	  gdouble o = g_array_index (pos, gdouble, 3*iv + j);
+	  gdouble d = floor ((x[j] - o)/step + 0.5);
+	  gint64 q = d > 4e18 ? G_GINT64_CONSTANT (4000000000000000000) :
+	    d < -4e18 ? - G_GINT64_CONSTANT (4000000000000000000) : (gint64) d;
+
+	  put_svarint (records, q);
+	  x[j] = o + q*step;
+	}
+	else
+	  put_double (records, x[j]);
+      GTS_OBJECT (v[i])->reserved = GUINT_TO_POINTER (pos->len/3);
+      g_array_append_vals (pos, x, 3);
+    }
+
+    for (i = 0; i < vs->ncf; i++, scf++) {
+      CFace * cf = CFACE (scf->f);
+
+      put_varint (records, 
+		  nf - GPOINTER_TO_UINT (g_hash_table_lookup (hash, cf->t)));
+      put_varint (records, cf->flags);
+      write_faces_pbinary (records, scf->a1, hash, nf);
+      write_faces_pbinary (records, scf->a2, hash, nf);
+      g_hash_table_insert (hash, cf, GUINT_TO_POINTER (++nf));
+    }
+
+    gts_split_expand (vs, ps->s, ps->s->edge_class);
+  }
+  if (ns % PSURFACE_LOD_STEP == 0) {
+    put_uint64 (lod, records->len);
+    put_uint32 (lod, nf);
+  }
+
+  header = g_byte_array_new ();
+  put_uint32 (header, PSURFACE_BINARY_VERSION);
+  put_uint32 (header, step > 0. ? PSURFACE_BINARY_QUANTIZED : 0);
+  put_double (header, step > 0. ? step : 0.);
+  put_uint32 (header, nv0);
+  put_uint32 (header, ne0);
+  put_uint32 (header, nf0);
+  put_uint32 (header, ns);
+  put_uint32 (header, PSURFACE_LOD_STEP);
+
+  fputs (PSURFACE_BINARY_SIGNATURE "\n", fptr);
+  fwrite (header->data, 1, header->len, fptr);
+  fwrite (lod->data, 1, lod->len, fptr);
+  fwrite (base->data, 1, base->len, fptr);
+  fwrite (records->data, 1, records->len, fptr);
+
+  gts_surface_foreach_vertex (ps->s, 
+			      (GtsFunc) gts_object_reset_reserved, NULL);
+  g_byte_array_free (header, TRUE);
+  g_byte_array_free (lod, TRUE);
+  g_byte_array_free (base, TRUE);
+  g_byte_array_free (records, TRUE);
+  g_array_free (pos, TRUE);
+  g_hash_table_destroy (hash);
+}
+
 static guint surface_read (GtsSurface * surface, 
 			   GtsFile * f,
 			   GPtrArray * vertices,
@@ -1568,6 +1807,198 @@ static guint surface_read (GtsSurface * surface,
   return 0;
 }
 
+typedef struct {
+  const guchar * p, * end;
+} BinaryInput;
+
+static gboolean get_uint32 (BinaryInput * in, guint32 * v)
+{
+  const guchar * p = in->p;
+
+  if (in->end - p < 4)
+    return FALSE;
+  *v = ((guint32) p[0] | ((guint32) p[1] << 8) |
+	((guint32) p[2] << 16) | ((guint32) p[3] << 24));
+  in->p += 4;
+  return TRUE;
+}
+
+static gboolean get_uint64 (BinaryInput * in, guint64 * v)
+{
+  guint32 lo, hi;
+
+  if (!get_uint32 (in, &lo) || !get_uint32 (in, &hi))
+    return FALSE;
+  *v = lo | ((guint64) hi << 32);
+  return TRUE;
+}
+
+static gboolean get_double (BinaryInput * in, gdouble * d)
+{
+  union { guint64 i; gdouble d; } u;
+
+  if (!get_uint64 (in, &u.i))
+    return FALSE;
+  *d = u.d;
+  return TRUE;
+}
+
+static gboolean get_varint (BinaryInput * in, guint64 * v)
+{
+  guint shift = 0;
+
+  *v = 0;
+  while (in->p < in->end && shift < 64) {
+    guchar c = *(in->p++);
+
+    *v |= (guint64) (c & 0x7f) << shift;
+    if (!(c & 0x80))
+      return TRUE;
+    shift += 7;
+  }
+  return FALSE;
+}
+
+static gboolean get_svarint (BinaryInput * in, gint64 * v)
+{
+  guint64 u;
+
+  if (!get_varint (in, &u))
+    return FALSE;
+  *v = (gint64) (u >> 1) ^ - (gint64) (u & 1);
+  return TRUE;
+}
+
+/* Reads an index relative to the end of a table of size @n */
+static gboolean get_index (BinaryInput * in, guint n, guint * i)
+{
+  guint64 d;
+
+  if (!get_varint (in, &d) || d >= n)
+    return FALSE;
+  *i = n - 1 - d;
+  return TRUE;
+}
+
+static guint psurface_read_binary (GtsPSurface * ps, GtsFile * f)
+{
+  GtsSurface * s = ps->s;
+  GtsPSurfaceBinary * b;
+  GtsEdge ** edges;
+  BinaryInput in;
+  guint32 version, flags, nv, ne, nf, n;
+  gdouble step;
+
+  if (f->next_token != '\n') {
+    gts_file_error (f, "malformed binary signature");
+    return f->line;
+  }
+  if (f->map == NULL) {
+    gts_file_error (f, "binary progressive surfaces can only be read "
+		    "from mapped files");
+    return f->line;
+  }
+  f->next_token = '\0';
+
+  in.p = (const guchar *) f->s;
+  in.end = (const guchar *) f->map->end;
+  b = g_malloc (sizeof (GtsPSurfaceBinary));
+  if (!get_uint32 (&in, &version) || !get_uint32 (&in, &flags) ||
+      !get_double (&in, &step) || 
+      !get_uint32 (&in, &nv) || !get_uint32 (&in, &ne) || 
+      !get_uint32 (&in, &nf) || !get_uint32 (&in, &b->ns) || 
+      !get_uint32 (&in, &b->lod_step)) {
+    gts_file_error (f, "incomplete binary header");
+    g_free (b);
+    return f->line;
+  }
+  if (version != PSURFACE_BINARY_VERSION) {
+    gts_file_error (f, "unsupported binary format version %u", version);
+    g_free (b);
+    return f->line;
+  }
+  if (((flags & PSURFACE_BINARY_QUANTIZED) && !(step > 0.)) ||
+      b->lod_step == 0) {
+    gts_file_error (f, "invalid binary header");
+    g_free (b);
+    return f->line;
+  }
+  if (12*((guint64) b->ns/b->lod_step + 1) + 24*(guint64) nv + 
+      8*(guint64) ne + 12*(guint64) nf > (guint64) (in.end - in.p)) {
+    gts_file_error (f, "binary file too short");
+    g_free (b);
+    return f->line;
+  }
+  b->step = flags & PSURFACE_BINARY_QUANTIZED ? step : 0.;
+  b->start = (const guchar *) f->map->start;
+  b->lod = in.p;
+  in.p += 12*(b->ns/b->lod_step + 1);
+
+  g_ptr_array_set_size (ps->vertices, 0);
+  for (n = 0; n < nv; n++) {
+    gdouble x, y, z;
+
+    if (!get_double (&in, &x) || !get_double (&in, &y) || 
+	!get_double (&in, &z)) {
+      gts_file_error (f, "incomplete vertex %u", n);
+      break;
+    }
+    g_ptr_array_add (ps->vertices, gts_vertex_new (s->vertex_class, x, y, z));
+  }
+
+  /* allocate ne + 1 just in case ne == 0 */
+  edges = g_malloc ((ne + 1)*sizeof (GtsEdge *));
+  for (n = 0; n < ne && f->type != GTS_ERROR; n++) {
+    guint32 v1, v2;
+
+    if (!get_uint32 (&in, &v1) || !get_uint32 (&in, &v2))
+      gts_file_error (f, "incomplete edge %u", n);
+    else if (v1 >= nv || v2 >= nv || v1 == v2)
+      gts_file_error (f, "invalid vertex indices for edge %u", n);
+    else
+      edges[n] = gts_edge_new (s->edge_class, 
+			       ps->vertices->pdata[v1], 
+			       ps->vertices->pdata[v2]);
+  }
+  g_ptr_array_set_size (ps->faces, 0);
+  for (n = 0; n < nf && f->type != GTS_ERROR; n++) {
+    guint32 e1, e2, e3;
+
+    if (!get_uint32 (&in, &e1) || !get_uint32 (&in, &e2) ||
+	!get_uint32 (&in, &e3))
+      gts_file_error (f, "incomplete face %u", n);
+    else if (e1 >= ne || e2 >= ne || e3 >= ne ||
+	     e1 == e2 || e2 == e3 || e3 == e1)
+      gts_file_error (f, "invalid edge indices for face %u", n);
+    else {
+      GtsFace * face = gts_face_new (s->face_class, 
+				     edges[e1], edges[e2], edges[e3]);
+
+      gts_surface_add_face (s, face);
+      g_ptr_array_add (ps->faces, face);
+    }
+  }
+  g_free (edges);
+
+  if (f->type == GTS_ERROR) {
+    /* destroying the vertices also destroys their edges and faces */
+    gts_allow_floating_vertices = TRUE;
+    for (n = 0; n < ps->vertices->len; n++)
+      gts_object_destroy (GTS_OBJECT (g_ptr_array_index (ps->vertices, n)));
+    gts_allow_floating_vertices = FALSE;    
+    g_ptr_array_set_size (ps->vertices, 0);
+    g_ptr_array_set_size (ps->faces, 0);
+    g_free (b);
+    return f->line;
+  }
+
+  b->records = in.p;
+  b->end = in.end;
+  ps->binary = b;
+  f->s = (gchar *) in.p;
+  return 0;
+}
+
 /**
  * gts_psurface_open:
  * @klass: a #GtsPSurfaceClass.
@@ -1577,7 +2008,9 @@ static guint surface_read (GtsSurface * surface,
  *
  * Creates a new #GtsPSurface prepared for input from the file @f 
  * containing a valid GTS representation of a progressive surface. The initial
- * shape of the progressive surface is loaded into @s.
+ * shape of the progressive surface is loaded into @s. The binary files
+ * written by gts_psurface_write_binary() are also recognized, provided
+ * @f was created with gts_file_new_mapped().
  * 
  * Before being usable as such this progressive surface must be closed using
  * gts_psurface_close(). While open however, the functions
@@ -1606,7 +2039,10 @@ GtsPSurface * gts_psurface_open (GtsPSurfaceClass * klass,
   ps->vertices = g_ptr_array_new ();
   ps->faces = g_ptr_array_new ();
 
-  if (surface_read (s, f, ps->vertices, ps->faces)) {
+  if (f->type == GTS_STRING && 
+      !strcmp (f->token->str, PSURFACE_BINARY_SIGNATURE) ?
+      psurface_read_binary (ps, f) :
+      surface_read (s, f, ps->vertices, ps->faces)) {
     ps->s = NULL;
     gts_object_destroy (GTS_OBJECT (ps));
     return NULL;
@@ -1615,7 +2051,9 @@ GtsPSurface * gts_psurface_open (GtsPSurfaceClass * klass,
   ps->min = gts_surface_vertex_number (ps->s);
   ps->pos = 0;
 
-  if (f->type == GTS_INT) {
+  if (ps->binary)
+    g_ptr_array_set_size (ps->split, ps->binary->ns);
+  else if (f->type == GTS_INT) {
     gint ns = strtol (f->token->str, NULL, 0);
     
     if (ns > 0) {
@@ -1627,6 +2065,132 @@ GtsPSurface * gts_psurface_open (GtsPSurfaceClass * klass,
   return ps;
 }
 
+/* Links @vs to its parent and expands it */
+static void psurface_add_split (GtsPSurface * ps, GtsSplit * vs)
+{
+  GtsSplit * parent;
+
+  if ((parent = GTS_OBJECT (vs->v)->reserved)) {
+    GTS_OBJECT (vs->v)->reserved = NULL;
+    if (parent->v1 == GTS_OBJECT (vs->v))
+      parent->v1 = GTS_OBJECT (vs);
+    else {
+      g_assert (parent->v2 == GTS_OBJECT (vs->v));
+      parent->v2 = GTS_OBJECT (vs);
+    }
+  }
+  g_ptr_array_index (ps->split, ps->pos++) = vs;
+  gts_split_expand (vs, ps->s, ps->s->edge_class);
+}
+
+static GtsTriangle ** psurface_read_faces (GtsPSurface * ps, 
+					   BinaryInput * in)
+{
+  GtsTriangle ** a;
+  guint64 n, i;
+
+  if (!get_varint (in, &n) || n > (guint64) (in->end - in->p))
+    return NULL;
+  a = g_malloc ((n + 1)*sizeof (GtsTriangle *));
+  for (i = 0; i < n; i++) {
+    guint it;
+
+    if (!get_index (in, ps->faces->len, &it)) {
+      g_free (a);
+      return NULL;
+    }
+    a[i] = g_ptr_array_index (ps->faces, it);
+  }
+  a[n] = NULL;
+  return a;
+}
+
+static GtsSplit * psurface_read_vertex_binary (GtsPSurface * ps, 
+					       GtsFile * fp)
+{
+  GtsPSurfaceBinary * b = ps->binary;
+  guint nv = ps->vertices->len, nf = ps->faces->len, iv, i, j;
+  GtsSplitCFace * scf;
+  GtsSplit * vs;
+  BinaryInput in;
+  guint64 ncf;
+
+  in.p = (const guchar *) fp->s;
+  in.end = b->end;
+  if (!get_index (&in, nv, &iv) || !get_varint (&in, &ncf) ||
+      ncf > (guint64) (in.end - in.p)) {
+    gts_file_error (fp, "invalid vertex split %u", ps->pos + 1);
+    return NULL;
+  }
+
+  vs = GTS_SPLIT (gts_object_new (GTS_OBJECT_CLASS (ps->split_class)));
+  vs->v = g_ptr_array_index (ps->vertices, iv);
+  for (i = 0; i < 2; i++) {
+    GtsPoint * o = GTS_POINT (vs->v);
+    gdouble x[3], ox[3];
+    GtsObject * v;
+
+    ox[0] = o->x; ox[1] = o->y; ox[2] = o->z;
+    for (j = 0; j < 3; j++)
+      if (b->step > 0.) {
+	gint64 q;
+
+	if (!get_svarint (&in, &q))
+	  break;
+	x[j] = ox[j] + q*b->step;
+      }
+      else if (!get_double (&in, &x[j]))
+	break;
+    if (j < 3)
+      goto error;
+    v = GTS_OBJECT (gts_vertex_new (ps->s->vertex_class, x[0], x[1], x[2]));
+    v->reserved = vs;
+    g_ptr_array_add (ps->vertices, v);
+    if (i == 0)
+      vs->v1 = v;
+    else
+      vs->v2 = v;
+  }
+
+  scf = vs->cfaces = g_malloc (sizeof (GtsSplitCFace)*ncf);
+  while (ncf--) {
+    guint64 flags;
+    CFace * cf;
+    guint it;
+
+    if (!get_index (&in, ps->faces->len, &it) || 
+	!get_varint (&in, &flags))
+      goto error;
+    scf->f = GTS_FACE (gts_object_new (GTS_OBJECT_CLASS (ps->s->face_class)));
+    scf->a1 = scf->a2 = NULL;
+    vs->ncf++;
+    cf = (CFace *) scf->f;
+    object_set_class (GTS_OBJECT (cf), GTS_OBJECT_CLASS (cface_class ()));
+    cf->parent_split = vs;
+    cf->t = g_ptr_array_index (ps->faces, it);
+    cf->flags = flags;
+    if (!(scf->a1 = psurface_read_faces (ps, &in)) ||
+	!(scf->a2 = psurface_read_faces (ps, &in)))
+      goto error;
+    g_ptr_array_add (ps->faces, scf->f);
+    scf++;
+  }
+
+  fp->s = (gchar *) in.p;
+  psurface_add_split (ps, vs);
+  return vs;
+
+ error:
+  gts_file_error (fp, "invalid vertex split %u", ps->pos + 1);
+  g_ptr_array_set_size (ps->vertices, nv);
+  g_ptr_array_set_size (ps->faces, nf);
+  if (vs->v1) gts_object_destroy (vs->v1);
+  if (vs->v2) gts_object_destroy (vs->v2);
+  vs->v = NULL;
+  gts_object_destroy (GTS_OBJECT (vs));
+  return NULL;
+}
+
 /**
  * gts_psurface_read_vertex:
  * @ps: a #GtsPSurface prealably created with gts_psurface_open().
@@ -1642,7 +2206,7 @@ GtsPSurface * gts_psurface_open (GtsPSurfaceClass * klass,
 GtsSplit * gts_psurface_read_vertex (GtsPSurface * ps, GtsFile * fp)
 {
   guint nv, ncf;
-  GtsSplit * vs, * parent;
+  GtsSplit * vs;
   GtsSplitCFace * scf;
 
   g_return_val_if_fail (ps != NULL, NULL);
@@ -1652,6 +2216,9 @@ GtsSplit * gts_psurface_read_vertex (GtsPSurface * ps, GtsFile * fp)
   if (ps->pos >= ps->split->len)
     return NULL;
 
+  if (ps->binary)
+    return psurface_read_vertex_binary (ps, fp);
+
   if (fp->type == GTS_NONE)
     return NULL;
   if (fp->type != GTS_INT) {
@@ -1737,7 +2304,8 @@ GtsSplit * gts_psurface_read_vertex (GtsPSurface * ps, GtsFile * fp)
 	      scf->f = f;
 
 	      cf = (CFace *) f;
-	      GTS_OBJECT (cf)->klass = GTS_OBJECT_CLASS (cface_class ());
+	      object_set_class (GTS_OBJECT (cf),
+				GTS_OBJECT_CLASS (cface_class ()));
 	      cf->parent_split = vs;
 	      cf->t = g_ptr_array_index (ps->faces, it - 1);
 	      cf->flags = flags;
@@ -1800,18 +2368,7 @@ GtsSplit * gts_psurface_read_vertex (GtsPSurface * ps, GtsFile * fp)
   }
 
   if (fp->type != GTS_ERROR) {
-    if ((parent = GTS_OBJECT (vs->v)->reserved)) {
-      GTS_OBJECT (vs->v)->reserved = NULL;
-      if (parent->v1 == GTS_OBJECT (vs->v))
-	parent->v1 = GTS_OBJECT (vs);
-      else {
-	g_assert (parent->v2 == GTS_OBJECT (vs->v));
-	parent->v2 = GTS_OBJECT (vs);
-      }
-    }
-    g_ptr_array_index (ps->split, ps->pos++) = vs;
-    gts_split_expand (vs, ps->s, ps->s->edge_class);
-
+    psurface_add_split (ps, vs);
     return vs;
   }
 
@@ -1836,9 +2393,12 @@ void gts_psurface_close (GtsPSurface * ps)
   g_ptr_array_free (ps->vertices, TRUE);
   g_ptr_array_free (ps->faces, TRUE);
   ps->faces = ps->vertices = NULL;
+  g_free (ps->binary);
+  ps->binary = NULL;
   
-  gts_surface_foreach_vertex (ps->s, 
-			      (GtsFunc) gts_object_reset_reserved, NULL);
+  if (ps->s)
+    gts_surface_foreach_vertex (ps->s, 
+				(GtsFunc) gts_object_reset_reserved, NULL);
   if (ps->pos > 0)
     g_ptr_array_set_size (ps->split, ps->pos);
   if (ps->split->len > 1) {
@@ -1853,3 +2413,83 @@ void gts_psurface_close (GtsPSurface * ps)
   }
   ps->pos = 0;
 }
+
+static gboolean psurface_skip_split (BinaryInput * in, gboolean quantized,
+				     guint64 * ncf)
+{
+  guint64 x, n, i, j;
+
+  if (!get_varint (in, &x) || !get_varint (in, ncf))
+    return FALSE;
+  for (i = 0; i < 6; i++)
+    if (quantized ? !get_varint (in, &x) : !get_uint64 (in, &x))
+      return FALSE;
+  for (i = 0; i < *ncf; i++) {
+    if (!get_varint (in, &x) || !get_varint (in, &x))
+      return FALSE;
+    for (j = 0; j < 2; j++) {
+      if (!get_varint (in, &n))
+	return FALSE;
+      while (n--)
+	if (!get_varint (in, &x))
+	  return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+/**
+ * gts_psurface_lod:
+ * @ps: a #GtsPSurface opened with gts_psurface_open() from a binary file.
+ * @n: a number of vertices.
+ * @nf: return location for the number of faces or %NULL.
+ * @size: return location for a number of bytes or %NULL.
+ *
+ * Uses the index of the binary file (see gts_psurface_write_binary())
+ * to find the number of faces of @ps when it has @n vertices and the
+ * number of bytes of the file, from its beginning, containing the
+ * vertex splits needed to reach it. This can be used to read or
+ * prefetch only the part of the file needed for a given level of
+ * detail. Only a few vertex splits are scanned and none is expanded.
+ *
+ * @n is clamped to the range of the vertex numbers of @ps. This
+ * function can only be used until @ps is closed.
+ *
+ * Returns: %TRUE if successful, %FALSE if @ps was not opened from a
+ * binary file or if the file is corrupted.
+ */
+gboolean gts_psurface_lod (GtsPSurface * ps, guint n, guint * nf, gsize * size)
+{
+  GtsPSurfaceBinary * b;
+  BinaryInput in;
+  guint64 offset;
+  guint32 faces;
+  guint k, i;
+
+  g_return_val_if_fail (ps != NULL, FALSE);
+
+  if ((b = ps->binary) == NULL)
+    return FALSE;
+
+  k = CLAMP (n, ps->min, ps->min + b->ns) - ps->min;
+  in.p = b->lod + 12*(k/b->lod_step);
+  in.end = b->records;
+  if (!get_uint64 (&in, &offset) || !get_uint32 (&in, &faces) ||
+      offset > (guint64) (b->end - b->records))
+    return FALSE;
+
+  in.p = b->records + offset;
+  in.end = b->end;
+  for (i = 0; i < k % b->lod_step; i++) {
+    guint64 ncf;
+
+    if (!psurface_skip_split (&in, b->step > 0., &ncf))
+      return FALSE;
+    faces += ncf;
+  }
+  if (nf)
+    *nf = faces;
+  if (size)
+    *size = in.p - b->start;
+  return TRUE;
+}
@@ -20,10 +20,13 @@
 #include <stdlib.h>
 #include <math.h>
 #include <string.h>
+#include <locale.h>
 #include "gts.h"
 
 #include "gts-private.h"
 
+guint64 gts_topology_stamp = 0;
+
 static void destroy_foreach_face (GtsFace * f, GtsSurface * s)
 {
   f->surfaces = g_slist_remove (f->surfaces, s);
@@ -32,16 +35,32 @@ static void destroy_foreach_face (GtsFace * f, GtsSurface * s)
     gts_object_destroy (GTS_OBJECT (f));
 }
 
+static void free_arena_object (GtsObject * object)
+{
+  if (GTS_IS_VERTEX (object))
+    gts_vertex_free_segments (GTS_VERTEX (object));
+  else if (GTS_IS_EDGE (object))
+    gts_edge_free_triangles (GTS_EDGE (object));
+  else if (GTS_IS_FACE (object))
+    g_slist_free (GTS_FACE (object)->surfaces);
+}
+
 static void surface_destroy (GtsObject * object)
 {
   GtsSurface * surface = GTS_SURFACE (object);
 
-  gts_surface_foreach_face (surface, (GtsFunc) destroy_foreach_face, surface);
-#ifdef USE_SURFACE_BTREE
-  g_tree_destroy (surface->faces);
-#else /* not USE_SURFACE_BTREE */
-  g_hash_table_destroy (surface->faces);
-#endif /* not USE_SURFACE_BTREE */
+  if (surface->arena && surface->unshared)
+    /* just free the adjacency lists, the objects go with the arena */
+    gts_object_arena_foreach (surface->arena, 
+			      (GtsFunc) free_arena_object, NULL);
+  else
+    gts_surface_foreach_face (surface, (GtsFunc) destroy_foreach_face, 
+			      surface);
+  if (surface->arena)
+    gts_object_arena_destroy (surface->arena, surface->unshared);
+  g_ptr_array_free (surface->faces, TRUE);
+  if (surface->shared)
+    g_hash_table_destroy (surface->shared);
 
   (* GTS_OBJECT_CLASS (gts_surface_class ())->parent_class->destroy) (object);
 }
@@ -65,28 +84,19 @@ static void surface_class_init (GtsSurfaceClass * klass)
   klass->remove_face = NULL;
 }
 
-#ifdef USE_SURFACE_BTREE
-static gint compare_pointers (gconstpointer a, gconstpointer b)
-{
-  if (GPOINTER_TO_UINT (a) < GPOINTER_TO_UINT (b))
-    return -1;
-  if (GPOINTER_TO_UINT (a) > GPOINTER_TO_UINT (b))
-    return 1;
-  return 0;
-}
-#endif /* USE_SURFACE_BTREE */
-
 static void surface_init (GtsSurface * surface)
 {
-#ifdef USE_SURFACE_BTREE
-  surface->faces = g_tree_new (compare_pointers);
-#else /* not USE_SURFACE_BTREE */
-  surface->faces = g_hash_table_new (NULL, NULL);
-#endif /* not USE_SURFACE_BTREE */
+  surface->faces = g_ptr_array_new ();
   surface->vertex_class = gts_vertex_class ();
   surface->edge_class = gts_edge_class ();
   surface->face_class = gts_face_class ();
   surface->keep_faces = FALSE;
+  surface->arena = NULL;
+  surface->unshared = FALSE;
+  surface->shared = NULL;
+  surface->n_vertices = surface->n_edges = 0;
+  surface->counts_valid = TRUE;
+  surface->counts_stamp = gts_topology_stamp;
 }
 
 /**
@@ -138,6 +148,258 @@ GtsSurface * gts_surface_new (GtsSurfaceClass * klass,
   return s;
 }
 
+/**
+ * gts_surface_arena:
+ * @s: a #GtsSurface.
+ *
+ * Creates if necessary the arena owned by @s. The faces, edges and
+ * vertices of @s should be created while this arena is current (see
+ * gts_object_arena_set_current()), for example:
+ *
+ * <informalexample><programlisting>
+ * GtsObjectArena * previous = 
+ *   gts_object_arena_set_current (gts_surface_arena (s));
+ * gts_surface_read (s, f);
+ * gts_object_arena_set_current (previous);
+ * </programlisting></informalexample>
+ *
+ * If @s->unshared is set to %TRUE, the caller guarantees that all the
+ * faces, edges and vertices of @s have been allocated in this arena
+ * and are not used by any other object. gts_object_destroy() then
+ * releases them all at once together with the arena, rather than
+ * destroying them one by one. Otherwise the arena is freed when its
+ * last object is destroyed.
+ *
+ * The arena must not be current when @s is destroyed.
+ *
+ * Returns: the #GtsObjectArena of @s.
+ */
+GtsObjectArena * gts_surface_arena (GtsSurface * s)
+{
+  g_return_val_if_fail (s != NULL, NULL);
+
+  if (s->arena == NULL)
+    s->arena = gts_object_arena_new ();
+  return s->arena;
+}
+
+/* The faces of a surface are stored in the @faces array. The index of
+   a face in this array is kept in its @slot field. A face can belong
+   to several surfaces but has a single slot: the index of the face in
+   the other surfaces is kept in their @shared hash table. */
+
+static gboolean face_slot_is_used (GtsFace * f, GtsSurface * s)
+{
+  return ((!s->shared || !g_hash_table_lookup (s->shared, f)) &&
+	  f->slot < s->faces->len &&
+	  g_ptr_array_index (s->faces, f->slot) == f);
+}
+
+/* Returns: the index of @f in @s->faces or -1 */
+static gint face_index (GtsSurface * s, GtsFace * f)
+{
+  if (s->shared) {
+    gpointer i = g_hash_table_lookup (s->shared, f);
+
+    if (i)
+      return GPOINTER_TO_UINT (i) - 1;
+  }
+  if (f->slot < s->faces->len && g_ptr_array_index (s->faces, f->slot) == f)
+    return f->slot;
+  return -1;
+}
+
+static void face_index_set (GtsSurface * s, GtsFace * f, guint i, 
+			    gboolean shared)
+{
+  if (shared) {
+    if (!s->shared)
+      s->shared = g_hash_table_new (NULL, NULL);
+    g_hash_table_insert (s->shared, f, GUINT_TO_POINTER (i + 1));
+  }
+  else
+    f->slot = i;
+}
+
+static void faces_append (GtsSurface * s, GtsFace * f)
+{
+  GSList * i = f->surfaces;
+  gboolean shared = FALSE;
+
+  while (i && !shared) {
+    shared = face_slot_is_used (f, i->data);
+    i = i->next;
+  }
+  face_index_set (s, f, s->faces->len, shared);
+  g_ptr_array_add (s->faces, f);
+}
+
+static void faces_remove_index (GtsSurface * s, guint i)
+{
+  GtsFace * f = g_ptr_array_index (s->faces, i);
+
+  if (s->shared)
+    g_hash_table_remove (s->shared, f);
+  g_ptr_array_remove_index_fast (s->faces, i);
+  if (i < s->faces->len) {
+    /* the last face has been moved to @i */
+    GtsFace * last = g_ptr_array_index (s->faces, i);
+
+    face_index_set (s, last, i, 
+		    s->shared && g_hash_table_lookup (s->shared, last));
+  }
+}
+
+/* Cached vertex and edge numbers: they are updated incrementally by
+   gts_surface_add_face() and gts_surface_remove_face() as long as the
+   connectivity is not modified in place (see GTS_TOPOLOGY_CHANGED()),
+   in which case they are recomputed when needed. */
+
+#define COUNTS_ARE_VALID(s) ((s)->counts_valid &&\
+                             (s)->counts_stamp == gts_topology_stamp)
+
+static gboolean edge_is_used (GtsEdge * e, GtsSurface * s, GtsFace * except)
+{
+  GSList * i = e->triangles;
+
+  while (i) {
+    if (i->data != except && GTS_IS_FACE (i->data) &&
+	face_index (s, i->data) >= 0)
+      return TRUE;
+    i = i->next;
+  }
+  return FALSE;
+}
+
+static gboolean vertex_is_used (GtsVertex * v, GtsSurface * s, 
+				GtsFace * except)
+{
+  GSList * i = v->segments;
+
+  while (i) {
+    if (GTS_IS_EDGE (i->data) && edge_is_used (i->data, s, except))
+      return TRUE;
+    i = i->next;
+  }
+  return FALSE;
+}
+
+/* Adds @sign times the vertices and edges of @f which are not used by
+   any other face of @s to the counts of @s */
+static void counts_update_face (GtsSurface * s, GtsFace * f, gint sign)
+{
+  GtsTriangle * t = GTS_TRIANGLE (f);
+  GtsVertex * v1, * v2, * v3;
+
+  gts_triangle_vertices (t, &v1, &v2, &v3);
+  if (!vertex_is_used (v1, s, f))
+    s->n_vertices += sign;
+  if (v2 != v1 && !vertex_is_used (v2, s, f))
+    s->n_vertices += sign;
+  if (v3 != v1 && v3 != v2 && !vertex_is_used (v3, s, f))
+    s->n_vertices += sign;
+  if (!edge_is_used (t->e1, s, f))
+    s->n_edges += sign;
+  if (!edge_is_used (t->e2, s, f))
+    s->n_edges += sign;
+  if (!edge_is_used (t->e3, s, f))
+    s->n_edges += sign;
+}
+
+static void number_foreach (gpointer data, guint * n)
+{
+  (*n)++;
+}
+
+static void counts_update (GtsSurface * s)
+{
+  s->n_vertices = s->n_edges = 0;
+  gts_surface_foreach_vertex (s, (GtsFunc) number_foreach, &s->n_vertices);
+  gts_surface_foreach_edge (s, (GtsFunc) number_foreach, &s->n_edges);
+  s->counts_valid = TRUE;
+  s->counts_stamp = gts_topology_stamp;
+}
+
+#ifdef DEBUG_SURFACE_COUNTS
+static void counts_check (GtsSurface * s)
+{
+  if (COUNTS_ARE_VALID (s)) {
+    guint nv = s->n_vertices, ne = s->n_edges;
+
+    counts_update (s);
+    g_assert (nv == s->n_vertices);
+    g_assert (ne == s->n_edges);
+  }
+}
+#else /* not DEBUG_SURFACE_COUNTS */
+# define counts_check(s)
+#endif /* not DEBUG_SURFACE_COUNTS */
+
+/* Adds @v, its neighbors and its edges to @vertices and @edges */
+static void star_add (GtsVertex * v, GSList ** vertices, GSList ** edges)
+{
+  GSList * i = v->segments;
+
+  if (!g_slist_find (*vertices, v))
+    *vertices = g_slist_prepend (*vertices, v);
+  while (i) {
+    GtsSegment * s = i->data;
+    GtsVertex * n = s->v1 == v ? s->v2 : s->v1;
+
+    if (!g_slist_find (*vertices, n))
+      *vertices = g_slist_prepend (*vertices, n);
+    if (GTS_IS_EDGE (s) && !g_slist_find (*edges, s))
+      *edges = g_slist_prepend (*edges, s);
+    i = i->next;
+  }
+}
+
+/* Adds @sign times the number of vertices and edges of the stars of
+   @v1, @v2 and @v3 (any of which can be %NULL) used by @s to the
+   counts of @s */
+static void counts_update_stars (GtsSurface * s, gint sign,
+				 GtsVertex * v1, GtsVertex * v2, GtsVertex * v3)
+{
+  GSList * vertices = NULL, * edges = NULL, * i;
+
+  if (v1) star_add (v1, &vertices, &edges);
+  if (v2) star_add (v2, &vertices, &edges);
+  if (v3) star_add (v3, &vertices, &edges);
+  for (i = vertices; i; i = i->next)
+    if (vertex_is_used (i->data, s, NULL))
+      s->n_vertices += sign;
+  for (i = edges; i; i = i->next)
+    if (edge_is_used (i->data, s, NULL))
+      s->n_edges += sign;
+  g_slist_free (vertices);
+  g_slist_free (edges);
+}
+
+/* Local updates of the counts of @s for in place modifications of its
+   connectivity which only involve the stars of a few vertices. The
+   stars given to local_counts_end() must include what is left of the
+   stars given to local_counts_begin(). Returns %FALSE if the counts
+   of @s are not valid anyway. */
+static gboolean local_counts_begin (GtsSurface * s, 
+				    GtsVertex * v1, GtsVertex * v2)
+{
+  if (!COUNTS_ARE_VALID (s))
+    return FALSE;
+  counts_update_stars (s, -1, v1, v2, NULL);
+  /* no incremental updates while the connectivity is modified */
+  s->counts_valid = FALSE;
+  return TRUE;
+}
+
+static void local_counts_end (GtsSurface * s,
+			      GtsVertex * v1, GtsVertex * v2, GtsVertex * v3)
+{
+  counts_update_stars (s, 1, v1, v2, v3);
+  s->counts_valid = TRUE;
+  s->counts_stamp = gts_topology_stamp;
+  counts_check (s);
+}
+
 /**
  * gts_surface_add_face:
  * @s: a #GtsSurface.
@@ -152,17 +414,13 @@ void gts_surface_add_face (GtsSurface * s, GtsFace * f)
 
   g_assert (s->keep_faces == FALSE);
 
-#ifdef USE_SURFACE_BTREE
-  if (!g_tree_lookup (s->faces, f)) {
+  if (face_index (s, f) < 0) {
+    if (COUNTS_ARE_VALID (s))
+      counts_update_face (s, f, 1);
+    faces_append (s, f);
     f->surfaces = g_slist_prepend (f->surfaces, s);
-    g_tree_insert (s->faces, f, f);
+    counts_check (s);
   }
-#else /* not USE_SURFACE_BTREE */
-  if (!g_hash_table_lookup (s->faces, f)) {
-    f->surfaces = g_slist_prepend (f->surfaces, s);
-    g_hash_table_insert (s->faces, f, f);
-  }
-#endif /* not USE_SURFACE_BTREE */
 
   if (GTS_SURFACE_CLASS (GTS_OBJECT (s)->klass)->add_face)
     (* GTS_SURFACE_CLASS (GTS_OBJECT (s)->klass)->add_face) (s, f);
@@ -178,18 +436,22 @@ void gts_surface_add_face (GtsSurface * s, GtsFace * f)
 void gts_surface_remove_face (GtsSurface * s,
                               GtsFace * f)
 {
+  gint i;
+
   g_return_if_fail (s != NULL);
   g_return_if_fail (f != NULL);
 
   g_assert (s->keep_faces == FALSE);
 
-#ifdef USE_SURFACE_BTREE
-  g_tree_remove (s->faces, f);
-#else /* not USE_SURFACE_BTREE */
-  g_hash_table_remove (s->faces, f);
-#endif /* not USE_SURFACE_BTREE */
+  i = face_index (s, f);
+  if (i >= 0) {
+    if (COUNTS_ARE_VALID (s))
+      counts_update_face (s, f, -1);
+    faces_remove_index (s, i);
+  }
 
   f->surfaces = g_slist_remove (f->surfaces, s);
+  counts_check (s);
 
   if (GTS_SURFACE_CLASS (GTS_OBJECT (s)->klass)->remove_face)
     (* GTS_SURFACE_CLASS (GTS_OBJECT (s)->klass)->remove_face) (s, f);
@@ -208,13 +470,626 @@ static gboolean char_in_string (char c, const char * s)
   return FALSE;
 }
 
+/* Fast reading of surfaces in the standard GTS format from a file
+   mapped in memory (see gts_file_new_mapped()). The data is parsed
+   in place, line by line. Anything the generic #GtsFile tokenizer
+   would not parse in the same way (braces, parentheses, custom
+   tokens, binary vertices, errors...) makes the fast reader give up,
+   in which case the generic reader is used instead. */
+
+typedef struct {
+  const gchar * p, * bol, * eol, * end;
+  guint line;
+} MappedInput;
+
+#define MAPPED_BLANK(c) ((c) == ' ' || (c) == '\t')
+#define MAPPED_CHUNK_MIN (1 << 20)
+#define MAPPED_COMMENT(c) ((c) == '#' || (c) == '!')
+
+/* Moves to the first non-blank character of the next line which is
+   neither empty nor a comment */
+static gboolean mapped_line (MappedInput * in)
+{
+  while (in->p < in->end) {
+    const gchar * p = in->p;
+
+    in->bol = p;
+    if (!(in->eol = memchr (p, '\n', in->end - p)))
+      in->eol = in->end;
+    while (p < in->eol && MAPPED_BLANK (*p))
+      p++;
+    if (p < in->eol && !MAPPED_COMMENT (*p)) {
+      in->p = p;
+      return TRUE;
+    }
+    if (in->eol < in->end)
+      in->line++;
+    in->p = in->eol < in->end ? in->eol + 1 : in->end;
+  }
+  return FALSE;
+}
+
+/* Skips the rest of the current line which must not contain any
+   token with a special meaning. Comments are not allowed either as
+   the tokenizer would also skip the next line. */
+static gboolean mapped_line_end (MappedInput * in)
+{
+  const gchar * p;
+
+  for (p = in->p; p < in->eol; p++)
+    switch (*p) {
+    case '{': case '}': case '(': case ')': case '=': case '\0':
+    case '#': case '!':
+      return FALSE;
+    }
+  if (in->eol < in->end) {
+    in->line++;
+    in->p = in->eol + 1;
+  }
+  else
+    in->p = in->end;
+  return TRUE;
+}
+
+static gboolean mapped_uint (MappedInput * in, guint * v)
+{
+  const gchar * p = in->p;
+  guint64 n = 0;
+
+  while (p < in->eol && MAPPED_BLANK (*p))
+    p++;
+  /* leading zeros would be parsed as octal by strtol() */
+  if (p == in->eol || *p < '1' || *p > '9')
+    return FALSE;
+  while (p < in->eol && *p >= '0' && *p <= '9')
+    if ((n = 10*n + (*(p++) - '0')) > G_MAXUINT)
+      return FALSE;
+  if (p < in->eol && !MAPPED_BLANK (*p))
+    return FALSE;
+  *v = n;
+  in->p = p;
+  return TRUE;
+}
+
+static gboolean mapped_double (MappedInput * in, gdouble * v)
+{
+  const gchar * p = in->p;
+  gchar buf[64], * end;
+  guint n = 0;
+  gboolean digit = FALSE;
+
+  while (p < in->eol && MAPPED_BLANK (*p))
+    p++;
+  while (p < in->eol && !MAPPED_BLANK (*p)) {
+    if (*p >= '0' && *p <= '9')
+      digit = TRUE;
+    else if (*p != '+' && *p != '-' && *p != '.' && *p != 'e' && *p != 'E')
+      return FALSE;
+    if (n == sizeof (buf) - 1)
+      return FALSE;
+    buf[n++] = *(p++);
+  }
+  if (!digit)
+    return FALSE;
+  buf[n] = '\0';
+  /* same conversion as point_read(), the whole token must be a number
+     (e.g. not "1-2" or "1.0.0") */
+  *v = strtod (buf, &end);
+  if (end != buf + n)
+    return FALSE;
+  in->p = p;
+  return TRUE;
+}
+
+/* Parses the end of the header line, after the number of vertices */
+static gboolean mapped_header (MappedInput * in,
+                               GtsSurface * surface,
+                               guint * ne, guint * nf,
+                               gboolean * classes)
+{
+  guint ntoken = 0;
+  gboolean binary = FALSE;
+
+  in->bol = in->p;
+  if (!(in->eol = memchr (in->p, '\n', in->end - in->p)))
+    in->eol = in->end;
+  if (!mapped_uint (in, ne) || !mapped_uint (in, nf))
+    return FALSE;
+  /* optional class names */
+  for (;;) {
+    const gchar * p = in->p, * start;
+    gboolean string = FALSE;
+
+    while (p < in->eol && MAPPED_BLANK (*p))
+      p++;
+    if (p == in->eol || MAPPED_COMMENT (*p))
+      break;
+    if (!((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z')))
+      return FALSE;
+    start = p;
+    while (p < in->eol && !MAPPED_BLANK (*p)) {
+      if (!((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z') ||
+            (*p >= '0' && *p <= '9') || *p == '_'))
+        return FALSE;
+      if (!strchr ("0123456789eE", *p))
+        string = TRUE;
+      p++;
+    }
+    if (!string)
+      return FALSE;
+    if (++ntoken == 4)
+      binary = (p - start == 15 && !strncmp (start, "GtsVertexBinary", 15));
+    in->p = p;
+  }
+  if ((ntoken > 0 && ntoken < 4) || binary ||
+      (ntoken == 0 && GTS_POINT_CLASS (surface->vertex_class)->binary))
+    return FALSE;
+  *classes = (ntoken > 0);
+  return mapped_line_end (in);
+}
+
+/* A chunk of the records (vertices, edges and faces) of a mapped file */
+typedef struct {
+  const gchar * start, * end;
+  guint nr, nl;           /* number of records and lines of the chunk */
+  guint record, line;     /* index of the first record and line */
+  guint nv, ne, nf;
+  gdouble * coords;
+  guint * indices;
+  gboolean failed;
+  const gchar * last, * last_bol; /* end of the last edge index */
+  guint last_line;
+} MappedChunk;
+
+static gpointer mapped_chunk_count (MappedChunk * c)
+{
+  const gchar * p = c->start, * eol;
+
+  c->nr = c->nl = 0;
+  while (p < c->end) {
+    if (!(eol = memchr (p, '\n', c->end - p)))
+      eol = c->end;
+    else
+      c->nl++;
+    while (p < eol && MAPPED_BLANK (*p))
+      p++;
+    if (p < eol && !MAPPED_COMMENT (*p))
+      c->nr++;
+    p = eol + 1;
+  }
+  return NULL;
+}
+
+static gpointer mapped_chunk_parse (MappedChunk * c)
+{
+  MappedInput in;
+  guint r = c->record, nr = c->nv + c->ne + c->nf;
+
+  in.p = c->start;
+  in.end = c->end;
+  in.line = c->line;
+  c->failed = TRUE;
+  while (r < nr && mapped_line (&in)) {
+    guint * i = c->indices;
+
+    if (r < c->nv) {
+      gdouble * x = c->coords + 3*(gsize) r;
+
+      if (!mapped_double (&in, &x[0]) ||
+          !mapped_double (&in, &x[1]) ||
+          !mapped_double (&in, &x[2]))
+        return NULL;
+    }
+    else if (r < c->nv + c->ne) {
+      i += 2*(gsize) (r - c->nv);
+      if (!mapped_uint (&in, &i[0]) || i[0] > c->nv ||
+          !mapped_uint (&in, &i[1]) || i[1] > c->nv)
+        return NULL;
+    }
+    else {
+      i += 2*(gsize) c->ne + 3*(gsize) (r - c->nv - c->ne);
+      if (!mapped_uint (&in, &i[0]) || i[0] > c->ne ||
+          !mapped_uint (&in, &i[1]) || i[1] > c->ne ||
+          !mapped_uint (&in, &i[2]) || i[2] > c->ne)
+        return NULL;
+      if (r == nr - 1) {
+        c->last = in.p;
+        c->last_bol = in.bol;
+        c->last_line = in.line;
+      }
+    }
+    if (!mapped_line_end (&in))
+      return NULL;
+    r++;
+  }
+  c->failed = FALSE;
+  return NULL;
+}
+
+/* Returns the end of the @k-th of @n chunks of [@start,@end) split at
+   newline boundaries, @prev being the end of the previous chunk */
+static const gchar * mapped_chunk_end (const gchar * start,
+                                       const gchar * end,
+                                       const gchar * prev,
+                                       guint k, guint n)
+{
+  const gchar * p = start + (end - start)/n*(k + 1);
+
+  if (k == n - 1)
+    return end;
+  if (p < prev)
+    return prev;
+  if (!(p = memchr (p, '\n', end - p)))
+    return end;
+  return p + 1;
+}
+
+/* Number of threads to use to parse @length bytes of @f */
+static guint mapped_threads (GtsFile * f, gsize length)
+{
+  guint n = f->map->threads ? f->map->threads : g_get_num_processors ();
+
+  /* not worth it for small files */
+  return MIN (n, length/MAPPED_CHUNK_MIN + 1);
+}
+
+/* Splits the records of @in into @n chunks parsed concurrently */
+static gboolean mapped_parse_threads (MappedInput * in, MappedChunk * model,
+                                      guint n)
+{
+  MappedChunk * c = g_malloc (n*sizeof (MappedChunk));
+  GThread ** threads = g_malloc (n*sizeof (GThread *));
+  guint k, record = 0, line = in->line;
+  gboolean failed = FALSE;
+
+  for (k = 0; k < n; k++) {
+    c[k] = *model;
+    c[k].start = k > 0 ? c[k - 1].end : in->p;
+    c[k].end = mapped_chunk_end (in->p, in->end, c[k].start, k, n);
+  }
+
+  for (k = 0; k < n; k++)
+    threads[k] = g_thread_new ("gts-read", 
+                               (GThreadFunc) mapped_chunk_count, &c[k]);
+  for (k = 0; k < n; k++) {
+    g_thread_join (threads[k]);
+    c[k].record = record;
+    c[k].line = line;
+    record += c[k].nr;
+    line += c[k].nl;
+  }
+  if (record < model->nv + model->ne + model->nf)
+    failed = TRUE;
+  else {
+    for (k = 0; k < n; k++)
+      threads[k] = g_thread_new ("gts-read", 
+                                 (GThreadFunc) mapped_chunk_parse, &c[k]);
+    for (k = 0; k < n; k++) {
+      g_thread_join (threads[k]);
+      if (c[k].failed)
+        failed = TRUE;
+      if (c[k].last)
+        *model = c[k];
+    }
+  }
+
+  g_free (threads);
+  g_free (c);
+  return !failed && model->last != NULL;
+}
+
+static gboolean surface_read_mapped (GtsSurface * surface, GtsFile * f)
+{
+  MappedInput in;
+  MappedChunk c;
+  GtsVertex ** vertices;
+  GtsEdge ** edges;
+  guint n, * i, nthreads;
+  gboolean classes, parsed;
+
+  if (f->ftype != GTS_FILE_GTS || f->type != GTS_INT ||
+      f->next_token != '\0' || f->curline != f->line ||
+      f->s == f->map->start || !MAPPED_BLANK (f->s[-1]))
+    return FALSE;
+  /* the classes must not read any additional data */
+  if (GTS_OBJECT_CLASS (surface->vertex_class)->read !=
+      GTS_OBJECT_CLASS (gts_vertex_class ())->read ||
+      GTS_OBJECT_CLASS (surface->edge_class)->read ||
+      GTS_OBJECT_CLASS (surface->face_class)->read)
+    return FALSE;
+
+  in.p = f->s;
+  in.end = f->map->end;
+  in.line = f->curline;
+  c.nv = strtol (f->token->str, NULL, 0);
+  if (!mapped_header (&in, surface, &c.ne, &c.nf, &classes) || c.nf == 0 ||
+      /* each record needs at least two bytes */
+      2*((guint64) c.nv + c.ne + c.nf) > (guint64) (in.end - in.p) + 1 ||
+      (guint64) c.nv + c.ne + c.nf > G_MAXUINT)
+    return FALSE;
+
+  /* the records are first parsed into arrays... */
+  c.coords = g_malloc ((3*(gsize) c.nv + 1)*sizeof (gdouble));
+  c.indices = g_malloc ((2*(gsize) c.ne + 3*(gsize) c.nf)*sizeof (guint));
+  c.last = NULL;
+  nthreads = mapped_threads (f, in.end - in.p);
+  if (nthreads > 1)
+    parsed = mapped_parse_threads (&in, &c, nthreads);
+  else {
+    c.start = in.p;
+    c.end = in.end;
+    c.record = 0;
+    c.line = in.line;
+    mapped_chunk_parse (&c);
+    parsed = !c.failed && c.last != NULL;
+  }
+  if (!parsed) {
+    g_free (c.coords);
+    g_free (c.indices);
+    return FALSE;
+  }
+
+  /* ... then the topology is built in one pass */
+  vertices = g_malloc ((c.nv + 1)*sizeof (GtsVertex *));
+  edges = g_malloc ((c.ne + 1)*sizeof (GtsEdge *));
+  for (n = 0; n < c.nv; n++)
+    vertices[n] = gts_vertex_new (surface->vertex_class,
+                                  c.coords[3*n],
+                                  c.coords[3*n + 1],
+                                  c.coords[3*n + 2]);
+  for (n = 0, i = c.indices; n < c.ne; n++, i += 2)
+    edges[n] = gts_edge_new (surface->edge_class,
+                             vertices[i[0] - 1], vertices[i[1] - 1]);
+  for (n = 0; n < c.nf; n++, i += 3)
+    gts_surface_add_face (surface, 
+                          gts_face_new (surface->face_class,
+                                        edges[i[0] - 1],
+                                        edges[i[1] - 1],
+                                        edges[i[2] - 1]));
+  g_free (vertices);
+  g_free (edges);
+  g_free (c.coords);
+  g_free (c.indices);
+
+  if (classes)
+    GTS_POINT_CLASS (surface->vertex_class)->binary = FALSE;
+  /* resume tokenizing after the last edge index of the last face, as
+     if it had just been read by the generic reader */
+  f->line = f->curline = c.last_line;
+  f->s = (gchar *) c.last;
+  f->curpos = c.last - c.last_bol + 1;
+  while (c.last > c.last_bol && !MAPPED_BLANK (c.last[-1]))
+    c.last--;
+  f->pos = c.last - c.last_bol + 1;
+  g_string_truncate (f->token, 0);
+  g_string_append_len (f->token, c.last, f->s - c.last);
+  gts_file_next_token (f);
+  gts_file_first_token_after (f, '\n');
+  return TRUE;
+}
+
+/* Binary format, see gts_surface_write_binary() */
+
+#define BINARY_SIGNATURE "GtsSurfaceBinary"
+#define BINARY_VERSION   1
+#define BINARY_TAG(a, b, c, d) ((guint32) (a) | ((guint32) (b) << 8) |\
+				((guint32) (c) << 16) | ((guint32) (d) << 24))
+#define BINARY_COLOR     BINARY_TAG ('C', 'O', 'L', 'R')
+#define BINARY_NORMAL    BINARY_TAG ('N', 'O', 'R', 'M')
+
+static guint32 binary_get_uint32 (const guchar * p)
+{
+  return ((guint32) p[0] | ((guint32) p[1] << 8) |
+	  ((guint32) p[2] << 16) | ((guint32) p[3] << 24));
+}
+
+static gdouble binary_get_double (const guchar * p)
+{
+  union { guint64 i; gdouble d; } u;
+
+  u.i = (binary_get_uint32 (p) | 
+	 ((guint64) binary_get_uint32 (p + 4) << 32));
+  return u.d;
+}
+
+static gfloat binary_get_float (const guchar * p)
+{
+  union { guint32 i; gfloat f; } u;
+
+  u.i = binary_get_uint32 (p);
+  return u.f;
+}
+
+/* Size in bytes of the chunks in which blocks are read when the
+   length of the file is not known */
+#define BINARY_CHUNK (1 << 20)
+
+/* Returns a pointer to the next @n elements of @size bytes of @f or
+   %NULL if @f is too short. If @f is mapped in memory the data is not
+   copied, otherwise it is read into *@buf which must be freed. As @n
+   comes from the file, the buffer is grown as the data is actually
+   read rather than allocated at once. */
+static const guchar * binary_block (GtsFile * f, 
+				    guint size, guint n,
+				    guchar ** buf)
+{
+  const guchar * p;
+  guint chunk, read = 0;
+  gsize length = 0;
+
+  *buf = NULL;
+  if (f->map) {
+    if ((guint64) size*n > (guint64) (f->map->end - f->s))
+      return NULL;
+    p = (const guchar *) f->s;
+    f->s += (gsize) size*n;
+    return p;
+  }
+  chunk = MAX (BINARY_CHUNK/size, 1);
+  *buf = g_malloc (1);
+  while (read < n) {
+    guint m = MIN (n - read, chunk);
+
+    if ((gsize) size*(read + m) > length) {
+      length = MAX ((gsize) size*(read + m), 2*length);
+      length = MIN (length, (gsize) size*n);
+      *buf = g_realloc (*buf, length + 1);
+    }
+    if (gts_file_read (f, *buf + (gsize) size*read, size, m) != m) {
+      g_free (*buf);
+      *buf = NULL;
+      return NULL;
+    }
+    read += m;
+  }
+  return *buf;
+}
+
+static void surface_read_binary (GtsSurface * surface, GtsFile * f)
+{
+  GtsVertex ** vertices = NULL;
+  GtsEdge ** edges = NULL;
+  const guchar * p;
+  guchar * buf;
+  guint32 nv = 0, ne, nf, nb, i;
+
+  if (f->next_token != '\n' || (f->fp == NULL && f->map == NULL)) {
+    gts_file_error (f, "malformed binary signature");
+    return;
+  }
+  f->next_token = '\0';
+
+  if (!(p = binary_block (f, 4, 5, &buf))) {
+    gts_file_error (f, "unexpected end of file (binary header)");
+    return;
+  }
+  if (binary_get_uint32 (p) != BINARY_VERSION) {
+    gts_file_error (f, "unsupported binary format version `%u'",
+		    binary_get_uint32 (p));
+    g_free (buf);
+    return;
+  }
+  nv = binary_get_uint32 (p + 4);
+  ne = binary_get_uint32 (p + 8);
+  nf = binary_get_uint32 (p + 12);
+  nb = binary_get_uint32 (p + 16);
+  g_free (buf);
+
+  /* vertices */
+  if (!(p = binary_block (f, 24, nv, &buf))) {
+    gts_file_error (f, "unexpected end of file (vertex block)");
+    return;
+  }
+  vertices = g_malloc ((nv + 1)*sizeof (GtsVertex *));
+  for (i = 0; i < nv; i++, p += 24)
+    vertices[i] = gts_vertex_new (surface->vertex_class,
+				  binary_get_double (p),
+				  binary_get_double (p + 8),
+				  binary_get_double (p + 16));
+  g_free (buf);
+
+  /* edges */
+  if (!(p = binary_block (f, 8, ne, &buf)))
+    gts_file_error (f, "unexpected end of file (edge block)");
+  else {
+    edges = g_malloc ((ne + 1)*sizeof (GtsEdge *));
+    for (i = 0; i < ne && f->type != GTS_ERROR; i++, p += 8) {
+      guint32 v1 = binary_get_uint32 (p), v2 = binary_get_uint32 (p + 4);
+
+      if (v1 >= nv || v2 >= nv || v1 == v2)
+	gts_file_error (f, "invalid vertex indices `%u %u' for edge `%u'",
+			v1, v2, i);
+      else
+	edges[i] = gts_edge_new (surface->edge_class, 
+				 vertices[v1], vertices[v2]);
+    }
+    g_free (buf);
+  }
+
+  /* faces */
+  if (f->type != GTS_ERROR) {
+    if (!(p = binary_block (f, 12, nf, &buf)))
+      gts_file_error (f, "unexpected end of file (face block)");
+    else {
+      for (i = 0; i < nf && f->type != GTS_ERROR; i++, p += 12) {
+	guint32 e1 = binary_get_uint32 (p), e2 = binary_get_uint32 (p + 4);
+	guint32 e3 = binary_get_uint32 (p + 8);
+
+	if (e1 >= ne || e2 >= ne || e3 >= ne)
+	  gts_file_error (f, "invalid edge indices `%u %u %u' for face `%u'",
+			  e1, e2, e3, i);
+	else
+	  gts_surface_add_face (surface,
+				gts_face_new (surface->face_class,
+					      edges[e1], edges[e2], edges[e3]));
+      }
+      g_free (buf);
+    }
+  }
+
+  /* attributes */
+  while (nb-- && f->type != GTS_ERROR) {
+    guint32 tag, target, size, n;
+
+    if (!(p = binary_block (f, 4, 3, &buf))) {
+      gts_file_error (f, "unexpected end of file (attribute block header)");
+      break;
+    }
+    tag = binary_get_uint32 (p);
+    target = binary_get_uint32 (p + 4);
+    size = binary_get_uint32 (p + 8);
+    g_free (buf);
+    n = target == 0 ? nv : target == 1 ? ne : nf;
+    if (target > 2 || !(p = binary_block (f, size, n, &buf))) {
+      gts_file_error (f, "malformed attribute block");
+      break;
+    }
+    if (target == 0 && tag == BINARY_COLOR && size == 12 &&
+	gts_object_class_is_from_class (surface->vertex_class,
+					gts_color_vertex_class ()))
+      for (i = 0; i < nv; i++, p += 12) {
+	GtsColor * c = &GTS_COLOR_VERTEX (vertices[i])->c;
+
+	c->r = binary_get_float (p);
+	c->g = binary_get_float (p + 4);
+	c->b = binary_get_float (p + 8);
+      }
+    else if (target == 0 && tag == BINARY_NORMAL && size == 24 &&
+	     gts_object_class_is_from_class (surface->vertex_class,
+					     gts_vertex_normal_class ()))
+      for (i = 0; i < nv; i++, p += 24) {
+	GtsVertexNormal * v = GTS_VERTEX_NORMAL (vertices[i]);
+
+	v->n[0] = binary_get_double (p);
+	v->n[1] = binary_get_double (p + 8);
+	v->n[2] = binary_get_double (p + 16);
+      }
+    /* unknown attributes are ignored */
+    g_free (buf);
+  }
+
+  if (f->type == GTS_ERROR) {
+    gts_allow_floating_vertices = TRUE;
+    while (nv)
+      gts_object_destroy (GTS_OBJECT (vertices[nv-- - 1]));
+    gts_allow_floating_vertices = FALSE;
+  }
+  else
+    gts_file_next_token (f);
+
+  g_free (vertices);
+  g_free (edges);
+}
+
 /**
  * gts_surface_read:
  * @surface: a #GtsSurface.
  * @f: a #GtsFile.
  *
  * Add to @surface the data read from @f. The format of the file pointed to
- * by @f is as described in gts_surface_write().
+ * by @f is as described in gts_surface_write() or
+ * gts_surface_write_binary(). Binary files are recognized
+ * automatically.
  *
  * Returns: 0 if successful or the line number at which the parsing
  * stopped in case of error (in which case the @error field of @f is
@@ -325,6 +1200,12 @@ guint gts_surface_read (GtsSurface * surface, GtsFile * f)
 
     return 0;
   }
+  if (f->map && surface_read_mapped (surface, f))
+    return 0;
+  if (f->type == GTS_STRING && !strcmp (f->token->str, BINARY_SIGNATURE)) {
+    surface_read_binary (surface, f);
+    return f->type == GTS_ERROR ? f->line : 0;
+  }
   if (f->type != GTS_INT) {
     gts_file_error (f, "expecting an integer (number of vertices)");
     return f->line;
@@ -508,368 +1389,2526 @@ guint gts_surface_read (GtsSurface * surface, GtsFile * f)
   return 0;
 }
 
+/* Building surfaces from indexed triangles */
+
+typedef struct {
+  GtsEdge * e;
+  guint other, next;
+} BuilderEdge;
+
+typedef struct {
+  GtsSurface * s;
+  GtsVertex ** v;
+  guint nv;
+  /* the edges are stored in linked lists attached to their vertex of
+     smallest index, head[i] is 1 + the index of the first edge of
+     vertex i or 0 */
+  guint * head;
+  GArray * edges;
+} SurfaceBuilder;
+
+static void surface_builder_init (SurfaceBuilder * b, GtsSurface * s,
+                                  GtsVertex ** v, guint nv)
+{
+  b->s = s;
+  b->v = v;
+  b->nv = nv;
+  b->head = g_malloc0 ((nv + 1)*sizeof (guint));
+  b->edges = g_array_new (FALSE, FALSE, sizeof (BuilderEdge));
+}
+
+static GtsEdge * surface_builder_edge (SurfaceBuilder * b, guint v1, guint v2)
+{
+  guint a = MIN (v1, v2), c = MAX (v1, v2), k = b->head[a];
+  BuilderEdge e;
+
+  while (k) {
+    BuilderEdge * i = &g_array_index (b->edges, BuilderEdge, k - 1);
+
+    if (i->other == c)
+      return i->e;
+    k = i->next;
+  }
+  e.e = gts_edge_new (b->s->edge_class, b->v[v1], b->v[v2]);
+  e.other = c;
+  e.next = b->head[a];
+  g_array_append_val (b->edges, e);
+  b->head[a] = b->edges->len;
+  return e.e;
+}
+
+/* Adds to the surface the face defined by the (valid) vertex indices
+   @v1, @v2 and @v3, unless it is degenerate */
+static void surface_builder_face (SurfaceBuilder * b, 
+                                  guint v1, guint v2, guint v3)
+{
+  GtsEdge * e1, * e2, * e3;
+
+  if (v1 == v2 || v2 == v3 || v3 == v1)
+    return;
+  e1 = surface_builder_edge (b, v1, v2);
+  e2 = surface_builder_edge (b, v2, v3);
+  e3 = surface_builder_edge (b, v3, v1);
+  gts_surface_add_face (b->s, gts_face_new (b->s->face_class, e1, e2, e3));
+}
+
+/* Frees the memory allocated for @b and destroys the vertices which
+   are not used by any face */
+static void surface_builder_free (SurfaceBuilder * b)
+{
+  guint i;
+
+  for (i = 0; i < b->nv; i++)
+    if (b->v[i]->segments == NULL)
+      gts_object_destroy (GTS_OBJECT (b->v[i]));
+  g_free (b->head);
+  g_array_free (b->edges, TRUE);
+}
+
+/* Building surfaces from arrays. The half-edges of the triangles
+   (identified by their "corner", 3*triangle + 0, 1 or 2) are sorted
+   in buckets according to their vertex of smallest index. The
+   duplicates are then looked for in each bucket, independently. */
+
+#define CORNER_NEXT(c)     ((c) % 3 == 2 ? (c) - 2 : (c) + 1)
+#define CORNER_MIN(t, c)   MIN ((t)[c], (t)[CORNER_NEXT (c)])
+#define CORNER_MAX(t, c)   MAX ((t)[c], (t)[CORNER_NEXT (c)])
+#define ARRAYS_BUCKET_SCAN 16
+#define ARRAYS_CHUNK_MIN   65536
+
+typedef struct {
+  const guint * t;
+  const gsize * start, * corner;
+  guint * edge;
+  gsize * first;
+  guint v1, v2;      /* the range of buckets of the chunk */
+  guint ne, offset;
+} EdgeChunk;
+
+static gint compare_guint64 (const void * a, const void * b)
+{
+  guint64 x = *((guint64 *) a), y = *((guint64 *) b);
+
+  return x < y ? -1 : x > y;
+}
+
+/* Sets the local index of the edge of each corner of the chunk */
+static gpointer edge_chunk_number (EdgeChunk * c)
+{
+  GArray * keys = g_array_new (FALSE, FALSE, sizeof (guint64));
+  guint a;
+
+  c->ne = 0;
+  for (a = c->v1; a < c->v2; a++) {
+    const gsize * corner = c->corner + c->start[a];
+    guint n = c->start[a + 1] - c->start[a], i, j;
+
+    if (n <= ARRAYS_BUCKET_SCAN)
+      for (i = 0; i < n; i++) {
+	guint b = CORNER_MAX (c->t, corner[i]);
+
+	for (j = 0; j < i && CORNER_MAX (c->t, corner[j]) != b; j++)
+	  ;
+	c->edge[corner[i]] = j < i ? c->edge[corner[j]] : c->ne++;
+      }
+    else {
+      guint64 * k;
+
+      /* large bucket (fan), sorted by second vertex */
+      g_array_set_size (keys, n);
+      k = (guint64 *) keys->data;
+      for (i = 0; i < n; i++)
+	k[i] = ((guint64) CORNER_MAX (c->t, corner[i]) << 32) | i;
+      qsort (k, n, sizeof (guint64), compare_guint64);
+      for (i = 0; i < n; i++) {
+	if (i == 0 || (k[i] >> 32) != (k[i - 1] >> 32))
+	  c->ne++;
+	c->edge[corner[k[i] & 0xffffffff]] = c->ne - 1;
+      }
+    }
+  }
+  g_array_free (keys, TRUE);
+  return NULL;
+}
+
+/* Sets the global index of the edge of each corner of the chunk and
+   the first corner of each edge */
+static gpointer edge_chunk_offset (EdgeChunk * c)
+{
+  gsize i;
+
+  for (i = c->start[c->v1]; i < c->start[c->v2]; i++) {
+    guint e = (c->edge[c->corner[i]] += c->offset);
+
+    if (c->first[e] == G_MAXSIZE)
+      c->first[e] = c->corner[i];
+  }
+  return NULL;
+}
+
+static void edge_chunks_run (EdgeChunk * c, guint n, GThreadFunc func)
+{
+  if (n == 1)
+    (* func) (c);
+  else {
+    GThread ** threads = g_malloc (n*sizeof (GThread *));
+    guint k;
+
+    for (k = 0; k < n; k++)
+      threads[k] = g_thread_new ("gts-edges", func, &c[k]);
+    for (k = 0; k < n; k++)
+      g_thread_join (threads[k]);
+    g_free (threads);
+  }
+}
+
+/* Adds to @s the non-degenerate triangles of @t, the vertex indices
+   of which are valid indices in @xyz. Only the vertices used by these
+   triangles are created. */
+static void surface_add_arrays (GtsSurface * s, 
+				const gdouble * xyz, guint nv,
+				const guint * t, guint nt,
+				guint threads)
+{
+  gsize * start = g_malloc0 ((nv + 2)*sizeof (gsize));
+  gsize * corner, * first, j, k;
+  guint * edge;
+  GtsVertex ** v;
+  GtsEdge ** e;
+  EdgeChunk * c;
+  guint i, n, ne, nused = 0;
+  gboolean counts;
+
+  /* bucket sort of the corners of the non-degenerate triangles, @j
+     being the first corner of triangle @i */
+  for (i = 0, j = 0; i < nt; i++, j += 3)
+    if (t[j] != t[j + 1] && t[j + 1] != t[j + 2] && t[j + 2] != t[j])
+      for (k = j; k < j + 3; k++)
+	start[CORNER_MIN (t, k) + 2]++;
+  for (i = 2; i < nv + 2; i++)
+    start[i] += start[i - 1];
+  corner = g_malloc ((start[nv + 1] + 1)*sizeof (gsize));
+  for (i = 0, j = 0; i < nt; i++, j += 3)
+    if (t[j] != t[j + 1] && t[j + 1] != t[j + 2] && t[j + 2] != t[j])
+      for (k = j; k < j + 3; k++)
+	corner[start[CORNER_MIN (t, k) + 1]++] = k;
+
+  /* numbering of the edges, by chunks of buckets of similar sizes */
+  n = threads ? threads : g_get_num_processors ();
+  n = MAX (1, MIN (n, start[nv]/ARRAYS_CHUNK_MIN + 1));
+  edge = g_malloc ((3*(gsize) nt + 1)*sizeof (guint));
+  memset (edge, 0xff, 3*(gsize) nt*sizeof (guint));
+  c = g_malloc (n*sizeof (EdgeChunk));
+  for (k = 0; k < n; k++) {
+    c[k].t = t;
+    c[k].start = start;
+    c[k].corner = corner;
+    c[k].edge = edge;
+    c[k].v1 = k > 0 ? c[k - 1].v2 : 0;
+    c[k].v2 = c[k].v1;
+    while (c[k].v2 < nv && 
+	   (k == n - 1 || start[c[k].v2] < (guint64) start[nv]*(k + 1)/n))
+      c[k].v2++;
+  }
+  edge_chunks_run (c, n, (GThreadFunc) edge_chunk_number);
+  for (k = 0, ne = 0; k < n; k++) {
+    c[k].offset = ne;
+    ne += c[k].ne;
+  }
+  first = g_malloc ((ne + 1)*sizeof (gsize));
+  memset (first, 0xff, ne*sizeof (gsize));
+  for (k = 0; k < n; k++)
+    c[k].first = first;
+  edge_chunks_run (c, n, (GThreadFunc) edge_chunk_offset);
+  g_free (c);
+
+  /* creation of the objects */
+  v = g_malloc0 ((nv + 1)*sizeof (GtsVertex *));
+  for (i = 0, j = 0; i < nt; i++, j += 3)
+    if (edge[j] != G_MAXUINT)
+      for (k = j; k < j + 3; k++)
+	v[t[k]] = GUINT_TO_POINTER (1);
+  for (i = 0; i < nv; i++)
+    if (v[i]) {
+      nused++;
+      v[i] = gts_vertex_new (s->vertex_class, 
+			     xyz[3*i], xyz[3*i + 1], xyz[3*i + 2]);
+    }
+  e = g_malloc ((ne + 1)*sizeof (GtsEdge *));
+  for (i = 0; i < ne; i++)
+    e[i] = gts_edge_new (s->edge_class, 
+			 v[t[first[i]]], v[t[CORNER_NEXT (first[i])]]);
+  /* the counts of @s are updated at once, all the vertices and edges
+     being new */
+  counts = COUNTS_ARE_VALID (s);
+  s->counts_valid = FALSE;
+  for (i = 0, j = 0; i < nt; i++, j += 3)
+    if (edge[j] != G_MAXUINT)
+      gts_surface_add_face (s, gts_face_new (s->face_class, e[edge[j]],
+					     e[edge[j + 1]],
+					     e[edge[j + 2]]));
+
+  if (counts && s->counts_stamp == gts_topology_stamp) {
+    s->n_vertices += nused;
+    s->n_edges += ne;
+    s->counts_valid = TRUE;
+  }
+  g_free (start);
+  g_free (corner);
+  g_free (edge);
+  g_free (first);
+  g_free (v);
+  g_free (e);
+}
+
+static gboolean indices_are_valid (const guint * t, gsize n, guint nv)
+{
+  gsize i;
+
+  for (i = 0; i < n; i++)
+    if (t[i] >= nv)
+      return FALSE;
+  return TRUE;
+}
+
+/**
+ * gts_surface_new_from_arrays:
+ * @klass: a #GtsSurfaceClass.
+ * @face_class: a #GtsFaceClass.
+ * @edge_class: a #GtsEdgeClass.
+ * @vertex_class: a #GtsVertexClass.
+ * @xyz: the coordinates of the vertices (three per vertex).
+ * @nv: the number of vertices.
+ * @triangles: the indices of the vertices of the triangles (three per
+ * triangle).
+ * @nt: the number of triangles.
+ * @threads: the number of threads to use or 0 for one per processor.
+ *
+ * Builds a new surface made of the triangles defined by @xyz and
+ * @triangles, much faster than by creating each face in turn. The
+ * edges shared by several triangles are found by sorting the edges
+ * according to their vertices, using @threads threads, and all the
+ * objects are allocated in the arena of the surface (see
+ * gts_surface_arena()).
+ *
+ * The faces are oriented according to the order of their vertex
+ * indices. Degenerate triangles are ignored, as are the vertices
+ * which do not belong to any triangle.
+ *
+ * Returns: a new #GtsSurface.
+ */
+GtsSurface * gts_surface_new_from_arrays (GtsSurfaceClass * klass,
+					  GtsFaceClass * face_class,
+					  GtsEdgeClass * edge_class,
+					  GtsVertexClass * vertex_class,
+					  const gdouble * xyz, guint nv,
+					  const guint * triangles, guint nt,
+					  guint threads)
+{
+  GtsObjectArena * previous;
+  GtsSurface * s;
+
+  g_return_val_if_fail (klass != NULL, NULL);
+  g_return_val_if_fail (face_class != NULL, NULL);
+  g_return_val_if_fail (edge_class != NULL, NULL);
+  g_return_val_if_fail (vertex_class != NULL, NULL);
+  g_return_val_if_fail (xyz != NULL || nv == 0, NULL);
+  g_return_val_if_fail (triangles != NULL || nt == 0, NULL);
+  g_return_val_if_fail (indices_are_valid (triangles, 3*(gsize) nt, nv),
+			NULL);
+
+  s = gts_surface_new (klass, face_class, edge_class, vertex_class);
+  previous = gts_object_arena_set_current (gts_surface_arena (s));
+  surface_add_arrays (s, xyz, nv, triangles, nt, threads);
+  gts_object_arena_set_current (previous);
+
+  return s;
+}
+
+/* STL files */
+
+/* Whether the @length bytes at @p are a binary STL file. ASCII files
+   start with "solid" but so do some binary files. */
+static gboolean stl_is_binary (const guchar * p, gsize length)
+{
+  if (length >= 84 &&
+      84 + 50*(guint64) binary_get_uint32 (p + 80) == length)
+    return TRUE;
+  return length < 5 || strncmp ((const gchar *) p, "solid", 5);
+}
+
+typedef struct {
+  const gchar * start, * end;
+  GArray * coords;
+  guint nl;                /* number of lines of the chunk */
+  gboolean endsolid;
+  const gchar * error;
+  guint error_line, error_pos;
+} StlChunk;
+
+static gpointer stl_chunk_parse (StlChunk * c)
+{
+  static const gchar * error[3] = {
+    "expecting a number (x coordinate)",
+    "expecting a number (y coordinate)",
+    "expecting a number (z coordinate)"
+  };
+  const gchar * p = c->start;
+
+  while (p < c->end) {
+    MappedInput in;
+    const gchar * w;
+
+    in.bol = p;
+    in.end = c->end;
+    if (!(in.eol = memchr (p, '\n', c->end - p)))
+      in.eol = c->end;
+    while (in.eol > p && in.eol[-1] == '\r')
+      in.eol--;
+    while (p < in.eol && MAPPED_BLANK (*p))
+      p++;
+    w = p;
+    while (p < in.eol && !MAPPED_BLANK (*p))
+      p++;
+    if (p - w == 6 && !strncmp (w, "vertex", 6)) {
+      gdouble x[3];
+      guint i;
+
+      in.p = p;
+      for (i = 0; i < 3; i++)
+        if (!mapped_double (&in, &x[i])) {
+          while (in.p < in.eol && MAPPED_BLANK (*in.p))
+            in.p++;
+          c->error = error[i];
+          c->error_line = c->nl;
+          c->error_pos = in.p - in.bol + 1;
+          return NULL;
+        }
+      g_array_append_vals (c->coords, x, 3);
+    }
+    else if (p - w == 8 && !strncmp (w, "endsolid", 8)) {
+      c->endsolid = TRUE;
+      return NULL;
+    }
+    if (!(p = memchr (p, '\n', c->end - p)))
+      break;
+    c->nl++;
+    p++;
+  }
+  return NULL;
+}
+
+static GArray * stl_read_ascii (GtsFile * f)
+{
+  const gchar * start = f->map->start, * end = f->map->end;
+  guint n = mapped_threads (f, end - start), k, line = 1;
+  StlChunk * c = g_malloc0 (n*sizeof (StlChunk));
+  GArray * coords = NULL;
+
+  for (k = 0; k < n; k++) {
+    c[k].start = k > 0 ? c[k - 1].end : start;
+    c[k].end = mapped_chunk_end (start, end, c[k].start, k, n);
+    c[k].coords = g_array_new (FALSE, FALSE, sizeof (gdouble));
+  }
+  if (n > 1) {
+    GThread ** threads = g_malloc (n*sizeof (GThread *));
+
+    for (k = 0; k < n; k++)
+      threads[k] = g_thread_new ("gts-read", 
+                                 (GThreadFunc) stl_chunk_parse, &c[k]);
+    for (k = 0; k < n; k++)
+      g_thread_join (threads[k]);
+    g_free (threads);
+  }
+  else
+    stl_chunk_parse (c);
+
+  /* the chunks following the first error or "endsolid" are ignored */
+  for (k = 0; k < n; k++) {
+    if (c[k].error) {
+      f->line = line + c[k].error_line;
+      f->pos = c[k].error_pos;
+      gts_file_error (f, c[k].error);
+      break;
+    }
+    if (coords == NULL) {
+      coords = c[k].coords;
+      c[k].coords = NULL;
+    }
+    else
+      g_array_append_vals (coords, c[k].coords->data, c[k].coords->len);
+    if (c[k].endsolid)
+      break;
+    line += c[k].nl;
+  }
+
+  for (k = 0; k < n; k++)
+    if (c[k].coords)
+      g_array_free (c[k].coords, TRUE);
+  g_free (c);
+  if (f->type == GTS_ERROR && coords) {
+    g_array_free (coords, TRUE);
+    coords = NULL;
+  }
+  return coords;
+}
+
+/* A cell of the spatial hash grid used to weld points */
+typedef struct {
+  gint64 key[3];
+  gboolean used;
+  guint head;              /* first point of the cell + 1 or 0 */
+} StlCell;
+
+static gint64 stl_cell_key (gdouble x, gdouble epsilon)
+{
+  if (epsilon == 0.) {
+    union { gdouble d; gint64 i; } u;
+
+    u.d = x + 0.; /* -0. is 0. */
+    return u.i;
+  }
+  x = floor (x/epsilon);
+  return x > 4e18 ? G_GINT64_CONSTANT (4000000000000000000) :
+    x < -4e18 ? - G_GINT64_CONSTANT (4000000000000000000) : (gint64) x;
+}
+
+static StlCell * stl_cell (StlCell * cells, guint mask, const gint64 * key)
+{
+  guint64 h = (key[0]*G_GUINT64_CONSTANT (0x9e3779b97f4a7c15) ^
+               key[1]*G_GUINT64_CONSTANT (0xc2b2ae3d27d4eb4f) ^
+               key[2]*G_GUINT64_CONSTANT (0x165667b19e3779f9));
+  guint i = (h ^ (h >> 32)) & mask;
+
+  while (cells[i].used &&
+         (cells[i].key[0] != key[0] || 
+          cells[i].key[1] != key[1] || 
+          cells[i].key[2] != key[2]))
+    i = (i + 1) & mask;
+  return &cells[i];
+}
+
+/* Welds the @n points of @coords which are closer than @epsilon along
+   each axis (no welding if @epsilon is negative). Returns the index
+   of the welded point associated with each point, the welded points
+   being numbered in order of first appearance. The number of welded
+   points is returned in @nw. */
+static guint * stl_weld (const gdouble * coords, guint n, gdouble epsilon,
+                         guint * nw)
+{
+  guint * id = g_malloc ((n + 1)*sizeof (guint)), * next;
+  StlCell * cells;
+  guint i, size = 16;
+
+  if (epsilon < 0.) {
+    for (i = 0; i < n; i++)
+      id[i] = i;
+    *nw = n;
+    return id;
+  }
+
+  /* cells of size epsilon, each containing a linked list of points */
+  while (size < 2*n)
+    size *= 2;
+  cells = g_malloc0 (size*sizeof (StlCell));
+  next = g_malloc ((n + 1)*sizeof (guint));
+  for (i = 0; i < n; i++) {
+    gint64 key[3];
+    StlCell * c;
+
+    key[0] = stl_cell_key (coords[3*i], epsilon);
+    key[1] = stl_cell_key (coords[3*i + 1], epsilon);
+    key[2] = stl_cell_key (coords[3*i + 2], epsilon);
+    c = stl_cell (cells, size - 1, key);
+    if (!c->used) {
+      memcpy (c->key, key, 3*sizeof (gint64));
+      c->used = TRUE;
+    }
+    next[i] = c->head;
+    c->head = i + 1;
+    id[i] = G_MAXUINT;
+  }
+
+  *nw = 0;
+  for (i = 0; i < n; i++)
+    if (id[i] == G_MAXUINT) {
+      const gdouble * x = &coords[3*i];
+      gint d = epsilon > 0. ? 1 : 0, dx, dy, dz;
+
+      id[i] = (*nw)++;
+      for (dx = -d; dx <= d; dx++)
+        for (dy = -d; dy <= d; dy++)
+          for (dz = -d; dz <= d; dz++) {
+            gint64 key[3];
+            StlCell * c;
+            guint * link;
+
+            key[0] = stl_cell_key (x[0], epsilon) + dx;
+            key[1] = stl_cell_key (x[1], epsilon) + dy;
+            key[2] = stl_cell_key (x[2], epsilon) + dz;
+            c = stl_cell (cells, size - 1, key);
+            /* welded points are removed from the lists */
+            link = &c->head;
+            while (*link) {
+              guint j = *link - 1;
+              const gdouble * y = &coords[3*j];
+
+              if (id[j] == G_MAXUINT &&
+                  fabs (x[0] - y[0]) <= epsilon &&
+                  fabs (x[1] - y[1]) <= epsilon &&
+                  fabs (x[2] - y[2]) <= epsilon)
+                id[j] = id[i];
+              if (id[j] != G_MAXUINT)
+                *link = next[j];
+              else
+                link = &next[j];
+            }
+          }
+    }
+
+  g_free (cells);
+  g_free (next);
+  return id;
+}
+
+/* Adds to @surface the triangles defined by the @n points of
+   @coords welded using @id */
+static void stl_build (GtsSurface * surface, const gdouble * coords,
+                       guint n, const guint * id, guint nw, guint threads)
+{
+  gdouble * xyz = g_malloc ((3*(gsize) nw + 1)*sizeof (gdouble));
+  guint i, nv = 0;
+
+  for (i = 0; i < n; i++)
+    if (id[i] == nv)
+      memcpy (&xyz[3*nv++], &coords[3*i], 3*sizeof (gdouble));
+  surface_add_arrays (surface, xyz, nw, id, n/3, threads);
+  g_free (xyz);
+}
+
+/**
+ * gts_surface_read_stl:
+ * @surface: a #GtsSurface.
+ * @f: a #GtsFile created with gts_file_new_mapped().
+ * @epsilon: the welding distance or a negative number.
+ *
+ * Adds to @surface the facets of the binary or ASCII STL file @f. The
+ * format is detected automatically.
+ *
+ * The vertices of the facets closer than @epsilon along each axis
+ * are welded together (use 0 to weld only identical vertices or a
+ * negative number to disable welding). Degenerate facets are ignored.
+ *
+ * The ASCII files are parsed using the number of threads set with
+ * gts_file_set_threads().
+ *
+ * Returns: 0 if successful or the line number at which the parsing
+ * stopped in case of error (in which case the @error field of @f is
+ * set to a description of the error which occured).
+ */
+guint gts_surface_read_stl (GtsSurface * surface, GtsFile * f,
+                            gdouble epsilon)
+{
+  const guchar * p;
+  gsize length;
+  GArray * coords;
+  guint * id, n, nw;
+
+  g_return_val_if_fail (surface != NULL, 1);
+  g_return_val_if_fail (f != NULL, 1);
+  g_return_val_if_fail (f->map != NULL, 1);
+  g_return_val_if_fail (f->type != GTS_ERROR, 1);
+
+  p = (const guchar *) f->map->start;
+  length = f->map->end - f->map->start;
+  if (length == 0)
+    return 0;
+  if (stl_is_binary (p, length)) {
+    guint32 nf, i, j;
+
+    if (length < 84) {
+      gts_file_error (f, "incomplete binary STL header");
+      return f->line;
+    }
+    nf = binary_get_uint32 (p + 80);
+    if (84 + 50*(guint64) nf > length) {
+      gts_file_error (f, "expecting %u facets, file too short", nf);
+      return f->line;
+    }
+    coords = g_array_sized_new (FALSE, FALSE, sizeof (gdouble), 9*nf);
+    for (i = 0, p += 84; i < nf; i++, p += 50)
+      for (j = 0; j < 9; j++) {
+        gdouble x = binary_get_float (p + 12 + 4*j);
+
+        g_array_append_val (coords, x);
+      }
+  }
+  else if (!(coords = stl_read_ascii (f)))
+    return f->line;
+
+  n = coords->len/3;
+  id = stl_weld ((gdouble *) coords->data, n, epsilon, &nw);
+  stl_build (surface, (gdouble *) coords->data, n, id, nw, f->map->threads);
+  g_free (id);
+  g_array_free (coords, TRUE);
+
+  /* the whole file has been read */
+  f->s = f->map->end;
+  f->next_token = '\0';
+  gts_file_next_token (f);
+  return 0;
+}
+
+/* PLY files */
+
+typedef enum {
+  PLY_CHAR, PLY_UCHAR, PLY_SHORT, PLY_USHORT,
+  PLY_INT, PLY_UINT, PLY_FLOAT, PLY_DOUBLE,
+  PLY_NONE
+} PlyType;
+
+static const struct {
+  const gchar * name, * alias;
+  guint size;
+  gdouble max; /* used to normalize colors */
+} ply_types[] = {
+  { "char",   "int8",    1, 127. },
+  { "uchar",  "uint8",   1, 255. },
+  { "short",  "int16",   2, 32767. },
+  { "ushort", "uint16",  2, 65535. },
+  { "int",    "int32",   4, 2147483647. },
+  { "uint",   "uint32",  4, 4294967295. },
+  { "float",  "float32", 4, 1. },
+  { "double", "float64", 8, 1. }
+};
+
+/* the properties of the vertices and faces which are used, in the
+   order of ply_vertex_properties */
+enum {
+  PLY_X, PLY_Y, PLY_Z, PLY_NX, PLY_NY, PLY_NZ, PLY_RED, PLY_GREEN, PLY_BLUE,
+  PLY_INDICES, PLY_IGNORED
+};
+
+static const gchar * ply_vertex_properties[] = {
+  "x", "y", "z", "nx", "ny", "nz", "red", "green", "blue"
+};
+
+enum { PLY_ASCII, PLY_BINARY_LITTLE_ENDIAN, PLY_BINARY_BIG_ENDIAN };
+
+typedef struct {
+  PlyType type, count_type; /* count_type is PLY_NONE if not a list */
+  guint use;
+} PlyProperty;
+
+typedef struct {
+  gchar * name;
+  guint n;
+  GArray * properties;
+  gboolean has[PLY_INDICES + 1];
+} PlyElement;
+
+typedef struct {
+  GtsFile * f;
+  guint format;
+  guchar buf[8];
+} PlyInput;
+
+static PlyType ply_type (const gchar * name)
+{
+  guint i;
+
+  for (i = 0; i < PLY_NONE; i++)
+    if (!strcmp (name, ply_types[i].name) || 
+        !strcmp (name, ply_types[i].alias))
+      return i;
+  return PLY_NONE;
+}
+
+static void ply_element_destroy (PlyElement * e)
+{
+  g_free (e->name);
+  g_array_free (e->properties, TRUE);
+  g_free (e);
+}
+
+/* Reads the header of @f and returns its elements or %NULL if an
+   error occured */
+static GPtrArray * ply_read_header (GtsFile * f, guint * format)
+{
+  GPtrArray * elements = g_ptr_array_new ();
+  PlyElement * e = NULL;
+
+  /* the first token was read before '\r' became a delimiter */
+  if (f->type != GTS_STRING || (strcmp (f->token->str, "ply") &&
+                                strcmp (f->token->str, "ply\r"))) {
+    gts_file_error (f, "expecting `ply'");
+    g_ptr_array_free (elements, TRUE);
+    return NULL;
+  }
+  *format = PLY_NONE;
+  gts_file_first_token_after (f, '\n');
+  while (f->type != GTS_ERROR) {
+    const gchar * keyword = f->token->str;
+
+    if (f->type == GTS_NONE) {
+      gts_file_error (f, "unexpected end of file (header)");
+      break;
+    }
+    if (f->type != GTS_STRING) {
+      gts_file_error (f, "expecting a keyword");
+      break;
+    }
+    if (!strcmp (keyword, "end_header"))
+      break;
+    if (!strcmp (keyword, "format")) {
+      gts_file_next_token (f);
+      if (!strcmp (f->token->str, "ascii"))
+        *format = PLY_ASCII;
+      else if (!strcmp (f->token->str, "binary_little_endian"))
+        *format = PLY_BINARY_LITTLE_ENDIAN;
+      else if (!strcmp (f->token->str, "binary_big_endian"))
+        *format = PLY_BINARY_BIG_ENDIAN;
+      else
+        gts_file_error (f, "unknown format `%s'", f->token->str);
+    }
+    else if (!strcmp (keyword, "element")) {
+      gts_file_next_token (f);
+      if (f->type != GTS_STRING)
+        gts_file_error (f, "expecting a string (element name)");
+      else {
+        e = g_malloc0 (sizeof (PlyElement));
+        e->name = g_strdup (f->token->str);
+        e->properties = g_array_new (FALSE, FALSE, sizeof (PlyProperty));
+        g_ptr_array_add (elements, e);
+        gts_file_next_token (f);
+        if (f->type != GTS_INT || f->token->str[0] == '-')
+          gts_file_error (f, "expecting an integer (number of elements)");
+        else
+          e->n = strtoul (f->token->str, NULL, 10);
+      }
+    }
+    else if (!strcmp (keyword, "property")) {
+      PlyProperty p;
+
+      p.count_type = PLY_NONE;
+      p.use = PLY_IGNORED;
+      gts_file_next_token (f);
+      if (!strcmp (f->token->str, "list")) {
+        gts_file_next_token (f);
+        if ((p.count_type = ply_type (f->token->str)) == PLY_NONE ||
+            p.count_type >= PLY_FLOAT) {
+          gts_file_error (f, "expecting an integer type (list count)");
+          break;
+        }
+        gts_file_next_token (f);
+      }
+      if ((p.type = ply_type (f->token->str)) == PLY_NONE)
+        gts_file_error (f, "unknown type `%s'", f->token->str);
+      else if (e == NULL)
+        gts_file_error (f, "property declared before any element");
+      else {
+        gts_file_next_token (f);
+        if (f->type != GTS_STRING)
+          gts_file_error (f, "expecting a string (property name)");
+        else if (!strcmp (e->name, "vertex") && p.count_type == PLY_NONE) {
+          guint i;
+
+          for (i = 0; i < PLY_INDICES; i++)
+            if (!strcmp (f->token->str, ply_vertex_properties[i]))
+              p.use = i;
+        }
+        else if (!strcmp (e->name, "face") && p.count_type != PLY_NONE &&
+                 p.type < PLY_FLOAT &&
+                 (!strcmp (f->token->str, "vertex_indices") ||
+                  !strcmp (f->token->str, "vertex_index")))
+          p.use = PLY_INDICES;
+        if (f->type != GTS_ERROR) {
+          if (p.use != PLY_IGNORED)
+            e->has[p.use] = TRUE;
+          g_array_append_val (e->properties, p);
+        }
+      }
+    }
+    else if (strcmp (keyword, "comment") && strcmp (keyword, "obj_info"))
+      gts_file_error (f, "unknown keyword `%s'", keyword);
+    gts_file_first_token_after (f, '\n');
+  }
+
+  if (f->type != GTS_ERROR && *format == PLY_NONE)
+    gts_file_error (f, "missing format");
+  if (f->type == GTS_ERROR) {
+    g_ptr_array_foreach (elements, (GFunc) ply_element_destroy, NULL);
+    g_ptr_array_free (elements, TRUE);
+    return NULL;
+  }
+  return elements;
+}
+
+static gboolean ply_read_value (PlyInput * in, PlyType type, gdouble * x)
+{
+  GtsFile * f = in->f;
+  const guchar * p;
+  guchar b[8];
+  guint i, size = ply_types[type].size;
+
+  if (in->format == PLY_ASCII) {
+    while (f->type == '\n')
+      gts_file_next_token (f);
+    if (f->type != GTS_INT && f->type != GTS_FLOAT)
+      return FALSE;
+    *x = atof (f->token->str);
+    gts_file_next_token (f);
+    return TRUE;
+  }
+
+  if (f->map) {
+    if (size > f->map->end - f->s)
+      return FALSE;
+    p = (const guchar *) f->s;
+    f->s += size;
+  }
+  else if (gts_file_read (f, in->buf, size, 1) != 1)
+    return FALSE;
+  else
+    p = in->buf;
+  if (in->format == PLY_BINARY_BIG_ENDIAN) {
+    for (i = 0; i < size; i++)
+      b[i] = p[size - 1 - i];
+    p = b;
+  }
+  switch (type) {
+  case PLY_CHAR:   *x = (gint8) p[0]; break;
+  case PLY_UCHAR:  *x = p[0]; break;
+  case PLY_SHORT:  *x = (gint16) (p[0] | (p[1] << 8)); break;
+  case PLY_USHORT: *x = (guint16) (p[0] | (p[1] << 8)); break;
+  case PLY_INT:    *x = (gint32) binary_get_uint32 (p); break;
+  case PLY_UINT:   *x = binary_get_uint32 (p); break;
+  case PLY_FLOAT:  *x = binary_get_float (p); break;
+  default:         *x = binary_get_double (p);
+  }
+  return TRUE;
+}
+
+/* Reads the next instance of element @e. The values of the scalar
+   properties which are used are stored in @record, the vertex indices
+   are appended to @indices (if not %NULL) */
+static gboolean ply_read_element (PlyInput * in, PlyElement * e,
+                                  gdouble * record, GArray * indices)
+{
+  guint i;
+
+  for (i = 0; i < e->properties->len; i++) {
+    PlyProperty * p = &g_array_index (e->properties, PlyProperty, i);
+    gdouble x;
+
+    if (p->count_type == PLY_NONE) {
+      if (!ply_read_value (in, p->type, &x))
+        return FALSE;
+      if (p->use < PLY_INDICES)
+        record[p->use] = p->use >= PLY_RED ? x/ply_types[p->type].max : x;
+    }
+    else {
+      gdouble n;
+
+      if (!ply_read_value (in, p->count_type, &n) || n < 0.)
+        return FALSE;
+      while (n-- > 0.) {
+        if (!ply_read_value (in, p->type, &x))
+          return FALSE;
+        if (indices && p->use == PLY_INDICES) {
+          guint j = x < 0. ? G_MAXUINT : x;
+
+          g_array_append_val (indices, j);
+        }
+      }
+    }
+  }
+  return TRUE;
+}
+
+/* The number of elements given by the header is not trusted: the
+   arrays of vertices start with at most PLY_CHUNK elements and are
+   grown with ply_grow() as the vertices are actually read */
+#define PLY_CHUNK 65536
+
+static guint ply_grow (guint size, guint n)
+{
+  return size > n/2 ? n : 2*size;
+}
+
+/* Reads the header of @in and positions it at the start of the
+   data. Returns the elements or %NULL if an error occured */
+static GPtrArray * ply_read_start (PlyInput * in)
+{
+  GtsFile * f = in->f;
+  GPtrArray * elements;
+
+  if (!(elements = ply_read_header (f, &in->format)))
+    return NULL;
+
+  if (in->format == PLY_ASCII)
+    gts_file_next_token (f);
+  else {
+    /* the binary data starts just after the end of the header line */
+    if (f->next_token == '\n' ||
+        (f->next_token == '\0' && gts_file_getc_scope (f) == '\n'))
+      f->next_token = '\0';
+    else
+      gts_file_error (f, "expecting a newline after `end_header'");
+  }
+  return elements;
+}
+
+/**
+ * gts_surface_read_ply:
+ * @surface: a #GtsSurface.
+ * @f: a #GtsFile.
+ *
+ * Adds to @surface the faces of the PLY file @f, in ASCII or binary
+ * (little or big-endian) format. The vertices and faces are added to
+ * @surface as they are read, using the "x", "y" and "z" properties of
+ * the "vertex" element and the "vertex_indices" (or "vertex_index")
+ * list of the "face" element. Faces with more than three vertices are
+ * triangulated and degenerate faces are ignored, as are the vertices
+ * which do not belong to any face and the other elements.
+ *
+ * If the vertex class of @surface is a #GtsColorVertex (resp. a
+ * #GtsVertexNormal) the "red", "green" and "blue" (resp. "nx", "ny"
+ * and "nz") properties are also read. Integer color components are
+ * normalized to the [0,1] range.
+ *
+ * Returns: 0 if successful or the line number at which the parsing
+ * stopped in case of error (in which case the @error field of @f is
+ * set to a description of the error which occured).
+ */
+guint gts_surface_read_ply (GtsSurface * surface, GtsFile * f)
+{
+  gchar * delimiters, * comments;
+  GPtrArray * elements;
+  GtsVertex ** vertices = NULL;
+  guint nv = 0, i;
+  SurfaceBuilder b;
+  PlyInput in;
+
+  g_return_val_if_fail (surface != NULL, 1);
+  g_return_val_if_fail (f != NULL, 1);
+
+  if (f->type == GTS_ERROR)
+    return f->line;
+  if (f->type == GTS_NONE) /* empty file */
+    return 0;
+
+  /* comments and carriage returns are not special in PLY headers */
+  delimiters = f->delimiters;
+  comments = f->comments;
+  f->delimiters = " \t\r";
+  f->comments = "";
+
+  in.f = f;
+  if (!(elements = ply_read_start (&in)))
+    goto restore;
+
+  for (i = 0; i < elements->len && f->type != GTS_ERROR; i++) {
+    PlyElement * e = elements->pdata[i];
+    gdouble record[PLY_INDICES];
+    guint j;
+
+    if (!strcmp (e->name, "vertex") && vertices == NULL) {
+      gboolean color = e->has[PLY_RED] && e->has[PLY_GREEN] && 
+        e->has[PLY_BLUE] &&
+        gts_object_class_is_from_class (surface->vertex_class,
+                                        gts_color_vertex_class ());
+      gboolean normal = e->has[PLY_NX] && e->has[PLY_NY] && 
+        e->has[PLY_NZ] &&
+        gts_object_class_is_from_class (surface->vertex_class,
+                                        gts_vertex_normal_class ());
+
+      guint size = MIN (e->n, PLY_CHUNK);
+
+      vertices = g_malloc ((size + 1)*sizeof (GtsVertex *));
+      memset (record, 0, sizeof (record));
+      for (j = 0; j < e->n && f->type != GTS_ERROR; j++)
+        if (!ply_read_element (&in, e, record, NULL))
+          gts_file_error (f, "expecting a number (vertex %u)", j);
+        else {
+          GtsVertex * v;
+
+          if (nv == size) {
+            size = ply_grow (size, e->n);
+            vertices = g_realloc (vertices, (size + 1)*sizeof (GtsVertex *));
+          }
+          v = gts_vertex_new (surface->vertex_class,
+                              record[PLY_X], record[PLY_Y], record[PLY_Z]);
+
+          if (color) {
+            GTS_COLOR_VERTEX (v)->c.r = record[PLY_RED];
+            GTS_COLOR_VERTEX (v)->c.g = record[PLY_GREEN];
+            GTS_COLOR_VERTEX (v)->c.b = record[PLY_BLUE];
+          }
+          if (normal) {
+            GTS_VERTEX_NORMAL (v)->n[0] = record[PLY_NX];
+            GTS_VERTEX_NORMAL (v)->n[1] = record[PLY_NY];
+            GTS_VERTEX_NORMAL (v)->n[2] = record[PLY_NZ];
+          }
+          vertices[nv++] = v;
+        }
+      surface_builder_init (&b, surface, vertices, nv);
+    }
+    else if (!strcmp (e->name, "face")) {
+      GArray * indices = g_array_new (FALSE, FALSE, sizeof (guint));
+
+      if (vertices == NULL)
+        gts_file_error (f, "faces defined before vertices");
+      for (j = 0; j < e->n && f->type != GTS_ERROR; j++) {
+        guint k, * id;
+
+        g_array_set_size (indices, 0);
+        if (!ply_read_element (&in, e, record, indices)) {
+          gts_file_error (f, "expecting a number (face %u)", j);
+          break;
+        }
+        id = (guint *) indices->data;
+        for (k = 0; k < indices->len; k++)
+          if (id[k] >= nv) {
+            gts_file_error (f, "invalid vertex index `%u' for face %u",
+                            id[k], j);
+            break;
+          }
+        for (k = 2; k < indices->len && f->type != GTS_ERROR; k++)
+          surface_builder_face (&b, id[0], id[k - 1], id[k]);
+      }
+      g_array_free (indices, TRUE);
+    }
+    else
+      for (j = 0; j < e->n && f->type != GTS_ERROR; j++)
+        if (!ply_read_element (&in, e, record, NULL))
+          gts_file_error (f, "expecting a number (element `%s')", e->name);
+  }
+
+  if (vertices) {
+    if (f->type == GTS_ERROR) {
+      gts_allow_floating_vertices = TRUE;
+      while (nv)
+        gts_object_destroy (GTS_OBJECT (vertices[nv-- - 1]));
+      gts_allow_floating_vertices = FALSE;
+      b.nv = 0;
+    }
+    surface_builder_free (&b);
+    g_free (vertices);
+  }
+  if (f->type != GTS_ERROR && in.format != PLY_ASCII)
+    gts_file_next_token (f);
+
+  g_ptr_array_foreach (elements, (GFunc) ply_element_destroy, NULL);
+  g_ptr_array_free (elements, TRUE);
+
+ restore:
+  f->delimiters = delimiters;
+  f->comments = comments;
+
+  if (f->type == GTS_ERROR)
+    return f->line;
+  return 0;
+}
+
 static void sum_area (GtsFace * f, gdouble * area) {
   *area += gts_triangle_area (GTS_TRIANGLE (f));
 }
 
 /**
- * gts_surface_area:
+ * gts_surface_area:
+ * @s: a #GtsSurface.
+ *
+ * Returns: the area of @s obtained as the sum of the signed areas of its
+ * faces.
+ */
+gdouble gts_surface_area (GtsSurface * s)
+{
+  gdouble area = 0.0;
+  gts_surface_foreach_face (s, (GtsFunc)sum_area, &area);
+  return area;
+}
+
+/**
+ * gts_range_init:
+ * @r: a #GtsRange.
+ *
+ * Initializes a #GtsRange.
+ */
+void gts_range_init (GtsRange * r)
+{
+  g_return_if_fail (r != NULL);
+
+  r->max = - G_MAXDOUBLE;
+  r->min = G_MAXDOUBLE;
+  r->sum = r->sum2 = 0.0;
+  r->n = 0;
+}
+
+/**
+ * gts_range_reset:
+ * @r: a #GtsRange.
+ *
+ * Sets all the fields of @r to 0.
+ */
+void gts_range_reset (GtsRange * r)
+{
+  g_return_if_fail (r != NULL);
+
+  r->max = 0.0;
+  r->min = 0.0;
+  r->sum = r->sum2 = 0.0;
+  r->n = 0;
+}
+
+/**
+ * gts_range_add_value:
+ * @r: a #GtsRange.
+ * @val: a value to add to @r.
+ *
+ * Adds @val to @r.
+ */
+void gts_range_add_value (GtsRange * r, gdouble val)
+{
+  g_return_if_fail (r != NULL);
+
+  if (val < r->min) r->min = val;
+  if (val > r->max) r->max = val;
+  r->sum += val;
+  r->sum2 += val*val;
+  r->n++;
+}
+
+/**
+ * gts_range_update:
+ * @r: a #GtsRange.
+ *
+ * Updates the fields of @r.
+ */
+void gts_range_update (GtsRange * r)
+{
+  g_return_if_fail (r != NULL);
+
+  if (r->n > 0) {
+    if (r->sum2 - r->sum*r->sum/(gdouble) r->n >= 0.)
+      r->stddev = sqrt ((r->sum2 - r->sum*r->sum/(gdouble) r->n)
+                        /(gdouble) r->n);
+    else
+      r->stddev = 0.;
+    r->mean = r->sum/(gdouble) r->n;
+  }
+  else
+    r->min = r->max = r->mean = r->stddev = 0.;
+}
+
+/**
+ * gts_range_print:
+ * @r: a #GtsRange.
+ * @fptr: a file pointer.
+ *
+ * Writes a text representation of @r in @fptr.
+ */
+void gts_range_print (GtsRange * r, FILE * fptr)
+{
+  g_return_if_fail (r != NULL);
+  g_return_if_fail (fptr != NULL);
+  fprintf (fptr, "min: %g mean: %g | %g max: %g",
+           r->min, r->mean, r->stddev, r->max);
+}
+
+static void stats_foreach_vertex (GtsVertex * v, GtsSurfaceStats * stats)
+{
+  GSList * i = v->segments;
+  guint nedges = 0;
+
+  while (i) {
+    if (GTS_IS_EDGE (i->data) &&
+        gts_edge_has_parent_surface (i->data, stats->parent))
+      nedges++;
+    i = i->next;
+  }
+  gts_range_add_value (&stats->edges_per_vertex, nedges);
+}
+
+static void stats_foreach_edge (GtsEdge * e, GtsSurfaceStats * stats)
+{
+  guint nt = gts_edge_face_number (e, stats->parent);
+
+  if (gts_segment_is_duplicate (GTS_SEGMENT (e)))
+    stats->n_duplicate_edges++;
+  if (nt == 1)
+    stats->n_boundary_edges++;
+  else if (nt > 2)
+    stats->n_non_manifold_edges++;
+  gts_range_add_value (&stats->faces_per_edge, nt);
+}
+
+static void stats_foreach_face (GtsTriangle * t, GtsSurfaceStats * stats)
+{
+  if (!gts_face_is_compatible (GTS_FACE (t), stats->parent))
+    stats->n_incompatible_faces++;
+  if (gts_triangle_is_duplicate (t))
+    stats->n_duplicate_faces++;
+  stats->n_faces++;
+}
+
+/**
+ * gts_surface_stats:
+ * @s: a #GtsSurface.
+ * @stats: a #GtsSurfaceStats.
+ *
+ * Fills @stats with the statistics relevant to surface @s.
+ */
+void gts_surface_stats (GtsSurface * s, GtsSurfaceStats * stats)
+{
+  g_return_if_fail (s != NULL);
+  g_return_if_fail (stats != NULL);
+
+  stats->parent = s;
+  stats->n_faces = 0;
+  stats->n_incompatible_faces = 0;
+  stats->n_duplicate_faces = 0;
+  stats->n_duplicate_edges = 0;
+  stats->n_boundary_edges = 0;
+  stats->n_non_manifold_edges = 0;
+  gts_range_init (&stats->edges_per_vertex);
+  gts_range_init (&stats->faces_per_edge);
+
+  gts_surface_foreach_vertex (s, (GtsFunc) stats_foreach_vertex, stats);
+  gts_surface_foreach_edge (s, (GtsFunc) stats_foreach_edge, stats);
+  gts_surface_foreach_face (s, (GtsFunc) stats_foreach_face, stats);
+
+  gts_range_update (&stats->edges_per_vertex);
+  gts_range_update (&stats->faces_per_edge);
+}
+
+static void quality_foreach_edge (GtsSegment * s,
+                                  GtsSurfaceQualityStats * stats)
+{
+  GSList * i = GTS_EDGE (s)->triangles;
+
+  gts_range_add_value (&stats->edge_length,
+                   gts_point_distance (GTS_POINT (s->v1),
+                                       GTS_POINT (s->v2)));
+  while (i) {
+    GSList * j = i->next;
+    while (j) {
+      gts_range_add_value (&stats->edge_angle,
+                           fabs (gts_triangles_angle (i->data, j->data)));
+      j = j->next;
+    }
+    i = i->next;
+  }
+}
+
+static void quality_foreach_face (GtsTriangle * t,
+                                  GtsSurfaceQualityStats * stats)
+{
+  gts_range_add_value (&stats->face_quality, gts_triangle_quality (t));
+  gts_range_add_value (&stats->face_area, gts_triangle_area (t));
+}
+
+/**
+ * gts_surface_quality_stats:
+ * @s: a #GtsSurface.
+ * @stats: a #GtsSurfaceQualityStats.
+ *
+ * Fills @stats with quality statistics relevant to surface @s.
+ */
+void gts_surface_quality_stats (GtsSurface * s, GtsSurfaceQualityStats * stats)
+{
+  g_return_if_fail (s != NULL);
+  g_return_if_fail (stats != NULL);
+
+  stats->parent = s;
+  gts_range_init (&stats->face_quality);
+  gts_range_init (&stats->face_area);
+  gts_range_init (&stats->edge_length);
+  gts_range_init (&stats->edge_angle);
+
+  gts_surface_foreach_edge (s, (GtsFunc) quality_foreach_edge, stats);
+  gts_surface_foreach_face (s, (GtsFunc) quality_foreach_face, stats);
+
+  gts_range_update (&stats->face_quality);
+  gts_range_update (&stats->face_area);
+  gts_range_update (&stats->edge_length);
+  gts_range_update (&stats->edge_angle);
+}
+
+/**
+ * gts_surface_print_stats:
+ * @s: a #GtsSurface.
+ * @fptr: a file pointer.
+ *
+ * Writes in the file pointed to by @fptr the statistics for surface @s.
+ */
+void gts_surface_print_stats (GtsSurface * s, FILE * fptr)
+{
+  GtsSurfaceStats stats;
+  GtsSurfaceQualityStats qstats;
+
+  g_return_if_fail (s != NULL);
+  g_return_if_fail (fptr != NULL);
+
+  gts_surface_stats (s, &stats);
+  gts_surface_quality_stats (s, &qstats);
+
+  fprintf (fptr,
+           "# vertices: %u edges: %u faces: %u\n"
+           "# Connectivity statistics\n"
+           "#   incompatible faces: %u\n"
+           "#   duplicate faces: %u\n"
+           "#   boundary edges: %u\n"
+           "#   duplicate edges: %u\n"
+           "#   non-manifold edges: %u\n",
+           stats.edges_per_vertex.n,
+           stats.faces_per_edge.n,
+           stats.n_faces,
+           stats.n_incompatible_faces,
+           stats.n_duplicate_faces,
+           stats.n_boundary_edges,
+           stats.n_duplicate_edges,
+           stats.n_non_manifold_edges);
+  fputs ("#   edges per vertex: ", fptr);
+  gts_range_print (&stats.edges_per_vertex, fptr);
+  fputs ("\n#   faces per edge: ", fptr);
+  gts_range_print (&stats.faces_per_edge, fptr);
+  fputs ("\n# Geometric statistics\n#   face quality: ", fptr);
+  gts_range_print (&qstats.face_quality, fptr);
+  fputs ("\n#   face area  : ", fptr);
+  gts_range_print (&qstats.face_area, fptr);
+  fputs ("\n#   edge length : ", fptr);
+  gts_range_print (&qstats.edge_length, fptr);
+  fputc ('\n', fptr);
+}
+
+/* Output buffer of gts_surface_write(). If @fp is not %NULL, the
+   buffer is flushed into @fp when full, otherwise it grows as
+   needed. */
+typedef struct {
+  gchar * s;
+  gsize len, size;
+  FILE * fp;
+} WriteBuffer;
+
+/* maximum length of a record written with the buffer */
+#define WRITE_RECORD_MAX 128
+
+static void write_buffer_init (WriteBuffer * b, gsize size, FILE * fp)
+{
+  b->s = g_malloc (size);
+  b->len = 0;
+  b->size = size;
+  b->fp = fp;
+}
+
+static void write_buffer_flush (WriteBuffer * b)
+{
+  fwrite (b->s, 1, b->len, b->fp);
+  b->len = 0;
+}
+
+static gchar * write_buffer_reserve (WriteBuffer * b)
+{
+  if (b->len + WRITE_RECORD_MAX > b->size) {
+    if (b->fp)
+      write_buffer_flush (b);
+    else
+      b->s = g_realloc (b->s, b->size *= 2);
+  }
+  return b->s + b->len;
+}
+
+static gchar * format_uint (gchar * p, guint n)
+{
+  gchar tmp[16], * t = tmp;
+
+  do {
+    *(t++) = '0' + n % 10;
+    n /= 10;
+  } while (n);
+  while (t > tmp)
+    *(p++) = *(--t);
+  return p;
+}
+
+static const gdouble exact_pow10[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/* x*10^n correctly rounded, for |n| <= 22 */
+static gdouble scale_pow10 (gdouble x, gint n)
+{
+  return n >= 0 ? x*exact_pow10[n] : x/exact_pow10[-n];
+}
+
+/* Same output as sprintf (p, "%.10g", x) (in the C locale) but much
+   faster. The 10 significant digits are obtained with a single
+   correctly rounded operation, with a fallback on sprintf() whenever
+   the result could be ambiguous. */
+static gchar * format_double (gchar * p, gdouble x)
+{
+  gdouble a = fabs (x), m, f;
+  guint64 n;
+  gint e, i, nd;
+  gchar d[10];
+
+  if (a == 0.) {
+    if (signbit (x))
+      *(p++) = '-';
+    *(p++) = '0';
+    return p;
+  }
+  if (!(a >= 1e-13 && a < 1e22))
+    return p + sprintf (p, "%.10g", x);
+
+  e = floor (log10 (a));
+  if (e < -13 || e > 31)
+    return p + sprintf (p, "%.10g", x);
+  m = scale_pow10 (a, 9 - e);
+  if (m >= 1e10) {
+    if (++e > 31)
+      return p + sprintf (p, "%.10g", x);
+    m = scale_pow10 (a, 9 - e);
+  }
+  else if (m < 1e9) {
+    if (--e < -13)
+      return p + sprintf (p, "%.10g", x);
+    m = scale_pow10 (a, 9 - e);
+  }
+  f = m - floor (m);
+  /* the rounding error on m is less than 1e-6 */
+  if (fabs (f - 0.5) < 1e-5)
+    return p + sprintf (p, "%.10g", x);
+  n = floor (m + 0.5);
+  if (n == G_GUINT64_CONSTANT (10000000000)) {
+    n = G_GUINT64_CONSTANT (1000000000);
+    e++;
+  }
+  for (i = 9; i >= 0; i--, n /= 10)
+    d[i] = '0' + n % 10;
+  for (nd = 10; d[nd - 1] == '0'; nd--);
+
+  if (x < 0.)
+    *(p++) = '-';
+  if (e < -4 || e >= 10) {
+    *(p++) = d[0];
+    if (nd > 1) {
+      *(p++) = '.';
+      for (i = 1; i < nd; i++)
+	*(p++) = d[i];
+    }
+    *(p++) = 'e';
+    *(p++) = e < 0 ? '-' : '+';
+    if (e < 0)
+      e = -e;
+    if (e >= 100)
+      *(p++) = '0' + e/100;
+    *(p++) = '0' + e/10 % 10;
+    *(p++) = '0' + e % 10;
+  }
+  else if (e < 0) {
+    *(p++) = '0';
+    *(p++) = '.';
+    for (i = -1; i > e; i--)
+      *(p++) = '0';
+    for (i = 0; i < nd; i++)
+      *(p++) = d[i];
+  }
+  else {
+    for (i = 0; i <= e; i++)
+      *(p++) = d[i];
+    if (nd > e + 1) {
+      *(p++) = '.';
+      for (; i < nd; i++)
+	*(p++) = d[i];
+    }
+  }
+  return p;
+}
+
+/* Whether @o is written by gts_surface_write() using the default
+   format (i.e. without calling its write() method) */
+#define WRITE_VERTEX_IS_DEFAULT(o) (GTS_OBJECT (o)->klass->write ==\
+				    GTS_OBJECT_CLASS (gts_point_class ())->write &&\
+				    !GTS_POINT_CLASS (GTS_OBJECT (o)->klass)->binary)
+#define WRITE_OBJECT_IS_DEFAULT(o) (GTS_OBJECT (o)->klass->write == NULL)
+
+#define WRITE_INDEX(index, o) GPOINTER_TO_UINT (gts_scratch_get (index, o))
+
+typedef struct {
+  GPtrArray * vertices, * edges, * faces;
+  GtsScratch * vindex, * eindex;
+  gboolean default_vertices, default_edges, default_faces;
+  gboolean c_locale;
+} WriteData;
+
+static void write_index_vertex (GtsVertex * v, WriteData * w)
+{
+  g_ptr_array_add (w->vertices, v);
+  gts_scratch_set (w->vindex, v, GUINT_TO_POINTER (w->vertices->len));
+  if (!WRITE_VERTEX_IS_DEFAULT (v))
+    w->default_vertices = FALSE;
+}
+
+static void write_index_edge (GtsEdge * e, WriteData * w)
+{
+  g_ptr_array_add (w->edges, e);
+  gts_scratch_set (w->eindex, e, GUINT_TO_POINTER (w->edges->len));
+  if (!WRITE_OBJECT_IS_DEFAULT (e))
+    w->default_edges = FALSE;
+}
+
+static void write_vertex (WriteBuffer * b, GtsPoint * p, WriteData * w)
+{
+  if (w->c_locale && WRITE_VERTEX_IS_DEFAULT (p)) {
+    gchar * s = write_buffer_reserve (b);
+
+    s = format_double (s, p->x);
+    *(s++) = ' ';
+    s = format_double (s, p->y);
+    *(s++) = ' ';
+    s = format_double (s, p->z);
+    *(s++) = '\n';
+    b->len = s - b->s;
+  }
+  else {
+    write_buffer_flush (b);
+    (*GTS_OBJECT (p)->klass->write) (GTS_OBJECT (p), b->fp);
+    if (!GTS_POINT_CLASS (GTS_OBJECT (p)->klass)->binary)
+      fputc ('\n', b->fp);
+  }
+}
+
+static void write_edge (WriteBuffer * b, GtsSegment * s, WriteData * w)
+{
+  gchar * p = write_buffer_reserve (b);
+
+  p = format_uint (p, WRITE_INDEX (w->vindex, s->v1));
+  *(p++) = ' ';
+  p = format_uint (p, WRITE_INDEX (w->vindex, s->v2));
+  if (WRITE_OBJECT_IS_DEFAULT (s))
+    *(p++) = '\n';
+  b->len = p - b->s;
+  if (!WRITE_OBJECT_IS_DEFAULT (s)) {
+    write_buffer_flush (b);
+    (*GTS_OBJECT (s)->klass->write) (GTS_OBJECT (s), b->fp);
+    fputc ('\n', b->fp);
+  }
+}
+
+static void write_face (WriteBuffer * b, GtsTriangle * t, WriteData * w)
+{
+  gchar * p = write_buffer_reserve (b);
+
+  p = format_uint (p, WRITE_INDEX (w->eindex, t->e1));
+  *(p++) = ' ';
+  p = format_uint (p, WRITE_INDEX (w->eindex, t->e2));
+  *(p++) = ' ';
+  p = format_uint (p, WRITE_INDEX (w->eindex, t->e3));
+  if (WRITE_OBJECT_IS_DEFAULT (t))
+    *(p++) = '\n';
+  b->len = p - b->s;
+  if (!WRITE_OBJECT_IS_DEFAULT (t)) {
+    write_buffer_flush (b);
+    (*GTS_OBJECT (t)->klass->write) (GTS_OBJECT (t), b->fp);
+    fputc ('\n', b->fp);
+  }
+}
+
+typedef void (* WriteFunc) (WriteBuffer *, gpointer, WriteData *);
+
+typedef struct {
+  GPtrArray * objects;
+  guint start, end;
+  WriteFunc func;
+  WriteData * w;
+  WriteBuffer b;
+} WriteChunk;
+
+static gpointer write_chunk (WriteChunk * c)
+{
+  guint i;
+
+  for (i = c->start; i < c->end; i++)
+    (* c->func) (&c->b, c->objects->pdata[i], c->w);
+  return NULL;
+}
+
+/* minimum number of objects written by each thread */
+#define WRITE_CHUNK_MIN 16384
+
+static void write_section (WriteBuffer * b, 
+			   GPtrArray * objects, 
+			   WriteFunc func,
+			   WriteData * w,
+			   gboolean parallel,
+			   guint threads)
+{
+  threads = MIN (threads, objects->len/WRITE_CHUNK_MIN + 1);
+  if (!parallel || threads < 2) {
+    WriteChunk c;
+
+    c.objects = objects;
+    c.start = 0;
+    c.end = objects->len;
+    c.func = func;
+    c.w = w;
+    c.b = *b;
+    write_chunk (&c);
+    *b = c.b;
+  }
+  else {
+    /* each chunk is formatted in memory then written in order */
+    WriteChunk * c = g_malloc (threads*sizeof (WriteChunk));
+    GThread ** thread = g_malloc (threads*sizeof (GThread *));
+    guint k;
+
+    write_buffer_flush (b);
+    for (k = 0; k < threads; k++) {
+      c[k].objects = objects;
+      c[k].start = (guint64) objects->len*k/threads;
+      c[k].end = (guint64) objects->len*(k + 1)/threads;
+      c[k].func = func;
+      c[k].w = w;
+      write_buffer_init (&c[k].b, 
+			 (c[k].end - c[k].start)*48 + WRITE_RECORD_MAX, NULL);
+      thread[k] = g_thread_new ("gts-write", (GThreadFunc) write_chunk, &c[k]);
+    }
+    for (k = 0; k < threads; k++) {
+      g_thread_join (thread[k]);
+      fwrite (c[k].b.s, 1, c[k].b.len, b->fp);
+      g_free (c[k].b.s);
+    }
+    g_free (thread);
+    g_free (c);
+  }
+}
+
+static void surface_write_sections (GtsSurface * s, FILE * fptr,
+				    guint threads)
+{
+  WriteData w;
+  WriteBuffer b;
+  struct lconv * lc = localeconv ();
+  guint i;
+
+  w.vertices = g_ptr_array_sized_new (gts_surface_vertex_number (s));
+  w.edges = g_ptr_array_sized_new (gts_surface_edge_number (s));
+  w.faces = s->faces;
+  w.vindex = gts_scratch_new (gts_surface_vertex_number (s));
+  w.eindex = gts_scratch_new (gts_surface_edge_number (s));
+  w.default_vertices = w.default_edges = w.default_faces = TRUE;
+  w.c_locale = !strcmp (lc->decimal_point, ".");
+  /* the indices (starting from one) of the vertices and edges are
+     kept in scratch tables, which the threads only read */
+  gts_surface_foreach_vertex (s, (GtsFunc) write_index_vertex, &w);
+  gts_surface_foreach_edge (s, (GtsFunc) write_index_edge, &w);
+  for (i = 0; i < w.faces->len && w.default_faces; i++)
+    if (!WRITE_OBJECT_IS_DEFAULT (w.faces->pdata[i]))
+      w.default_faces = FALSE;
+
+  fprintf (fptr, "%u %u %u", w.vertices->len, w.edges->len, w.faces->len);
+  if (GTS_OBJECT (s)->klass->write)
+    (*GTS_OBJECT (s)->klass->write) (GTS_OBJECT (s), fptr);
+  fputc ('\n', fptr);
+
+  /* forbid removal of faces */
+  s->keep_faces = TRUE;
+  write_buffer_init (&b, 65536, fptr);
+  write_section (&b, w.vertices, (WriteFunc) write_vertex, &w,
+		 w.default_vertices && w.c_locale, threads);
+  if (GTS_POINT_CLASS (s->vertex_class)->binary) {
+    write_buffer_flush (&b);
+    fputc ('\n', fptr);
+  }
+  write_section (&b, w.edges, (WriteFunc) write_edge, &w, 
+		 w.default_edges, threads);
+  write_section (&b, w.faces, (WriteFunc) write_face, &w, 
+		 w.default_faces, threads);
+  write_buffer_flush (&b);
+  g_free (b.s);
+  /* allow removal of faces */
+  s->keep_faces = FALSE;
+
+  gts_scratch_destroy (w.vindex);
+  gts_scratch_destroy (w.eindex);
+  g_ptr_array_free (w.vertices, TRUE);
+  g_ptr_array_free (w.edges, TRUE);
+}
+
+/**
+ * gts_surface_write:
+ * @s: a #GtsSurface.
+ * @fptr: a file pointer.
+ *
+ * Writes in the file @fptr an ASCII representation of @s. The file
+ * format is as follows.
+ *
+ * All the lines beginning with #GTS_COMMENTS are ignored. The first line
+ * contains three unsigned integers separated by spaces. The first
+ * integer is the number of vertices, nv, the second is the number of
+ * edges, ne and the third is the number of faces, nf.
+ *
+ * Follows nv lines containing the x, y and z coordinates of the
+ * vertices.  Follows ne lines containing the two indices (starting
+ * from one) of the vertices of each edge. Follows nf lines containing
+ * the three ordered indices (also starting from one) of the edges of
+ * each face.
+ *
+ * The format described above is the least common denominator to all
+ * GTS files.  Consistent with an object-oriented approach, the GTS
+ * file format is extensible. Each of the lines of the file can be
+ * extended with user-specific attributes accessible through the
+ * read() and write() virtual methods of each of the objects written
+ * (surface, vertices, edges or faces). When read with different
+ * object classes, these extra attributes are just ignored.
+ */
+void gts_surface_write (GtsSurface * s, FILE * fptr)
+{
+  g_return_if_fail (s != NULL);
+  g_return_if_fail (fptr != NULL);
+
+  surface_write_sections (s, fptr, 1);
+}
+
+/**
+ * gts_surface_write_parallel:
  * @s: a #GtsSurface.
+ * @fptr: a file pointer.
+ * @threads: the number of threads or 0.
  *
- * Returns: the area of @s obtained as the sum of the signed areas of its
- * faces.
+ * Same as gts_surface_write() but the records of each section are
+ * formatted concurrently by @threads threads (one per processor if
+ * @threads is 0), whenever the objects use the default format. The
+ * resulting file is identical.
  */
-gdouble gts_surface_area (GtsSurface * s)
+void gts_surface_write_parallel (GtsSurface * s, FILE * fptr, guint threads)
 {
-  gdouble area = 0.0;
-  gts_surface_foreach_face (s, (GtsFunc)sum_area, &area);
-  return area;
+  g_return_if_fail (s != NULL);
+  g_return_if_fail (fptr != NULL);
+
+  surface_write_sections (s, fptr, 
+			  threads ? threads : g_get_num_processors ());
 }
 
-/**
- * gts_range_init:
- * @r: a #GtsRange.
- *
- * Initializes a #GtsRange.
- */
-void gts_range_init (GtsRange * r)
+typedef struct {
+  FILE * fp;
+  guchar buf[8192];
+  guint n;
+  GtsScratch * vindex, * eindex;
+  guint32 nv, ne;
+} BinaryOutput;
+
+static void binary_flush (BinaryOutput * out)
 {
-  g_return_if_fail (r != NULL);
+  fwrite (out->buf, 1, out->n, out->fp);
+  out->n = 0;
+}
 
-  r->max = - G_MAXDOUBLE;
-  r->min = G_MAXDOUBLE;
-  r->sum = r->sum2 = 0.0;
-  r->n = 0;
+static void binary_put_uint32 (BinaryOutput * out, guint32 v)
+{
+  guchar * p;
+
+  if (out->n + 4 > sizeof (out->buf))
+    binary_flush (out);
+  p = out->buf + out->n;
+  p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+  out->n += 4;
 }
 
-/**
- * gts_range_reset:
- * @r: a #GtsRange.
- *
- * Sets all the fields of @r to 0.
- */
-void gts_range_reset (GtsRange * r)
+static void binary_put_uint16 (BinaryOutput * out, guint16 v)
 {
-  g_return_if_fail (r != NULL);
+  if (out->n + 2 > sizeof (out->buf))
+    binary_flush (out);
+  out->buf[out->n++] = v;
+  out->buf[out->n++] = v >> 8;
+}
 
-  r->max = 0.0;
-  r->min = 0.0;
-  r->sum = r->sum2 = 0.0;
-  r->n = 0;
+static void binary_put_uint8 (BinaryOutput * out, guint8 v)
+{
+  if (out->n + 1 > sizeof (out->buf))
+    binary_flush (out);
+  out->buf[out->n++] = v;
 }
 
-/**
- * gts_range_add_value:
- * @r: a #GtsRange.
- * @val: a value to add to @r.
- *
- * Adds @val to @r.
- */
-void gts_range_add_value (GtsRange * r, gdouble val)
+static void binary_put_double (BinaryOutput * out, gdouble d)
 {
-  g_return_if_fail (r != NULL);
+  union { guint64 i; gdouble d; } u;
 
-  if (val < r->min) r->min = val;
-  if (val > r->max) r->max = val;
-  r->sum += val;
-  r->sum2 += val*val;
-  r->n++;
+  u.d = d;
+  binary_put_uint32 (out, u.i);
+  binary_put_uint32 (out, u.i >> 32);
 }
 
-/**
- * gts_range_update:
- * @r: a #GtsRange.
- *
- * Updates the fields of @r.
- */
-void gts_range_update (GtsRange * r)
+static void binary_put_float (BinaryOutput * out, gfloat f)
 {
-  g_return_if_fail (r != NULL);
+  union { guint32 i; gfloat f; } u;
 
-  if (r->n > 0) {
-    if (r->sum2 - r->sum*r->sum/(gdouble) r->n >= 0.)
-      r->stddev = sqrt ((r->sum2 - r->sum*r->sum/(gdouble) r->n)
-                        /(gdouble) r->n);
-    else
-      r->stddev = 0.;
-    r->mean = r->sum/(gdouble) r->n;
-  }
-  else
-    r->min = r->max = r->mean = r->stddev = 0.;
+  u.f = f;
+  binary_put_uint32 (out, u.i);
+}
+
+static void write_vertex_binary (GtsPoint * p, BinaryOutput * out)
+{
+  binary_put_double (out, p->x);
+  binary_put_double (out, p->y);
+  binary_put_double (out, p->z);
+  gts_scratch_set (out->vindex, p, GUINT_TO_POINTER (out->nv++));
+}
+
+static void write_edge_binary (GtsSegment * s, BinaryOutput * out)
+{
+  binary_put_uint32 (out, 
+		     GPOINTER_TO_UINT (gts_scratch_get (out->vindex, s->v1)));
+  binary_put_uint32 (out, 
+		     GPOINTER_TO_UINT (gts_scratch_get (out->vindex, s->v2)));
+  gts_scratch_set (out->eindex, s, GUINT_TO_POINTER (out->ne++));
+}
+
+static void write_face_binary (GtsTriangle * t, BinaryOutput * out)
+{
+  binary_put_uint32 (out, 
+		     GPOINTER_TO_UINT (gts_scratch_get (out->eindex, t->e1)));
+  binary_put_uint32 (out, 
+		     GPOINTER_TO_UINT (gts_scratch_get (out->eindex, t->e2)));
+  binary_put_uint32 (out, 
+		     GPOINTER_TO_UINT (gts_scratch_get (out->eindex, t->e3)));
+}
+
+static void write_color_binary (GtsColorVertex * v, BinaryOutput * out)
+{
+  binary_put_float (out, v->c.r);
+  binary_put_float (out, v->c.g);
+  binary_put_float (out, v->c.b);
+}
+
+static void write_normal_binary (GtsVertexNormal * v, BinaryOutput * out)
+{
+  binary_put_double (out, v->n[0]);
+  binary_put_double (out, v->n[1]);
+  binary_put_double (out, v->n[2]);
 }
 
 /**
- * gts_range_print:
- * @r: a #GtsRange.
+ * gts_surface_write_binary:
+ * @s: a #GtsSurface.
  * @fptr: a file pointer.
  *
- * Writes a text representation of @r in @fptr.
+ * Writes in the file @fptr a binary representation of @s which can
+ * be read back (much faster than the ASCII representation) using
+ * gts_surface_read(). The file format is as follows.
+ *
+ * The first line contains the string "GtsSurfaceBinary" followed by a
+ * newline character. All the following data are little-endian
+ * unsigned 32 bits integers, 32 bits floats or 64 bits doubles. The
+ * header contains five integers: the version of the format (currently
+ * 1), the number of vertices nv, of edges ne and of faces nf and the
+ * number of attribute blocks.
+ *
+ * Follows nv triplets of doubles, the x, y and z coordinates of the
+ * vertices. Follows ne pairs of integers, the indices (starting from
+ * zero) of the vertices of each edge. Follows nf triplets of integers,
+ * the ordered indices (also starting from zero) of the edges of each
+ * face.
+ *
+ * Each attribute block starts with three integers: a tag made of four
+ * ASCII characters, the type of the objects it applies to (0 for
+ * vertices, 1 for edges, 2 for faces) and the size in bytes of the
+ * data for each object. Follows the data for each of the objects, in
+ * the order in which they were written. The colors of #GtsColorVertex
+ * ("COLR", three floats) and the normals of #GtsVertexNormal ("NORM",
+ * three doubles) are written in this way. Unknown attributes or
+ * attributes not supported by the classes of the surface are ignored
+ * when reading.
+ *
+ * Contrary to gts_surface_write(), the read() and write() methods of
+ * the objects are not used.
  */
-void gts_range_print (GtsRange * r, FILE * fptr)
+void gts_surface_write_binary (GtsSurface * s, FILE * fptr)
 {
-  g_return_if_fail (r != NULL);
-  g_return_if_fail (fptr != NULL);
-  fprintf (fptr, "min: %g mean: %g | %g max: %g",
-           r->min, r->mean, r->stddev, r->max);
-}
+  BinaryOutput * out;
+  guint nb = 0;
+  gboolean color, normal;
 
-static void stats_foreach_vertex (GtsVertex * v, GtsSurfaceStats * stats)
-{
-  GSList * i = v->segments;
-  guint nedges = 0;
+  g_return_if_fail (s != NULL);
+  g_return_if_fail (fptr != NULL);
 
-  while (i) {
-    if (GTS_IS_EDGE (i->data) &&
-        gts_edge_has_parent_surface (i->data, stats->parent))
-      nedges++;
-    i = i->next;
+  color = gts_object_class_is_from_class (s->vertex_class,
+					  gts_color_vertex_class ()) != NULL;
+  normal = gts_object_class_is_from_class (s->vertex_class,
+					   gts_vertex_normal_class ()) != NULL;
+  if (color) nb++;
+  if (normal) nb++;
+
+  out = g_malloc (sizeof (BinaryOutput));
+  out->fp = fptr;
+  out->n = out->nv = out->ne = 0;
+  out->vindex = gts_scratch_new (gts_surface_vertex_number (s));
+  out->eindex = gts_scratch_new (gts_surface_edge_number (s));
+
+  fputs (BINARY_SIGNATURE "\n", fptr);
+  binary_put_uint32 (out, BINARY_VERSION);
+  binary_put_uint32 (out, gts_surface_vertex_number (s));
+  binary_put_uint32 (out, gts_surface_edge_number (s));
+  binary_put_uint32 (out, gts_surface_face_number (s));
+  binary_put_uint32 (out, nb);
+  gts_surface_foreach_vertex (s, (GtsFunc) write_vertex_binary, out);
+  gts_surface_foreach_edge (s, (GtsFunc) write_edge_binary, out);
+  gts_surface_foreach_face (s, (GtsFunc) write_face_binary, out);
+  if (color) {
+    binary_put_uint32 (out, BINARY_COLOR);
+    binary_put_uint32 (out, 0);
+    binary_put_uint32 (out, 12);
+    gts_surface_foreach_vertex (s, (GtsFunc) write_color_binary, out);
   }
-  gts_range_add_value (&stats->edges_per_vertex, nedges);
+  if (normal) {
+    binary_put_uint32 (out, BINARY_NORMAL);
+    binary_put_uint32 (out, 0);
+    binary_put_uint32 (out, 24);
+    gts_surface_foreach_vertex (s, (GtsFunc) write_normal_binary, out);
+  }
+  binary_flush (out);
+
+  gts_scratch_destroy (out->vindex);
+  gts_scratch_destroy (out->eindex);
+  g_free (out);
 }
 
-static void stats_foreach_edge (GtsEdge * e, GtsSurfaceStats * stats)
+static void write_face_stl (GtsTriangle * t, FILE * fp)
 {
-  guint nt = gts_edge_face_number (e, stats->parent);
+  GtsVertex * v1, * v2, * v3;
+  GtsVector n;
 
-  if (gts_segment_is_duplicate (GTS_SEGMENT (e)))
-    stats->n_duplicate_edges++;
-  if (nt == 1)
-    stats->n_boundary_edges++;
-  else if (nt > 2)
-    stats->n_non_manifold_edges++;
-  gts_range_add_value (&stats->faces_per_edge, nt);
+  gts_triangle_vertices (t, &v1, &v2, &v3);
+  gts_triangle_normal (t, &n[0], &n[1], &n[2]);
+  gts_vector_normalize (n);
+  fprintf (fp, "facet normal %g %g %g\nouter loop\n", n[0], n[1], n[2]);
+  fprintf (fp, "vertex %g %g %g\n", 
+           GTS_POINT (v1)->x, GTS_POINT (v1)->y, GTS_POINT (v1)->z);
+  fprintf (fp, "vertex %g %g %g\n", 
+           GTS_POINT (v2)->x, GTS_POINT (v2)->y, GTS_POINT (v2)->z);
+  fprintf (fp, "vertex %g %g %g\n", 
+           GTS_POINT (v3)->x, GTS_POINT (v3)->y, GTS_POINT (v3)->z);
+  fputs ("endloop\nendfacet\n", fp);
 }
 
-static void stats_foreach_face (GtsTriangle * t, GtsSurfaceStats * stats)
+static void write_face_stl_binary (GtsTriangle * t, BinaryOutput * out)
 {
-  if (!gts_face_is_compatible (GTS_FACE (t), stats->parent))
-    stats->n_incompatible_faces++;
-  if (gts_triangle_is_duplicate (t))
-    stats->n_duplicate_faces++;
-  stats->n_faces++;
+  GtsVertex * v[3];
+  GtsVector n;
+  guint i;
+
+  gts_triangle_vertices (t, &v[0], &v[1], &v[2]);
+  gts_triangle_normal (t, &n[0], &n[1], &n[2]);
+  gts_vector_normalize (n);
+  for (i = 0; i < 3; i++)
+    binary_put_float (out, n[i]);
+  for (i = 0; i < 3; i++) {
+    binary_put_float (out, GTS_POINT (v[i])->x);
+    binary_put_float (out, GTS_POINT (v[i])->y);
+    binary_put_float (out, GTS_POINT (v[i])->z);
+  }
+  binary_put_uint16 (out, 0);
 }
 
 /**
- * gts_surface_stats:
+ * gts_surface_write_stl:
  * @s: a #GtsSurface.
- * @stats: a #GtsSurfaceStats.
+ * @fptr: a file pointer.
+ * @binary: whether to use the binary STL format.
  *
- * Fills @stats with the statistics relevant to surface @s.
+ * Writes in the file @fptr an STL representation of the faces of @s,
+ * either in binary or in ASCII format. The STL format uses single
+ * precision for binary files and six significant digits for ASCII
+ * files.
  */
-void gts_surface_stats (GtsSurface * s, GtsSurfaceStats * stats)
+void gts_surface_write_stl (GtsSurface * s, FILE * fptr, gboolean binary)
 {
   g_return_if_fail (s != NULL);
-  g_return_if_fail (stats != NULL);
+  g_return_if_fail (fptr != NULL);
 
-  stats->parent = s;
-  stats->n_faces = 0;
-  stats->n_incompatible_faces = 0;
-  stats->n_duplicate_faces = 0;
-  stats->n_duplicate_edges = 0;
-  stats->n_boundary_edges = 0;
-  stats->n_non_manifold_edges = 0;
-  gts_range_init (&stats->edges_per_vertex);
-  gts_range_init (&stats->faces_per_edge);
+  if (binary) {
+    BinaryOutput * out = g_malloc0 (sizeof (BinaryOutput));
+    gchar header[80];
+    guint i;
+
+    memset (header, ' ', 80);
+    memcpy (header, "binary STL file written by GTS", 30);
+    out->fp = fptr;
+    for (i = 0; i < 80; i++)
+      out->buf[out->n++] = header[i];
+    binary_put_uint32 (out, gts_surface_face_number (s));
+    gts_surface_foreach_face (s, (GtsFunc) write_face_stl_binary, out);
+    binary_flush (out);
+    g_free (out);
+  }
+  else {
+    fputs ("solid\n", fptr);
+    gts_surface_foreach_face (s, (GtsFunc) write_face_stl, fptr);
+    fputs ("endsolid\n", fptr);
+  }
+}
 
-  gts_surface_foreach_vertex (s, (GtsFunc) stats_foreach_vertex, stats);
-  gts_surface_foreach_edge (s, (GtsFunc) stats_foreach_edge, stats);
-  gts_surface_foreach_face (s, (GtsFunc) stats_foreach_face, stats);
+typedef struct {
+  BinaryOutput * out;
+  gboolean binary, color, normal;
+} PlyOutput;
 
-  gts_range_update (&stats->edges_per_vertex);
-  gts_range_update (&stats->faces_per_edge);
+static guchar ply_color (gfloat c)
+{
+  return CLAMP (c, 0., 1.)*255. + 0.5;
 }
 
-static void quality_foreach_edge (GtsSegment * s,
-                                  GtsSurfaceQualityStats * stats)
+static void write_vertex_ply (GtsPoint * p, PlyOutput * ply)
 {
-  GSList * i = GTS_EDGE (s)->triangles;
-
-  gts_range_add_value (&stats->edge_length,
-                   gts_point_distance (GTS_POINT (s->v1),
-                                       GTS_POINT (s->v2)));
-  while (i) {
-    GSList * j = i->next;
-    while (j) {
-      gts_range_add_value (&stats->edge_angle,
-                           fabs (gts_triangles_angle (i->data, j->data)));
-      j = j->next;
+  BinaryOutput * out = ply->out;
+
+  gts_scratch_set (out->vindex, p, GUINT_TO_POINTER (out->nv++));
+  if (ply->binary) {
+    binary_put_double (out, p->x);
+    binary_put_double (out, p->y);
+    binary_put_double (out, p->z);
+    if (ply->normal) {
+      binary_put_double (out, GTS_VERTEX_NORMAL (p)->n[0]);
+      binary_put_double (out, GTS_VERTEX_NORMAL (p)->n[1]);
+      binary_put_double (out, GTS_VERTEX_NORMAL (p)->n[2]);
     }
-    i = i->next;
+    if (ply->color) {
+      binary_put_uint8 (out, ply_color (GTS_COLOR_VERTEX (p)->c.r));
+      binary_put_uint8 (out, ply_color (GTS_COLOR_VERTEX (p)->c.g));
+      binary_put_uint8 (out, ply_color (GTS_COLOR_VERTEX (p)->c.b));
+    }
+  }
+  else {
+    fprintf (out->fp, "%.10g %.10g %.10g", p->x, p->y, p->z);
+    if (ply->normal)
+      fprintf (out->fp, " %.10g %.10g %.10g",
+               GTS_VERTEX_NORMAL (p)->n[0],
+               GTS_VERTEX_NORMAL (p)->n[1],
+               GTS_VERTEX_NORMAL (p)->n[2]);
+    if (ply->color)
+      fprintf (out->fp, " %u %u %u",
+               ply_color (GTS_COLOR_VERTEX (p)->c.r),
+               ply_color (GTS_COLOR_VERTEX (p)->c.g),
+               ply_color (GTS_COLOR_VERTEX (p)->c.b));
+    fputc ('\n', out->fp);
   }
 }
 
-static void quality_foreach_face (GtsTriangle * t,
-                                  GtsSurfaceQualityStats * stats)
+static void write_face_ply (GtsTriangle * t, PlyOutput * ply)
 {
-  gts_range_add_value (&stats->face_quality, gts_triangle_quality (t));
-  gts_range_add_value (&stats->face_area, gts_triangle_area (t));
+  BinaryOutput * out = ply->out;
+  GtsVertex * v[3];
+  guint i;
+
+  gts_triangle_vertices (t, &v[0], &v[1], &v[2]);
+  if (ply->binary) {
+    binary_put_uint8 (out, 3);
+    for (i = 0; i < 3; i++)
+      binary_put_uint32 (out, 
+                         GPOINTER_TO_UINT (gts_scratch_get (out->vindex, v[i])));
+  }
+  else
+    fprintf (out->fp, "3 %u %u %u\n",
+             GPOINTER_TO_UINT (gts_scratch_get (out->vindex, v[0])),
+             GPOINTER_TO_UINT (gts_scratch_get (out->vindex, v[1])),
+             GPOINTER_TO_UINT (gts_scratch_get (out->vindex, v[2])));
 }
 
 /**
- * gts_surface_quality_stats:
+ * gts_surface_write_ply:
  * @s: a #GtsSurface.
- * @stats: a #GtsSurfaceQualityStats.
+ * @fptr: a file pointer.
+ * @binary: whether to use the binary (little-endian) PLY format.
  *
- * Fills @stats with quality statistics relevant to surface @s.
+ * Writes in the file @fptr a PLY representation of @s, either in
+ * binary or in ASCII format. The coordinates of the vertices are
+ * written as doubles. The normals of #GtsVertexNormal and the colors
+ * (as unsigned chars) of #GtsColorVertex are also written.
  */
-void gts_surface_quality_stats (GtsSurface * s, GtsSurfaceQualityStats * stats)
+void gts_surface_write_ply (GtsSurface * s, FILE * fptr, gboolean binary)
 {
+  PlyOutput ply;
+
   g_return_if_fail (s != NULL);
-  g_return_if_fail (stats != NULL);
+  g_return_if_fail (fptr != NULL);
 
-  stats->parent = s;
-  gts_range_init (&stats->face_quality);
-  gts_range_init (&stats->face_area);
-  gts_range_init (&stats->edge_length);
-  gts_range_init (&stats->edge_angle);
+  ply.binary = binary;
+  ply.color = gts_object_class_is_from_class (s->vertex_class,
+                                              gts_color_vertex_class ()) != NULL;
+  ply.normal = gts_object_class_is_from_class (s->vertex_class,
+                                               gts_vertex_normal_class ()) != NULL;
+  ply.out = g_malloc (sizeof (BinaryOutput));
+  ply.out->fp = fptr;
+  ply.out->n = ply.out->nv = 0;
+  ply.out->vindex = gts_scratch_new (gts_surface_vertex_number (s));
 
-  gts_surface_foreach_edge (s, (GtsFunc) quality_foreach_edge, stats);
-  gts_surface_foreach_face (s, (GtsFunc) quality_foreach_face, stats);
+  fprintf (fptr,
+           "ply\n"
+           "format %s 1.0\n"
+           "comment written by GTS\n"
+           "element vertex %u\n"
+           "property double x\n"
+           "property double y\n"
+           "property double z\n",
+           binary ? "binary_little_endian" : "ascii",
+           gts_surface_vertex_number (s));
+  if (ply.normal)
+    fputs ("property double nx\n"
+           "property double ny\n"
+           "property double nz\n", fptr);
+  if (ply.color)
+    fputs ("property uchar red\n"
+           "property uchar green\n"
+           "property uchar blue\n", fptr);
+  fprintf (fptr,
+           "element face %u\n"
+           "property list uchar int vertex_indices\n"
+           "end_header\n",
+           gts_surface_face_number (s));
+  gts_surface_foreach_vertex (s, (GtsFunc) write_vertex_ply, &ply);
+  gts_surface_foreach_face (s, (GtsFunc) write_face_ply, &ply);
+  binary_flush (ply.out);
+
+  gts_scratch_destroy (ply.out->vindex);
+  g_free (ply.out);
+}
 
-  gts_range_update (&stats->face_quality);
-  gts_range_update (&stats->face_area);
-  gts_range_update (&stats->edge_length);
-  gts_range_update (&stats->edge_angle);
+/* Triangle soups */
+
+typedef struct {
+  BinaryOutput * out;
+  glong offset;             /* position of the header in the file or -1 */
+  guint64 nt, header_nt;
+  gfloat bbox[6];
+} SoupOutput;
+
+static void soup_init (SoupOutput * soup, FILE * fptr)
+{
+  soup->out = g_malloc (sizeof (BinaryOutput));
+  soup->out->fp = fptr;
+  soup->out->n = 0;
+  soup->offset = ftell (fptr);
+  soup->nt = soup->header_nt = 0;
+  soup->bbox[0] = soup->bbox[1] = soup->bbox[2] = G_MAXFLOAT;
+  soup->bbox[3] = soup->bbox[4] = soup->bbox[5] = - G_MAXFLOAT;
+}
+
+static void soup_bbox_add (SoupOutput * soup, const gfloat * x)
+{
+  guint i;
+
+  for (i = 0; i < 3; i++) {
+    if (x[i] < soup->bbox[i])
+      soup->bbox[i] = x[i];
+    if (x[i] > soup->bbox[i + 3])
+      soup->bbox[i + 3] = x[i];
+  }
+}
+
+static void soup_write_header (SoupOutput * soup, guint64 nt)
+{
+  const gchar * s = GTS_SOUP_SIGNATURE;
+  gboolean empty = soup->bbox[0] > soup->bbox[3];
+  guint i;
+
+  soup->header_nt = nt;
+  while (*s)
+    binary_put_uint8 (soup->out, *s++);
+  binary_put_uint32 (soup->out, GTS_SOUP_VERSION);
+  binary_put_uint32 (soup->out, nt);
+  binary_put_uint32 (soup->out, nt >> 32);
+  for (i = 0; i < 6; i++)
+    binary_put_double (soup->out, empty ? 0. : soup->bbox[i]);
+}
+
+static void soup_write_triangle (SoupOutput * soup, const gfloat * x)
+{
+  guint i;
+
+  for (i = 0; i < 9; i++)
+    binary_put_float (soup->out, x[i]);
+  soup->nt++;
+}
+
+/* Flushes the output and, if the header does not give the number of
+   triangles written, updates it when possible */
+static void soup_finish (SoupOutput * soup)
+{
+  FILE * fptr = soup->out->fp;
+
+  binary_flush (soup->out);
+  if (soup->nt != soup->header_nt && soup->offset >= 0 &&
+      !fseek (fptr, soup->offset + GTS_SOUP_NT_OFFSET, SEEK_SET)) {
+    binary_put_uint32 (soup->out, soup->nt);
+    binary_put_uint32 (soup->out, soup->nt >> 32);
+    binary_flush (soup->out);
+    fseek (fptr, 0, SEEK_END);
+  }
+  g_free (soup->out);
+}
+
+static void soup_point (GtsPoint * p, gfloat * x)
+{
+  x[0] = p->x; x[1] = p->y; x[2] = p->z;
+}
+
+static void bbox_vertex_soup (GtsPoint * p, SoupOutput * soup)
+{
+  gfloat x[3];
+
+  soup_point (p, x);
+  soup_bbox_add (soup, x);
+}
+
+static void write_face_soup (GtsTriangle * t, SoupOutput * soup)
+{
+  GtsVertex * v1, * v2, * v3;
+  gfloat x[9];
+
+  gts_triangle_vertices (t, &v1, &v2, &v3);
+  soup_point (GTS_POINT (v1), x);
+  soup_point (GTS_POINT (v2), x + 3);
+  soup_point (GTS_POINT (v3), x + 6);
+  soup_write_triangle (soup, x);
 }
 
 /**
- * gts_surface_print_stats:
+ * gts_surface_write_triangle_soup:
  * @s: a #GtsSurface.
  * @fptr: a file pointer.
  *
- * Writes in the file pointed to by @fptr the statistics for surface @s.
+ * Writes in the file @fptr the faces of @s as a triangle soup, the
+ * binary format read by gts_cluster_grid_read_triangle_soup() for
+ * out-of-core simplification.
+ *
+ * The file starts with a header made of the "GtsTriangleSoup"
+ * signature followed by a newline, the version of the format (1) as
+ * a 32-bit integer, the number of triangles as a 64-bit integer and
+ * the bounding box of the triangles (x1, y1, z1, x2, y2, z2) as six
+ * doubles. It is followed by the coordinates of the three vertices
+ * of each triangle, as nine floats. All the numbers are
+ * little-endian. A number of triangles of 0 in the header means that
+ * the triangles extend to the end of the file.
+ *
+ * As in binary STL files, the coordinates are stored in single
+ * precision.
  */
-void gts_surface_print_stats (GtsSurface * s, FILE * fptr)
+void gts_surface_write_triangle_soup (GtsSurface * s, FILE * fptr)
 {
-  GtsSurfaceStats stats;
-  GtsSurfaceQualityStats qstats;
+  SoupOutput soup;
+  guint nt;
 
   g_return_if_fail (s != NULL);
   g_return_if_fail (fptr != NULL);
 
-  gts_surface_stats (s, &stats);
-  gts_surface_quality_stats (s, &qstats);
-
-  fprintf (fptr,
-           "# vertices: %u edges: %u faces: %u\n"
-           "# Connectivity statistics\n"
-           "#   incompatible faces: %u\n"
-           "#   duplicate faces: %u\n"
-           "#   boundary edges: %u\n"
-           "#   duplicate edges: %u\n"
-           "#   non-manifold edges: %u\n",
-           stats.edges_per_vertex.n,
-           stats.faces_per_edge.n,
-           stats.n_faces,
-           stats.n_incompatible_faces,
-           stats.n_duplicate_faces,
-           stats.n_boundary_edges,
-           stats.n_duplicate_edges,
-           stats.n_non_manifold_edges);
-  fputs ("#   edges per vertex: ", fptr);
-  gts_range_print (&stats.edges_per_vertex, fptr);
-  fputs ("\n#   faces per edge: ", fptr);
-  gts_range_print (&stats.faces_per_edge, fptr);
-  fputs ("\n# Geometric statistics\n#   face quality: ", fptr);
-  gts_range_print (&qstats.face_quality, fptr);
-  fputs ("\n#   face area  : ", fptr);
-  gts_range_print (&qstats.face_area, fptr);
-  fputs ("\n#   edge length : ", fptr);
-  gts_range_print (&qstats.edge_length, fptr);
-  fputc ('\n', fptr);
+  soup_init (&soup, fptr);
+  nt = gts_surface_face_number (s);
+  gts_surface_foreach_vertex (s, (GtsFunc) bbox_vertex_soup, &soup);
+  soup_write_header (&soup, nt);
+  gts_surface_foreach_face (s, (GtsFunc) write_face_soup, &soup);
+  soup_finish (&soup);
 }
 
-static void write_vertex (GtsPoint * p, gpointer * data)
+static void soup_convert_stl (GtsFile * f, SoupOutput * soup)
 {
-  (*GTS_OBJECT (p)->klass->write) (GTS_OBJECT (p), (FILE *) data[0]);
-  if (!GTS_POINT_CLASS (GTS_OBJECT (p)->klass)->binary)
-    fputc ('\n', (FILE *) data[0]);
-  g_hash_table_insert (data[2], p,
-                       GUINT_TO_POINTER (++(*((guint *) data[1]))));
+  const guchar * p = (const guchar *) f->map->start, * q;
+  gsize length = f->map->end - f->map->start;
+  gfloat x[9];
+  guint64 i, nt;
+  guint j;
+
+  if (stl_is_binary (p, length)) {
+    if (length < 84) {
+      gts_file_error (f, "incomplete binary STL header");
+      return;
+    }
+    nt = binary_get_uint32 (p + 80);
+    if (84 + 50*nt > length) {
+      gts_file_error (f, "expecting %u facets, file too short", (guint) nt);
+      return;
+    }
+    /* the facets are read twice, first for the bounding box */
+    for (i = 0, q = p + 84; i < nt; i++, q += 50)
+      for (j = 0; j < 9; j += 3) {
+        x[0] = binary_get_float (q + 12 + 4*j);
+        x[1] = binary_get_float (q + 16 + 4*j);
+        x[2] = binary_get_float (q + 20 + 4*j);
+        soup_bbox_add (soup, x);
+      }
+    soup_write_header (soup, nt);
+    for (i = 0, q = p + 84; i < nt; i++, q += 50) {
+      for (j = 0; j < 9; j++)
+        x[j] = binary_get_float (q + 12 + 4*j);
+      soup_write_triangle (soup, x);
+    }
+  }
+  else {
+    GArray * coords;
+    const gdouble * c;
+
+    if (!(coords = stl_read_ascii (f)))
+      return;
+    c = (const gdouble *) coords->data;
+    nt = coords->len/9;
+    for (i = 0; i < 3*nt; i++) {
+      x[0] = c[3*i]; x[1] = c[3*i + 1]; x[2] = c[3*i + 2];
+      soup_bbox_add (soup, x);
+    }
+    soup_write_header (soup, nt);
+    for (i = 0; i < nt; i++, c += 9) {
+      for (j = 0; j < 9; j++)
+        x[j] = c[j];
+      soup_write_triangle (soup, x);
+    }
+    g_array_free (coords, TRUE);
+  }
+  f->s = f->map->end;
+  f->next_token = '\0';
+  gts_file_next_token (f);
 }
 
-static void write_edge (GtsSegment * s, gpointer * data)
+static void soup_convert_ply (GtsFile * f, SoupOutput * soup)
 {
-  fprintf ((FILE *) data[0], "%u %u",
-           GPOINTER_TO_UINT (g_hash_table_lookup (data[2], s->v1)),
-           GPOINTER_TO_UINT (g_hash_table_lookup (data[2], s->v2)));
-  if (GTS_OBJECT (s)->klass->write)
-    (*GTS_OBJECT (s)->klass->write) (GTS_OBJECT (s), (FILE *) data[0]);
-  fputc ('\n', (FILE *) data[0]);
-  g_hash_table_insert (data[3], s,
-                       GUINT_TO_POINTER (++(*((guint *) data[1]))));
-}
+  GPtrArray * elements;
+  gfloat * xyz = NULL;
+  gboolean header = FALSE;
+  guint nv = 0, i;
+  PlyInput in;
+
+  in.f = f;
+  if (!(elements = ply_read_start (&in)))
+    return;
 
-static void write_face (GtsTriangle * t, gpointer * data)
-{
-  fprintf (data[0], "%u %u %u",
-           GPOINTER_TO_UINT (g_hash_table_lookup (data[3], t->e1)),
-           GPOINTER_TO_UINT (g_hash_table_lookup (data[3], t->e2)),
-           GPOINTER_TO_UINT (g_hash_table_lookup (data[3], t->e3)));
-  if (GTS_OBJECT (t)->klass->write)
-    (*GTS_OBJECT (t)->klass->write) (GTS_OBJECT (t), data[0]);
-  fputc ('\n', data[0]);
+  for (i = 0; i < elements->len && f->type != GTS_ERROR; i++) {
+    PlyElement * e = elements->pdata[i];
+    gdouble record[PLY_INDICES];
+    guint j;
+
+    if (!strcmp (e->name, "vertex") && xyz == NULL) {
+      guint size = MIN (e->n, PLY_CHUNK);
+
+      xyz = g_malloc ((3*(gsize) size + 1)*sizeof (gfloat));
+      memset (record, 0, sizeof (record));
+      for (j = 0; j < e->n && f->type != GTS_ERROR; j++)
+        if (!ply_read_element (&in, e, record, NULL))
+          gts_file_error (f, "expecting a number (vertex %u)", j);
+        else {
+          gfloat * x;
+
+          if (nv == size) {
+            size = ply_grow (size, e->n);
+            xyz = g_realloc (xyz, (3*(gsize) size + 1)*sizeof (gfloat));
+          }
+          x = &xyz[3*nv++];
+          x[0] = record[PLY_X]; x[1] = record[PLY_Y]; x[2] = record[PLY_Z];
+          soup_bbox_add (soup, x);
+        }
+      /* the number of triangles is not known yet */
+      soup_write_header (soup, 0);
+      header = TRUE;
+    }
+    else if (!strcmp (e->name, "face")) {
+      GArray * indices = g_array_new (FALSE, FALSE, sizeof (guint));
+
+      if (xyz == NULL)
+        gts_file_error (f, "faces defined before vertices");
+      for (j = 0; j < e->n && f->type != GTS_ERROR; j++) {
+        guint k, * id;
+
+        g_array_set_size (indices, 0);
+        if (!ply_read_element (&in, e, record, indices)) {
+          gts_file_error (f, "expecting a number (face %u)", j);
+          break;
+        }
+        id = (guint *) indices->data;
+        for (k = 0; k < indices->len; k++)
+          if (id[k] >= nv) {
+            gts_file_error (f, "invalid vertex index `%u' for face %u",
+                            id[k], j);
+            break;
+          }
+        for (k = 2; k < indices->len && f->type != GTS_ERROR; k++) {
+          gfloat x[9];
+
+          memcpy (x, &xyz[3*id[0]], 3*sizeof (gfloat));
+          memcpy (x + 3, &xyz[3*id[k - 1]], 3*sizeof (gfloat));
+          memcpy (x + 6, &xyz[3*id[k]], 3*sizeof (gfloat));
+          soup_write_triangle (soup, x);
+        }
+      }
+      g_array_free (indices, TRUE);
+    }
+    else
+      for (j = 0; j < e->n && f->type != GTS_ERROR; j++)
+        if (!ply_read_element (&in, e, record, NULL))
+          gts_file_error (f, "expecting a number (element `%s')", e->name);
+  }
+  if (!header)
+    soup_write_header (soup, 0);
+  if (f->type != GTS_ERROR && in.format != PLY_ASCII)
+    gts_file_next_token (f);
+
+  g_free (xyz);
+  g_ptr_array_foreach (elements, (GFunc) ply_element_destroy, NULL);
+  g_ptr_array_free (elements, TRUE);
 }
 
 /**
- * gts_surface_write:
- * @s: a #GtsSurface.
+ * gts_triangle_soup_convert:
+ * @f: a #GtsFile.
  * @fptr: a file pointer.
  *
- * Writes in the file @fptr an ASCII representation of @s. The file
- * format is as follows.
- *
- * All the lines beginning with #GTS_COMMENTS are ignored. The first line
- * contains three unsigned integers separated by spaces. The first
- * integer is the number of vertices, nv, the second is the number of
- * edges, ne and the third is the number of faces, nf.
+ * Writes in the file @fptr the triangles of the STL or PLY file @f as
+ * a triangle soup (see gts_surface_write_triangle_soup()), without
+ * building a #GtsSurface. STL files can only be converted if @f was
+ * created with gts_file_new_mapped().
  *
- * Follows nv lines containing the x, y and z coordinates of the
- * vertices.  Follows ne lines containing the two indices (starting
- * from one) of the vertices of each edge. Follows nf lines containing
- * the three ordered indices (also starting from one) of the edges of
- * each face.
+ * The triangles are written as they are read, so that only the
+ * vertices of PLY files and the coordinates of ASCII STL files are
+ * kept in memory. The faces of PLY files with more than three
+ * vertices are triangulated. Since their number of triangles is not
+ * known in advance, it is only written in the header if @fptr can
+ * seek.
  *
- * The format described above is the least common denominator to all
- * GTS files.  Consistent with an object-oriented approach, the GTS
- * file format is extensible. Each of the lines of the file can be
- * extended with user-specific attributes accessible through the
- * read() and write() virtual methods of each of the objects written
- * (surface, vertices, edges or faces). When read with different
- * object classes, these extra attributes are just ignored.
+ * Returns: 0 if successful or the line number at which the parsing
+ * stopped in case of error (in which case the @error field of @f is
+ * set to a description of the error which occured).
  */
-void gts_surface_write (GtsSurface * s, FILE * fptr)
+guint gts_triangle_soup_convert (GtsFile * f, FILE * fptr)
 {
-  guint n;
-  gpointer data[4];
-  GHashTable * vindex, * eindex;
-  GtsSurfaceStats stats;
+  SoupOutput soup;
 
-  g_return_if_fail (s != NULL);
-  g_return_if_fail (fptr != NULL);
+  g_return_val_if_fail (f != NULL, 1);
+  g_return_val_if_fail (fptr != NULL, 1);
 
-  data[0] = fptr;
-  data[1] = &n;
-  data[2] = vindex = g_hash_table_new (NULL, NULL);
-  data[3] = eindex = g_hash_table_new (NULL, NULL);
+  if (f->type == GTS_ERROR)
+    return f->line;
 
-  gts_surface_stats (s, &stats);
-  fprintf (fptr, "%u %u %u",
-           stats.edges_per_vertex.n,
-           stats.faces_per_edge.n,
-           stats.n_faces);
-  if (GTS_OBJECT (s)->klass->write)
-    (*GTS_OBJECT (s)->klass->write) (GTS_OBJECT (s), fptr);
-  fputc ('\n', fptr);
-  n = 0;
-  gts_surface_foreach_vertex (s, (GtsFunc) write_vertex, data);
-  n = 0;
-  if (GTS_POINT_CLASS (s->vertex_class)->binary)
-    fputc ('\n', fptr);
-  gts_surface_foreach_edge (s, (GtsFunc) write_edge, data);
-  gts_surface_foreach_face (s, (GtsFunc) write_face, data);
-  g_hash_table_destroy (vindex);
-  g_hash_table_destroy (eindex);
+  soup_init (&soup, fptr);
+  if (f->type == GTS_NONE) /* empty file */
+    soup_write_header (&soup, 0);
+  else if (f->map == NULL ||
+           (f->map->end - f->map->start >= 3 && 
+            !strncmp (f->map->start, "ply", 3))) {
+    gchar * delimiters = f->delimiters, * comments = f->comments;
+
+    /* comments and carriage returns are not special in PLY headers */
+    f->delimiters = " \t\r";
+    f->comments = "";
+    soup_convert_ply (f, &soup);
+    f->delimiters = delimiters;
+    f->comments = comments;
+  }
+  else
+    soup_convert_stl (f, &soup);
+  soup_finish (&soup);
+
+  if (f->type == GTS_ERROR)
+    return f->line;
+  return 0;
 }
 
 static void write_vertex_obj (GtsPoint * p, gpointer * data)
@@ -1070,38 +4109,42 @@ void gts_surface_write_oogl_boundary (GtsSurface * s, FILE * fptr)
   fputs ("}\n", fptr);
 }
 
-#ifdef USE_SURFACE_BTREE
-static gint vertex_foreach_face (GtsTriangle * t,
-                                 gpointer t_data,
-                                 gpointer * info)
-#else /* not USE_SURFACE_BTREE */
-static void vertex_foreach_face (GtsTriangle * t,
-                                 gpointer t_data,
-                                 gpointer * info)
-#endif /* not USE_SURFACE_BTREE */
-{
-  GHashTable * hash = info[0];
-  gpointer data = info[1];
-  GtsFunc func = (GtsFunc) info[2];
-  GtsSegment
-    * s1 = GTS_SEGMENT (t->e1);
-
-  if (!g_hash_table_lookup (hash, s1->v1)) {
-    (*func) (s1->v1, data);
-    g_hash_table_insert (hash, s1->v1, GINT_TO_POINTER (-1));
-  }
-  if (!g_hash_table_lookup (hash, s1->v2)) {
-    (*func) (s1->v2, data);
-    g_hash_table_insert (hash, s1->v2, GINT_TO_POINTER (-1));
-  }
-  if (!g_hash_table_lookup (hash, gts_triangle_vertex (t))) {
-    (*func) (gts_triangle_vertex (t), data);
-    g_hash_table_insert (hash, gts_triangle_vertex (t),
-                         GINT_TO_POINTER (-1));
-  }
-#ifdef USE_SURFACE_BTREE
-  return FALSE;
-#endif /* USE_SURFACE_BTREE */
+/* Vertices and edges visited by the current traversal are stamped
+   with visit_epoch. Only one traversal at a time can own the stamps:
+   nested traversals (started from within the user function) and
+   traversals running concurrently in other threads fall back to a
+   hash table. */
+static guint64 visit_epoch = 0;
+static volatile gint visit_depth = 0;
+
+/* Returns %TRUE if the calling traversal owns the visit stamps, in
+   which case visit_epoch has been incremented */
+static gboolean visit_begin (void)
+{
+  if (g_atomic_int_add (&visit_depth, 1) > 0)
+    return FALSE;
+  visit_epoch++;
+  return TRUE;
+}
+
+static void visit_end (void)
+{
+  g_atomic_int_add (&visit_depth, -1);
+}
+
+static void vertex_visit (GtsVertex * v, GHashTable * hash,
+			  GtsFunc func, gpointer data)
+{
+  if (hash) {
+    if (!g_hash_table_lookup (hash, v)) {
+      (*func) (v, data);
+      g_hash_table_insert (hash, v, GINT_TO_POINTER (-1));
+    }
+  }
+  else if (v->visit != visit_epoch) {
+    v->visit = visit_epoch;
+    (*func) (v, data);
+  }
 }
 
 /**
@@ -1110,60 +4153,51 @@ static void vertex_foreach_face (GtsTriangle * t,
  * @func: a #GtsFunc.
  * @data: user data to be passed to @func.
  *
- * Calls @func once for each vertex of @s.
+ * Calls @func once for each vertex of @s. Apart from nested calls (from
+ * within @func) or calls running concurrently in other threads, no
+ * memory is allocated. Several threads can traverse surfaces at the
+ * same time as long as none of them modifies the surfaces.
  */
 void gts_surface_foreach_vertex (GtsSurface * s, GtsFunc func, gpointer data)
 {
-  gpointer info[3];
+  GHashTable * hash = NULL;
+  guint i;
 
   g_return_if_fail (s != NULL);
   g_return_if_fail (func != NULL);
 
   /* forbid removal of faces */
   s->keep_faces = TRUE;
-  info[0] = g_hash_table_new (NULL, NULL);
-  info[1] = data;
-  info[2] = func;
-#ifdef USE_SURFACE_BTREE
-  g_tree_traverse (s->faces, (GTraverseFunc) vertex_foreach_face, G_IN_ORDER,
-                   info);
-#else /* not USE_SURFACE_BTREE */
-  g_hash_table_foreach (s->faces, (GHFunc) vertex_foreach_face, info);
-#endif /* not USE_SURFACE_BTREE */
-  g_hash_table_destroy (info[0]);
+  if (!visit_begin ())
+    hash = g_hash_table_new (NULL, NULL);
+  for (i = 0; i < s->faces->len; i++) {
+    GtsTriangle * t = g_ptr_array_index (s->faces, i);
+    GtsSegment * s1 = GTS_SEGMENT (t->e1);
+
+    vertex_visit (s1->v1, hash, func, data);
+    vertex_visit (s1->v2, hash, func, data);
+    vertex_visit (gts_triangle_vertex (t), hash, func, data);
+  }
+  if (hash)
+    g_hash_table_destroy (hash);
+  visit_end ();
   /* allow removal of faces */
   s->keep_faces = FALSE;
 }
 
-#ifdef USE_SURFACE_BTREE
-static gint edge_foreach_face (GtsTriangle * t,
-                               gpointer t_data,
-                               gpointer * info)
-#else /* not USE_SURFACE_BTREE */
-static void edge_foreach_face (GtsTriangle * t,
-                               gpointer t_data,
-                               gpointer * info)
-#endif /* not USE_SURFACE_BTREE */
+static void edge_visit (GtsEdge * e, GHashTable * hash,
+			GtsFunc func, gpointer data)
 {
-  GHashTable * hash = info[0];
-  gpointer data = info[1];
-  GtsFunc func = (GtsFunc) info[2];
-
-  if (!g_hash_table_lookup (hash, t->e1)) {
-    (*func) (t->e1, data);
-    g_hash_table_insert (hash, t->e1, GINT_TO_POINTER (-1));
-  }
-  if (!g_hash_table_lookup (hash, t->e2)) {
-    (*func) (t->e2, data);
-    g_hash_table_insert (hash, t->e2, GINT_TO_POINTER (-1));
+  if (hash) {
+    if (!g_hash_table_lookup (hash, e)) {
+      (*func) (e, data);
+      g_hash_table_insert (hash, e, GINT_TO_POINTER (-1));
+    }
   }
-  if (!g_hash_table_lookup (hash, t->e3)) {
-    (*func) (t->e3, data);
-    g_hash_table_insert (hash, t->e3, GINT_TO_POINTER (-1));
+  else if (e->visit != visit_epoch) {
+    e->visit = visit_epoch;
+    (*func) (e, data);
   }
-#ifdef USE_SURFACE_BTREE
-  return FALSE;
-#endif /* not USE_SURFACE_BTREE */
 }
 
 /**
@@ -1172,47 +4206,37 @@ static void edge_foreach_face (GtsTriangle * t,
  * @func: a #GtsFunc.
  * @data: user data to be passed to @func.
  *
- * Calls @func once for each edge of @s.
+ * Calls @func once for each edge of @s. Apart from nested calls (from
+ * within @func) or calls running concurrently in other threads, no
+ * memory is allocated. Several threads can traverse surfaces at the
+ * same time as long as none of them modifies the surfaces.
  */
 void gts_surface_foreach_edge (GtsSurface * s, GtsFunc func, gpointer data)
 {
-  gpointer info[3];
+  GHashTable * hash = NULL;
+  guint i;
 
   g_return_if_fail (s != NULL);
   g_return_if_fail (func != NULL);
 
   /* forbid removal of faces */
   s->keep_faces = TRUE;
-  info[0] = g_hash_table_new (NULL, NULL);
-  info[1] = data;
-  info[2] = func;
-#ifdef USE_SURFACE_BTREE
-  g_tree_traverse (s->faces, (GTraverseFunc) edge_foreach_face, G_IN_ORDER,
-                   info);
-#else /* not USE_SURFACE_BTREE */
-  g_hash_table_foreach (s->faces, (GHFunc) edge_foreach_face, info);
-#endif /* not USE_SURFACE_BTREE */
-  g_hash_table_destroy (info[0]);
+  if (!visit_begin ())
+    hash = g_hash_table_new (NULL, NULL);
+  for (i = 0; i < s->faces->len; i++) {
+    GtsTriangle * t = g_ptr_array_index (s->faces, i);
+
+    edge_visit (t->e1, hash, func, data);
+    edge_visit (t->e2, hash, func, data);
+    edge_visit (t->e3, hash, func, data);
+  }
+  if (hash)
+    g_hash_table_destroy (hash);
+  visit_end ();
   /* allow removal of faces */
   s->keep_faces = FALSE;
 }
 
-#ifdef USE_SURFACE_BTREE
-static gint foreach_face (GtsFace * f,
-                          gpointer t_data,
-                          gpointer * info)
-#else /* not USE_SURFACE_BTREE */
-static void foreach_face (GtsFace * f,
-                          gpointer t_data,
-                          gpointer * info)
-#endif /* not USE_SURFACE_BTREE */
-{
-  (*((GtsFunc) info[0])) (f, info[1]);
-#ifdef USE_SURFACE_BTREE
-  return FALSE;
-#endif /* USE_SURFACE_BTREE */
-}
-
 /**
  * gts_surface_foreach_face:
  * @s: a #GtsSurface.
@@ -1225,71 +4249,19 @@ void gts_surface_foreach_face (GtsSurface * s,
                                GtsFunc func,
                                gpointer data)
 {
-  gpointer info[2];
+  guint i;
 
   g_return_if_fail (s != NULL);
   g_return_if_fail (func != NULL);
 
   /* forbid removal of faces */
   s->keep_faces = TRUE;
-  info[0] = func;
-  info[1] = data;
-#ifdef USE_SURFACE_BTREE
-  g_tree_traverse (s->faces, (GTraverseFunc) foreach_face, G_IN_ORDER,
-                   info);
-#else /* not USE_SURFACE_BTREE */
-  g_hash_table_foreach (s->faces, (GHFunc) foreach_face, info);
-#endif /* not USE_SURFACE_BTREE */
+  for (i = 0; i < s->faces->len; i++)
+    (*func) (g_ptr_array_index (s->faces, i), data);
   /* allow removal of faces */
   s->keep_faces = FALSE;
 }
 
-#ifdef USE_SURFACE_BTREE
-static gint foreach_face_remove (GtsFace * f,
-                                 gpointer t_data,
-                                 gpointer * info)
-{
-  if ((*((GtsFunc) info[0])) (f, info[1])) {
-    GtsSurface * s = info[2];
-    guint * n = info[3];
-
-    f->surfaces = g_slist_remove (f->surfaces, s);
-    if (!GTS_OBJECT_DESTROYED (f) &&
-        !gts_allow_floating_faces &&
-        f->surfaces == NULL)
-      gts_object_destroy (GTS_OBJECT (f));
-
-    if (GTS_SURFACE_CLASS (GTS_OBJECT (s)->klass)->remove_face)
-      (* GTS_SURFACE_CLASS (GTS_OBJECT (s)->klass)->remove_face) (s, f);
-
-    g_tree_remove (s->faces, f);
-    (*n)++;
-  }
-  return FALSE;
-}
-#else /* not USE_SURFACE_BTREE */
-static gboolean foreach_face_remove (GtsFace * f,
-                                     gpointer t_data,
-                                     gpointer * info)
-{
-  if ((*((GtsFunc) info[0])) (f, info[1])) {
-    GtsSurface * s = info[2];
-
-    f->surfaces = g_slist_remove (f->surfaces, s);
-    if (!GTS_OBJECT_DESTROYED (f) &&
-        !gts_allow_floating_faces &&
-        f->surfaces == NULL)
-      gts_object_destroy (GTS_OBJECT (f));
-
-    if (GTS_SURFACE_CLASS (GTS_OBJECT (s)->klass)->remove_face)
-      (* GTS_SURFACE_CLASS (GTS_OBJECT (s)->klass)->remove_face) (s, f);
-
-    return TRUE;
-  }
-  return FALSE;
-}
-#endif /* not USE_SURFACE_BTREE */
-
 /**
  * gts_surface_foreach_face_remove:
  * @s: a #GtsSurface.
@@ -1307,32 +4279,173 @@ guint gts_surface_foreach_face_remove (GtsSurface * s,
                                        GtsFunc func,
                                        gpointer data)
 {
-  gpointer info[4];
-  guint n = 0;
+  guint i = 0, n = 0;
 
   g_return_val_if_fail (s != NULL, 0);
   g_return_val_if_fail (func != NULL, 0);
 
   /* forbid removal of faces */
   s->keep_faces = TRUE;
-  info[0] = func;
-  info[1] = data;
-  info[2] = s;
-#ifdef USE_SURFACE_BTREE
-  info[3] = &n;
-  g_tree_traverse (s->faces, (GTraverseFunc) foreach_face_remove, G_PRE_ORDER,
-                   info);
-#else /* not USE_SURFACE_BTREE */
-  n = g_hash_table_foreach_remove (s->faces,
-                                   (GHRFunc) foreach_face_remove,
-                                   info);
-#endif /* not USE_SURFACE_BTREE */
+  while (i < s->faces->len) {
+    GtsFace * f = g_ptr_array_index (s->faces, i);
+
+    if ((*func) (f, data)) {
+      if (COUNTS_ARE_VALID (s))
+	counts_update_face (s, f, -1);
+      /* the last face is moved to @i */
+      faces_remove_index (s, i);
+      f->surfaces = g_slist_remove (f->surfaces, s);
+      if (!GTS_OBJECT_DESTROYED (f) &&
+	  !gts_allow_floating_faces &&
+	  f->surfaces == NULL)
+	gts_object_destroy (GTS_OBJECT (f));
+
+      if (GTS_SURFACE_CLASS (GTS_OBJECT (s)->klass)->remove_face)
+	(* GTS_SURFACE_CLASS (GTS_OBJECT (s)->klass)->remove_face) (s, f);
+      n++;
+    }
+    else
+      i++;
+  }
   /* allow removal of faces */
   s->keep_faces = FALSE;
 
   return n;
 }
 
+typedef struct {
+  gdouble * xyz, * normals;
+  GtsScratch * index;
+  gboolean vertex_normals;
+  guint nv;
+} ExportData;
+
+/* Returns the index of @v, exporting it if necessary */
+static guint export_vertex (GtsVertex * v, ExportData * d)
+{
+  GtsPoint * p = GTS_POINT (v);
+  guint i;
+
+  if ((i = GPOINTER_TO_UINT (gts_scratch_get (d->index, v))))
+    return i - 1;
+  gts_scratch_set (d->index, v, GUINT_TO_POINTER (d->nv + 1));
+
+  i = d->nv++;
+  if (d->xyz) {
+    d->xyz[3*i] = p->x;
+    d->xyz[3*i + 1] = p->y;
+    d->xyz[3*i + 2] = p->z;
+  }
+  if (d->normals && d->vertex_normals) {
+    d->normals[3*i] = GTS_VERTEX_NORMAL (v)->n[0];
+    d->normals[3*i + 1] = GTS_VERTEX_NORMAL (v)->n[1];
+    d->normals[3*i + 2] = GTS_VERTEX_NORMAL (v)->n[2];
+  }
+  return i;
+}
+
+/**
+ * gts_surface_export_arrays:
+ * @s: a #GtsSurface.
+ * @xyz: a pointer to an array of coordinates or %NULL.
+ * @normals: a pointer to an array of normals or %NULL.
+ * @triangles: a pointer to an array of vertex indices or %NULL.
+ * @nv: a pointer to the number of vertices or %NULL.
+ * @nt: a pointer to the number of triangles or %NULL.
+ *
+ * Exports @s as arrays suitable for gts_surface_new_from_arrays() or
+ * for rendering, in a single pass through the faces of @s.
+ *
+ * The vertices are numbered from zero, in order of first appearance
+ * in the faces. Their coordinates (three per vertex) are stored in
+ * *@xyz and their unit normals in *@normals. If the vertex class of
+ * @s is a #GtsVertexNormal its normals are used, otherwise the
+ * normals are the average of the normals of the faces weighted by
+ * their area. The indices of the vertices of each face (three per
+ * face) are stored in *@triangles, in the order given by
+ * gts_triangle_vertices() i.e. following the orientation of the face.
+ *
+ * If *@xyz, *@normals or *@triangles is %NULL, a new array is
+ * allocated, which must be freed with g_free(). Otherwise it must be
+ * large enough for the gts_surface_vertex_number() or
+ * gts_surface_face_number() elements of @s. If any of these pointers
+ * is %NULL, the corresponding array is not exported.
+ *
+ * The number of vertices and triangles exported are stored in *@nv
+ * and *@nt.
+ */
+void gts_surface_export_arrays (GtsSurface * s,
+				gdouble ** xyz,
+				gdouble ** normals,
+				guint ** triangles,
+				guint * nv,
+				guint * nt)
+{
+  guint nvertices, i;
+  guint * t = NULL;
+  ExportData d;
+
+  g_return_if_fail (s != NULL);
+
+  nvertices = gts_surface_vertex_number (s);
+  d.xyz = d.normals = NULL;
+  if (xyz)
+    d.xyz = *xyz ? *xyz : 
+      (*xyz = g_malloc ((3*(gsize) nvertices + 1)*sizeof (gdouble)));
+  if (normals) {
+    d.normals = *normals ? *normals :
+      (*normals = g_malloc ((3*(gsize) nvertices + 1)*sizeof (gdouble)));
+    d.vertex_normals = 
+      gts_object_class_is_from_class (s->vertex_class,
+				      gts_vertex_normal_class ()) != NULL;
+    if (!d.vertex_normals)
+      memset (d.normals, 0, 3*(gsize) nvertices*sizeof (gdouble));
+  }
+  if (triangles)
+    t = *triangles ? *triangles :
+      (*triangles = g_malloc ((3*(gsize) s->faces->len + 1)*sizeof (guint)));
+  d.nv = 0;
+  d.index = gts_scratch_new (nvertices);
+
+  for (i = 0; i < s->faces->len; i++) {
+    GtsTriangle * f = g_ptr_array_index (s->faces, i);
+    GtsVertex * v1, * v2, * v3;
+    guint i1, i2, i3;
+
+    gts_triangle_vertices (f, &v1, &v2, &v3);
+    i1 = export_vertex (v1, &d);
+    i2 = export_vertex (v2, &d);
+    i3 = export_vertex (v3, &d);
+    if (t) {
+      t[3*i] = i1;
+      t[3*i + 1] = i2;
+      t[3*i + 2] = i3;
+    }
+    if (d.normals && !d.vertex_normals) {
+      GtsVector n;
+      guint j;
+
+      /* the norm of the normal is twice the area of the face */
+      gts_triangle_normal (f, &n[0], &n[1], &n[2]);
+      for (j = 0; j < 3; j++) {
+	d.normals[3*i1 + j] += n[j];
+	d.normals[3*i2 + j] += n[j];
+	d.normals[3*i3 + j] += n[j];
+      }
+    }
+  }
+
+  gts_scratch_destroy (d.index);
+  if (d.normals)
+    for (i = 0; i < d.nv; i++)
+      gts_vector_normalize (&d.normals[3*i]);
+
+  if (nv)
+    *nv = d.nv;
+  if (nt)
+    *nt = s->faces->len;
+}
+
 static void midvertex_insertion (GtsEdge * e,
                                  GtsSurface * surface,
                                  GtsEHeap * heap,
@@ -1341,10 +4454,12 @@ static void midvertex_insertion (GtsEdge * e,
                                  GtsVertexClass * vertex_class,
                                  GtsEdgeClass * edge_class)
 {
-  GtsVertex * midvertex;
+  GtsVertex * midvertex, * v1 = GTS_SEGMENT (e)->v1, * v2 = GTS_SEGMENT (e)->v2;
   GtsEdge * e1, * e2;
   GSList * i;
+  gboolean counted = local_counts_begin (surface, v1, v2);
 
+  GTS_TOPOLOGY_CHANGED ();
   midvertex = (*refine_func) (e, vertex_class, refine_data);
   e1 = gts_edge_new (edge_class, GTS_SEGMENT (e)->v1, midvertex);
   gts_eheap_insert (heap, e1);
@@ -1364,18 +4479,20 @@ static void midvertex_insertion (GtsEdge * e,
     if (GTS_SEGMENT (e1)->v1 == v2) {
       tmp = e1; e1 = e2; e2 = tmp;
     }
-    e1->triangles = g_slist_prepend (e1->triangles, t);
-    ne->triangles = g_slist_prepend (ne->triangles, t);
-    te2->triangles = g_slist_remove (te2->triangles, t);
+    gts_edge_add_triangle (e1, t);
+    gts_edge_add_triangle (ne, t);
+    gts_edge_remove_triangle (te2, t);
     t->e1 = e1; t->e2 = ne; t->e3 = te3;
     gts_surface_add_face (surface,
                           gts_face_new (surface->face_class, e2, te2, ne));
     i = i->next;
   }
   /* destroys edge */
-  g_slist_free (e->triangles);
-  e->triangles = NULL;
+  gts_edge_free_triangles (e);
   gts_object_destroy (GTS_OBJECT (e));
+
+  if (counted)
+    local_counts_end (surface, v1, v2, midvertex);
 }
 
 static gdouble edge_length2_inverse (GtsSegment * s)
@@ -1633,12 +4750,14 @@ gboolean gts_edge_collapse_is_valid (GtsEdge * e)
   return TRUE;
 }
 
-#define HEAP_INSERT_EDGE(h, e) (GTS_OBJECT (e)->reserved = gts_eheap_insert (h, e))
-#define HEAP_REMOVE_EDGE(h, e) (gts_eheap_remove (h, GTS_OBJECT (e)->reserved),\
-                                GTS_OBJECT (e)->reserved = NULL)
+#define HEAP_INSERT_EDGE(h, p, e) (gts_scratch_set (p, e, gts_eheap_insert (h, e)))
+#define HEAP_REMOVE_EDGE(h, p, e) (gts_eheap_remove (h, gts_scratch_get (p, e)),\
+                                   gts_scratch_remove (p, e))
 
 static GtsVertex * edge_collapse (GtsEdge * e,
+                                  GtsSurface * surface,
                                   GtsEHeap * heap,
+                                  GtsScratch * pairs,
                                   GtsCoarsenFunc coarsen_func,
                                   gpointer coarsen_data,
                                   GtsVertexClass * klass,
@@ -1646,6 +4765,7 @@ static GtsVertex * edge_collapse (GtsEdge * e,
 {
   GSList * i;
   GtsVertex  * v1 = GTS_SEGMENT (e)->v1, * v2 = GTS_SEGMENT (e)->v2, * mid;
+  gboolean counted;
 
   /* if the edge is degenerate (i.e. v1 == v2), destroy and return */
   if (v1 == v2) {
@@ -1654,20 +4774,21 @@ static GtsVertex * edge_collapse (GtsEdge * e,
   }
 
   if (!gts_edge_collapse_is_valid (e)) {
-    GTS_OBJECT (e)->reserved =
-      gts_eheap_insert_with_key (heap, e, G_MAXDOUBLE);
+    gts_scratch_set (pairs, e,
+                     gts_eheap_insert_with_key (heap, e, G_MAXDOUBLE));
     return NULL;
   }
 
   mid = (*coarsen_func) (e, klass, coarsen_data);
 
   if (gts_edge_collapse_creates_fold (e, mid, maxcosine2)) {
-    GTS_OBJECT (e)->reserved =
-      gts_eheap_insert_with_key (heap, e, G_MAXDOUBLE);
+    gts_scratch_set (pairs, e,
+                     gts_eheap_insert_with_key (heap, e, G_MAXDOUBLE));
     gts_object_destroy (GTS_OBJECT (mid));
     return NULL;
   }
 
+  counted = local_counts_begin (surface, v1, v2);
   gts_object_destroy (GTS_OBJECT (e));
 
   gts_vertex_replace (v1, mid);
@@ -1682,7 +4803,7 @@ static GtsVertex * edge_collapse (GtsEdge * e,
     GtsEdge * duplicate;
     while ((duplicate = gts_edge_is_duplicate (e1))) {
       gts_edge_replace (duplicate, GTS_EDGE (e1));
-      HEAP_REMOVE_EDGE (heap, duplicate);
+      HEAP_REMOVE_EDGE (heap, pairs, duplicate);
       gts_object_destroy (GTS_OBJECT (duplicate));
     }
     i = i->next;
@@ -1692,33 +4813,42 @@ static GtsVertex * edge_collapse (GtsEdge * e,
          the initial surface) */
       g_warning ("file %s: line %d (%s): probably duplicate triangle.",
                  __FILE__, __LINE__, G_GNUC_PRETTY_FUNCTION);
-      HEAP_REMOVE_EDGE (heap, e1);
+      HEAP_REMOVE_EDGE (heap, pairs, e1);
       gts_object_destroy (GTS_OBJECT (e1));
       if (i == NULL) /* mid has been destroyed */
         mid = NULL;
+      /* vertices outside the star of mid may have been affected */
+      counted = FALSE;
     }
   }
 
+  if (counted)
+    local_counts_end (surface, mid, NULL, NULL);
+
   return mid;
 }
 
 #ifdef DEBUG
-static void update_closest_neighbors (GtsVertex * v, GtsEHeap * heap)
+static void update_closest_neighbors (GtsVertex * v,
+                                      GtsEHeap * heap,
+                                      GtsScratch * pairs)
 {
   GSList * i = v->segments;
 
   while (i) {
     GtsSegment * s = i->data;
     if (GTS_IS_EDGE (s)) {
-      HEAP_REMOVE_EDGE (heap, GTS_EDGE (s));
-      HEAP_INSERT_EDGE (heap, GTS_EDGE (s));
+      HEAP_REMOVE_EDGE (heap, pairs, GTS_EDGE (s));
+      HEAP_INSERT_EDGE (heap, pairs, GTS_EDGE (s));
     }
     i = i->next;
   }
 }
 #endif /* DEBUG */
 
-static void update_2nd_closest_neighbors (GtsVertex * v, GtsEHeap * heap)
+static void update_2nd_closest_neighbors (GtsVertex * v,
+                                          GtsEHeap * heap,
+                                          GtsScratch * pairs)
 {
   GSList * i = v->segments;
   GSList * list = NULL;
@@ -1741,8 +4871,8 @@ static void update_2nd_closest_neighbors (GtsVertex * v, GtsEHeap * heap)
   i = list;
   while (i) {
     GtsEdge * e = i->data;
-    HEAP_REMOVE_EDGE (heap, e);
-    HEAP_INSERT_EDGE (heap, e);
+    HEAP_REMOVE_EDGE (heap, pairs, e);
+    HEAP_INSERT_EDGE (heap, pairs, e);
     i = i->next;
   }
 
@@ -1755,9 +4885,9 @@ static gdouble edge_length2 (GtsEdge * e)
                               GTS_POINT (GTS_SEGMENT (e)->v2));
 }
 
-static void create_heap_coarsen (GtsEdge * e, GtsEHeap * heap)
+static void create_heap_coarsen (GtsEdge * e, gpointer * data)
 {
-  HEAP_INSERT_EDGE (heap, e);
+  HEAP_INSERT_EDGE (data[0], data[1], e);
 }
 
 /**
@@ -1794,9 +4924,11 @@ void gts_surface_coarsen (GtsSurface * surface,
                           gdouble minangle)
 {
   GtsEHeap * heap;
+  GtsScratch * pairs;
   GtsEdge * e;
   gdouble top_cost;
   gdouble maxcosine2;
+  gpointer data[2];
 
   g_return_if_fail (surface != NULL);
   g_return_if_fail (stop_func != NULL);
@@ -1807,10 +4939,13 @@ void gts_surface_coarsen (GtsSurface * surface,
     coarsen_func = (GtsCoarsenFunc) gts_segment_midvertex;
 
   heap = gts_eheap_new (cost_func, cost_data);
+  pairs = gts_scratch_new (gts_surface_edge_number (surface));
   maxcosine2 = cos (minangle); maxcosine2 *= maxcosine2;
 
+  data[0] = heap;
+  data[1] = pairs;
   gts_eheap_freeze (heap);
-  gts_surface_foreach_edge (surface, (GtsFunc) create_heap_coarsen, heap);
+  gts_surface_foreach_edge (surface, (GtsFunc) create_heap_coarsen, data);
   gts_eheap_thaw (heap);
   /* we want to control edge destruction manually */
   gts_allow_floating_edges = TRUE;
@@ -1819,17 +4954,18 @@ void gts_surface_coarsen (GtsSurface * surface,
          !(*stop_func) (top_cost, gts_eheap_size (heap) -
                         gts_edge_face_number (e, surface), stop_data))
     {
-      GtsVertex * v = edge_collapse (e, heap, coarsen_func, coarsen_data,
-                                     surface->vertex_class, maxcosine2);
+      GtsVertex * v;
+
+      gts_scratch_remove (pairs, e);
+      v = edge_collapse (e, surface, heap, pairs,
+                         coarsen_func, coarsen_data,
+                         surface->vertex_class, maxcosine2);
       if (v != NULL)
-        update_2nd_closest_neighbors (v, heap);
+        update_2nd_closest_neighbors (v, heap, pairs);
     }
   gts_allow_floating_edges = FALSE;
 
-  /* set reserved field of remaining edges back to NULL */
-  if (e) GTS_OBJECT (e)->reserved = NULL;
-  gts_eheap_foreach (heap, (GFunc) gts_object_reset_reserved, NULL);
-
+  gts_scratch_destroy (pairs);
   gts_eheap_destroy (heap);
 }
 
@@ -1990,6 +5126,7 @@ static GtsVertex * unit_sphere_arc_midvertex (GtsSegment * s,
 
 static void tessellate_face (GtsFace * f,
                              GtsSurface * s,
+                             GtsScratch * split,
                              GtsRefineFunc refine_func,
                              gpointer refine_data,
                              GtsVertexClass * vertex_class,
@@ -2032,12 +5169,12 @@ static void tessellate_face (GtsFace * f,
     g_assert_not_reached ();
   }
 
-  e1->triangles = g_slist_remove (e1->triangles, t);
-  e2->triangles = g_slist_remove (e2->triangles, t);
-  e3->triangles = g_slist_remove (e3->triangles, t);
+  GTS_TOPOLOGY_CHANGED ();
+  gts_edge_remove_triangle (e1, t);
+  gts_edge_remove_triangle (e2, t);
+  gts_edge_remove_triangle (e3, t);
 
-  if (GTS_OBJECT (e1)->reserved) {
-    dum = (GTS_OBJECT (e1)->reserved);
+  if ((dum = gts_scratch_get (split, e1))) {
     e24 = dum->data;
     e34 = dum->next->data;
     v4 = GTS_SEGMENT (e24)->v2;
@@ -2051,10 +5188,9 @@ static void tessellate_face (GtsFace * f,
     e34 = gts_edge_new (edge_class, v3, v4);
     dum = g_slist_append (NULL, e24);
     dum = g_slist_append (dum,  e34);
-    GTS_OBJECT (e1)->reserved = dum;
+    gts_scratch_set (split, e1, dum);
   }
-  if (GTS_OBJECT (e2)->reserved) {
-    dum = (GTS_OBJECT (e2)->reserved);
+  if ((dum = gts_scratch_get (split, e2))) {
     e35 = dum->data;
     e15 = dum->next->data;
     v5 = GTS_SEGMENT (e35)->v2;
@@ -2068,10 +5204,9 @@ static void tessellate_face (GtsFace * f,
     e15 = gts_edge_new (edge_class, v1, v5);
     dum = g_slist_append (NULL, e35);
     dum = g_slist_append (dum,  e15);
-    GTS_OBJECT (e2)->reserved = dum;
+    gts_scratch_set (split, e2, dum);
   }
-  if (GTS_OBJECT (e3)->reserved) {
-    dum = (GTS_OBJECT (e3)->reserved);
+  if ((dum = gts_scratch_get (split, e3))) {
     e16 = dum->data;
     e26 = dum->next->data;
     v6 = GTS_SEGMENT (e16)->v2;
@@ -2085,24 +5220,24 @@ static void tessellate_face (GtsFace * f,
     e26 = gts_edge_new (edge_class, v2, v6);
     dum = g_slist_append (NULL, e16);
     dum = g_slist_append (dum,  e26);
-    GTS_OBJECT (e3)->reserved = dum;
+    gts_scratch_set (split, e3, dum);
   }
 
   if (e1->triangles == NULL) {
-    g_slist_free (GTS_OBJECT (e1)->reserved);
-    GTS_OBJECT (e1)->reserved = NULL;
+    g_slist_free (gts_scratch_get (split, e1));
+    gts_scratch_remove (split, e1);
     gts_object_destroy (GTS_OBJECT (e1));
     e1 = NULL;
   }
   if (e2->triangles == NULL) {
-    g_slist_free (GTS_OBJECT (e2)->reserved);
-    GTS_OBJECT (e2)->reserved = NULL;
+    g_slist_free (gts_scratch_get (split, e2));
+    gts_scratch_remove (split, e2);
     gts_object_destroy (GTS_OBJECT (e2));
     e2 = NULL;
   }
   if (e3->triangles == NULL) {
-    g_slist_free (GTS_OBJECT (e3)->reserved);
-    GTS_OBJECT (e3)->reserved = NULL;
+    g_slist_free (gts_scratch_get (split, e3));
+    gts_scratch_remove (split, e3);
     gts_object_destroy (GTS_OBJECT (e3));
     e3 = NULL;
   }
@@ -2110,9 +5245,9 @@ static void tessellate_face (GtsFace * f,
   e56 = gts_edge_new (edge_class, v5, v6);
   e64 = gts_edge_new (edge_class, v6, v4);
   e45 = gts_edge_new (edge_class, v4, v5);
-  t->e1 = e56; e56->triangles = g_slist_prepend (e56->triangles, t);
-  t->e2 = e64; e64->triangles = g_slist_prepend (e64->triangles, t);
-  t->e3 = e45; e45->triangles = g_slist_prepend (e45->triangles, t);
+  t->e1 = e56; gts_edge_add_triangle (e56, t);
+  t->e2 = e64; gts_edge_add_triangle (e64, t);
+  t->e3 = e45; gts_edge_add_triangle (e45, t);
 
   gts_surface_add_face (s, gts_face_new (s->face_class, e16, e56, e15));
   gts_surface_add_face (s, gts_face_new (s->face_class, e26, e24, e64));
@@ -2124,6 +5259,11 @@ static void create_array_tessellate (GtsFace * f, GPtrArray * array)
   g_ptr_array_add (array, f);
 }
 
+static void free_split (GtsEdge * e, GSList * split)
+{
+  g_slist_free (split);
+}
+
 /**
  * gts_surface_tessellate:
  * @s: a #GtsSurface.
@@ -2145,6 +5285,7 @@ void gts_surface_tessellate (GtsSurface * s,
                              gpointer refine_data)
 {
   GPtrArray * array;
+  GtsScratch * split;
   guint i;
 
   g_return_if_fail (s != NULL);
@@ -2154,10 +5295,14 @@ void gts_surface_tessellate (GtsSurface * s,
 
   array = g_ptr_array_new ();
   gts_surface_foreach_face (s, (GtsFunc) create_array_tessellate, array);
+  split = gts_scratch_new (gts_surface_edge_number (s));
   for(i = 0; i < array->len; i++)
     tessellate_face (g_ptr_array_index (array, i),
-                     s, refine_func, refine_data,
+                     s, split, refine_func, refine_data,
                      s->vertex_class, s->edge_class);
+  /* edges also used by triangles not belonging to s are kept */
+  gts_scratch_foreach (split, (GHFunc) free_split, NULL);
+  gts_scratch_destroy (split);
   g_ptr_array_free (array, TRUE);
 }
 
@@ -2189,25 +5334,32 @@ GtsSurface * gts_surface_generate_sphere (GtsSurface * s,
   return s;
 }
 
-static void foreach_vertex_copy (GtsPoint * p, GtsVertexClass * klass)
+static void foreach_vertex_copy (GtsPoint * p, gpointer * data)
 {
-  GTS_OBJECT (p)->reserved = gts_vertex_new (klass, p->x, p->y, p->z);
+  GtsSurface * s = data[0];
+
+  gts_scratch_set (data[1], p,
+                   gts_vertex_new (s->vertex_class, p->x, p->y, p->z));
 }
 
-static void foreach_edge_copy (GtsSegment * s, GtsEdgeClass * klass)
+static void foreach_edge_copy (GtsSegment * e, gpointer * data)
 {
-  GTS_OBJECT (s)->reserved = gts_edge_new (klass,
-                                           GTS_OBJECT (s->v1)->reserved,
-                                           GTS_OBJECT (s->v2)->reserved);
+  GtsSurface * s = data[0];
+
+  gts_scratch_set (data[1], e,
+                   gts_edge_new (s->edge_class,
+                                 gts_scratch_get (data[1], e->v1),
+                                 gts_scratch_get (data[1], e->v2)));
 }
 
-static void foreach_face_copy (GtsTriangle * t,
-                               GtsSurface * s)
+static void foreach_face_copy (GtsTriangle * t, gpointer * data)
 {
+  GtsSurface * s = data[0];
+
   gts_surface_add_face (s, gts_face_new (s->face_class,
-                                         GTS_OBJECT (t->e1)->reserved,
-                                         GTS_OBJECT (t->e2)->reserved,
-                                         GTS_OBJECT (t->e3)->reserved));
+                                         gts_scratch_get (data[1], t->e1),
+                                         gts_scratch_get (data[1], t->e2),
+                                         gts_scratch_get (data[1], t->e3)));
 }
 
 /**
@@ -2221,16 +5373,18 @@ static void foreach_face_copy (GtsTriangle * t,
  */
 GtsSurface * gts_surface_copy (GtsSurface * s1, GtsSurface * s2)
 {
+  gpointer data[2];
+
   g_return_val_if_fail (s1 != NULL, NULL);
   g_return_val_if_fail (s2 != NULL, NULL);
 
-  gts_surface_foreach_vertex (s2, (GtsFunc) foreach_vertex_copy,
-                              s1->vertex_class);
-  gts_surface_foreach_edge (s2, (GtsFunc) foreach_edge_copy, s1->edge_class);
-  gts_surface_foreach_face (s2, (GtsFunc) foreach_face_copy, s1);
-
-  gts_surface_foreach_vertex (s2, (GtsFunc) gts_object_reset_reserved, NULL);
-  gts_surface_foreach_edge (s2, (GtsFunc) gts_object_reset_reserved, NULL);
+  data[0] = s1;
+  data[1] = gts_scratch_new (gts_surface_vertex_number (s2) +
+                             gts_surface_edge_number (s2));
+  gts_surface_foreach_vertex (s2, (GtsFunc) foreach_vertex_copy, data);
+  gts_surface_foreach_edge (s2, (GtsFunc) foreach_edge_copy, data);
+  gts_surface_foreach_face (s2, (GtsFunc) foreach_face_copy, data);
+  gts_scratch_destroy (data[1]);
 
   return s1;
 }
@@ -2515,43 +5669,46 @@ gdouble gts_surface_center_of_area (GtsSurface * s,
   return area;
 }
 
-static void number_foreach (gpointer data, guint * n)
-{
-  (*n)++;
-}
-
 /**
  * gts_surface_vertex_number:
  * @s: a #GtsSurface.
  *
+ * The number of vertices is maintained as faces are added to or
+ * removed from @s. It is only recomputed (by traversing @s) if the
+ * connectivity of the faces has been modified in place in the
+ * meantime, by gts_vertex_replace() for example.
+ *
  * Returns: the number of vertices of @s.
  */
 guint gts_surface_vertex_number (GtsSurface * s)
 {
-  guint n = 0;
-
   g_return_val_if_fail (s != NULL, 0);
 
-  gts_surface_foreach_vertex (s, (GtsFunc) number_foreach, &n);
+  if (!COUNTS_ARE_VALID (s))
+    counts_update (s);
+  counts_check (s);
 
-  return n;
+  return s->n_vertices;
 }
 
 /**
  * gts_surface_edge_number:
  * @s: a #GtsSurface.
  *
+ * See gts_surface_vertex_number() for details on how this number is
+ * maintained.
+ *
  * Returns: the number of edges of @s.
  */
 guint gts_surface_edge_number (GtsSurface * s)
 {
-  guint n = 0;
-
   g_return_val_if_fail (s != NULL, 0);
 
-  gts_surface_foreach_edge (s, (GtsFunc) number_foreach, &n);
+  if (!COUNTS_ARE_VALID (s))
+    counts_update (s);
+  counts_check (s);
 
-  return n;
+  return s->n_edges;
 }
 
 /**
@@ -2564,16 +5721,27 @@ guint gts_surface_face_number (GtsSurface * s)
 {
   g_return_val_if_fail (s != NULL, 0);
 
-#ifdef USE_SURFACE_BTREE
-  return g_tree_nnodes (s->faces);
-#else /* not USE_SURFACE_BTREE */
-  return g_hash_table_size (s->faces);
-#endif /* not USE_SURFACE_BTREE */
+  return s->faces->len;
 }
 
-static void build_list_face (GtsTriangle * t, GSList ** list)
+/**
+ * gts_surface_nth_face:
+ * @s: a #GtsSurface.
+ * @n: an index smaller than the number of faces of @s.
+ *
+ * The faces of @s are stored contiguously, in no particular order,
+ * and their index changes when faces are removed from @s. This
+ * function can be used to pick a face of @s at random in constant
+ * time, for example.
+ *
+ * Returns: the @n-th face of @s.
+ */
+GtsFace * gts_surface_nth_face (GtsSurface * s, guint n)
 {
-  *list = g_slist_prepend (*list, gts_bbox_triangle (gts_bbox_class (), t));
+  g_return_val_if_fail (s != NULL, NULL);
+  g_return_val_if_fail (n < s->faces->len, NULL);
+
+  return g_ptr_array_index (s->faces, n);
 }
 
 static void build_list_boundary (GtsEdge * e, GSList ** list)
@@ -2584,24 +5752,26 @@ static void build_list_boundary (GtsEdge * e, GSList ** list)
 }
 
 /**
- * gts_surface_distance:
+ * gts_surface_distance_parallel:
  * @s1: a #GtsSurface.
  * @s2: a #GtsSurface.
  * @delta: a spatial increment defined as the percentage of the diagonal
  * of the bounding box of @s2.
  * @face_range: a #GtsRange.
  * @boundary_range: a #GtsRange.
+ * @threads: the number of threads or 0.
  *
- * Using the gts_bb_tree_surface_distance() and
- * gts_bb_tree_surface_boundary_distance() functions fills @face_range
- * and @boundary_range with the min, max and average Euclidean
- * (minimum) distances between the faces of @s1 and the faces of @s2
- * and between the boundary edges of @s1 and @s2.
+ * Same as gts_surface_distance() but the distances between the faces
+ * are computed using gts_bvh_surface_distance_batch() with @threads
+ * threads (one per processor if @threads is 0).
  */
-void gts_surface_distance (GtsSurface * s1, GtsSurface * s2, gdouble delta,
-                           GtsRange * face_range, GtsRange * boundary_range)
+void gts_surface_distance_parallel (GtsSurface * s1, GtsSurface * s2, 
+                                    gdouble delta,
+                                    GtsRange * face_range, 
+                                    GtsRange * boundary_range,
+                                    guint threads)
 {
-  GNode * face_tree, * boundary_tree;
+  GtsBVH * face_tree, * boundary_tree;
   GSList * bboxes;
 
   g_return_if_fail (s1 != NULL);
@@ -2610,28 +5780,23 @@ void gts_surface_distance (GtsSurface * s1, GtsSurface * s2, gdouble delta,
   g_return_if_fail (face_range != NULL);
   g_return_if_fail (boundary_range != NULL);
 
-  bboxes = NULL;
-  gts_surface_foreach_face (s2, (GtsFunc) build_list_face, &bboxes);
-  if (bboxes != NULL) {
-    face_tree = gts_bb_tree_new (bboxes);
-    g_slist_free (bboxes);
-
-    gts_bb_tree_surface_distance (face_tree, s1,
-                               (GtsBBoxDistFunc) gts_point_triangle_distance,
-                                  delta, face_range);
-    gts_bb_tree_destroy (face_tree, TRUE);
+  face_tree = gts_bvh_surface_full (s2, GTS_BVH_BINNED_SAH, 4, threads);
+  if (face_tree != NULL) {
+    gts_bvh_surface_distance_batch (face_tree, s1, delta, face_range, 
+                                    threads);
+    gts_bvh_destroy (face_tree, TRUE);
 
     bboxes = NULL;
     gts_surface_foreach_edge (s2, (GtsFunc) build_list_boundary, &bboxes);
     if (bboxes != NULL) {
-      boundary_tree = gts_bb_tree_new (bboxes);
+      boundary_tree = gts_bvh_new (bboxes);
       g_slist_free (bboxes);
 
-      gts_bb_tree_surface_boundary_distance (boundary_tree,
+      gts_bvh_surface_boundary_distance (boundary_tree,
                s1,
                (GtsBBoxDistFunc) gts_point_segment_distance,
                delta, boundary_range);
-      gts_bb_tree_destroy (boundary_tree, TRUE);
+      gts_bvh_destroy (boundary_tree, TRUE);
     }
     else
       gts_range_reset (boundary_range);
@@ -2642,6 +5807,28 @@ void gts_surface_distance (GtsSurface * s1, GtsSurface * s2, gdouble delta,
   }
 }
 
+/**
+ * gts_surface_distance:
+ * @s1: a #GtsSurface.
+ * @s2: a #GtsSurface.
+ * @delta: a spatial increment defined as the percentage of the diagonal
+ * of the bounding box of @s2.
+ * @face_range: a #GtsRange.
+ * @boundary_range: a #GtsRange.
+ *
+ * Using the gts_bvh_surface_distance_batch() and
+ * gts_bvh_surface_boundary_distance() functions fills @face_range
+ * and @boundary_range with the min, max and average Euclidean
+ * (minimum) distances between the faces of @s1 and the faces of @s2
+ * and between the boundary edges of @s1 and @s2.
+ */
+void gts_surface_distance (GtsSurface * s1, GtsSurface * s2, gdouble delta,
+                           GtsRange * face_range, GtsRange * boundary_range)
+{
+  gts_surface_distance_parallel (s1, s2, delta, face_range, boundary_range, 
+                                 1);
+}
+
 static void surface_boundary (GtsEdge * e, gpointer * data)
 {
   GSList ** list = data[0];
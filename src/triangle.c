@@ -19,6 +19,7 @@
 
 #include <math.h>
 #include "gts.h"
+#include "gts-private.h"
 
 static void triangle_destroy (GtsObject * object)
 {
@@ -27,17 +28,17 @@ static void triangle_destroy (GtsObject * object)
   GtsEdge * e2 = triangle->e2;
   GtsEdge * e3 = triangle->e3;
 
-  e1->triangles = g_slist_remove (e1->triangles, triangle);
+  gts_edge_remove_triangle (e1, triangle);
   if (!GTS_OBJECT_DESTROYED (e1) &&
       !gts_allow_floating_edges && e1->triangles == NULL)
     gts_object_destroy (GTS_OBJECT (e1));
   
-  e2->triangles = g_slist_remove (e2->triangles, triangle);
+  gts_edge_remove_triangle (e2, triangle);
   if (!GTS_OBJECT_DESTROYED (e2) &&
       !gts_allow_floating_edges && e2->triangles == NULL)
     gts_object_destroy (GTS_OBJECT (e2));
   
-  e3->triangles = g_slist_remove (e3->triangles, triangle);
+  gts_edge_remove_triangle (e3, triangle);
   if (!GTS_OBJECT_DESTROYED (e3) &&
       !gts_allow_floating_edges && e3->triangles == NULL)
     gts_object_destroy (GTS_OBJECT (e3));
@@ -101,6 +102,8 @@ void gts_triangle_set (GtsTriangle * triangle,
   g_return_if_fail (e3 != NULL);
   g_return_if_fail (e1 != e2 && e1 != e3 && e2 != e3);
 
+  if (triangle->e1)
+    GTS_TOPOLOGY_CHANGED ();
   triangle->e1 = e1;
   triangle->e2 = e2;
   triangle->e3 = e3;
@@ -124,9 +127,9 @@ void gts_triangle_set (GtsTriangle * triangle,
   else
     g_assert_not_reached ();
 
-  e1->triangles = g_slist_prepend (e1->triangles, triangle);
-  e2->triangles = g_slist_prepend (e2->triangles, triangle);
-  e3->triangles = g_slist_prepend (e3->triangles, triangle);
+  gts_edge_add_triangle (e1, triangle);
+  gts_edge_add_triangle (e2, triangle);
+  gts_edge_add_triangle (e3, triangle);
 }
 
 /**
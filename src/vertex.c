@@ -19,6 +19,7 @@
 
 #include <math.h>
 #include "gts.h"
+#include "gts-private.h"
 
 gboolean gts_allow_floating_vertices = FALSE;
 
@@ -40,6 +41,10 @@ static void vertex_clone (GtsObject * clone, GtsObject * object)
   (* GTS_OBJECT_CLASS (gts_vertex_class ())->parent_class->clone) (clone, 
 								   object);
   GTS_VERTEX (clone)->segments = NULL;
+  GTS_VERTEX (clone)->visit = 0;
+#ifdef GTS_INLINE_ADJACENCY
+  GTS_VERTEX (clone)->inline_used = 0;
+#endif /* GTS_INLINE_ADJACENCY */
 }
 
 static void vertex_class_init (GtsVertexClass * klass)
@@ -52,6 +57,10 @@ static void vertex_class_init (GtsVertexClass * klass)
 static void vertex_init (GtsVertex * vertex)
 {
   vertex->segments = NULL;
+  vertex->visit = 0;
+#ifdef GTS_INLINE_ADJACENCY
+  vertex->inline_used = 0;
+#endif /* GTS_INLINE_ADJACENCY */
 }
 
 /**
@@ -100,6 +109,67 @@ GtsVertex * gts_vertex_new (GtsVertexClass * klass,
   return v;
 }
 
+/**
+ * gts_vertex_add_segment:
+ * @v: a #GtsVertex.
+ * @s: a #GtsSegment.
+ *
+ * Prepends @s to the list of segments of @v.
+ */
+void gts_vertex_add_segment (GtsVertex * v, GtsSegment * s)
+{
+  g_return_if_fail (v != NULL);
+  g_return_if_fail (s != NULL);
+
+#ifdef GTS_INLINE_ADJACENCY
+  v->segments = inline_list_prepend (v->segments, s, v->inline_segments,
+				     &v->inline_used,
+				     GTS_VERTEX_INLINE_SEGMENTS);
+#else /* not GTS_INLINE_ADJACENCY */
+  v->segments = g_slist_prepend (v->segments, s);
+#endif /* not GTS_INLINE_ADJACENCY */
+}
+
+/**
+ * gts_vertex_remove_segment:
+ * @v: a #GtsVertex.
+ * @s: a #GtsSegment.
+ *
+ * Removes @s from the list of segments of @v.
+ */
+void gts_vertex_remove_segment (GtsVertex * v, GtsSegment * s)
+{
+  g_return_if_fail (v != NULL);
+
+#ifdef GTS_INLINE_ADJACENCY
+  v->segments = inline_list_remove (v->segments, s, v->inline_segments,
+				    &v->inline_used,
+				    GTS_VERTEX_INLINE_SEGMENTS);
+#else /* not GTS_INLINE_ADJACENCY */
+  v->segments = g_slist_remove (v->segments, s);
+#endif /* not GTS_INLINE_ADJACENCY */
+}
+
+/**
+ * gts_vertex_free_segments:
+ * @v: a #GtsVertex.
+ *
+ * Frees the list of segments of @v and sets @v->segments to %NULL. The
+ * segments themselves are not modified.
+ */
+void gts_vertex_free_segments (GtsVertex * v)
+{
+  g_return_if_fail (v != NULL);
+
+#ifdef GTS_INLINE_ADJACENCY
+  inline_list_free (v->segments, v->inline_segments, &v->inline_used,
+		    GTS_VERTEX_INLINE_SEGMENTS);
+#else /* not GTS_INLINE_ADJACENCY */
+  g_slist_free (v->segments);
+#endif /* not GTS_INLINE_ADJACENCY */
+  v->segments = NULL;
+}
+
 /**
  * gts_vertex_replace:
  * @v: a #GtsVertex.
@@ -118,17 +188,17 @@ void gts_vertex_replace (GtsVertex * v, GtsVertex * with)
   g_return_if_fail (with != NULL);
   g_return_if_fail (v != with);
 
+  GTS_TOPOLOGY_CHANGED ();
   i = v->segments;
   while (i) {
     GtsSegment * s = i->data;
     if (s->v1 != with && s->v2 != with)
-      with->segments = g_slist_prepend (with->segments, s);
+      gts_vertex_add_segment (with, s);
     if (s->v1 == v) s->v1 = with;
     if (s->v2 == v) s->v2 = with;
     i = i->next;
   }
-  g_slist_free (v->segments);
-  v->segments = NULL;
+  gts_vertex_free_segments (v);
 }
 
 /**
@@ -359,6 +429,7 @@ GList * gts_vertices_merge (GList * vertices,
   GPtrArray * array;
   GList * i;
   GNode * kdtree;
+  GtsScratch * inactive;
 
   g_return_val_if_fail (vertices != NULL, NULL);
 
@@ -369,12 +440,13 @@ GList * gts_vertices_merge (GList * vertices,
     i = i->next;
   }
   kdtree = gts_kdtree_new (array, NULL);
+  inactive = gts_scratch_new (array->len);
   g_ptr_array_free (array, TRUE);
   
   i = vertices;
   while (i) {
     GtsVertex * v = i->data;
-    if (!GTS_OBJECT (v)->reserved) { /* Do something only if v is active */
+    if (!gts_scratch_get (inactive, v)) { /* Do something only if v is active */
       GtsBBox * bbox;
       GSList * selected, * j;
 
@@ -392,10 +464,11 @@ GList * gts_vertices_merge (GList * vertices,
       j = selected = gts_kdtree_range (kdtree, bbox, NULL);
       while (j) {
 	GtsVertex * sv = j->data;
-	if (sv != v && !GTS_OBJECT (sv)->reserved && (!check || (*check) (sv, v))) {
+	if (sv != v && !gts_scratch_get (inactive, sv) &&
+	    (!check || (*check) (sv, v))) {
 	  /* sv is not v and is active */
 	  gts_vertex_replace (sv, v);
-	  GTS_OBJECT (sv)->reserved = sv; /* mark sv as inactive */
+	  gts_scratch_set (inactive, sv, sv); /* mark sv as inactive */
 	}
 	j = j->next;
       }
@@ -416,7 +489,7 @@ GList * gts_vertices_merge (GList * vertices,
   while (i) {
     GtsVertex * v = i->data;
     GList * next = i->next;
-    if (GTS_OBJECT (v)->reserved) { /* v is inactive */
+    if (gts_scratch_get (inactive, v)) { /* v is inactive */
       gts_object_destroy (GTS_OBJECT (v));
       vertices = g_list_remove_link (vertices, i);
       g_list_free_1 (i);
@@ -424,6 +497,7 @@ GList * gts_vertices_merge (GList * vertices,
     i = next;
   }
   gts_allow_floating_vertices = FALSE; 
+  gts_scratch_destroy (inactive);
 
   return vertices;
 }
@@ -573,10 +647,11 @@ static GtsEdge * replace_vertex (GtsTriangle * t,
 
   if (with != v) {
     GtsSegment * s = GTS_SEGMENT (e);
+    GTS_TOPOLOGY_CHANGED ();
     if (s->v1 == v) s->v1 = with;
     if (s->v2 == v) s->v2 = with;
-    with->segments = g_slist_prepend (with->segments, s);
-    v->segments = g_slist_remove (v->segments, s);
+    gts_vertex_add_segment (with, s);
+    gts_vertex_remove_segment (v, s);
   }
 
   return e;
@@ -0,0 +1,100 @@
+/* GTS - Library for the manipulation of triangulated surfaces
+ * Copyright (C) 1999 Stéphane Popinet
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include <stdlib.h>
+#include <math.h>
+#include "gts.h"
+#include "common.h"
+
+#define N 10000
+
+/* Checks gts_bvh_points_distance() using @threads threads against
+   gts_bb_tree_point_distance() for the @n points @xyz */
+static void check_points (GtsBVH * bvh, GNode * tree, 
+			  const gdouble * xyz, guint n, guint threads)
+{
+  gdouble * distance = g_malloc (n*sizeof (gdouble));
+  gdouble * closest = g_malloc (3*n*sizeof (gdouble));
+  GtsTriangle ** triangles = g_malloc (n*sizeof (GtsTriangle *));
+  GtsPoint * p = gts_point_new (gts_point_class (), 0., 0., 0.);
+  GtsPoint * c = gts_point_new (gts_point_class (), 0., 0., 0.);
+  guint i;
+
+  gts_bvh_points_distance (bvh, xyz, n, distance, closest, triangles, 
+			   threads);
+  for (i = 0; i < n; i++) {
+    gts_point_set (p, xyz[3*i], xyz[3*i + 1], xyz[3*i + 2]);
+    gts_point_set (c, closest[3*i], closest[3*i + 1], closest[3*i + 2]);
+    g_assert (distance[i] == 
+	      gts_bb_tree_point_distance (tree, p, (GtsBBoxDistFunc)
+					  gts_point_triangle_distance, NULL));
+    g_assert (distance[i] == gts_point_triangle_distance (p, triangles[i]));
+    g_assert (gts_point_triangle_distance (c, triangles[i]) < 1e-9);
+    g_assert (fabs (gts_point_distance (p, c) - distance[i]) < 1e-9);
+  }
+
+  /* the optional arrays can be omitted */
+  gts_bvh_points_distance (bvh, xyz, n, distance, NULL, NULL, threads);
+  for (i = 0; i < n; i++) {
+    gts_point_set (p, xyz[3*i], xyz[3*i + 1], xyz[3*i + 2]);
+    g_assert (distance[i] == gts_point_triangle_distance (p, triangles[i]));
+  }
+
+  g_free (distance);
+  g_free (closest);
+  g_free (triangles);
+  gts_object_destroy (GTS_OBJECT (p));
+  gts_object_destroy (GTS_OBJECT (c));
+}
+
+int main (int argc, char * argv[])
+{
+  GtsSurface * s = sphere (4, 1., 0.), * s1 = sphere (3, 1.1, 0.3);
+  GtsBVH * bvh = gts_bvh_surface_full (s, GTS_BVH_BINNED_SAH, 4, 1);
+  GNode * tree = gts_bb_tree_surface (s);
+  gdouble * xyz = g_malloc (3*N*sizeof (gdouble));
+  GtsRange r1, r2;
+  guint i, threads;
+
+  srand (1);
+  for (i = 0; i < 3*N; i++)
+    xyz[i] = 3.*rand ()/(gdouble) RAND_MAX - 1.5;
+
+  gts_bb_tree_surface_distance (tree, s1, (GtsBBoxDistFunc)
+				gts_point_triangle_distance, 0.05, &r1);
+  for (threads = 1; threads <= 4; threads++) {
+    check_points (bvh, tree, xyz, N, threads);
+
+    gts_bvh_surface_distance_batch (bvh, s1, 0.05, &r2, threads);
+    g_assert (r1.n == r2.n && r1.min == r2.min && r1.max == r2.max);
+    g_assert (r1.mean == r2.mean && r1.stddev == r2.stddev);
+  }
+
+  /* no points */
+  gts_bvh_points_distance (bvh, xyz, 0, NULL, NULL, NULL, 2);
+
+  g_free (xyz);
+  gts_bb_tree_destroy (tree, TRUE);
+  gts_bvh_destroy (bvh, TRUE);
+  gts_object_destroy (GTS_OBJECT (s));
+  gts_object_destroy (GTS_OBJECT (s1));
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,207 @@
+/* GTS - Library for the manipulation of triangulated surfaces
+ * Copyright (C) 1999 Stéphane Popinet
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include <stdlib.h>
+#include "gts.h"
+#include "common.h"
+
+#define N 1000
+
+static GtsPoint * triangle_closest (GtsPoint * p, GtsTriangle * t)
+{
+  GtsPoint * c = gts_point_new (gts_point_class (), 0., 0., 0.);
+
+  gts_point_triangle_closest (p, t, c);
+  return c;
+}
+
+static void count_pair (GtsBBox * bb1, GtsBBox * bb2, guint64 * pairs)
+{
+  pairs[0]++;
+  pairs[1] += GPOINTER_TO_SIZE (bb1->bounded)*31 ^ 
+    GPOINTER_TO_SIZE (bb2->bounded);
+}
+
+/* Checks that the queries on @bvh give the same results as on @tree,
+   both built from the triangles of @s, using @s1 for the distance
+   between surfaces */
+static void check_bvh (GtsBVH * bvh, GNode * tree, 
+		       GtsSurface * s, GtsSurface * s1)
+{
+  GtsBBox * bb = gts_bvh_bbox (gts_bbox_class (), bvh);
+  GtsBBox * bb1 = gts_bbox_surface (gts_bbox_class (), s);
+  GtsPoint * p = gts_point_new (gts_point_class (), 0., 0., 0.);
+  GtsRange r1, r2;
+  guint64 pairs1[2] = { 0, 0 }, pairs2[2] = { 0, 0 };
+  guint i;
+
+  g_assert (bb->x1 == bb1->x1 && bb->x2 == bb1->x2);
+  g_assert (bb->y1 == bb1->y1 && bb->y2 == bb1->y2);
+  g_assert (bb->z1 == bb1->z1 && bb->z2 == bb1->z2);
+  gts_object_destroy (GTS_OBJECT (bb1));
+
+  srand (1);
+  for (i = 0; i < N; i++) {
+    GtsPoint * c1, * c2;
+    gdouble d1, d2;
+
+    p->x = random_coord (bb->x1, bb->x2);
+    p->y = random_coord (bb->y1, bb->y2);
+    p->z = random_coord (bb->z1, bb->z2);
+    check_same_list (gts_bb_tree_stabbed (tree, p), 
+		     gts_bvh_stabbed (bvh, p));
+    d1 = gts_bb_tree_point_distance (tree, p, (GtsBBoxDistFunc) 
+				     gts_point_triangle_distance, NULL);
+    d2 = gts_bvh_point_distance (bvh, p, (GtsBBoxDistFunc) 
+				 gts_point_triangle_distance, NULL);
+    g_assert (d1 == d2);
+    c1 = gts_bb_tree_point_closest (tree, p, (GtsBBoxClosestFunc)
+				    triangle_closest, &d1);
+    c2 = gts_bvh_point_closest (bvh, p, (GtsBBoxClosestFunc) 
+				triangle_closest, &d2);
+    g_assert (d1 == d2);
+    g_assert (gts_point_distance2 (c1, c2) == 0.);
+    gts_object_destroy (GTS_OBJECT (c1));
+    gts_object_destroy (GTS_OBJECT (c2));
+
+    bb1 = gts_bbox_new (gts_bbox_class (), NULL, p->x, p->y, p->z,
+			p->x + 0.05*(bb->x2 - bb->x1),
+			p->y + 0.1*(bb->y2 - bb->y1),
+			p->z + 0.02*(bb->z2 - bb->z1));
+    check_same_list (gts_bb_tree_overlap (tree, bb1),
+		     gts_bvh_overlap (bvh, bb1));
+    g_assert (gts_bb_tree_is_overlapping (tree, bb1) ==
+	      gts_bvh_is_overlapping (bvh, bb1));
+    gts_object_destroy (GTS_OBJECT (bb1));
+  }
+
+  gts_bb_tree_traverse_overlapping (tree, tree, 
+				    (GtsBBTreeTraverseFunc) count_pair, 
+				    pairs1);
+  gts_bvh_traverse_overlapping (bvh, bvh, 
+				(GtsBBTreeTraverseFunc) count_pair, pairs2);
+  g_assert (pairs1[0] > 0);
+  g_assert (pairs1[0] == pairs2[0] && pairs1[1] == pairs2[1]);
+
+  gts_bb_tree_surface_distance (tree, s1, (GtsBBoxDistFunc)
+				gts_point_triangle_distance, 0.1, &r1);
+  gts_bvh_surface_distance (bvh, s1, (GtsBBoxDistFunc)
+			    gts_point_triangle_distance, 0.1, &r2);
+  g_assert (r1.n == r2.n && r1.min == r2.min && r1.max == r2.max);
+  g_assert (r1.mean == r2.mean && r1.stddev == r2.stddev);
+
+  gts_object_destroy (GTS_OBJECT (p));
+  gts_object_destroy (GTS_OBJECT (bb));
+}
+
+/* Checks the statistics of @bvh, built with leaves of at most
+   @leaf_size bounding boxes out of @n */
+static void check_stats (GtsBVH * bvh, guint leaf_size, guint n)
+{
+  GtsBVHStats stats;
+
+  gts_bvh_stats (bvh, &stats);
+  g_assert (stats.n_leaves > 0 && stats.n_leaves <= stats.n_nodes);
+  g_assert (stats.leaf_size.n == stats.n_leaves);
+  g_assert (stats.leaf_size.min >= 1. && stats.leaf_size.max <= leaf_size);
+  g_assert (stats.leaf_size.sum == n);
+  g_assert (stats.leaf_depth.max <= stats.depth);
+  g_assert (stats.sah_cost > 0.);
+}
+
+int main (int argc, char * argv[])
+{
+  GtsBVHBuilder builders[] = {
+    GTS_BVH_MIDPOINT, GTS_BVH_MEDIAN, GTS_BVH_BINNED_SAH, GTS_BVH_SWEEP_SAH
+  };
+  guint leaf_sizes[] = { 1, 4 }, i, j, threads;
+  GtsSurface * s = sphere (4, 1., 0.), * s1 = sphere (3, 1.1, 0.3);
+  GSList * bboxes = NULL;
+  GNode * tree;
+  GtsBVH * bvh;
+
+  gts_surface_foreach_face (s, (GtsFunc) add_bbox, &bboxes);
+  tree = gts_bb_tree_new (bboxes);
+
+  bvh = gts_bvh_new (bboxes);
+  check_bvh (bvh, tree, s, s1);
+  gts_bvh_destroy (bvh, FALSE);
+
+  bvh = gts_bvh_new_from_bb_tree (tree);
+  check_bvh (bvh, tree, s, s1);
+  gts_bvh_destroy (bvh, FALSE);
+
+  bvh = gts_bvh_surface (s);
+  check_bvh (bvh, tree, s, s1);
+  gts_bvh_destroy (bvh, TRUE);
+
+  for (i = 0; i < G_N_ELEMENTS (builders); i++)
+    for (j = 0; j < G_N_ELEMENTS (leaf_sizes); j++) {
+      bvh = gts_bvh_new_full (bboxes, builders[i], leaf_sizes[j], 1);
+      check_stats (bvh, leaf_sizes[j], g_slist_length (bboxes));
+      check_bvh (bvh, tree, s, s1);
+
+      /* rebuilding with another builder */
+      gts_bvh_rebuild (bvh, builders[(i + 1) % G_N_ELEMENTS (builders)],
+		       leaf_sizes[j], 1);
+      check_stats (bvh, leaf_sizes[j], g_slist_length (bboxes));
+      check_bvh (bvh, tree, s, s1);
+      gts_bvh_destroy (bvh, FALSE);
+    }
+
+  bvh = gts_bvh_surface_full (s, GTS_BVH_SWEEP_SAH, 2, 1);
+  check_stats (bvh, 2, gts_surface_face_number (s));
+  check_bvh (bvh, tree, s, s1);
+  gts_bvh_destroy (bvh, TRUE);
+
+  gts_bb_tree_destroy (tree, TRUE);
+  g_slist_free (bboxes);
+  gts_object_destroy (GTS_OBJECT (s));
+  gts_object_destroy (GTS_OBJECT (s1));
+
+  /* the trees do not depend on the number of threads, for surfaces
+     large enough to be built concurrently */
+  s = sphere (7, 1., 0.);
+  bboxes = NULL;
+  gts_surface_foreach_face (s, (GtsFunc) add_bbox, &bboxes);
+  for (i = 0; i < G_N_ELEMENTS (builders); i++) {
+    GtsBVH * bvh1 = gts_bvh_new_full (bboxes, builders[i], 4, 1);
+
+    for (threads = 2; threads <= 4; threads++) {
+      bvh = gts_bvh_new_full (bboxes, builders[i], 4, threads);
+      check_same_tree (bvh1, bvh);
+      gts_bvh_destroy (bvh, FALSE);
+    }
+    gts_bvh_destroy (bvh1, FALSE);
+
+    bvh1 = gts_bvh_surface_full (s, builders[i], 4, 1);
+    for (threads = 2; threads <= 4; threads++) {
+      bvh = gts_bvh_surface_full (s, builders[i], 4, threads);
+      check_same_tree (bvh1, bvh);
+      gts_bvh_destroy (bvh, TRUE);
+    }
+    gts_bvh_destroy (bvh1, TRUE);
+  }
+  g_slist_foreach (bboxes, (GFunc) gts_object_destroy, NULL);
+  g_slist_free (bboxes);
+  gts_object_destroy (GTS_OBJECT (s));
+
+  return EXIT_SUCCESS;
+}
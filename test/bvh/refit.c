@@ -0,0 +1,155 @@
+/* GTS - Library for the manipulation of triangulated surfaces
+ * Copyright (C) 1999 Stéphane Popinet
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include <stdlib.h>
+#include <math.h>
+#include "gts.h"
+#include "common.h"
+
+#define N 1000
+
+/* Rotates @p around the z axis by an angle proportional to its z
+   coordinate and stretches it along z */
+static void twist (GtsPoint * p, gdouble * amount)
+{
+  gdouble a = *amount*p->z, x = p->x, y = p->y;
+
+  p->x = cos (a)*x - sin (a)*y;
+  p->y = sin (a)*x + cos (a)*y;
+  p->z *= 1.5;
+}
+
+static void update_bbox (GtsBBox * bb)
+{
+  GtsBBox * bb1 = gts_bbox_triangle (gts_bbox_class (), bb->bounded);
+
+  gts_bbox_set (bb, bb->bounded, 
+		bb1->x1, bb1->y1, bb1->z1, bb1->x2, bb1->y2, bb1->z2);
+  gts_object_destroy (GTS_OBJECT (bb1));
+}
+
+/* Checks that the queries on @bvh give the same results as on a tree
+   freshly built from the triangles of @s */
+static void check_bvh (GtsBVH * bvh, GtsSurface * s)
+{
+  GNode * tree = gts_bb_tree_surface (s);
+  GtsBBox * bb = gts_bvh_bbox (gts_bbox_class (), bvh);
+  GtsPoint * p = gts_point_new (gts_point_class (), 0., 0., 0.);
+  guint i;
+
+  check_same_bbox (bb, tree->data);
+  srand (1);
+  for (i = 0; i < N; i++) {
+    GtsBBox * bb1;
+
+    p->x = random_coord (bb->x1, bb->x2);
+    p->y = random_coord (bb->y1, bb->y2);
+    p->z = random_coord (bb->z1, bb->z2);
+    check_same_list (gts_bb_tree_stabbed (tree, p), 
+		     gts_bvh_stabbed (bvh, p));
+    g_assert (gts_bb_tree_point_distance (tree, p, (GtsBBoxDistFunc) 
+					  gts_point_triangle_distance, NULL) ==
+	      gts_bvh_point_distance (bvh, p, (GtsBBoxDistFunc) 
+				      gts_point_triangle_distance, NULL));
+
+    bb1 = gts_bbox_new (gts_bbox_class (), NULL, p->x, p->y, p->z,
+			p->x + 0.05*(bb->x2 - bb->x1),
+			p->y + 0.1*(bb->y2 - bb->y1),
+			p->z + 0.02*(bb->z2 - bb->z1));
+    check_same_list (gts_bb_tree_overlap (tree, bb1),
+		     gts_bvh_overlap (bvh, bb1));
+    gts_object_destroy (GTS_OBJECT (bb1));
+  }
+
+  gts_object_destroy (GTS_OBJECT (p));
+  gts_object_destroy (GTS_OBJECT (bb));
+  gts_bb_tree_destroy (tree, TRUE);
+}
+
+int main (int argc, char * argv[])
+{
+  GtsSurface * s = sphere (4, 1., 0.);
+  GtsBVH * bvh, * bvh1, * trees[5];
+  GtsBVHStats stats, stats1;
+  gboolean rebuilt;
+  GSList * bboxes = NULL;
+  gdouble amount = 0.3;
+  guint threads;
+
+  /* small displacements keep the hierarchy */
+  bvh = gts_bvh_surface_full (s, GTS_BVH_BINNED_SAH, 4, 1);
+  bvh1 = gts_bvh_surface_full (s, GTS_BVH_BINNED_SAH, 4, 1);
+  gts_surface_foreach_vertex (s, (GtsFunc) twist, &amount);
+  rebuilt = gts_bvh_refit (bvh, 0.5, 1);
+  g_assert (!rebuilt);
+  rebuilt = gts_bvh_refit (bvh1, 0., 1);
+  g_assert (!rebuilt);
+  check_same_tree (bvh, bvh1);
+  check_bvh (bvh, s);
+
+  /* large ones rebuild the tree when it becomes too costly */
+  amount = 3.;
+  gts_surface_foreach_vertex (s, (GtsFunc) twist, &amount);
+  rebuilt = gts_bvh_refit (bvh, 0.5, 1);
+  g_assert (rebuilt);
+  rebuilt = gts_bvh_refit (bvh1, 0., 1);
+  g_assert (!rebuilt);
+  check_bvh (bvh, s);
+  check_bvh (bvh1, s);
+  gts_bvh_stats (bvh, &stats);
+  gts_bvh_stats (bvh1, &stats1);
+  g_assert (stats.sah_cost < stats1.sah_cost);
+  gts_bvh_destroy (bvh1, TRUE);
+  gts_bvh_destroy (bvh, TRUE);
+
+  /* the leaves of other trees are updated by the caller */
+  gts_surface_foreach_face (s, (GtsFunc) add_bbox, &bboxes);
+  bvh = gts_bvh_new_full (bboxes, GTS_BVH_MEDIAN, 4, 1);
+  amount = 1.;
+  gts_surface_foreach_vertex (s, (GtsFunc) twist, &amount);
+  g_slist_foreach (bboxes, (GFunc) update_bbox, NULL);
+  rebuilt = gts_bvh_refit (bvh, 0., 1);
+  g_assert (!rebuilt);
+  check_bvh (bvh, s);
+  gts_bvh_destroy (bvh, TRUE);
+  g_slist_free (bboxes);
+  gts_object_destroy (GTS_OBJECT (s));
+
+  /* the refitted bounds do not depend on the number of threads, for
+     trees large enough to be refitted concurrently */
+  s = sphere (7, 1., 0.);
+  bvh1 = gts_bvh_surface_full (s, GTS_BVH_BINNED_SAH, 4, 1);
+  for (threads = 2; threads <= 4; threads++)
+    trees[threads] = gts_bvh_surface_full (s, GTS_BVH_BINNED_SAH, 4, threads);
+  amount = 0.3;
+  gts_surface_foreach_vertex (s, (GtsFunc) twist, &amount);
+  rebuilt = gts_bvh_refit (bvh1, 0., 1);
+  g_assert (!rebuilt);
+  for (threads = 2; threads <= 4; threads++) {
+    rebuilt = gts_bvh_refit (trees[threads], 0., threads);
+    g_assert (!rebuilt);
+    check_same_tree (trees[threads], bvh1);
+    gts_bvh_destroy (trees[threads], TRUE);
+  }
+  gts_bvh_destroy (bvh1, TRUE);
+  gts_object_destroy (GTS_OBJECT (s));
+
+  return EXIT_SUCCESS;
+}
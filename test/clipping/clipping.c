@@ -538,17 +538,17 @@ static void print_segment (GtsSegment * s, FILE * fp)
 
 static void segment_detach (GtsSegment * s)
 {
-  s->v1->segments = g_slist_remove (s->v1->segments, s);
-  s->v2->segments = g_slist_remove (s->v2->segments, s);
+  gts_vertex_remove_segment (s->v1, s);
+  gts_vertex_remove_segment (s->v2, s);
   s->v1 = s->v2 = NULL;
 }
 
 static void segment_attach (GtsSegment * s, GtsVertex * v1, GtsVertex * v2)
 {
   s->v1 = v1;
-  v1->segments = g_slist_prepend (v1->segments, s);
+  gts_vertex_add_segment (v1, s);
   s->v2 = v2;
-  v2->segments = g_slist_prepend (v2->segments, s);
+  gts_vertex_add_segment (v2, s);
 }
 
 static GtsConstraint * new_constraint (GtsVertex * v1,
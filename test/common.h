@@ -0,0 +1,190 @@
+/* GTS - Library for the manipulation of triangulated surfaces
+ * Copyright (C) 1999 Stéphane Popinet
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+/* Fixtures shared by the test programs. Each program uses only some
+   of them. */
+
+#ifndef __TEST_COMMON_H__
+#define __TEST_COMMON_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gts.h"
+
+/* Returns a new empty surface with vertices of class @klass */
+G_GNUC_UNUSED
+static GtsSurface * surface_new (GtsVertexClass * klass)
+{
+  return gts_surface_new (gts_surface_class (), gts_face_class (),
+			  gts_edge_class (), klass);
+}
+
+/* Returns a sphere of radius @scale centered on (@dx,0,0) */
+G_GNUC_UNUSED
+static GtsSurface * sphere (guint level, gdouble scale, gdouble dx)
+{
+  GtsSurface * s = surface_new (gts_vertex_class ());
+
+  gts_surface_generate_sphere (s, level);
+  if (scale != 1. || dx != 0.) {
+    GtsVector v = { scale, scale, scale };
+    GtsMatrix * m = gts_matrix_scale (NULL, v);
+
+    m[0][3] = dx;
+    gts_surface_foreach_vertex (s, (GtsFunc) gts_point_transform, m);
+    gts_matrix_destroy (m);
+  }
+  return s;
+}
+
+/* Checks that @s1 and @s2 are identical */
+G_GNUC_UNUSED
+static void check_same (GtsSurface * s1, GtsSurface * s2)
+{
+  gdouble * xyz1 = NULL, * xyz2 = NULL;
+  guint * t1 = NULL, * t2 = NULL, nv1, nv2, nt1, nt2, i;
+
+  g_assert (gts_surface_edge_number (s1) == gts_surface_edge_number (s2));
+  gts_surface_export_arrays (s1, &xyz1, NULL, &t1, &nv1, &nt1);
+  gts_surface_export_arrays (s2, &xyz2, NULL, &t2, &nv2, &nt2);
+  g_assert (nv1 == nv2 && nt1 == nt2);
+  for (i = 0; i < 3*nv1; i++)
+    g_assert (xyz1[i] == xyz2[i]);
+  for (i = 0; i < 3*nt1; i++)
+    g_assert (t1[i] == t2[i]);
+  g_free (xyz1); g_free (xyz2);
+  g_free (t1); g_free (t2);
+}
+
+/* Returns a new file containing the first @length bytes of @content
+   (all of it if @length is negative), rewound */
+G_GNUC_UNUSED
+static FILE * file_new (const gchar * content, gssize length)
+{
+  FILE * fp = tmpfile ();
+  gsize n;
+
+  g_assert (fp != NULL);
+  if (length < 0)
+    length = strlen (content);
+  n = fwrite (content, 1, length, fp);
+  g_assert (n == length);
+  rewind (fp);
+  return fp;
+}
+
+/* Returns the whole content of @fp, followed by a null byte, and
+   stores its length in @length */
+G_GNUC_UNUSED
+static gchar * file_content (FILE * fp, glong * length)
+{
+  gchar * content;
+  gsize n;
+
+  fseek (fp, 0, SEEK_END);
+  *length = ftell (fp);
+  content = g_malloc (*length + 1);
+  rewind (fp);
+  n = fread (content, 1, *length, fp);
+  g_assert (n == *length);
+  content[*length] = '\0';
+  return content;
+}
+
+/* Bounding box trees */
+
+G_GNUC_UNUSED
+static void add_bbox (GtsTriangle * t, GSList ** bboxes)
+{
+  *bboxes = g_slist_prepend (*bboxes, 
+			     gts_bbox_triangle (gts_bbox_class (), t));
+}
+
+G_GNUC_UNUSED
+static gint compare_pointers (gconstpointer a, gconstpointer b)
+{
+  return a < b ? -1 : a > b;
+}
+
+/* Checks that the bounding boxes of @l1 and @l2 bound the same
+   objects and frees the lists */
+G_GNUC_UNUSED
+static void check_same_list (GSList * l1, GSList * l2)
+{
+  GSList * i, * j;
+
+  for (i = l1; i; i = i->next)
+    i->data = GTS_BBOX (i->data)->bounded;
+  for (j = l2; j; j = j->next)
+    j->data = GTS_BBOX (j->data)->bounded;
+  l1 = g_slist_sort (l1, compare_pointers);
+  l2 = g_slist_sort (l2, compare_pointers);
+  for (i = l1, j = l2; i && j; i = i->next, j = j->next)
+    g_assert (i->data == j->data);
+  g_assert (i == NULL && j == NULL);
+  g_slist_free (l1);
+  g_slist_free (l2);
+}
+
+G_GNUC_UNUSED
+static void check_same_bbox (GtsBBox * bb1, GtsBBox * bb2)
+{
+  g_assert (bb1->x1 == bb2->x1 && bb1->x2 == bb2->x2);
+  g_assert (bb1->y1 == bb2->y1 && bb1->y2 == bb2->y2);
+  g_assert (bb1->z1 == bb2->z1 && bb1->z2 == bb2->z2);
+}
+
+/* Checks that @bvh1 and @bvh2 are the same tree with the same bounds */
+G_GNUC_UNUSED
+static void check_same_tree (GtsBVH * bvh1, GtsBVH * bvh2)
+{
+  GtsBVHStats stats1, stats2;
+  GtsBBox ** leaves1, ** leaves2, * bb1, * bb2;
+  guint n1, n2, i;
+
+  leaves1 = gts_bvh_leaves (bvh1, &n1);
+  leaves2 = gts_bvh_leaves (bvh2, &n2);
+  g_assert (n1 == n2);
+  for (i = 0; i < n1; i++) {
+    g_assert (leaves1[i]->bounded == leaves2[i]->bounded);
+    check_same_bbox (leaves1[i], leaves2[i]);
+  }
+  gts_bvh_stats (bvh1, &stats1);
+  gts_bvh_stats (bvh2, &stats2);
+  g_assert (stats1.n_nodes == stats2.n_nodes);
+  g_assert (stats1.n_leaves == stats2.n_leaves);
+  g_assert (stats1.depth == stats2.depth);
+  g_assert (stats1.sah_cost == stats2.sah_cost);
+  bb1 = gts_bvh_bbox (gts_bbox_class (), bvh1);
+  bb2 = gts_bvh_bbox (gts_bbox_class (), bvh2);
+  check_same_bbox (bb1, bb2);
+  gts_object_destroy (GTS_OBJECT (bb1));
+  gts_object_destroy (GTS_OBJECT (bb2));
+}
+
+/* Returns a random coordinate in [@x1,@x2] extended by 20% on each side */
+G_GNUC_UNUSED
+static gdouble random_coord (gdouble x1, gdouble x2)
+{
+  return x1 + (x2 - x1)*(1.4*rand ()/(gdouble) RAND_MAX - 0.2);
+}
+
+#endif /* __TEST_COMMON_H__ */
@@ -0,0 +1,110 @@
+/* GTS - Library for the manipulation of triangulated surfaces
+ * Copyright (C) 1999 Stéphane Popinet
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include "gts.h"
+#include "common.h"
+
+static void set_normal (GtsVertex * v)
+{
+  GTS_VERTEX_NORMAL (v)->n[0] = GTS_POINT (v)->x;
+  GTS_VERTEX_NORMAL (v)->n[1] = GTS_POINT (v)->y;
+  GTS_VERTEX_NORMAL (v)->n[2] = GTS_POINT (v)->z;
+}
+
+static void check_normal (GtsVertex * v)
+{
+  g_assert (GTS_VERTEX_NORMAL (v)->n[0] == GTS_POINT (v)->x);
+  g_assert (GTS_VERTEX_NORMAL (v)->n[1] == GTS_POINT (v)->y);
+  g_assert (GTS_VERTEX_NORMAL (v)->n[2] == GTS_POINT (v)->z);
+}
+
+/* Reads a surface of vertex class @klass from @fp, mapped or not,
+   returns %NULL if an error occured */
+static GtsSurface * read_surface (FILE * fp, gboolean mapped,
+				  GtsVertexClass * klass)
+{
+  GtsSurface * s = surface_new (klass);
+  GtsFile * f;
+
+  rewind (fp);
+  f = mapped ? gts_file_new_mapped (fp) : gts_file_new (fp);
+  if (gts_surface_read (s, f)) {
+    gts_object_destroy (GTS_OBJECT (s));
+    s = NULL;
+  }
+  gts_file_destroy (f);
+  return s;
+}
+
+int main (int argc, char * argv[])
+{
+  GtsVertexClass * normal_class = 
+    GTS_VERTEX_CLASS (gts_vertex_normal_class ());
+  GtsSurface * s = surface_new (normal_class), * s1;
+  gchar * content;
+  glong length, l;
+  guint mapped;
+  FILE * fp;
+
+  gts_surface_generate_sphere (s, 5);
+  gts_surface_foreach_vertex (s, (GtsFunc) set_normal, NULL);
+  fp = tmpfile ();
+  g_assert (fp != NULL);
+  gts_surface_write_binary (s, fp);
+
+  for (mapped = 0; mapped < 2; mapped++) {
+    /* with the normals */
+    s1 = read_surface (fp, mapped, normal_class);
+    g_assert (s1 != NULL);
+    check_same (s, s1);
+    gts_surface_foreach_vertex (s1, (GtsFunc) check_normal, NULL);
+    gts_object_destroy (GTS_OBJECT (s1));
+
+    /* ignoring them */
+    s1 = read_surface (fp, mapped, gts_vertex_class ());
+    g_assert (s1 != NULL);
+    check_same (s, s1);
+    gts_object_destroy (GTS_OBJECT (s1));
+  }
+
+  /* truncated files are errors */
+  content = file_content (fp, &length);
+  fclose (fp);
+  for (l = 17; l < length; l += length/7) {
+    fp = file_new (content, l);
+    for (mapped = 0; mapped < 2; mapped++)
+      g_assert (read_surface (fp, mapped, normal_class) == NULL);
+    fclose (fp);
+  }
+
+  /* and so are wrong counts, without allocating memory for them */
+  memset (content + 21, 0xff, 4);
+  fp = file_new (content, length);
+  for (mapped = 0; mapped < 2; mapped++)
+    g_assert (read_surface (fp, mapped, normal_class) == NULL);
+  fclose (fp);
+
+  g_free (content);
+  gts_object_destroy (GTS_OBJECT (s));
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,158 @@
+/* GTS - Library for the manipulation of triangulated surfaces
+ * Copyright (C) 1999 Stéphane Popinet
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include "gts.h"
+#include "common.h"
+
+/* Malformed or unusual GTS files, which must be read exactly as by
+   the tokenizer */
+static const gchar * cases[] = {
+  "3 3 1\n0 0 0\n1 0 0\n0 1 0\n1 2\n2 3\n3 1\n1 2 3\n",
+  "3 3 1 GtsSurface GtsFace GtsEdge GtsVertex\n"
+  "0 0 0\n1 0 0\n0 1 0\n1 2\n2 3\n3 1\n1 2 3\n",
+  "# comment\n3 3 1\n0 0 0 # comment\n1e0 0 0\n\n0 1. 0\n"
+  "1 2\n2 3\n3 1\n1 2 3\n",
+  "3 3 1\r\n0 0 0\r\n1 0 0\r\n0 1 0\r\n1 2\r\n2 3\r\n3 1\r\n1 2 3\r\n",
+  "3 3 1\n0 0 0\n1 0 0\n0 1-2 0\n1 2\n2 3\n3 1\n1 2 3\n",
+  "3 3 1\n0 0 0\n1 0 0\n0 1.0.0 0\n1 2\n2 3\n3 1\n1 2 3\n",
+  "3 3 1\n0 0 0\n1 0 0\n0 a 0\n1 2\n2 3\n3 1\n1 2 3\n",
+  "3 3 1\n0 0 0\n1 0 0\n0 1 0\n1 4\n2 3\n3 1\n1 2 3\n",
+  "3 3 1\n0 0 0\n1 0 0\n0 1 0\n1 2\n2 3\n3 1\n1 2 4\n",
+  "3 3 1\n0 0 0\n1 0 0\n0 1 0\n1 2\n2 3\n",
+  "3 3 2\n0 0 0\n1 0 0\n0 1 0\n1 2\n2 3\n3 1\n1 2 3\n",
+  NULL
+};
+
+/* Reads a surface from @fp, with the tokenizer if @threads is 0 or
+   from a mapped file parsed with @threads threads */
+static GtsSurface * read_surface (FILE * fp, guint threads, gchar ** error)
+{
+  GtsSurface * s = surface_new (gts_vertex_class ());
+  GtsFile * f;
+
+  rewind (fp);
+  if (threads) {
+    f = gts_file_new_mapped (fp);
+    gts_file_set_threads (f, threads);
+  }
+  else
+    f = gts_file_new (fp);
+  g_assert (f != NULL);
+  if (gts_surface_read (s, f)) {
+    *error = g_strdup_printf ("%d:%d: %s", f->line, f->pos, f->error);
+    gts_object_destroy (GTS_OBJECT (s));
+    s = NULL;
+  }
+  else
+    *error = NULL;
+  gts_file_destroy (f);
+  return s;
+}
+
+static void check_file (FILE * fp)
+{
+  gchar * error;
+  GtsSurface * s = read_surface (fp, 0, &error);
+  guint threads;
+
+  for (threads = 1; threads <= 4; threads++) {
+    gchar * error_mapped;
+    GtsSurface * s_mapped = read_surface (fp, threads, &error_mapped);
+
+    if (s) {
+      g_assert (s_mapped != NULL);
+      check_same (s, s_mapped);
+      gts_object_destroy (GTS_OBJECT (s_mapped));
+    }
+    else {
+      g_assert (s_mapped == NULL);
+      if (strcmp (error, error_mapped)) {
+	fprintf (stderr, "tokenizer: %s\nmapped (%u threads): %s\n",
+		 error, threads, error_mapped);
+	exit (EXIT_FAILURE);
+      }
+      g_free (error_mapped);
+    }
+  }
+  if (s)
+    gts_object_destroy (GTS_OBJECT (s));
+  g_free (error);
+}
+
+/* Replaces line @i of @lines with @record and checks the result */
+static void check_corrupted (gchar ** lines, guint i, const gchar * record)
+{
+  gchar * saved = lines[i], * content;
+  FILE * fp;
+
+  lines[i] = (gchar *) record;
+  content = g_strjoinv ("\n", lines);
+  lines[i] = saved;
+  fp = file_new (content, -1);
+  check_file (fp);
+  fclose (fp);
+  g_free (content);
+}
+
+int main (int argc, char * argv[])
+{
+  GtsSurface * s = surface_new (gts_vertex_class ());
+  FILE * fp;
+  guint i;
+
+  gchar ** lines, * content;
+  guint nv, ne, nf;
+  glong length;
+
+  /* large enough to be parsed in four chunks */
+  gts_surface_generate_sphere (s, 6);
+  nv = gts_surface_vertex_number (s);
+  ne = gts_surface_edge_number (s);
+  nf = gts_surface_face_number (s);
+  fp = tmpfile ();
+  g_assert (fp != NULL);
+  gts_surface_write (s, fp);
+  check_file (fp);
+  gts_object_destroy (GTS_OBJECT (s));
+
+  /* errors in each of the chunks */
+  content = file_content (fp, &length);
+  fclose (fp);
+  lines = g_strsplit (content, "\n", 0);
+  g_free (content);
+  g_assert (g_strv_length (lines) > 1 + nv + ne + nf);
+  for (i = 1; i < 4; i++) {
+    check_corrupted (lines, 1 + i*nv/4, "0 a 0");
+    check_corrupted (lines, 1 + nv + i*ne/4, "1 0");
+    check_corrupted (lines, 1 + nv + ne + i*nf/4, "1 2 1000000000");
+  }
+  check_corrupted (lines, nv + ne + nf, "1 2");
+  g_strfreev (lines);
+
+  for (i = 0; cases[i]; i++) {
+    fp = file_new (cases[i], -1);
+    check_file (fp);
+    fclose (fp);
+  }
+
+  return EXIT_SUCCESS;
+}
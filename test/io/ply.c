@@ -0,0 +1,159 @@
+/* GTS - Library for the manipulation of triangulated surfaces
+ * Copyright (C) 1999 Stéphane Popinet
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "gts.h"
+#include "common.h"
+
+/* Reads a surface of vertex class @klass from the PLY file @fp,
+   mapped or not, returns %NULL if an error occured */
+static GtsSurface * read_ply (FILE * fp, gboolean mapped, 
+			      GtsVertexClass * klass)
+{
+  GtsSurface * s = surface_new (klass);
+  GtsFile * f;
+
+  rewind (fp);
+  f = mapped ? gts_file_new_mapped (fp) : gts_file_new (fp);
+  if (gts_surface_read_ply (s, f)) {
+    gts_object_destroy (GTS_OBJECT (s));
+    s = NULL;
+  }
+  gts_file_destroy (f);
+  return s;
+}
+
+/* Checks that @s1 is @s written with ten significant digits */
+static void check_ply (GtsSurface * s, GtsSurface * s1)
+{
+  GtsBBox * bb = gts_bbox_surface (gts_bbox_class (), s);
+  GtsBBox * bb1 = gts_bbox_surface (gts_bbox_class (), s1);
+  gdouble area = gts_surface_area (s);
+
+  g_assert (gts_surface_vertex_number (s1) == gts_surface_vertex_number (s));
+  g_assert (gts_surface_edge_number (s1) == gts_surface_edge_number (s));
+  g_assert (gts_surface_face_number (s1) == gts_surface_face_number (s));
+  g_assert (gts_surface_is_closed (s1));
+  g_assert (fabs (gts_surface_area (s1) - area) < 1e-9*area);
+  g_assert (fabs (bb1->x1 - bb->x1) < 1e-9 && fabs (bb1->x2 - bb->x2) < 1e-9);
+  g_assert (fabs (bb1->y1 - bb->y1) < 1e-9 && fabs (bb1->y2 - bb->y2) < 1e-9);
+  g_assert (fabs (bb1->z1 - bb->z1) < 1e-9 && fabs (bb1->z2 - bb->z2) < 1e-9);
+  gts_object_destroy (GTS_OBJECT (bb));
+  gts_object_destroy (GTS_OBJECT (bb1));
+}
+
+static void set_color (GtsVertex * v)
+{
+  GTS_COLOR_VERTEX (v)->c.r = (GTS_POINT (v)->x + 1.)/2.;
+  GTS_COLOR_VERTEX (v)->c.g = (GTS_POINT (v)->y + 1.)/2.;
+  GTS_COLOR_VERTEX (v)->c.b = (GTS_POINT (v)->z + 1.)/2.;
+}
+
+static void check_color (GtsVertex * v)
+{
+  GtsColor c = GTS_COLOR_VERTEX (v)->c;
+
+  g_assert (fabs (c.r - (GTS_POINT (v)->x + 1.)/2.) <= 1./255.);
+  g_assert (fabs (c.g - (GTS_POINT (v)->y + 1.)/2.) <= 1./255.);
+  g_assert (fabs (c.b - (GTS_POINT (v)->z + 1.)/2.) <= 1./255.);
+}
+
+static const gchar * header =
+  "ply\n"
+  "format ascii 1.0\n"
+  "element vertex 4\n"
+  "property float x\n"
+  "property float y\n"
+  "property float z\n"
+  "element face 1\n"
+  "property list uchar int vertex_indices\n"
+  "end_header\n"
+  "0 0 0\n"
+  "1 0 0\n"
+  "1 1 0\n"
+  "0 1 0\n";
+
+int main (int argc, char * argv[])
+{
+  GtsVertexClass * color_class = 
+    GTS_VERTEX_CLASS (gts_color_vertex_class ());
+  GtsSurface * s = surface_new (color_class), * s1, * s2;
+  gboolean binary;
+  gchar * content;
+  FILE * fp;
+
+  gts_surface_generate_sphere (s, 4);
+  gts_surface_foreach_vertex (s, (GtsFunc) set_color, NULL);
+
+  for (binary = FALSE; binary <= TRUE; binary++) {
+    fp = tmpfile ();
+    g_assert (fp != NULL);
+    gts_surface_write_ply (s, fp, binary);
+
+    /* with the colors */
+    s1 = read_ply (fp, FALSE, color_class);
+    g_assert (s1 != NULL);
+    check_ply (s, s1);
+    gts_surface_foreach_vertex (s1, (GtsFunc) check_color, NULL);
+    s2 = read_ply (fp, TRUE, color_class);
+    g_assert (s2 != NULL);
+    check_same (s1, s2);
+    gts_object_destroy (GTS_OBJECT (s1));
+    gts_object_destroy (GTS_OBJECT (s2));
+
+    /* ignoring them */
+    s1 = read_ply (fp, TRUE, gts_vertex_class ());
+    g_assert (s1 != NULL);
+    check_ply (s, s1);
+    gts_object_destroy (GTS_OBJECT (s1));
+    fclose (fp);
+  }
+
+  /* quads are triangulated */
+  content = g_strconcat (header, "4 0 1 2 3\n", NULL);
+  fp = file_new (content, -1);
+  s1 = read_ply (fp, FALSE, gts_vertex_class ());
+  g_assert (s1 != NULL);
+  g_assert (gts_surface_face_number (s1) == 2);
+  g_assert (gts_surface_vertex_number (s1) == 4);
+  g_assert (fabs (gts_surface_area (s1) - 1.) < 1e-12);
+  gts_object_destroy (GTS_OBJECT (s1));
+  fclose (fp);
+  g_free (content);
+
+  /* invalid vertex indices are errors */
+  content = g_strconcat (header, "3 0 1 4\n", NULL);
+  fp = file_new (content, -1);
+  g_assert (read_ply (fp, FALSE, gts_vertex_class ()) == NULL);
+  g_assert (read_ply (fp, TRUE, gts_vertex_class ()) == NULL);
+  fclose (fp);
+  g_free (content);
+
+  /* and so are missing faces */
+  fp = file_new (header, -1);
+  g_assert (read_ply (fp, FALSE, gts_vertex_class ()) == NULL);
+  fclose (fp);
+
+  gts_object_destroy (GTS_OBJECT (s));
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,207 @@
+/* GTS - Library for the manipulation of triangulated surfaces
+ * Copyright (C) 1999 Stéphane Popinet
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include <stdlib.h>
+#include <math.h>
+#include "gts.h"
+#include "common.h"
+
+/* Returns the largest coordinate difference between a vertex of @s1
+   and the closest vertex of @s2 */
+static gdouble vertices_distance (GtsSurface * s1, GtsSurface * s2)
+{
+  gdouble * xyz1 = NULL, * xyz2 = NULL, dmax = 0.;
+  guint nv1, nv2, nt, i, j;
+
+  gts_surface_export_arrays (s1, &xyz1, NULL, NULL, &nv1, &nt);
+  gts_surface_export_arrays (s2, &xyz2, NULL, NULL, &nv2, &nt);
+  g_assert (nv1 == nv2);
+  for (i = 0; i < nv1; i++) {
+    gdouble dmin = G_MAXDOUBLE;
+
+    for (j = 0; j < nv2 && dmin > 0.; j++) {
+      gdouble d = MAX (fabs (xyz1[3*i] - xyz2[3*j]),
+		       MAX (fabs (xyz1[3*i + 1] - xyz2[3*j + 1]),
+			    fabs (xyz1[3*i + 2] - xyz2[3*j + 2])));
+      
+      if (d < dmin)
+	dmin = d;
+    }
+    if (dmin > dmax)
+      dmax = dmin;
+  }
+  g_free (xyz1);
+  g_free (xyz2);
+  return dmax;
+}
+
+/* Opens the binary progressive surface @fp, returns %NULL if an error
+   occured */
+static GtsPSurface * psurface_open (FILE * fp, GtsFile ** f)
+{
+  GtsSurface * s = surface_new (gts_vertex_class ());
+  GtsPSurface * ps;
+
+  rewind (fp);
+  *f = gts_file_new_mapped (fp);
+  ps = gts_psurface_open (gts_psurface_class (), s, gts_split_class (), *f);
+  if (ps == NULL) {
+    gts_file_destroy (*f);
+    gts_object_destroy (GTS_OBJECT (s));
+  }
+  return ps;
+}
+
+static void psurface_destroy (GtsPSurface * ps, GtsFile * f)
+{
+  GtsSurface * s = ps->s;
+
+  gts_object_destroy (GTS_OBJECT (ps));
+  gts_object_destroy (GTS_OBJECT (s));
+  gts_file_destroy (f);
+}
+
+/* Checks the binary progressive surface @fp against @ps, written with
+   quantization step @step, and whose number of faces for each vertex
+   split is given by @faces */
+static void check_psurface (FILE * fp, GtsPSurface * ps, gdouble step,
+			    const guint * faces)
+{
+  GtsPSurface * ps1;
+  GtsSplit * vs;
+  GtsFile * f;
+  guint nv, k, nf;
+  gsize size, size0 = 0;
+  const gchar * s0 = NULL;
+  gboolean ok;
+
+  ps1 = psurface_open (fp, &f);
+  g_assert (ps1 != NULL);
+  nv = gts_psurface_min_vertex_number (ps);
+  g_assert (gts_psurface_min_vertex_number (ps1) == nv);
+  g_assert (gts_psurface_max_vertex_number (ps1) == 
+	    gts_psurface_max_vertex_number (ps));
+
+  /* the index gives the number of faces and the position of the
+     records for each level of detail... */
+  for (k = 0; k <= ps->split->len; k++) {
+    ok = gts_psurface_lod (ps1, nv + k, &nf, &size);
+    g_assert (ok);
+    g_assert (nf == faces[k]);
+    if (k == 0) {
+      size0 = size;
+      s0 = f->s;
+    }
+    g_assert (size - size0 == f->s - s0);
+    g_assert (gts_surface_vertex_number (ps1->s) == nv + k);
+    g_assert (gts_surface_face_number (ps1->s) == faces[k]);
+    vs = gts_psurface_read_vertex (ps1, f);
+    g_assert (vs != NULL || k == ps->split->len);
+  }
+  g_assert (f->type != GTS_ERROR);
+  /* ...and is clamped to the range of vertex numbers */
+  ok = gts_psurface_lod (ps1, 0, &nf, NULL);
+  g_assert (ok && nf == faces[0]);
+  ok = gts_psurface_lod (ps1, G_MAXUINT, &nf, NULL);
+  g_assert (ok && nf == faces[ps->split->len]);
+  gts_psurface_close (ps1);
+
+  /* the geometry is the same, within the quantization error */
+  gts_psurface_set_vertex_number (ps, gts_psurface_max_vertex_number (ps));
+  gts_psurface_set_vertex_number (ps1, gts_psurface_max_vertex_number (ps1));
+  g_assert (gts_surface_edge_number (ps1->s) == 
+	    gts_surface_edge_number (ps->s));
+  g_assert (gts_surface_face_number (ps1->s) == 
+	    gts_surface_face_number (ps->s));
+  if (step > 0.)
+    g_assert (vertices_distance (ps1->s, ps->s) <= step/2.*(1. + 1e-6));
+  else
+    g_assert (vertices_distance (ps1->s, ps->s) == 0.);
+
+  /* and it can be coarsened again (then refined, so that the
+     vertices of the splits belong to the surface when destroyed) */
+  gts_psurface_set_vertex_number (ps1, 0);
+  g_assert (gts_surface_face_number (ps1->s) == faces[0]);
+  gts_psurface_set_vertex_number (ps1, gts_psurface_max_vertex_number (ps1));
+  psurface_destroy (ps1, f);
+}
+
+int main (int argc, char * argv[])
+{
+  GtsSurface * s = sphere (4, 1., 0.);
+  gdouble steps[] = { 0., 1e-4 };
+  guint nedge = 300, * faces, i, k;
+  gchar * content;
+  glong length, l;
+  GtsPSurface * ps;
+  GtsFile * f;
+  FILE * fp;
+
+  ps = gts_psurface_new (gts_psurface_class (), s, gts_split_class (),
+			 NULL, NULL, NULL, NULL,
+			 (GtsStopFunc) gts_coarsen_stop_number, &nedge, 
+			 M_PI/180.);
+  g_assert (ps->split->len > 64);
+
+  /* the number of faces for each vertex split */
+  faces = g_malloc ((ps->split->len + 1)*sizeof (guint));
+  gts_psurface_set_vertex_number (ps, 0);
+  for (k = 0; k <= ps->split->len; k++) {
+    faces[k] = gts_surface_face_number (s);
+    g_assert (gts_psurface_add_vertex (ps) != NULL || k == ps->split->len);
+  }
+
+  for (i = 0; i < G_N_ELEMENTS (steps); i++) {
+    fp = tmpfile ();
+    g_assert (fp != NULL);
+    gts_psurface_write_binary (ps, fp, steps[i]);
+    check_psurface (fp, ps, steps[i], faces);
+
+    /* truncated files are errors, when opening them or when reading
+       the vertex splits */
+    content = file_content (fp, &length);
+    fclose (fp);
+    for (l = 0; l < length; l += 1 + length/37) {
+      GtsPSurface * ps1;
+
+      fp = file_new (content, l);
+      if ((ps1 = psurface_open (fp, &f))) {
+	while (gts_psurface_read_vertex (ps1, f))
+	  ;
+	g_assert (f->type == GTS_ERROR);
+	psurface_destroy (ps1, f);
+      }
+      fclose (fp);
+    }
+
+    /* so are unknown versions */
+    content[strlen ("GtsPSurfaceBinary\n")] = 2;
+    fp = file_new (content, length);
+    g_assert (psurface_open (fp, &f) == NULL);
+    fclose (fp);
+    g_free (content);
+  }
+
+  g_free (faces);
+  gts_object_destroy (GTS_OBJECT (ps));
+  gts_object_destroy (GTS_OBJECT (s));
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,151 @@
+/* GTS - Library for the manipulation of triangulated surfaces
+ * Copyright (C) 1999 Stéphane Popinet
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "gts.h"
+#include "common.h"
+
+/* Converts @fp with gts_triangle_soup_convert() and checks that the
+   result is identical to @expected */
+static void check_convert (FILE * fp, const gchar * expected, glong length)
+{
+  FILE * soup = tmpfile ();
+  gchar * content;
+  glong l;
+  GtsFile * f;
+  guint line;
+
+  g_assert (soup != NULL);
+  rewind (fp);
+  f = gts_file_new_mapped (fp);
+  line = gts_triangle_soup_convert (f, soup);
+  g_assert (line == 0);
+  gts_file_destroy (f);
+  content = file_content (soup, &l);
+  g_assert (l == length && !memcmp (content, expected, length));
+  g_free (content);
+  fclose (soup);
+}
+
+static void add_triangle (GtsTriangle * t, GtsClusterGrid * grid)
+{
+  GtsVertex * v1, * v2, * v3;
+
+  gts_triangle_vertices (t, &v1, &v2, &v3);
+  gts_cluster_grid_add_triangle (grid, 
+				 GTS_POINT (v1), GTS_POINT (v2), GTS_POINT (v3),
+				 NULL);
+}
+
+int main (int argc, char * argv[])
+{
+  GtsSurface * s = surface_new (gts_vertex_class ()), * s1, * s2;
+  GtsBBox * bb, * bb1;
+  GtsClusterGrid * grid;
+  gchar * expected;
+  glong length;
+  guint64 nt, n;
+  gboolean ok;
+  FILE * fp, * fp1;
+
+  gts_surface_generate_sphere (s, 4);
+  bb = gts_bbox_surface (gts_bbox_class (), s);
+  fp = tmpfile ();
+  g_assert (fp != NULL);
+  gts_surface_write_triangle_soup (s, fp);
+  expected = file_content (fp, &length);
+
+  /* the header */
+  rewind (fp);
+  bb1 = gts_bbox_new (gts_bbox_class (), NULL, 0., 0., 0., 0., 0., 0.);
+  ok = gts_triangle_soup_read_header (fp, &nt, bb1);
+  g_assert (ok);
+  g_assert (nt == gts_surface_face_number (s));
+  g_assert (fabs (bb1->x1 - bb->x1) < 1e-6 && fabs (bb1->x2 - bb->x2) < 1e-6);
+  g_assert (fabs (bb1->y1 - bb->y1) < 1e-6 && fabs (bb1->y2 - bb->y2) < 1e-6);
+  g_assert (fabs (bb1->z1 - bb->z1) < 1e-6 && fabs (bb1->z2 - bb->z2) < 1e-6);
+
+  /* the triangles give the same clusters as the surface itself */
+  s1 = surface_new (gts_vertex_class ());
+  grid = gts_cluster_grid_new (gts_cluster_grid_class (), gts_cluster_class (),
+			       s1, bb1, 1e-3);
+  n = gts_cluster_grid_read_triangle_soup (grid, fp, nt, NULL);
+  g_assert (n == nt);
+  gts_cluster_grid_update (grid);
+  gts_object_destroy (GTS_OBJECT (grid));
+  s2 = surface_new (gts_vertex_class ());
+  grid = gts_cluster_grid_new (gts_cluster_grid_class (), gts_cluster_class (),
+			       s2, bb1, 1e-3);
+  gts_surface_foreach_face (s, (GtsFunc) add_triangle, grid);
+  gts_cluster_grid_update (grid);
+  gts_object_destroy (GTS_OBJECT (grid));
+  g_assert (gts_surface_face_number (s1) == gts_surface_face_number (s));
+  g_assert (gts_surface_vertex_number (s1) == gts_surface_vertex_number (s2));
+  g_assert (gts_surface_edge_number (s1) == gts_surface_edge_number (s2));
+  g_assert (gts_surface_face_number (s1) == gts_surface_face_number (s2));
+  g_assert (fabs (gts_surface_area (s1) - gts_surface_area (s2)) < 
+	    1e-5*gts_surface_area (s2));
+  gts_object_destroy (GTS_OBJECT (s1));
+  gts_object_destroy (GTS_OBJECT (s2));
+
+  /* a truncated soup stops at the last complete triangle */
+  fp1 = file_new (expected, length - 1);
+  ok = gts_triangle_soup_read_header (fp1, NULL, NULL);
+  g_assert (ok);
+  s1 = surface_new (gts_vertex_class ());
+  grid = gts_cluster_grid_new (gts_cluster_grid_class (), gts_cluster_class (),
+			       s1, bb1, 1e-3);
+  n = gts_cluster_grid_read_triangle_soup (grid, fp1, 0, NULL);
+  g_assert (n == nt - 1);
+  gts_object_destroy (GTS_OBJECT (grid));
+  gts_object_destroy (GTS_OBJECT (s1));
+  fclose (fp1);
+
+  /* anything else is not a soup */
+  fp1 = tmpfile ();
+  g_assert (fp1 != NULL);
+  gts_surface_write (s, fp1);
+  rewind (fp1);
+  ok = gts_triangle_soup_read_header (fp1, &nt, bb1);
+  g_assert (!ok);
+  fclose (fp1);
+  fclose (fp);
+
+  /* binary STL and PLY files convert to the same soup */
+  fp = tmpfile ();
+  g_assert (fp != NULL);
+  gts_surface_write_stl (s, fp, TRUE);
+  check_convert (fp, expected, length);
+  fclose (fp);
+  fp = tmpfile ();
+  g_assert (fp != NULL);
+  gts_surface_write_ply (s, fp, TRUE);
+  check_convert (fp, expected, length);
+  fclose (fp);
+
+  g_free (expected);
+  gts_object_destroy (GTS_OBJECT (bb));
+  gts_object_destroy (GTS_OBJECT (bb1));
+  gts_object_destroy (GTS_OBJECT (s));
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,115 @@
+/* GTS - Library for the manipulation of triangulated surfaces
+ * Copyright (C) 1999 Stéphane Popinet
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "gts.h"
+#include "common.h"
+
+/* Reads the STL file @fp using @threads threads and returns the
+   surface or %NULL if an error occured */
+static GtsSurface * read_stl (FILE * fp, guint threads, gdouble epsilon)
+{
+  GtsSurface * s = surface_new (gts_vertex_class ());
+  GtsFile * f;
+
+  rewind (fp);
+  f = gts_file_new_mapped (fp);
+  gts_file_set_threads (f, threads);
+  if (gts_surface_read_stl (s, f, epsilon)) {
+    gts_object_destroy (GTS_OBJECT (s));
+    s = NULL;
+  }
+  gts_file_destroy (f);
+  return s;
+}
+
+/* Checks that @s1 is @s written with single precision */
+static void check_stl (GtsSurface * s, GtsSurface * s1)
+{
+  GtsBBox * bb = gts_bbox_surface (gts_bbox_class (), s);
+  GtsBBox * bb1 = gts_bbox_surface (gts_bbox_class (), s1);
+  gdouble area = gts_surface_area (s);
+
+  g_assert (gts_surface_vertex_number (s1) == gts_surface_vertex_number (s));
+  g_assert (gts_surface_edge_number (s1) == gts_surface_edge_number (s));
+  g_assert (gts_surface_face_number (s1) == gts_surface_face_number (s));
+  g_assert (gts_surface_is_closed (s1));
+  g_assert (fabs (gts_surface_area (s1) - area) < 1e-5*area);
+  g_assert (fabs (bb1->x1 - bb->x1) < 1e-6 && fabs (bb1->x2 - bb->x2) < 1e-6);
+  g_assert (fabs (bb1->y1 - bb->y1) < 1e-6 && fabs (bb1->y2 - bb->y2) < 1e-6);
+  g_assert (fabs (bb1->z1 - bb->z1) < 1e-6 && fabs (bb1->z2 - bb->z2) < 1e-6);
+  gts_object_destroy (GTS_OBJECT (bb));
+  gts_object_destroy (GTS_OBJECT (bb1));
+}
+
+int main (int argc, char * argv[])
+{
+  GtsSurface * s = surface_new (gts_vertex_class ());
+  gboolean binary;
+
+  gts_surface_generate_sphere (s, 4);
+
+  for (binary = FALSE; binary <= TRUE; binary++) {
+    GtsSurface * s1, * s2;
+    guint threads;
+    FILE * fp = tmpfile ();
+
+    g_assert (fp != NULL);
+    gts_surface_write_stl (s, fp, binary);
+
+    /* welding identical vertices gives back the sphere */
+    s1 = read_stl (fp, 1, 0.);
+    g_assert (s1 != NULL);
+    check_stl (s, s1);
+    for (threads = 2; threads <= 4; threads++) {
+      s2 = read_stl (fp, threads, 0.);
+      g_assert (s2 != NULL);
+      check_same (s1, s2);
+      gts_object_destroy (GTS_OBJECT (s2));
+    }
+    gts_object_destroy (GTS_OBJECT (s1));
+
+    /* without welding each facet has its own vertices */
+    s1 = read_stl (fp, 1, -1.);
+    g_assert (s1 != NULL);
+    g_assert (gts_surface_face_number (s1) == gts_surface_face_number (s));
+    g_assert (gts_surface_vertex_number (s1) == 
+	      3*gts_surface_face_number (s));
+    gts_object_destroy (GTS_OBJECT (s1));
+
+    if (binary) {
+      /* truncated binary files are errors */
+      glong length;
+      gchar * content = file_content (fp, &length);
+      FILE * fp1 = file_new (content, length - 1);
+
+      g_assert (read_stl (fp1, 1, 0.) == NULL);
+      g_free (content);
+      fclose (fp1);
+    }
+    fclose (fp);
+  }
+
+  gts_object_destroy (GTS_OBJECT (s));
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,108 @@
+/* GTS - Library for the manipulation of triangulated surfaces
+ * Copyright (C) 1999 Stéphane Popinet
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include "gts.h"
+#include "common.h"
+
+static void mark_reserved (GtsObject * o)
+{
+  o->reserved = o;
+}
+
+static void check_reserved (GtsObject * o)
+{
+  g_assert (o->reserved == o);
+}
+
+int main (int argc, char * argv[])
+{
+  GtsSurface * s = surface_new (gts_vertex_class ()), * s1, * s2 = surface_new (gts_vertex_class ());
+  gchar * expected;
+  glong length;
+  guint threads, line;
+  FILE * fp;
+  GtsFile * f;
+
+  gts_surface_generate_sphere (s, 4);
+  fp = tmpfile ();
+  g_assert (fp != NULL);
+  gts_surface_write (s, fp);
+  expected = file_content (fp, &length);
+  rewind (fp);
+  f = gts_file_new (fp);
+  line = gts_surface_read (s2, f);
+  g_assert (line == 0);
+  gts_file_destroy (f);
+  fclose (fp);
+
+  /* the reserved fields of the user are left untouched */
+  gts_surface_foreach_vertex (s, (GtsFunc) mark_reserved, NULL);
+  gts_surface_foreach_edge (s, (GtsFunc) mark_reserved, NULL);
+
+  for (threads = 1; threads <= 4; threads++) {
+    gchar * content;
+    glong l;
+
+    /* the parallel writer writes the same file... */
+    fp = tmpfile ();
+    g_assert (fp != NULL);
+    gts_surface_write_parallel (s, fp, threads);
+    content = file_content (fp, &l);
+    g_assert (l == length && !memcmp (content, expected, length));
+    g_free (content);
+
+    /* ...which can be read back */
+    rewind (fp);
+    f = gts_file_new_mapped (fp);
+    gts_file_set_threads (f, threads);
+    s1 = surface_new (gts_vertex_class ());
+    line = gts_surface_read (s1, f);
+    g_assert (line == 0);
+    check_same (s1, s2);
+    gts_object_destroy (GTS_OBJECT (s1));
+    gts_file_destroy (f);
+    fclose (fp);
+  }
+
+  gts_surface_foreach_vertex (s, (GtsFunc) check_reserved, NULL);
+  gts_surface_foreach_edge (s, (GtsFunc) check_reserved, NULL);
+
+  /* an empty surface */
+  s1 = surface_new (gts_vertex_class ());
+  fp = tmpfile ();
+  g_assert (fp != NULL);
+  gts_surface_write_parallel (s1, fp, 2);
+  rewind (fp);
+  f = gts_file_new (fp);
+  line = gts_surface_read (s1, f);
+  g_assert (line == 0);
+  g_assert (gts_surface_face_number (s1) == 0);
+  gts_file_destroy (f);
+  fclose (fp);
+  gts_object_destroy (GTS_OBJECT (s1));
+
+  g_free (expected);
+  gts_object_destroy (GTS_OBJECT (s2));
+  gts_object_destroy (GTS_OBJECT (s));
+
+  return EXIT_SUCCESS;
+}
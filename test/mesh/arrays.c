@@ -0,0 +1,142 @@
+/* GTS - Library for the manipulation of triangulated surfaces
+ * Copyright (C) 1999 Stéphane Popinet
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include <stdlib.h>
+#include <math.h>
+#include "gts.h"
+#include "common.h"
+
+static gboolean close_to (gdouble a, gdouble b)
+{
+  return fabs (a - b) <= 1e-12*MAX (fabs (a), fabs (b));
+}
+
+static void check_copy (GtsSurface * s, GtsSurface * copy)
+{
+  g_assert (gts_surface_vertex_number (copy) == 
+	    gts_surface_vertex_number (s));
+  g_assert (gts_surface_edge_number (copy) == gts_surface_edge_number (s));
+  g_assert (gts_surface_face_number (copy) == gts_surface_face_number (s));
+  g_assert (gts_surface_is_closed (copy));
+  g_assert (gts_surface_is_orientable (copy));
+  g_assert (close_to (gts_surface_area (copy), gts_surface_area (s)));
+  g_assert (close_to (gts_surface_volume (copy), gts_surface_volume (s)));
+}
+
+static GtsSurface * from_arrays (gdouble * xyz, guint nv,
+				 guint * triangles, guint nt,
+				 guint threads)
+{
+  return gts_surface_new_from_arrays (gts_surface_class (),
+				      gts_face_class (),
+				      gts_edge_class (),
+				      gts_vertex_class (),
+				      xyz, nv, triangles, nt, threads);
+}
+
+static void mark_vertex (GtsVertex * v, GtsVertex * mark)
+{
+  GTS_OBJECT (v)->reserved = mark;
+}
+
+static void check_vertex (GtsVertex * v, GtsVertex * mark)
+{
+  g_assert (GTS_OBJECT (v)->reserved == mark);
+}
+
+static void check_export (GtsSurface * s)
+{
+  gdouble * xyz = NULL, * normals = NULL, * xyz1 = NULL;
+  guint * triangles = NULL, * triangles1 = NULL, nv, nt, nv1, nt1, i;
+  GtsSurface * copy;
+
+  gts_surface_export_arrays (s, &xyz, &normals, &triangles, &nv, &nt);
+  g_assert (nv == gts_surface_vertex_number (s));
+  g_assert (nt == gts_surface_face_number (s));
+  for (i = 0; i < nv; i++) {
+    gdouble * n = &normals[3*i], * p = &xyz[3*i];
+
+    /* the normals of a sphere are radial */
+    g_assert (close_to (gts_vector_norm (n), 1.));
+    g_assert (gts_vector_scalar (n, p)/gts_vector_norm (p) > 0.99);
+  }
+
+  /* the arrays of a surface built from exported arrays are identical */
+  copy = from_arrays (xyz, nv, triangles, nt, 1);
+  check_copy (s, copy);
+  gts_surface_export_arrays (copy, &xyz1, NULL, &triangles1, &nv1, &nt1);
+  g_assert (nv1 == nv && nt1 == nt);
+  for (i = 0; i < 3*nv; i++)
+    g_assert (xyz1[i] == xyz[i]);
+  for (i = 0; i < 3*nt; i++)
+    g_assert (triangles1[i] == triangles[i]);
+  gts_object_destroy (GTS_OBJECT (copy));
+
+  g_free (xyz);
+  g_free (xyz1);
+  g_free (normals);
+  g_free (triangles);
+  g_free (triangles1);
+}
+
+int main (int argc, char * argv[])
+{
+  GtsSurface * s, * copy;
+  GtsMeshArrays * m;
+  gdouble * xyz;
+  guint * triangles, nv, nt, i, threads;
+
+  s = sphere (5, 1., 0.);
+
+  /* the arrays of the sphere, with an unused vertex and a degenerate
+     triangle which must be ignored */
+  m = gts_mesh_arrays_from_surface (s, FALSE);
+  nv = m->n_vertices + 1;
+  nt = m->n_faces + 1;
+  xyz = g_malloc (3*nv*sizeof (gdouble));
+  triangles = g_malloc (3*nt*sizeof (guint));
+  for (i = 0; i < 3*m->n_vertices; i++)
+    xyz[i] = m->xyz[i];
+  xyz[3*nv - 3] = xyz[3*nv - 2] = xyz[3*nv - 1] = 10.;
+  for (i = 0; i < 3*m->n_faces; i++)
+    triangles[i] = m->faces[i];
+  triangles[3*nt - 3] = triangles[3*nt - 2] = 0;
+  triangles[3*nt - 1] = 1;
+  gts_mesh_arrays_destroy (m);
+
+  for (threads = 1; threads <= 4; threads++) {
+    copy = from_arrays (xyz, nv, triangles, nt, threads);
+    check_copy (s, copy);
+    gts_object_destroy (GTS_OBJECT (copy));
+  }
+
+  g_free (xyz);
+  g_free (triangles);
+
+  /* exporting leaves the reserved field of the vertices untouched */
+  gts_surface_foreach_vertex (s, (GtsFunc) mark_vertex, s);
+  check_export (s);
+  gts_surface_foreach_vertex (s, (GtsFunc) check_vertex, s);
+  gts_surface_foreach_vertex (s, (GtsFunc) mark_vertex, NULL);
+
+  gts_object_destroy (GTS_OBJECT (s));
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,161 @@
+/* GTS - Library for the manipulation of triangulated surfaces
+ * Copyright (C) 1999 Stéphane Popinet
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include <stdlib.h>
+#include "gts.h"
+#include "common.h"
+
+static void count_item (gpointer item, guint * n)
+{
+  (*n)++;
+}
+
+/* compares the cached counts of @s with a full traversal */
+static void check_counts (GtsSurface * s)
+{
+  guint nv = 0, ne = 0, nf = 0;
+  guint cv, ce, cf;
+
+  gts_surface_foreach_vertex (s, (GtsFunc) count_item, &nv);
+  gts_surface_foreach_edge (s, (GtsFunc) count_item, &ne);
+  gts_surface_foreach_face (s, (GtsFunc) count_item, &nf);
+  cv = gts_surface_vertex_number (s);
+  ce = gts_surface_edge_number (s);
+  cf = gts_surface_face_number (s);
+  g_assert (cv == nv);
+  g_assert (ce == ne);
+  g_assert (cf == nf);
+}
+
+typedef struct {
+  GtsSurface * s;
+  guint calls, max;
+} StopData;
+
+static gboolean stop_checking (gdouble cost, guint nedge, StopData * d)
+{
+  check_counts (d->s);
+  return ++d->calls > d->max;
+}
+
+static void collect_face (GtsFace * f, GSList ** faces)
+{
+  *faces = g_slist_prepend (*faces, f);
+}
+
+static GtsVertex * vertex_new (gdouble x, gdouble y, gdouble z)
+{
+  return gts_vertex_new (gts_vertex_class (), x, y, z);
+}
+
+static GtsFace * triangle_new (GtsVertex * v1, GtsVertex * v2, GtsVertex * v3)
+{
+  GtsEdge * e1 = gts_edge_new (gts_edge_class (), v1, v2);
+  GtsEdge * e2 = gts_edge_new (gts_edge_class (), v2, v3);
+  GtsEdge * e3 = gts_edge_new (gts_edge_class (), v3, v1);
+
+  return gts_face_new (gts_face_class (), e1, e2, e3);
+}
+
+int main (int argc, char * argv[])
+{
+  GtsSurface * s = sphere (3, 1., 0.), * s1;
+  GSList * faces = NULL, * i;
+  GtsVertex * a, * b, * c, * d, * b1, * c1;
+  guint n, nv;
+  StopData data;
+
+  check_counts (s);
+
+  /* incremental add and remove */
+  gts_surface_foreach_face (s, (GtsFunc) collect_face, &faces);
+  s1 = surface_new (gts_vertex_class ());
+  check_counts (s1);
+  for (i = faces; i; i = i->next) {
+    gts_surface_add_face (s1, i->data);
+    check_counts (s1);
+  }
+  n = 0;
+  for (i = faces; i; i = i->next)
+    if (n++ % 3 == 0) {
+      gts_surface_remove_face (s1, i->data);
+      check_counts (s1);
+    }
+  n = 0;
+  for (i = faces; i; i = i->next)
+    if (n++ % 3 != 0)
+      gts_surface_remove_face (s1, i->data);
+  check_counts (s1);
+  g_assert (gts_surface_face_number (s1) == 0);
+  g_slist_free (faces);
+
+  /* gts_vertex_replace() merging two separate triangles */
+  a = vertex_new (0., 0., 0.);
+  b = vertex_new (1., 0., 0.);
+  c = vertex_new (0., 1., 0.);
+  d = vertex_new (1., 1., 0.);
+  b1 = vertex_new (1., 0., 0.);
+  c1 = vertex_new (0., 1., 0.);
+  gts_surface_add_face (s1, triangle_new (a, b, c));
+  gts_surface_add_face (s1, triangle_new (d, c1, b1));
+  check_counts (s1);
+  g_assert (gts_surface_vertex_number (s1) == 6);
+  gts_vertex_replace (c1, c);
+  check_counts (s1);
+  gts_vertex_replace (b1, b);
+  check_counts (s1);
+  nv = gts_surface_vertex_number (s1);
+  g_assert (nv == 4);
+  gts_object_destroy (GTS_OBJECT (b1));
+  gts_object_destroy (GTS_OBJECT (c1));
+  gts_object_destroy (GTS_OBJECT (s1));
+
+  /* gts_vertex_replace() on a closed surface */
+  faces = NULL;
+  gts_surface_foreach_face (s, (GtsFunc) collect_face, &faces);
+  a = GTS_SEGMENT (GTS_TRIANGLE (faces->data)->e1)->v1;
+  b = vertex_new (GTS_POINT (a)->x, GTS_POINT (a)->y, GTS_POINT (a)->z);
+  gts_vertex_replace (a, b);
+  check_counts (s);
+  gts_object_destroy (GTS_OBJECT (a));
+  check_counts (s);
+  g_slist_free (faces);
+
+  /* coarsening, checked after each collapse */
+  data.s = s;
+  data.calls = 0;
+  data.max = gts_surface_edge_number (s)/2;
+  gts_surface_coarsen (s, NULL, NULL, NULL, NULL,
+		       (GtsStopFunc) stop_checking, &data, 0.);
+  check_counts (s);
+  g_assert (data.calls > 1);
+
+  /* refinement, checked after each split */
+  data.calls = 0;
+  data.max = gts_surface_edge_number (s);
+  gts_surface_refine (s, NULL, NULL, NULL, NULL,
+		      (GtsStopFunc) stop_checking, &data);
+  check_counts (s);
+  g_assert (data.calls > 1);
+
+  gts_object_destroy (GTS_OBJECT (s));
+
+  return EXIT_SUCCESS;
+}
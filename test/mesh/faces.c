@@ -0,0 +1,141 @@
+/* GTS - Library for the manipulation of triangulated surfaces
+ * Copyright (C) 1999 Stéphane Popinet
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include <stdlib.h>
+#include "gts.h"
+#include "common.h"
+
+typedef struct {
+  GHashTable * expected, * visited;
+} Visit;
+
+static void visit_face (GtsFace * f, Visit * v)
+{
+  g_assert (g_hash_table_lookup (v->expected, f) != NULL);
+  g_assert (g_hash_table_lookup (v->visited, f) == NULL);
+  g_hash_table_insert (v->visited, f, f);
+}
+
+/* checks that gts_surface_foreach_face() visits each face of
+   @expected exactly once */
+static void check_faces (GtsSurface * s, GHashTable * expected)
+{
+  Visit v;
+  guint n;
+
+  v.expected = expected;
+  v.visited = g_hash_table_new (NULL, NULL);
+  gts_surface_foreach_face (s, (GtsFunc) visit_face, &v);
+  n = g_hash_table_size (v.visited);
+  g_assert (n == g_hash_table_size (expected));
+  n = gts_surface_face_number (s);
+  g_assert (n == g_hash_table_size (expected));
+  g_hash_table_destroy (v.visited);
+}
+
+static void collect_face (GtsFace * f, GPtrArray * faces)
+{
+  g_ptr_array_add (faces, f);
+}
+
+static void insert_face (GtsFace * f, GHashTable * set)
+{
+  g_hash_table_insert (set, f, f);
+}
+
+static void remove_face (GtsSurface * s, GHashTable * set, GtsFace * f)
+{
+  gts_surface_remove_face (s, f);
+  g_hash_table_remove (set, f);
+}
+
+static void add_face (GtsSurface * s, GHashTable * set, GtsFace * f)
+{
+  gts_surface_add_face (s, f);
+  g_hash_table_insert (set, f, f);
+}
+
+int main (int argc, char * argv[])
+{
+  GtsSurface * s1 = sphere (3, 1., 0.), * s2;
+  GPtrArray * faces = g_ptr_array_new ();
+  GHashTable * e1 = g_hash_table_new (NULL, NULL);
+  GHashTable * e2 = g_hash_table_new (NULL, NULL);
+  guint i, n, mid;
+
+  gts_surface_foreach_face (s1, (GtsFunc) collect_face, faces);
+  gts_surface_foreach_face (s1, (GtsFunc) insert_face, e1);
+  n = faces->len;
+
+  /* s2 holds the faces of s1 in reverse order: their slots belong
+     to s1 */
+  s2 = surface_new (gts_vertex_class ());
+  for (i = n; i > 0; i--)
+    add_face (s2, e2, g_ptr_array_index (faces, i - 1));
+  check_faces (s1, e1);
+  check_faces (s2, e2);
+
+  /* remove the faces of the first half from the middle of s1, they
+     are still in s2 */
+  mid = n/2;
+  for (i = 0; i < n/4; i++) {
+    remove_face (s1, e1, g_ptr_array_index (faces, mid - 1 - i));
+    check_faces (s1, e1);
+    check_faces (s2, e2);
+  }
+
+  /* add them back to s1: their slots now belong to s2 */
+  for (i = 0; i < n/4; i++) {
+    add_face (s1, e1, g_ptr_array_index (faces, mid - 1 - i));
+    check_faces (s1, e1);
+    check_faces (s2, e2);
+  }
+
+  /* remove faces from the middle of both surfaces alternately */
+  for (i = 0; i < n/4; i++) {
+    if (i % 2)
+      remove_face (s1, e1, g_ptr_array_index (faces, mid - n/8 + i));
+    else
+      remove_face (s2, e2, g_ptr_array_index (faces, mid - n/8 + i));
+    check_faces (s1, e1);
+    check_faces (s2, e2);
+  }
+
+  /* remove all the faces of s2 from the middle outwards */
+  for (i = 0; i < n; i++) {
+    guint j = i % 2 ? mid + (i + 1)/2 : mid + n - i/2;
+    GtsFace * f = g_ptr_array_index (faces, j % n);
+
+    if (g_hash_table_lookup (e2, f)) {
+      remove_face (s2, e2, f);
+      check_faces (s1, e1);
+      check_faces (s2, e2);
+    }
+  }
+  g_assert (gts_surface_face_number (s2) == 0);
+
+  g_hash_table_destroy (e1);
+  g_hash_table_destroy (e2);
+  g_ptr_array_free (faces, TRUE);
+  gts_object_destroy (GTS_OBJECT (s2));
+  gts_object_destroy (GTS_OBJECT (s1));
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,128 @@
+/* GTS - Library for the manipulation of triangulated surfaces
+ * Copyright (C) 1999 Stéphane Popinet
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "gts.h"
+#include "common.h"
+
+static gboolean close_to (gdouble a, gdouble b)
+{
+  return fabs (a - b) <= 1e-12*MAX (fabs (a), fabs (b));
+}
+
+/* Checks that @s is a copy of @m, face by face */
+static void check_surface (GtsSurface * s, GtsMeshArrays * m, GtsVertex ** v)
+{
+  guint i;
+
+  g_assert (gts_surface_vertex_number (s) == m->n_vertices);
+  g_assert (gts_surface_edge_number (s) == m->n_edges);
+  g_assert (gts_surface_face_number (s) == m->n_faces);
+  g_assert (gts_surface_is_closed (s));
+  g_assert (gts_surface_is_orientable (s));
+  g_assert (close_to (gts_surface_area (s), gts_mesh_arrays_area (m)));
+  g_assert (close_to (gts_surface_volume (s), gts_mesh_arrays_volume (m)));
+  for (i = 0; i < m->n_faces; i++) {
+    GtsTriangle * t = g_ptr_array_index (s->faces, i);
+    GtsVertex * v1, * v2, * v3;
+    guint k;
+
+    /* same vertices, same orientation */
+    gts_triangle_vertices (t, &v1, &v2, &v3);
+    for (k = 0; k < 3 && v[m->faces[3*i + k]] != v1; k++);
+    g_assert (k < 3);
+    g_assert (v[m->faces[3*i + (k + 1) % 3]] == v2);
+    g_assert (v[m->faces[3*i + (k + 2) % 3]] == v3);
+  }
+}
+
+static void mark_reserved (GtsObject * o)
+{
+  o->reserved = o;
+}
+
+static void check_reserved (GtsObject * o)
+{
+  g_assert (o->reserved == o);
+}
+
+int main (int argc, char * argv[])
+{
+  GtsSurface * s = surface_new (gts_vertex_class ()), * s1, * s2;
+  GtsMeshArrays * m, * m1;
+  GtsVertex ** v;
+  GtsVector min, max;
+  GtsRange face_area, edge_length;
+  guint nb, nnm, i;
+
+  gts_surface_generate_sphere (s, 4);
+
+  /* the reserved fields of the user are left untouched */
+  gts_surface_foreach_vertex (s, (GtsFunc) mark_reserved, NULL);
+  gts_surface_foreach_edge (s, (GtsFunc) mark_reserved, NULL);
+  m = gts_mesh_arrays_from_surface (s, TRUE);
+  gts_surface_foreach_vertex (s, (GtsFunc) check_reserved, NULL);
+  gts_surface_foreach_edge (s, (GtsFunc) check_reserved, NULL);
+  g_assert (m->n_vertices == gts_surface_vertex_number (s));
+  g_assert (m->n_edges == gts_surface_edge_number (s));
+  g_assert (m->n_faces == gts_surface_face_number (s));
+  g_assert (close_to (gts_mesh_arrays_area (m), gts_surface_area (s)));
+  g_assert (close_to (gts_mesh_arrays_volume (m), gts_surface_volume (s)));
+  gts_mesh_arrays_bbox (m, min, max);
+  for (i = 0; i < 3; i++)
+    g_assert (close_to (min[i], -1.) && close_to (max[i], 1.));
+  gts_mesh_arrays_stats (m, &nb, &nnm, &face_area, &edge_length);
+  g_assert (nb == 0 && nnm == 0);
+  g_assert (face_area.n == m->n_faces && edge_length.n == m->n_edges);
+  for (i = 0; i < 3*m->n_faces; i++) {
+    g_assert (m->opposite[i] >= 0);
+    g_assert (m->opposite[m->opposite[i]] == i);
+    g_assert (m->face_edges[i] == m->face_edges[m->opposite[i]]);
+  }
+
+  /* back to a surface, with the edges of @m */
+  s1 = surface_new (gts_vertex_class ());
+  v = gts_mesh_arrays_to_surface (m, s1);
+  check_surface (s1, m, v);
+  g_free (v);
+
+  /* the same arrays without edges: the edges are rebuilt */
+  m1 = gts_mesh_arrays_new (m->n_vertices, m->n_faces);
+  memcpy (m1->xyz, m->xyz, 3*m->n_vertices*sizeof (gdouble));
+  memcpy (m1->faces, m->faces, 3*m->n_faces*sizeof (gint32));
+  g_assert (m1->edges == NULL);
+  s2 = surface_new (gts_vertex_class ());
+  v = gts_mesh_arrays_to_surface (m1, s2);
+  g_assert (m1->edges != NULL && m1->n_edges == m->n_edges);
+  for (i = 0; i < 3*m->n_faces; i++)
+    g_assert (m1->opposite[i] == m->opposite[i]);
+  check_surface (s2, m1, v);
+  g_free (v);
+
+  gts_mesh_arrays_destroy (m);
+  gts_mesh_arrays_destroy (m1);
+  gts_object_destroy (GTS_OBJECT (s));
+  gts_object_destroy (GTS_OBJECT (s1));
+  gts_object_destroy (GTS_OBJECT (s2));
+
+  return EXIT_SUCCESS;
+}
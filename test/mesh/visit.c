@@ -0,0 +1,118 @@
+/* GTS - Library for the manipulation of triangulated surfaces
+ * Copyright (C) 1999 Stéphane Popinet
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include <stdlib.h>
+#include "gts.h"
+#include "common.h"
+
+/* A traversal recording the objects it visits */
+typedef struct {
+  GHashTable * visited;
+  GtsSurface * s, * other;
+  guint depth, nested;
+} Traversal;
+
+static void traversal_init (Traversal * t, GtsSurface * s, GtsSurface * other,
+			    guint depth)
+{
+  t->visited = g_hash_table_new (NULL, NULL);
+  t->s = s;
+  t->other = other;
+  t->depth = depth;
+  t->nested = 0;
+}
+
+static void traversal_check (Traversal * t, guint n)
+{
+  guint size = g_hash_table_size (t->visited);
+
+  g_assert (size == n);
+  g_hash_table_destroy (t->visited);
+}
+
+static void visit_vertex (GtsVertex * v, Traversal * t);
+static void visit_edge (GtsEdge * e, Traversal * t);
+
+/* starts complete traversals of both surfaces from within the
+   traversal @t */
+static void nested_traversals (Traversal * t)
+{
+  Traversal inner;
+
+  if (t->depth == 0 || t->nested++ % 17 != 0)
+    return;
+
+  traversal_init (&inner, t->s, t->other, t->depth - 1);
+  gts_surface_foreach_vertex (t->s, (GtsFunc) visit_vertex, &inner);
+  traversal_check (&inner, gts_surface_vertex_number (t->s));
+
+  traversal_init (&inner, t->s, t->other, t->depth - 1);
+  gts_surface_foreach_edge (t->s, (GtsFunc) visit_edge, &inner);
+  traversal_check (&inner, gts_surface_edge_number (t->s));
+
+  traversal_init (&inner, t->other, t->s, t->depth - 1);
+  gts_surface_foreach_vertex (t->other, (GtsFunc) visit_vertex, &inner);
+  traversal_check (&inner, gts_surface_vertex_number (t->other));
+}
+
+static void visit_vertex (GtsVertex * v, Traversal * t)
+{
+  g_assert (g_hash_table_lookup (t->visited, v) == NULL);
+  g_hash_table_insert (t->visited, v, v);
+  nested_traversals (t);
+}
+
+static void visit_edge (GtsEdge * e, Traversal * t)
+{
+  g_assert (g_hash_table_lookup (t->visited, e) == NULL);
+  g_hash_table_insert (t->visited, e, e);
+  nested_traversals (t);
+}
+
+int main (int argc, char * argv[])
+{
+  GtsSurface * s1 = sphere (3, 1., 0.), * s2 = sphere (2, 1., 3.);
+  guint nv1 = gts_surface_vertex_number (s1);
+  guint ne1 = gts_surface_edge_number (s1);
+  guint depth;
+  Traversal t;
+
+  for (depth = 0; depth <= 2; depth++) {
+    /* vertices of s1 with nested traversals of s1 and s2 */
+    traversal_init (&t, s1, s2, depth);
+    gts_surface_foreach_vertex (s1, (GtsFunc) visit_vertex, &t);
+    traversal_check (&t, nv1);
+
+    /* edges of s1 with nested traversals of s1 and s2 */
+    traversal_init (&t, s1, s2, depth);
+    gts_surface_foreach_edge (s1, (GtsFunc) visit_edge, &t);
+    traversal_check (&t, ne1);
+
+    /* a plain traversal following the nested ones */
+    traversal_init (&t, s1, s2, 0);
+    gts_surface_foreach_vertex (s1, (GtsFunc) visit_vertex, &t);
+    traversal_check (&t, nv1);
+  }
+
+  gts_object_destroy (GTS_OBJECT (s1));
+  gts_object_destroy (GTS_OBJECT (s2));
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,138 @@
+/* GTS - Library for the manipulation of triangulated surfaces
+ * Copyright (C) 1999 Stéphane Popinet
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include <stdlib.h>
+#include "gts.h"
+#include "common.h"
+
+#define N 1000
+
+static void count (GtsObject * object, guint * n)
+{
+  (*n)++;
+}
+
+static void add_face (GtsFace * f, GtsSurface * s)
+{
+  gts_surface_add_face (s, f);
+}
+
+/* the current arena of the main thread is not current here */
+static gpointer other_thread (gpointer data)
+{
+  GtsObjectArena * previous = gts_object_arena_set_current (NULL);
+
+  g_assert (previous == NULL);
+  return gts_vertex_new (gts_vertex_class (), 0., 0., 0.);
+}
+
+static GtsSurface * sphere_in_arena (guint level)
+{
+  GtsSurface * s = surface_new (gts_vertex_class ());
+  GtsObjectArena * previous = 
+    gts_object_arena_set_current (gts_surface_arena (s));
+
+  gts_surface_generate_sphere (s, level);
+  previous = gts_object_arena_set_current (previous);
+  g_assert (previous == s->arena);
+  return s;
+}
+
+int main (int argc, char * argv[])
+{
+  GtsObjectArena * arena = gts_object_arena_new (), * previous;
+  GtsVertex ** v = g_malloc (N*sizeof (GtsVertex *)), * outside;
+  GtsSurface * s, * s2;
+  gdouble area;
+  guint i, n;
+
+  /* objects of any class are allocated in the current arena */
+  outside = gts_vertex_new (gts_vertex_class (), 0., 0., 0.);
+  previous = gts_object_arena_set_current (arena);
+  g_assert (previous == NULL);
+  for (i = 0; i < N; i++)
+    v[i] = gts_vertex_new (gts_vertex_class (), i, 0., 0.);
+  s = surface_new (gts_vertex_class ());
+  previous = gts_object_arena_set_current (NULL);
+  g_assert (previous == arena);
+  g_assert (gts_object_arena_contains (arena, GTS_OBJECT (v[0])));
+  g_assert (gts_object_arena_contains (arena, GTS_OBJECT (s)));
+  g_assert (!gts_object_arena_contains (arena, GTS_OBJECT (outside)));
+  n = 0;
+  gts_object_arena_foreach (arena, (GtsFunc) count, &n);
+  g_assert (n == N + 1);
+
+  /* objects of an arena can be destroyed individually */
+  gts_object_destroy (GTS_OBJECT (s));
+  for (i = 0; i < N; i += 2)
+    gts_object_destroy (GTS_OBJECT (v[i]));
+  n = 0;
+  gts_object_arena_foreach (arena, (GtsFunc) count, &n);
+  g_assert (n == N/2);
+
+  /* the arena is freed with its last object */
+  gts_object_arena_destroy (arena, FALSE);
+  for (i = 1; i < N; i += 2)
+    gts_object_destroy (GTS_OBJECT (v[i]));
+
+  /* or at once */
+  arena = gts_object_arena_new ();
+  gts_object_arena_set_current (arena);
+  for (i = 0; i < N; i++)
+    v[i] = gts_vertex_new (gts_vertex_class (), i, 0., 0.);
+  gts_object_arena_set_current (NULL);
+  gts_object_arena_destroy (arena, TRUE);
+  gts_object_destroy (GTS_OBJECT (outside));
+
+  /* the current arena is specific to each thread */
+  arena = gts_object_arena_new ();
+  gts_object_arena_set_current (arena);
+  outside = g_thread_join (g_thread_new ("test", other_thread, NULL));
+  previous = gts_object_arena_set_current (NULL);
+  g_assert (previous == arena);
+  g_assert (!gts_object_arena_contains (arena, GTS_OBJECT (outside)));
+  gts_object_destroy (GTS_OBJECT (outside));
+  gts_object_arena_destroy (arena, FALSE);
+
+  /* surface arenas */
+  s = sphere_in_arena (4);
+  n = 0;
+  gts_object_arena_foreach (s->arena, (GtsFunc) count, &n);
+  g_assert (n == gts_surface_vertex_number (s) + 
+	    gts_surface_edge_number (s) + gts_surface_face_number (s));
+  area = gts_surface_area (s);
+  s->unshared = TRUE;
+  gts_object_destroy (GTS_OBJECT (s));
+
+  /* faces used by another surface survive the destruction of the
+     surface owning their arena */
+  s = sphere_in_arena (4);
+  s2 = surface_new (gts_vertex_class ());
+  gts_surface_foreach_face (s, (GtsFunc) add_face, s2);
+  n = gts_surface_face_number (s);
+  gts_object_destroy (GTS_OBJECT (s));
+  g_assert (gts_surface_face_number (s2) == n);
+  g_assert (gts_surface_area (s2) == area);
+  gts_object_destroy (GTS_OBJECT (s2));
+
+  g_free (v);
+  gts_finalize ();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,128 @@
+/* GTS - Library for the manipulation of triangulated surfaces
+ * Copyright (C) 1999 Stéphane Popinet
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include <stdlib.h>
+#include "gts.h"
+#include "common.h"
+
+static GtsObjectClass * derived_class (GtsObjectClass * parent,
+				       const gchar * name)
+{
+  GtsObjectClassInfo info = {
+    "",
+    sizeof (GtsVertex),
+    sizeof (GtsVertexClass),
+    (GtsObjectClassInitFunc) NULL,
+    (GtsObjectInitFunc) NULL,
+    (GtsArgSetFunc) NULL,
+    (GtsArgGetFunc) NULL
+  };
+
+  strcpy (info.name, name);
+  return gts_object_class_new (parent, &info);
+}
+
+/* the membership test walking up the parent classes */
+static gboolean is_from_class (GtsObjectClass * klass, GtsObjectClass * from)
+{
+  while (klass) {
+    if (klass == from)
+      return TRUE;
+    klass = klass->parent_class;
+  }
+  return FALSE;
+}
+
+static void check_ancestors (GtsObjectClass * klass)
+{
+  GtsObjectClass * c = klass;
+  guint d = klass->depth + 1;
+
+  while (c) {
+    g_assert (d > 0);
+    g_assert (klass->ancestors[--d] == c);
+    g_assert (c->depth == d);
+    c = c->parent_class;
+  }
+  g_assert (d == 0);
+}
+
+int main (int argc, char * argv[])
+{
+  GtsObjectClass * vertex = GTS_OBJECT_CLASS (gts_vertex_class ());
+  GtsObjectClass * a = derived_class (vertex, "DerivedA");
+  GtsObjectClass * b = derived_class (a, "DerivedB");
+  GtsObjectClass * c = derived_class (b, "DerivedC");
+  GtsObjectClass * sibling = derived_class (a, "SiblingB");
+  GtsObjectClass * other = derived_class (vertex, "OtherA");
+  GtsObjectClass * classes[] = {
+    gts_object_class (),
+    GTS_OBJECT_CLASS (gts_point_class ()),
+    vertex,
+    GTS_OBJECT_CLASS (gts_segment_class ()),
+    GTS_OBJECT_CLASS (gts_edge_class ()),
+    GTS_OBJECT_CLASS (gts_triangle_class ()),
+    GTS_OBJECT_CLASS (gts_face_class ()),
+    GTS_OBJECT_CLASS (gts_surface_class ()),
+    a, b, c, sibling, other
+  };
+  guint i, j, n = G_N_ELEMENTS (classes);
+  GtsObject * o;
+
+  g_assert (gts_object_class ()->depth == 0);
+  g_assert (vertex->depth == 2);
+  g_assert (a->depth == 3 && b->depth == 4 && c->depth == 5);
+  g_assert (sibling->depth == 4 && other->depth == 3);
+
+  for (i = 0; i < n; i++) {
+    check_ancestors (classes[i]);
+    for (j = 0; j < n; j++) {
+      gboolean expected = is_from_class (classes[i], classes[j]);
+      gpointer found = gts_object_class_is_from_class (classes[i], 
+						       classes[j]);
+
+      g_assert (found == (expected ? classes[i] : NULL));
+    }
+  }
+
+  /* explicit positive and negative answers */
+  g_assert (gts_object_class_is_from_class (c, a) == c);
+  g_assert (gts_object_class_is_from_class (c, vertex) == c);
+  g_assert (gts_object_class_is_from_class (c, gts_object_class ()) == c);
+  g_assert (gts_object_class_is_from_class (a, c) == NULL);
+  g_assert (gts_object_class_is_from_class (c, sibling) == NULL);
+  g_assert (gts_object_class_is_from_class (sibling, b) == NULL);
+  g_assert (gts_object_class_is_from_class (c, other) == NULL);
+  g_assert (gts_object_class_is_from_class (c, gts_edge_class ()) == NULL);
+
+  /* instances */
+  o = GTS_OBJECT (gts_vertex_new (GTS_VERTEX_CLASS (c), 0., 0., 0.));
+  for (i = 0; i < n; i++) {
+    gboolean expected = is_from_class (c, classes[i]);
+
+    g_assert (gts_object_is_from_class (o, classes[i]) == 
+	      (expected ? o : NULL));
+  }
+  g_assert (GTS_IS_VERTEX (o) && GTS_IS_POINT (o) && !GTS_IS_EDGE (o));
+  gts_object_destroy (o);
+  g_assert (gts_object_is_from_class (NULL, vertex) == NULL);
+
+  return EXIT_SUCCESS;
+}
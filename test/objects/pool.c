@@ -0,0 +1,146 @@
+/* GTS - Library for the manipulation of triangulated surfaces
+ * Copyright (C) 1999 Stéphane Popinet
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include <stdlib.h>
+#include "gts.h"
+#include "common.h"
+
+#define N 10000
+
+/* A class of the same size as GtsVertex */
+static GtsVertexClass * plain_vertex_class (void)
+{
+  static GtsVertexClass * klass = NULL;
+
+  if (klass == NULL) {
+    GtsObjectClassInfo plain_vertex_info = {
+      "PlainVertex",
+      sizeof (GtsVertex),
+      sizeof (GtsVertexClass),
+      (GtsObjectClassInitFunc) NULL,
+      (GtsObjectInitFunc) NULL,
+      (GtsArgSetFunc) NULL,
+      (GtsArgGetFunc) NULL
+    };
+    klass = gts_object_class_new (GTS_OBJECT_CLASS (gts_vertex_class ()),
+				  &plain_vertex_info);
+  }
+  return klass;
+}
+
+int main (int argc, char * argv[])
+{
+  GtsObjectClass * klass = GTS_OBJECT_CLASS (gts_vertex_class ());
+  GtsVertex ** v = g_malloc (N*sizeof (GtsVertex *));
+  GtsObjectPoolStats stats;
+  GtsSurface * s;
+  gdouble area;
+  guint i, used, n;
+
+  /* no pool yet */
+  gts_object_class_pool_stats (klass, &stats);
+  g_assert (stats.object_size == klass->info.object_size);
+  g_assert (stats.n_slabs == 0 && stats.n_used == 0 && stats.n_free == 0);
+
+  s = sphere (4, 1., 0.);
+  area = gts_surface_area (s);
+  gts_object_destroy (GTS_OBJECT (s));
+
+  gts_object_class_set_pool (gts_object_class (), TRUE);
+  gts_object_class_pool_stats (klass, &stats);
+  used = stats.n_used;
+  for (i = 0; i < N; i++) {
+    v[i] = gts_vertex_new (gts_vertex_class (), i, 0., 0.);
+    g_assert (GTS_OBJECT (v[i])->flags & GTS_POOLED);
+  }
+  gts_object_class_pool_stats (klass, &stats);
+  g_assert (stats.n_used == used + N);
+  g_assert (stats.n_slabs > 0 && stats.bytes > 0);
+
+  /* clones are pooled too and destroyed objects are recycled */
+  for (i = 0; i < N; i++) {
+    GtsObject * clone = gts_object_clone (GTS_OBJECT (v[i]));
+
+    g_assert (clone->flags & GTS_POOLED);
+    g_assert (GTS_POINT (clone)->x == i);
+    gts_object_destroy (clone);
+    gts_object_destroy (GTS_OBJECT (v[i]));
+  }
+  gts_object_class_pool_stats (klass, &stats);
+  g_assert (stats.n_used == used);
+  g_assert (stats.n_free >= N);
+  if (used == 0) {
+    n = gts_object_class_pool_trim (klass);
+    g_assert (n > 0);
+    gts_object_class_pool_stats (klass, &stats);
+    g_assert (stats.n_slabs == 0 && stats.bytes == 0);
+  }
+
+  /* pooled surfaces are identical to individually allocated ones */
+  s = sphere (4, 1., 0.);
+  g_assert (gts_surface_area (s) == area);
+  gts_object_class_pool_stats (GTS_OBJECT_CLASS (gts_face_class ()), &stats);
+  g_assert (stats.n_used >= gts_surface_face_number (s));
+  gts_object_destroy (GTS_OBJECT (s));
+
+  /* a class which does not use its pool any longer reports zeros */
+  gts_object_class_set_pool (gts_object_class (), FALSE);
+  gts_object_class_pool_stats (GTS_OBJECT_CLASS (gts_face_class ()), &stats);
+  g_assert (stats.n_slabs == 0 && stats.n_used == 0 && stats.n_free == 0);
+  g_assert (stats.bytes == 0);
+  v[0] = gts_vertex_new (gts_vertex_class (), 0., 0., 0.);
+  g_assert (!(GTS_OBJECT (v[0])->flags & GTS_POOLED));
+  gts_object_destroy (GTS_OBJECT (v[0]));
+
+  gts_object_class_set_pool (gts_object_class (), TRUE);
+  gts_object_class_pool_release (GTS_OBJECT_CLASS (gts_face_class ()));
+  gts_object_class_pool_stats (GTS_OBJECT_CLASS (gts_face_class ()), &stats);
+  g_assert (stats.n_slabs == 0 && stats.n_used == 0);
+
+  /* a class without pool does not trim or release the pool of the
+     classes of the same size */
+  gts_object_class_set_pool (GTS_OBJECT_CLASS (plain_vertex_class ()), FALSE);
+  g_assert (GTS_OBJECT_CLASS (plain_vertex_class ())->info.object_size ==
+	    klass->info.object_size);
+  for (i = 0; i < N; i++) {
+    v[i] = gts_vertex_new (i % 2 ? plain_vertex_class () : gts_vertex_class (),
+			   i, 0., 0.);
+    g_assert ((GTS_OBJECT (v[i])->flags & GTS_POOLED) == 
+	      (i % 2 ? 0 : GTS_POOLED));
+  }
+  gts_object_class_pool_stats (klass, &stats);
+  used = stats.n_used;
+  g_assert (used >= N/2);
+  n = gts_object_class_pool_trim (GTS_OBJECT_CLASS (plain_vertex_class ()));
+  g_assert (n == 0);
+  gts_object_class_pool_release (GTS_OBJECT_CLASS (plain_vertex_class ()));
+  gts_object_class_pool_stats (klass, &stats);
+  g_assert (stats.n_used == used && stats.n_slabs > 0);
+  for (i = 0; i < N; i++) {
+    g_assert (GTS_POINT (v[i])->x == i);
+    gts_object_destroy (GTS_OBJECT (v[i]));
+  }
+  gts_object_class_pool_stats (klass, &stats);
+  g_assert (stats.n_used == used - (N + 1)/2);
+
+  g_free (v);
+  gts_finalize ();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,99 @@
+/* GTS - Library for the manipulation of triangulated surfaces
+ * Copyright (C) 1999 Stéphane Popinet
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include <stdlib.h>
+#include "gts.h"
+#include "common.h"
+
+#define N 5000
+
+static void check_entry (gpointer key, gpointer data, GHashTable * hash)
+{
+  g_assert (g_hash_table_lookup (hash, key) == data);
+  g_hash_table_remove (hash, key);
+}
+
+static void set_vertex (GtsVertex * v, GtsScratch * scratch)
+{
+  gts_scratch_set (scratch, v, GTS_POINT (v));
+}
+
+static void check_vertex (GtsVertex * v, GtsScratch * scratch)
+{
+  g_assert (gts_scratch_get (scratch, v) == GTS_POINT (v));
+  g_assert (GTS_OBJECT (v)->reserved == NULL);
+}
+
+int main (int argc, char * argv[])
+{
+  GtsScratch * scratch = gts_scratch_new (0), * s1, * s2;
+  GHashTable * hash = g_hash_table_new (NULL, NULL);
+  GtsSurface * s;
+  guint i, r;
+
+  /* random insertions and removals checked against a hash table */
+  srand (1);
+  for (r = 0; r < 10; r++) {
+    for (i = 0; i < 100000; i++) {
+      gpointer key = GUINT_TO_POINTER (16*(rand () % N + 1));
+
+      if (rand () % 3 == 0) {
+	gts_scratch_remove (scratch, key);
+	g_hash_table_remove (hash, key);
+      }
+      else {
+	gpointer data = GUINT_TO_POINTER (rand () + 1);
+
+	gts_scratch_set (scratch, key, data);
+	g_hash_table_insert (hash, key, data);
+      }
+      key = GUINT_TO_POINTER (16*(rand () % N + 1));
+      g_assert (gts_scratch_get (scratch, key) == 
+		g_hash_table_lookup (hash, key));
+    }
+    g_assert (gts_scratch_size (scratch) == g_hash_table_size (hash));
+    gts_scratch_foreach (scratch, (GHFunc) check_entry, hash);
+    g_assert (g_hash_table_size (hash) == 0);
+
+    gts_scratch_clear (scratch);
+    g_assert (gts_scratch_size (scratch) == 0);
+    for (i = 1; i <= N; i++)
+      g_assert (gts_scratch_get (scratch, GUINT_TO_POINTER (16*i)) == NULL);
+  }
+  gts_scratch_destroy (scratch);
+  g_hash_table_destroy (hash);
+
+  /* several tables on the same objects, leaving them untouched */
+  s = sphere (4, 1., 0.);
+  s1 = gts_scratch_new (gts_surface_vertex_number (s));
+  s2 = gts_scratch_new (0);
+  gts_surface_foreach_vertex (s, (GtsFunc) set_vertex, s1);
+  gts_surface_foreach_vertex (s, (GtsFunc) set_vertex, s2);
+  g_assert (gts_scratch_size (s1) == gts_surface_vertex_number (s));
+  gts_surface_foreach_vertex (s, (GtsFunc) check_vertex, s1);
+  gts_scratch_clear (s1);
+  g_assert (gts_scratch_size (s1) == 0);
+  gts_surface_foreach_vertex (s, (GtsFunc) check_vertex, s2);
+  gts_scratch_destroy (s1);
+  gts_scratch_destroy (s2);
+  gts_object_destroy (GTS_OBJECT (s));
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,199 @@
+/* GTS - Library for the manipulation of triangulated surfaces
+ * Copyright (C) 1999 Stéphane Popinet
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include <stdlib.h>
+#include "gts.h"
+#include "common.h"
+
+#define NT 4
+#define N 20000
+
+static GtsObjectClass * counted_class (void)
+{
+  static GtsObjectClass * klass = NULL;
+
+  if (klass == NULL) {
+    GtsObjectClassInfo counted_info = {
+      "CountedObject",
+      sizeof (GtsObject),
+      sizeof (GtsObjectClass),
+      (GtsObjectClassInitFunc) NULL,
+      (GtsObjectInitFunc) NULL,
+      (GtsArgSetFunc) NULL,
+      (GtsArgGetFunc) NULL
+    };
+    klass = gts_object_class_new (gts_object_class (), &counted_info);
+  }
+  return klass;
+}
+
+static GtsObjectClass * unused_class (void)
+{
+  static GtsObjectClass * klass = NULL;
+
+  if (klass == NULL) {
+    GtsObjectClassInfo unused_info = {
+      "UnusedObject",
+      sizeof (GtsObject),
+      sizeof (GtsObjectClass),
+      (GtsObjectClassInitFunc) NULL,
+      (GtsObjectInitFunc) NULL,
+      (GtsArgSetFunc) NULL,
+      (GtsArgGetFunc) NULL
+    };
+    klass = gts_object_class_new (gts_object_class (), &unused_info);
+  }
+  return klass;
+}
+
+static gpointer create_objects (GtsObject ** o)
+{
+  guint i;
+
+  for (i = 0; i < N; i++)
+    o[i] = gts_object_new (counted_class ());
+  return NULL;
+}
+
+static gpointer destroy_objects (GtsObject ** o)
+{
+  guint i;
+
+  for (i = 0; i < N; i++)
+    gts_object_destroy (o[i]);
+  return NULL;
+}
+
+static void run_threads (GThreadFunc func, GtsObject ** o)
+{
+  GThread * threads[NT];
+  guint k;
+
+  for (k = 0; k < NT; k++)
+    threads[k] = g_thread_new ("test", func, &o[k*N]);
+  for (k = 0; k < NT; k++)
+    g_thread_join (threads[k]);
+}
+
+static GtsObjectClassStats * find_stats (GArray * snapshot, 
+					 GtsObjectClass * klass)
+{
+  guint i;
+
+  for (i = 0; i < snapshot->len; i++) {
+    GtsObjectClassStats * stats = 
+      &g_array_index (snapshot, GtsObjectClassStats, i);
+
+    if (stats->klass == klass)
+      return stats;
+  }
+  return NULL;
+}
+
+static void check_snapshot (GArray * snapshot)
+{
+  guint i;
+
+  for (i = 1; i < snapshot->len; i++) {
+    GtsObjectClassStats * s1 = 
+      &g_array_index (snapshot, GtsObjectClassStats, i - 1);
+    GtsObjectClassStats * s2 = 
+      &g_array_index (snapshot, GtsObjectClassStats, i);
+
+    g_assert (s1->bytes >= s2->bytes);
+  }
+  g_assert (find_stats (snapshot, unused_class ()) == NULL);
+}
+
+int main (int argc, char * argv[])
+{
+  GtsObjectClass * klass = counted_class ();
+  GtsObject ** o = g_malloc (NT*N*sizeof (GtsObject *));
+  GtsObjectClassStats stats, * s;
+  GArray * snapshot;
+  gchar * content, * expected;
+  glong length;
+  FILE * fp;
+
+  unused_class ();
+  gts_object_class_stats (klass, &stats);
+  g_assert (stats.n_live == 0 && stats.n_peak == 0 && stats.n_total == 0);
+
+  /* concurrent creation */
+  run_threads ((GThreadFunc) create_objects, o);
+  gts_object_class_stats (klass, &stats);
+  g_assert (stats.klass == klass);
+  g_assert (stats.n_live == NT*N);
+  g_assert (stats.n_peak == NT*N);
+  g_assert (stats.n_total == NT*N);
+  g_assert (stats.bytes == NT*N*sizeof (GtsObject));
+  g_assert (stats.peak_bytes == stats.bytes);
+
+  snapshot = gts_object_stats_snapshot ();
+  check_snapshot (snapshot);
+  s = find_stats (snapshot, klass);
+  g_assert (s != NULL);
+  g_assert (s->n_live == NT*N && s->n_total == NT*N);
+  g_array_free (snapshot, TRUE);
+
+  /* concurrent destruction */
+  run_threads ((GThreadFunc) destroy_objects, o);
+  gts_object_class_stats (klass, &stats);
+  g_assert (stats.n_live == 0);
+  g_assert (stats.n_peak == NT*N);
+  g_assert (stats.n_total == NT*N);
+  g_assert (stats.bytes == 0);
+
+  /* JSON and table output */
+  snapshot = gts_object_stats_snapshot ();
+  check_snapshot (snapshot);
+  fp = tmpfile ();
+  gts_object_stats_write_json (snapshot, fp);
+  content = file_content (fp, &length);
+  fclose (fp);
+  g_assert (content[0] == '{' && content[length - 2] == '}');
+  expected = g_strdup_printf ("{\"name\": \"CountedObject\", \"size\": %u, "
+			      "\"live\": 0, \"peak\": %u, \"total\": %u, "
+			      "\"bytes\": 0, \"peak_bytes\": %lu}",
+			      (guint) sizeof (GtsObject), NT*N, NT*N,
+			      (gulong) (NT*N*sizeof (GtsObject)));
+  g_assert (strstr (content, expected) != NULL);
+  g_assert (strstr (content, "UnusedObject") == NULL);
+  g_free (expected);
+  g_free (content);
+
+  fp = tmpfile ();
+  gts_object_stats_write (snapshot, fp);
+  content = file_content (fp, &length);
+  fclose (fp);
+  g_assert (strstr (content, "CountedObject") != NULL);
+  g_assert (strstr (content, "UnusedObject") == NULL);
+  g_free (content);
+  g_array_free (snapshot, TRUE);
+
+  /* peak reset */
+  gts_object_stats_reset_peak ();
+  gts_object_class_stats (klass, &stats);
+  g_assert (stats.n_peak == 0 && stats.n_total == NT*N);
+
+  g_free (o);
+
+  return EXIT_SUCCESS;
+}
@@ -65,7 +65,7 @@ int main (int argc, char * argv[])
     return 1;
   }
 
-  fp = gts_file_new (fptr_in);
+  fp = gts_file_new_mapped (fptr_in);
   if (gts_surface_read (s, fp)) {
     fputs ("gts2obj: file on standard input is not a valid GTS file\n",
            stderr);
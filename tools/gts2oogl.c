@@ -800,7 +800,7 @@ int main (int argc, char * argv[])
 			     gts_face_class (),
 			     gts_edge_class (),
 			     gts_vertex_class ());
-  fp = gts_file_new (stdin);
+  fp = gts_file_new_mapped (stdin);
   if (gts_surface_read (surface, fp)) {
     fputs ("gts2oogl: the file on standard input is not a valid GTS file\n", 
 	   stderr);
@@ -30,29 +30,17 @@
 #endif /* HAVE_UNISTD_H */
 #include "gts.h"
 
-static void write_face (GtsTriangle * t)
-{
-  GtsVertex * v1, * v2, * v3;
-  GtsVector n;
-
-  gts_triangle_vertices (t, &v1, &v2, &v3);
-  gts_triangle_normal (t, &n[0], &n[1], &n[2]);
-  gts_vector_normalize (n);
-  printf ("facet normal %g %g %g\nouter loop\n", n[0], n[1], n[2]);
-  printf ("vertex %g %g %g\n", 
-	  GTS_POINT (v1)->x, GTS_POINT (v1)->y, GTS_POINT (v1)->z);
-  printf ("vertex %g %g %g\n", 
-	  GTS_POINT (v2)->x, GTS_POINT (v2)->y, GTS_POINT (v2)->z);
-  printf ("vertex %g %g %g\n", 
-	  GTS_POINT (v3)->x, GTS_POINT (v3)->y, GTS_POINT (v3)->z);
-  puts ("endloop\nendfacet");
-}
+#ifdef NATIVE_WIN32
+#  include <fcntl.h>
+#  include <io.h>
+#endif 
 
 int main (int argc, char * argv[])
 {
   int c = 0;
   gboolean verbose = FALSE;
   gboolean revert  = FALSE;  
+  gboolean binary  = FALSE;
   GtsSurface * s;
   GtsFile * fp;
 
@@ -63,25 +51,30 @@ int main (int argc, char * argv[])
 #ifdef HAVE_GETOPT_LONG
     static struct option long_options[] = {
       {"revert", no_argument, NULL, 'r'},
+      {"binary", no_argument, NULL, 'b'},
       {"help", no_argument, NULL, 'h'},
       {"verbose", no_argument, NULL, 'v'},
       { NULL }
     };
     int option_index = 0;
-    switch ((c = getopt_long (argc, argv, "hvr",
+    switch ((c = getopt_long (argc, argv, "hvrb",
 			      long_options, &option_index))) {
 #else /* not HAVE_GETOPT_LONG */
-    switch ((c = getopt (argc, argv, "hvr"))) {
+    switch ((c = getopt (argc, argv, "hvrb"))) {
 #endif /* not HAVE_GETOPT_LONG */
     case 'r': /* revert */
       revert = TRUE;
       break;
+    case 'b': /* binary */
+      binary = TRUE;
+      break;
     case 'h': /* help */
       fprintf (stderr,
              "Usage: gts2stl [OPTION]... < input.gts > output.stl\n"
 	     "Convert a GTS file to STL format.\n"
 	     "\n"
 	     "  -r,     --revert       revert face normals\n"
+	     "  -b,     --binary       write a binary STL file\n"
 	     "  -v,     --verbose      display surface statistics\n"
 	     "  -h,     --help         display this help and exit\n"
 	     "\n"
@@ -102,7 +95,7 @@ int main (int argc, char * argv[])
 		       gts_face_class (),
 		       gts_edge_class (),
 		       gts_vertex_class ());
-  fp = gts_file_new (stdin);
+  fp = gts_file_new_mapped (stdin);
   if (gts_surface_read (s, fp)) {
     fputs ("gts2stl: file on standard input is not a valid GTS file\n", 
 	   stderr);
@@ -115,9 +108,11 @@ int main (int argc, char * argv[])
   if (verbose)
     gts_surface_print_stats (s, stderr);
 
-  puts ("solid");
-  gts_surface_foreach_face (s, (GtsFunc) write_face, NULL);
-  puts ("endsolid");
+#ifdef NATIVE_WIN32
+  if (binary)
+    _setmode (_fileno (stdout), _O_BINARY);
+#endif 
+  gts_surface_write_stl (s, stdout, binary);
 
   return 0;
 }
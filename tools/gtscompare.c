@@ -43,11 +43,6 @@ typedef struct {
 
 Colormap * colormap = NULL;
 
-static void build_list (GtsTriangle * t, GSList ** list)
-{
-  *list = g_slist_prepend (*list, gts_bbox_triangle (gts_bbox_class (), t));
-}
-
 static Color * color_new (gdouble r, gdouble g, gdouble b)
 {
   Color * c = g_malloc (sizeof (Color));
@@ -112,10 +107,8 @@ static void foreach_vertex (GtsVertex * v, gpointer * info)
   FILE * fp = info[0];
   GHashTable * hash = info[1];
   guint * nv = info[2];
-  GNode * tree = info[3];
-  gdouble d = sqrt (gts_bb_tree_point_distance (tree, GTS_POINT (v),
-			(GtsBBoxDistFunc) gts_point_triangle_distance2,
-			NULL));
+  gdouble * distance = info[3];
+  gdouble d = distance[*nv];
   Color c;
   
   if (logscale) {
@@ -170,21 +163,41 @@ static void foreach_triangle (GtsTriangle * t, gpointer * info)
   fprintf (fp, "3 %u %u %u\n", p1 - 1, p2 - 1, p3 - 1);
 }
 
-static void oogl_surface (GtsSurface * s, FILE * fptr, GNode * tree)
+static void add_vertex (GtsPoint * p, gdouble ** xyz)
+{
+  *((*xyz)++) = p->x;
+  *((*xyz)++) = p->y;
+  *((*xyz)++) = p->z;
+}
+
+static void oogl_surface (GtsSurface * s, FILE * fptr, GtsBVH * tree,
+			  guint threads)
 {
   gpointer info[4];
   GtsSurfaceStats stats;
+  gdouble * xyz, * p, * distance;
   guint np = 0;
 
   g_return_if_fail (s != NULL);
   g_return_if_fail (fptr != NULL);
 
+  gts_surface_stats (s, &stats);
+
+  /* distances of all the vertices, in the order of
+     gts_surface_foreach_vertex() */
+  p = xyz = g_malloc (3*stats.edges_per_vertex.n*sizeof (gdouble));
+  gts_surface_foreach_vertex (s, (GtsFunc) add_vertex, &p);
+  distance = g_malloc0 (stats.edges_per_vertex.n*sizeof (gdouble));
+  if (tree)
+    gts_bvh_points_distance (tree, xyz, stats.edges_per_vertex.n, 
+			     distance, NULL, NULL, threads);
+  g_free (xyz);
+
   info[0] = fptr;
   info[1] = g_hash_table_new (NULL, NULL);
   info[2] = &np;
-  info[3] = tree;
+  info[3] = distance;
   
-  gts_surface_stats (s, &stats);
   fprintf (fptr, "COFF %u %u %u\n",
 	   stats.edges_per_vertex.n, 
 	   stats.n_faces,
@@ -193,6 +206,7 @@ static void oogl_surface (GtsSurface * s, FILE * fptr, GNode * tree)
   gts_surface_foreach_face (s, (GtsFunc)foreach_triangle, info);
 
   g_hash_table_destroy (info[1]);
+  g_free (distance);
 }
 
 static void build_bbox (GtsPoint * p, GtsBBox * bbox)
@@ -218,6 +232,7 @@ int main (int argc, char * argv[])
   GtsSurfaceQualityStats sq1, sq2;
   gboolean image = FALSE;
   gboolean symmetric = FALSE;
+  guint threads = 1;
   int c = 0;
   FILE * fptr;
   GtsFile * fp;
@@ -240,13 +255,14 @@ int main (int argc, char * argv[])
       {"min", required_argument, NULL, 'm'},
       {"max", required_argument, NULL, 'M'},
       {"reverse", no_argument, NULL, 'r'},
+      {"threads", required_argument, NULL, 'j'},
       { NULL }
     };
     int option_index = 0;
-    switch ((c = getopt_long (argc, argv, "c:hm:M:risl",
+    switch ((c = getopt_long (argc, argv, "c:hj:m:M:risl",
 			      long_options, &option_index))) {
 #else /* not HAVE_GETOPT_LONG */
-    switch ((c = getopt (argc, argv, "c:hm:M:risl"))) {
+    switch ((c = getopt (argc, argv, "c:hj:m:M:risl"))) {
 #endif /* not HAVE_GETOPT_LONG */
     case 'l':
       logscale = TRUE;
@@ -277,6 +293,9 @@ int main (int argc, char * argv[])
     case 'r': /* reverse colormap */
       colormap->reversed = TRUE;
       break;
+    case 'j': /* number of threads */
+      threads = strtol (optarg, NULL, 0);
+      break;
     case 'h': /* help */
       fprintf (stderr,
 	     "Usage: gtscompare [OPTION]... FILE1 FILE2 DELTA\n"
@@ -290,6 +309,7 @@ int main (int argc, char * argv[])
 	     "  -M VAL, --max=VAL      use VAL as maximum scaling value\n"
 	     "  -r,     --reverse      reverse colormap\n"
 	     "  -l,     --log          use log scale\n"
+	     "  -j N,   --threads=N    use N threads, 0 for one per processor\n"
 	     "  -h,     --help         display this help and exit\n"
 	     "\n"
 	     "Report bugs to %s\n",
@@ -324,7 +344,7 @@ int main (int argc, char * argv[])
 			gts_face_class (),
 			gts_edge_class (),
 			gts_vertex_class ());
-  fp = gts_file_new (fptr);
+  fp = gts_file_new_mapped (fptr);
   if (gts_surface_read (s1, fp)) {
     fprintf (stderr, "gtscompare: file `%s' is not a valid GTS file\n", 
 	     argv[optind]);
@@ -345,7 +365,7 @@ int main (int argc, char * argv[])
 			gts_face_class (),
 			gts_edge_class (),
 			gts_vertex_class ());
-  fp = gts_file_new (fptr);
+  fp = gts_file_new_mapped (fptr);
   if (gts_surface_read (s2, fp)) {
     fprintf (stderr, "gtscompare: file `%s' is not a valid GTS file\n", 
 	     argv[optind + 1]);
@@ -361,7 +381,7 @@ int main (int argc, char * argv[])
   gts_surface_stats (s2, &ss2);
   gts_surface_quality_stats (s1, &sq1);
   gts_surface_quality_stats (s2, &sq2);
-  gts_surface_distance (s1, s2, delta, &fd1, &bd1);
+  gts_surface_distance_parallel (s1, s2, delta, &fd1, &bd1, threads);
   v1 = gts_surface_volume (s1);
   v2 = gts_surface_volume (s2);
   bbox = gts_bbox_new (GTS_BBOX_CLASS (gts_bbox_class()),
@@ -436,7 +456,7 @@ int main (int argc, char * argv[])
   if (l2 == 0.0) l2 = 1.0;
   if (l1 == 0.0) l1 = 1.0;
   if (symmetric) {
-    gts_surface_distance (s2, s1, delta, &fd2, &bd2);
+    gts_surface_distance_parallel (s2, s1, delta, &fd2, &bd2, threads);
     fprintf (stderr,
 	   "------------------ Distance between faces -------------------\n"
 	   "Minimum:     %16.4g (%5.2f%%) %12.4g (%5.2f%%)\n"
@@ -484,12 +504,8 @@ int main (int argc, char * argv[])
   }
 
   if (image) {
-    GSList * bboxes = NULL;
-    GNode * tree;
-    
-    gts_surface_foreach_face (s2, (GtsFunc) build_list, &bboxes);
-    tree = gts_bb_tree_new (bboxes);
-    g_slist_free (bboxes);
+    GtsBVH * tree = gts_bvh_surface_full (s2, GTS_BVH_BINNED_SAH, 4, 
+					  threads);
   
     if (min == G_MAXDOUBLE) {
       if (logscale)
@@ -503,8 +519,9 @@ int main (int argc, char * argv[])
       else
 	max = fd1.max;
     }
-    oogl_surface (s1, stdout, tree);
-    gts_bb_tree_destroy (tree, TRUE);
+    oogl_surface (s1, stdout, tree, threads);
+    if (tree)
+      gts_bvh_destroy (tree, TRUE);
   }
 
   return 0;
@@ -0,0 +1,89 @@
+/* GTS - Library for the manipulation of triangulated surfaces
+ * Copyright (C) 1999 Stéphane Popinet
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <stdlib.h>
+#include <locale.h>
+#include "config.h"
+#ifdef HAVE_GETOPT_H
+#  include <getopt.h>
+#endif /* HAVE_GETOPT_H */
+#ifdef HAVE_UNISTD_H
+#  include <unistd.h>
+#endif /* HAVE_UNISTD_H */
+#include "gts.h"
+
+#ifdef NATIVE_WIN32
+#  include <fcntl.h>
+#  include <io.h>
+#endif 
+
+int main (int argc, char * argv[])
+{
+  int c = 0;
+  GtsFile * fp;
+
+  if (!setlocale (LC_ALL, "POSIX"))
+    g_warning ("cannot set locale to POSIX");
+
+  while (c != EOF) {
+#ifdef HAVE_GETOPT_LONG
+    static struct option long_options[] = {
+      {"help", no_argument, NULL, 'h'},
+      { NULL }
+    };
+    int option_index = 0;
+    switch ((c = getopt_long (argc, argv, "h",
+			      long_options, &option_index))) {
+#else /* not HAVE_GETOPT_LONG */
+    switch ((c = getopt (argc, argv, "h"))) {
+#endif /* not HAVE_GETOPT_LONG */
+    case 'h': /* help */
+      fprintf (stderr,
+             "Usage: gtssoup [OPTION]... < input > output.soup\n"
+	     "Convert an STL or PLY file to a binary triangle soup, as read\n"
+	     "by the oocs example for out-of-core simplification.\n"
+	     "\n"
+	     "  -h,     --help         display this help and exit\n"
+	     "\n"
+	     "Report bugs to %s\n",
+	     GTS_MAINTAINER);
+      return 0;
+      break;
+    case '?': /* wrong options */
+      fprintf (stderr, "Try `gtssoup --help' for more information.\n");
+      return 1;
+    }
+  }
+
+#ifdef NATIVE_WIN32
+  _setmode (_fileno (stdin), _O_BINARY);
+  _setmode (_fileno (stdout), _O_BINARY);
+#endif 
+
+  fp = gts_file_new_mapped (stdin);
+  if (gts_triangle_soup_convert (fp, stdout)) {
+    fputs ("gtssoup: file on standard input is not a valid STL or PLY file\n", 
+	   stderr);
+    fprintf (stderr, "stdin:%d:%d: %s\n", fp->line, fp->pos, fp->error);
+    return 1; /* failure */
+  }
+  gts_file_destroy (fp);
+
+  return 0;
+}